@@ -11,60 +11,490 @@
 /* Macro for the maximum transfer unit for Classical CAN frame payload (8 bytes = 2 words) */
 #define MAX_MTU_WORDS   (2u)
 
+/* FlexCAN protocol engine clock, SOSCDIV2 fed by the 8 MHz crystal */
+#define CAN_CLOCK_HZ        (8000000u)
+
+/* Nominal bitrate, sample point and sample point tolerance (per mille), looked up at compile
+ * time in CAN_bit_timing_table.h, regenerated by tools/bit_timing_table.py */
+#define CAN_BITRATE         (500000u)
+#define CAN_SAMPLE_POINT    (875u)
+#define CAN_SP_TOLERANCE    (50u)
+
+/* Payload size of every message buffer in CAN FD mode: 8, 16, 32 or 64 bytes */
+#define CAN_FD_PAYLOAD_BYTES     (64u)
+
+/* Maximum transfer unit for a CAN FD frame payload in words */
+#define MAX_FD_MTU_WORDS         (CAN_FD_PAYLOAD_BYTES / 4u)
+
+/* FlexCAN protocol engine clock in CAN FD mode, the bus clock running from the 48 MHz FIRC */
+#define CAN_FD_CLOCK_HZ          (48000000u)
+
+/* Nominal and data phase bitrates and data phase sample point (per mille) in CAN FD mode */
+#define CAN_FD_NOMINAL_BITRATE   (1000000u)
+#define CAN_FD_DATA_BITRATE      (4000000u)
+#define CAN_FD_DATA_SAMPLE_POINT (750u)
+
+/* Number of frames the software reception ring can hold, must be a power of two */
+#define RX_RING_SIZE    (32u)
+
+#if (RX_RING_SIZE & (RX_RING_SIZE - 1u)) != 0u
+#error "RX_RING_SIZE must be a power of two"
+#endif
+
+/* Number of frames the software transmission queue can hold, must be a power of two */
+#define TX_QUEUE_SIZE   (16u)
+
+#if (TX_QUEUE_SIZE & (TX_QUEUE_SIZE - 1u)) != 0u
+#error "TX_QUEUE_SIZE must be a power of two"
+#endif
+
+/* Number of FlexCAN0 message buffers dedicated to hot IDs, see install_hot_ID(). They come out
+ * of the room of the RX FIFO ID filter table, two message buffers per eight filter elements.
+ * FlexCAN1 has too few message buffers to spare any */
+#define HOT_MB_COUNT    (4u)
+
+#if HOT_MB_COUNT > 8u
+#error "HOT_MB_COUNT must not exceed 8, the hot message buffers are served by the MB 16-31 interrupt"
+#endif
+
+/* Number of identifiers whose worst-case queuing delay is tracked, later ones are not tracked */
+#define TX_DELAY_SLOTS  (16u)
+
+/* Lowest local transmission priority, see transmit_frame_prio() */
+#define TX_PRIO_LOWEST  (7u)
+
+/* NVIC priority of the message buffer interrupts, only the upper nibble is implemented.
+ * Interrupts at this same priority never preempt them, see transmit_frame_ISR() */
+#define CAN_MB_IRQ_PRIORITY (0x40u)
+
+/* Number of frames the CAN FD software reception ring can hold, must be a power of two */
+#define RX_FD_RING_SIZE (8u)
+
+#if (RX_FD_RING_SIZE & (RX_FD_RING_SIZE - 1u)) != 0u
+#error "RX_FD_RING_SIZE must be a power of two"
+#endif
+
+/* Number of transmission confirmations kept for transmitted_frame(), must be a power of two */
+#define TX_DONE_RING_SIZE (16u)
+
+#if (TX_DONE_RING_SIZE & (TX_DONE_RING_SIZE - 1u)) != 0u
+#error "TX_DONE_RING_SIZE must be a power of two"
+#endif
+
+/* Number of RX FIFO filters with their own hit counter, hits on later filters share the last one */
+#define FILTER_HIT_COUNTERS (32u)
+
+/* Number of RX FIFO entries the DMA reception buffer can hold, must be a power of two */
+#define RX_DMA_RING_SIZE (32u)
+
+#if (RX_DMA_RING_SIZE & (RX_DMA_RING_SIZE - 1u)) != 0u
+#error "RX_DMA_RING_SIZE must be a power of two"
+#endif
+
+/**
+ * FlexCAN instances, each with its own queues, filters and counters
+ */
+typedef enum{
+	FlexCAN_0 = 0,  /* 32 message buffers, CAN FD capable */
+	FlexCAN_1 = 1,  /* 16 message buffers, Classical CAN only */
+	FlexCAN_instances
+} FlexCAN_instance_t;
+
 /**
  * Status codes for the return value status
  */
 typedef enum{
 	Failure = 0,
-	BufferFull = 0,
-	Success = 1
+	Success = 1,
+	BufferFull = 2,
+	Suppressed = 3  /* The frame was withheld on purpose, see CAN_shaping.h */
 } status_t;
 
+/* Flag of frame_t and fd_frame_t IDs marking a 29-bit extended ID, the bits below it
+ * hold the 11-bit standard or the 29-bit extended ID right-aligned */
+#define CAN_ID_EXT      (0x80000000u)
+#define CAN_ID_MASK     (0x1FFFFFFFu)
+
 /**
  *  Structure for a CAN frame
  */
 typedef struct{
-	uint32_t ID;
+	uint32_t ID;        /* Standard ID, or extended ID ORed with CAN_ID_EXT */
 	uint32_t payload[MAX_MTU_WORDS];
+	uint64_t timestamp; /* Reception or transmission time in CAN bit times, see FlexCAN_timer_now() */
 } frame_t;
 
 /**
- * Initialize the 0th FlexCAN instance for transmission and reception
- * of CAN-FD frames at 4 Mbit/s and 1 Mbit/s in data and nominal phases respectively.
+ *  Handler of a received frame, called from the message buffer interrupt
+ */
+typedef void (*rx_callback_t)(const frame_t* frame);
+
+/**
+ *  Raw RX FIFO output entry as the DMA copies it: control/status word, ID word and payload.
+ *  The IDE flag is bit 21 of the control/status word. The standard ID sits at bits [28..18]
+ *  of the ID word and the extended ID at bits [28..0].
+ */
+typedef struct{
+	uint32_t CS;
+	uint32_t ID;
+	uint32_t payload[MAX_MTU_WORDS];
+} rx_fifo_entry_t;
+
+/**
+ *  Structure for a CAN FD frame
+ */
+typedef struct{
+	uint32_t ID;     /* Standard ID, or extended ID ORed with CAN_ID_EXT */
+	uint8_t length;  /* Payload length in bytes, rounded up to the next valid CAN FD length on transmission */
+	uint8_t BRS;     /* 1 to transmit the data phase at CAN_FD_DATA_BITRATE */
+	uint32_t payload[MAX_FD_MTU_WORDS];
+	uint64_t timestamp; /* Reception time in nominal CAN bit times, see FlexCAN_timer_now() */
+} fd_frame_t;
+
+/**
+ *  Structure for an RX FIFO acceptance filter
+ */
+typedef struct{
+	uint32_t ID;       /* Standard or extended ID to accept */
+	uint32_t mask;     /* Bits of ID that must match, same alignment as ID */
+	uint8_t  extended; /* 1 for a 29-bit extended ID, 0 for an 11-bit standard one */
+} filter_t;
+
+/**
+ *  Snapshot of the reception counters
+ */
+typedef struct{
+	uint32_t received;        /* Frames taken out of the RX FIFO */
+	uint32_t fifo_warnings;   /* Times the RX FIFO reached 5 pending frames (BUF6I) */
+	uint32_t fifo_overflows;  /* Times the RX FIFO was full when a frame arrived (BUF7I) */
+	uint32_t ring_overruns;   /* Frames discarded because the software ring was full */
+	uint32_t dropped;         /* Lower bound of frames lost, one per overflow plus every ring and hot message buffer overrun */
+	uint32_t filter_hits[FILTER_HIT_COUNTERS]; /* Frames accepted by each RX FIFO filter, from IDHIT */
+} rx_stats_t;
+
+/**
+ *  Queuing delay of the frames transmitted with an identifier
+ */
+typedef struct{
+	uint32_t ID;
+	uint32_t sent;         /* Frames transmitted with this identifier */
+	uint32_t worst_delay;  /* Longest time from queuing to the bus, in timer ticks */
+} tx_delay_t;
+
+/**
+ * Initialize a FlexCAN instance for transmission and reception through the RX FIFO,
+ * with the bit timings solved for CAN_BITRATE and CAN_SAMPLE_POINT from CAN_CLOCK_HZ.
+ * FlexCAN0 is routed to its transceiver pins on PORT E; the FlexCAN1 pins depend on the
+ * board and are left to the application.
  *
+ * @param [in] can The FlexCAN instance
  * @return Success If the peripheral was started wihtout errors
  * @return Failure If at least an error occurred during the startup sequence
  */
-status_t FlexCAN_init_RXFIFO(void);
+status_t FlexCAN_init_RXFIFO(FlexCAN_instance_t can);
 
 /**
- * Setup a message buffer for reception of a specific ID
+ * Setup the RX FIFO for reception of a single specific ID, replacing the
+ * installed filters
  *
- * @param[in] filter
+ * @param [in] can The FlexCAN instance
+ * @param[in] id     Standard ID, or extended ID ORed with CAN_ID_EXT, to receive
  * @return Success If the filters were installed correctly
  * @return Failure If the setup couldn't be performed
  */
-status_t install_ID(uint32_t id);
+status_t install_ID(FlexCAN_instance_t can, uint32_t id);
+
+/**
+ * Program a whole list of acceptance filters into the RX FIFO ID filter table in a
+ * single freeze window. The most precise table format that fits the list is chosen:
+ * format A (one full ID per element), format B (two standard or 14-bit extended IDs per
+ * element) or format C (four 8-bit partial IDs per element); partial formats are only
+ * used when the masks of the filters don't care about the bits they drop.
+ * Format C elements have no IDE bit: they compare standard ID bits [10..3] of standard frames
+ * and extended ID bits [28..21] of extended frames, so a list of one ID type also accepts
+ * frames of the other type whose compared bits match. Check CAN_ID_EXT of the received
+ * frames, or keep the list within format A or B, when that matters.
+ * The first 8 + 2 * RFFN elements get their own mask, the rest share the RX FIFO global
+ * mask, which is the intersection of their masks and may over-accept.
+ *
+ * @param [in] can The FlexCAN instance
+ * @param [in]  filters Array of filters to install, replacing the current ones
+ * @param [in]  count   Number of filters in the array, 0 rejects every frame (format D)
+ * @param [out] slots   Optional array of count entries where the filter number (the one
+ *                      reported by IDHIT) assigned to each filter is written, may be NULL
+ * @return Success If the filters were installed
+ * @return Failure If the list doesn't fit in the table in any format
+ */
+status_t install_filters(FlexCAN_instance_t can, const filter_t* filters, uint32_t count, uint16_t* slots);
+
+/**
+ * Dedicate one of the HOT_MB_COUNT message buffers of FlexCAN0 to a latency critical ID. Its frames are
+ * matched by the message buffer before the RX FIFO is considered, and handed to the callback
+ * straight from the message buffer interrupt, so they never wait behind FIFO traffic nor go
+ * through receive_frame(). The callback runs in interrupt context and must return quickly.
+ * Not available in CAN FD mode.
+ *
+ * @param [in] can The FlexCAN instance
+ * @param [in] slot     Hot message buffer to use, below HOT_MB_COUNT, replacing its current ID
+ * @param [in] id       Standard ID, or extended ID ORed with CAN_ID_EXT, to receive
+ * @param [in] callback Handler of the received frames
+ * @return Success If the message buffer was set up
+ * @return Failure If the slot is out of range, the callback is NULL, the module is in CAN FD mode
+ *                 or the instance has no hot message buffers
+ */
+status_t install_hot_ID(FlexCAN_instance_t can, uint8_t slot, uint32_t id, rx_callback_t callback);
+
+/**
+ * Queue a single CAN frame for transmission, without blocking, with the most urgent local
+ * priority so only its ID ranks it. Same as transmit_frame_prio() with a priority of 0.
+ * Must only be called from one context.
+ *
+ * @param [in] can The FlexCAN instance
+ * @param [in] frame  The reference to the frame that is going to be transmitted
+ * @return Success    If the frame was queued for transmission
+ * @return BufferFull If the transmission queue was full and the frame couldn't
+ * 					  be queued
+ * @return Failure    If the instance runs in CAN FD mode, see transmit_frame_FD()
+ */
+status_t transmit_frame(FlexCAN_instance_t can, frame_t* frame);
 
 /**
- * Transmit a single CAN frame
+ * Queue a single CAN frame for transmission with a local priority, without blocking.
+ * The message buffer interrupt keeps the pending frames ordered by local priority first
+ * and ID second, always loads the most urgent ones into the free transmission message
+ * buffers, and aborts the least urgent loaded frame still waiting for arbitration when a
+ * more urgent one is pending and no message buffer is free.
+ * Must only be called from one context.
  *
+ * @param [in] can The FlexCAN instance
  * @param [in] frame  The reference to the frame that is going to be transmitted
- * @return Success    If the frame was sent immediately
- * @return BufferFull If the transmission message buffer was full and the frame couldn't
- * 					  be transmitted
- * @return Failure    If an error occurred during the transmission
+ * @param [in] prio   Local priority, from 0 (most urgent) to TX_PRIO_LOWEST
+ * @return Success    If the frame was queued for transmission
+ * @return BufferFull If the transmission queue was full and the frame couldn't
+ * 					  be queued
+ * @return Failure    If the priority is above TX_PRIO_LOWEST or the instance runs in CAN FD mode
+ */
+status_t transmit_frame_prio(FlexCAN_instance_t can, frame_t* frame, uint8_t prio);
+
+/**
+ * Queue a burst of CAN frames for transmission, without blocking, with the most urgent
+ * local priority. The accepted frames are published to the message buffer interrupt at
+ * once and it is pended a single time, which loads as many of them as message buffers
+ * are idle in one pass. Must be called from the same context as transmit_frame().
+ *
+ * @param [in] can The FlexCAN instance
+ * @param [in] frames The frames that are going to be transmitted, in order
+ * @param [in] count  Number of frames
+ * @return The number of leading frames queued, less than count if the queue filled up,
+ *         0 if the instance runs in CAN FD mode
+ */
+uint32_t transmit_batch(FlexCAN_instance_t can, const frame_t* frames, uint32_t count);
+
+/**
+ * Hand a CAN frame straight to the pending frames of the message buffer interrupt, loading it
+ * into a message buffer right away if it is among the most urgent ones. Unlike transmit_frame()
+ * it doesn't go through the queue, so it can be used besides the context that calls it.
+ * Must only be called from interrupts at CAN_MB_IRQ_PRIORITY, which can't preempt the
+ * message buffer interrupts nor be preempted by them.
+ *
+ * @param [in] can The FlexCAN instance
+ * @param [in] frame  The reference to the frame that is going to be transmitted
+ * @param [in] prio   Local priority, from 0 (most urgent) to TX_PRIO_LOWEST
+ * @return Success    If the frame is pending transmission
+ * @return BufferFull If TX_QUEUE_SIZE frames are already pending
+ * @return Failure    If the priority is above TX_PRIO_LOWEST or the instance runs in CAN FD mode
+ */
+status_t transmit_frame_ISR(FlexCAN_instance_t can, const frame_t* frame, uint8_t prio);
+
+/**
+ * Copy the worst-case queuing delay of each transmitted identifier, for the first
+ * TX_DELAY_SLOTS identifiers transmitted since startup.
+ *
+ * @param [in] can The FlexCAN instance
+ * @param [out] delays Array where the delays are copied
+ * @param [in]  max    Number of entries the array can hold
+ * @return The number of entries copied
+ */
+uint32_t get_tx_delays(FlexCAN_instance_t can, tx_delay_t* delays, uint32_t max);
+
+/**
+ * Receive a single CAN frame from the software reception ring, without blocking.
+ * The ring is filled by the RX FIFO interrupt, so this is the consumer side of a
+ * single-producer/single-consumer queue and must only be called from one context.
+ *
+ * @param [in] can The FlexCAN instance
+ * @param [out] frame A reference to a frame where the received one is copied
+ * @return Success If a frame was dequeued
+ * @return Failure If the ring was empty
+ */
+status_t receive_frame(FlexCAN_instance_t can, frame_t* frame);
+
+/**
+ * Dequeue the confirmation of a frame that left the bus, without blocking, with its
+ * timestamp set to the time the mailbox captured on transmission.
+ * Confirmations not collected are dropped once TX_DONE_RING_SIZE of them pile up.
+ *
+ * @param [in] can The FlexCAN instance
+ * @param [out] frame A reference to a frame where the transmitted one is copied
+ * @return Success If a confirmation was dequeued
+ * @return Failure If no frame was transmitted since the last call
+ */
+status_t transmitted_frame(FlexCAN_instance_t can, frame_t* frame);
+
+/**
+ * Current value of the FlexCAN free running timer extended to 64 bits.
+ * The timer counts nominal bit times; its 16-bit wraparounds are tracked every time the
+ * driver samples it, which happens on every message buffer interrupt and on this call. If
+ * the bus can stay idle longer than 65536 bit times, register an anchor with
+ * set_timestamp_anchor() so no wraparound goes unnoticed.
+ * Must not be called from interrupts.
+ *
+ * @param [in] can The FlexCAN instance
+ * @return The number of bit times elapsed since the module started
+ */
+uint64_t FlexCAN_timer_now(FlexCAN_instance_t can);
+
+/**
+ * Anchor the timestamp extension to a monotonic clock such as an LPIT0 channel or a
+ * SysTick based counter, which is then used to count the 16-bit timer wraparounds.
+ *
+ * @param [in] can The FlexCAN instance
+ * @param [in] anchor    Function returning the anchor clock ticks, NULL to remove the anchor
+ * @param [in] anchor_hz Frequency of the anchor clock
+ */
+void set_timestamp_anchor(FlexCAN_instance_t can, uint64_t (*anchor)(void), uint32_t anchor_hz);
+
+/**
+ * Lend the oldest received frame in place in the reception ring, without copying it.
+ * The slot stays valid and untouched by the interrupt until release_frames() is called.
+ *
+ * @param [in] can The FlexCAN instance
+ * @param [out] frame Pointer set to the frame inside the ring
+ * @return Success If a frame was lent
+ * @return Failure If the ring was empty
+ */
+status_t lend_frame(FlexCAN_instance_t can, frame_t** frame);
+
+/**
+ * Lend every received frame stored contiguously from the oldest one, up to the end of the ring.
+ * Frames past the wraparound are lent by the next call once these are released.
+ *
+ * @param [in] can The FlexCAN instance
+ * @param [out] frames Pointer set to the first frame of the span inside the ring
+ * @return The number of frames in the span, 0 if the ring was empty
+ */
+uint32_t lend_frames(FlexCAN_instance_t can, frame_t** frames);
+
+/**
+ * Give back to the interrupt the oldest lent frames of the reception ring
+ *
+ * @param [in] can The FlexCAN instance
+ * @param [in] count Number of frames to release, at most the number lent
+ */
+void release_frames(FlexCAN_instance_t can, uint32_t count);
+
+/**
+ * Copy the reception counters. The copy doesn't mask the interrupts, so each counter is
+ * consistent on its own but they may come from slightly different instants.
+ *
+ * @param [in] can The FlexCAN instance
+ * @param [out] stats Where the counters are copied
+ */
+void get_rx_stats(FlexCAN_instance_t can, rx_stats_t* stats);
+
+/**
+ * Switch the RX FIFO to DMA mode: every received frame is moved by an eDMA channel
+ * into a circular RAM buffer without CPU involvement, and the RX FIFO interrupt
+ * (and with it receive_frame()) stops being fed. Call after FlexCAN_init_RXFIFO().
+ * The buffer is overwritten if it is not consumed at least every RX_DMA_RING_SIZE frames.
+ *
+ * @param [in] can The FlexCAN instance
+ * @return Success If the DMA channel and the FlexCAN were configured
+ */
+status_t enable_RX_DMA(FlexCAN_instance_t can);
+
+/**
+ * Consume a batch of frames from the DMA reception buffer, without blocking.
+ * Timestamps are extended against the current timer, so the batch must be consumed
+ * within 65536 bit times of its reception. Filter hits are counted here for this mode.
+ *
+ * @param [in] can The FlexCAN instance
+ * @param [out] frames Array where the received frames are copied
+ * @param [in]  max    Maximum number of frames that fit in the array
+ * @return The number of frames copied, 0 if the buffer was empty
+ */
+uint32_t receive_frames_DMA(FlexCAN_instance_t can, frame_t* frames, uint32_t max);
+
+/**
+ * Lend the entries the DMA completed, in place in the DMA reception buffer and up to its end.
+ * The DMA keeps writing regardless, so the entries must be parsed before it laps the buffer.
+ * Entries carry the raw 16-bit timestamp in the low half of their CS word.
+ *
+ * @param [in] can The FlexCAN instance
+ * @param [out] entries Pointer set to the first entry of the span
+ * @return The number of entries in the span, 0 if the buffer was empty
+ */
+uint32_t lend_frames_DMA(FlexCAN_instance_t can, rx_fifo_entry_t** entries);
+
+/**
+ * Mark the oldest lent entries of the DMA reception buffer as consumed
+ *
+ * @param [in] can The FlexCAN instance
+ * @param [in] count Number of entries to release, at most the number lent
+ */
+void release_frames_DMA(FlexCAN_instance_t can, uint32_t count);
+
+/**
+ * Initialize FlexCAN0 in CAN FD mode at CAN_FD_NOMINAL_BITRATE and
+ * CAN_FD_DATA_BITRATE, with CAN_FD_PAYLOAD_BYTES per message buffer and transceiver delay
+ * compensation. The RX FIFO can't hold CAN FD frames, so reception goes through message
+ * buffers accepting every standard and extended ID, drained by interrupt into a software ring.
+ * Use instead of FlexCAN_init_RXFIFO().
+ *
+ * @param [in] can The FlexCAN instance
+ * @return Success If the peripheral was started without errors
+ * @return Failure If the instance has no CAN FD
+ */
+status_t FlexCAN_init_FD(FlexCAN_instance_t can);
+
+/**
+ * Transmit a single CAN FD frame through an idle message buffer, without blocking.
+ * Must only be called from one context.
+ *
+ * @param [in] can The FlexCAN instance
+ * @param [in] frame  The reference to the frame that is going to be transmitted
+ * @return Success    If the frame was loaded for transmission
+ * @return BufferFull If every transmission message buffer is busy
+ * @return Failure    If the frame is longer than CAN_FD_PAYLOAD_BYTES
+ */
+status_t transmit_frame_FD(FlexCAN_instance_t can, fd_frame_t* frame);
+
+/**
+ * Receive a single CAN FD frame from the software reception ring, without blocking.
+ * Must only be called from one context.
+ *
+ * @param [in] can The FlexCAN instance
+ * @param [out] frame A reference to a frame where the received one is copied
+ * @return Success If a frame was dequeued
+ * @return Failure If the ring was empty
+ */
+status_t receive_frame_FD(FlexCAN_instance_t can, fd_frame_t* frame);
+
+/**
+ * Payload length in bytes of a CAN FD data length code
+ *
+ * @param [in] dlc Data length code, 0 to 15
+ * @return The length in bytes, up to 64
  */
-status_t transmit_frame(frame_t* frame);
+uint8_t FD_dlc_to_length(uint8_t dlc);
 
 /**
- * Receive a single CAN frame
+ * Smallest CAN FD data length code that holds a payload length
  *
- * @param [in] frame A reference to a frame for transmitting
- * @return Success If a frame was read successfully
- * @return Failure If at least an error occurred
+ * @param [in] length Length in bytes, up to 64
+ * @return The data length code, 0 to 15
  */
-status_t receive_frame(frame_t* frame);
+uint8_t FD_length_to_dlc(uint8_t length);
 
 /**
  * Function for initializing the indicator green LED on board
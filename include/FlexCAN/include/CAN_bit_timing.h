@@ -0,0 +1,55 @@
+/**
+ * @file
+ * Header file for computing the FlexCAN bit timings
+ */
+
+#ifndef FLEXCAN_INCLUDE_CAN_BIT_TIMING_H_
+#define FLEXCAN_INCLUDE_CAN_BIT_TIMING_H_
+
+#include <FlexCAN/include/CAN_RXFIFO.h>
+
+/**
+ *  Structure for the CAN bit timings, each field holds its register encoding (value - 1)
+ */
+typedef struct {
+    uint16_t PRESDIV;
+    uint8_t PROPSEG;
+    uint8_t PSEG1;
+    uint8_t PSEG2;
+    uint8_t RJW;
+} CAN_bit_timings_t;
+
+/**
+ * Bit timing phases the solver can target
+ */
+typedef enum{
+	Nominal_phase = 0, /* CAN0_CBT ranges, arbitration phase */
+	Data_phase = 1     /* CAN0_FDCBT ranges, CAN FD data phase with bit rate switch */
+} bit_timing_phase_t;
+
+/* Bit timings of the configuration, looked up at compile time in CAN_bit_timing_table.h and
+ * checked against it by _Static_assert: CAN_BITRATE from CAN_CLOCK_HZ, and both phases of
+ * CAN FD mode from CAN_FD_CLOCK_HZ */
+extern const CAN_bit_timings_t CAN_timings;
+extern const CAN_bit_timings_t CAN_FD_nominal_timings;
+extern const CAN_bit_timings_t CAN_FD_data_timings;
+
+/**
+ * Search every legal prescaler and segment combination of the bit timing register for
+ * an exact bitrate with the closest sample point. Among equally close solutions the one with
+ * more time quanta per bit is chosen. The resynchronization jump width is made as wide
+ * as both phase segments allow. tools/bit_timing_table.py runs the same search offline.
+ *
+ * @param [in]  clock_hz     FlexCAN protocol engine clock
+ * @param [in]  bitrate      Bitrate in bit/s
+ * @param [in]  sample_point Desired sample point in per mille of the bit time
+ * @param [in]  tolerance    Maximum sample point deviation in per mille
+ * @param [in]  phase        Register whose ranges bound the search
+ * @param [out] timings      The solution found
+ * @return Success If a solution within tolerance exists
+ * @return Failure If the clock can't produce the bitrate within the register ranges and tolerance
+ */
+status_t solve_bit_timings(uint32_t clock_hz, uint32_t bitrate, uint16_t sample_point,
+                           uint16_t tolerance, bit_timing_phase_t phase, CAN_bit_timings_t* timings);
+
+#endif /* FLEXCAN_INCLUDE_CAN_BIT_TIMING_H_ */
@@ -0,0 +1,707 @@
+/**
+ * @file
+ * Header file of the FlexCAN bit timings selected at compile time, register encodings
+ * (value - 1) and the sample point reached in per mille
+ * Generated by tools/bit_timing_table.py, do not edit
+ */
+
+#ifndef FLEXCAN_INCLUDE_CAN_BIT_TIMING_TABLE_H_
+#define FLEXCAN_INCLUDE_CAN_BIT_TIMING_TABLE_H_
+
+#include <FlexCAN/include/CAN_RXFIFO.h>
+
+/* Classical CAN, CAN0_CBT */
+#if (CAN_CLOCK_HZ == 8000000u) && (CAN_BITRATE == 125000u) && (CAN_SAMPLE_POINT == 800u)
+#define CAN_NOMINAL_PRESDIV    (0u)
+#define CAN_NOMINAL_PROPSEG    (36u)
+#define CAN_NOMINAL_PSEG1      (12u)
+#define CAN_NOMINAL_PSEG2      (12u)
+#define CAN_NOMINAL_RJW        (12u)
+#define CAN_NOMINAL_SP_REACHED (796u)
+#elif (CAN_CLOCK_HZ == 8000000u) && (CAN_BITRATE == 125000u) && (CAN_SAMPLE_POINT == 875u)
+#define CAN_NOMINAL_PRESDIV    (0u)
+#define CAN_NOMINAL_PROPSEG    (46u)
+#define CAN_NOMINAL_PSEG1      (7u)
+#define CAN_NOMINAL_PSEG2      (7u)
+#define CAN_NOMINAL_RJW        (7u)
+#define CAN_NOMINAL_SP_REACHED (875u)
+#elif (CAN_CLOCK_HZ == 8000000u) && (CAN_BITRATE == 250000u) && (CAN_SAMPLE_POINT == 800u)
+#define CAN_NOMINAL_PRESDIV    (0u)
+#define CAN_NOMINAL_PROPSEG    (18u)
+#define CAN_NOMINAL_PSEG1      (5u)
+#define CAN_NOMINAL_PSEG2      (5u)
+#define CAN_NOMINAL_RJW        (5u)
+#define CAN_NOMINAL_SP_REACHED (812u)
+#elif (CAN_CLOCK_HZ == 8000000u) && (CAN_BITRATE == 250000u) && (CAN_SAMPLE_POINT == 875u)
+#define CAN_NOMINAL_PRESDIV    (0u)
+#define CAN_NOMINAL_PROPSEG    (22u)
+#define CAN_NOMINAL_PSEG1      (3u)
+#define CAN_NOMINAL_PSEG2      (3u)
+#define CAN_NOMINAL_RJW        (3u)
+#define CAN_NOMINAL_SP_REACHED (875u)
+#elif (CAN_CLOCK_HZ == 8000000u) && (CAN_BITRATE == 500000u) && (CAN_SAMPLE_POINT == 800u)
+#define CAN_NOMINAL_PRESDIV    (0u)
+#define CAN_NOMINAL_PROPSEG    (8u)
+#define CAN_NOMINAL_PSEG1      (2u)
+#define CAN_NOMINAL_PSEG2      (2u)
+#define CAN_NOMINAL_RJW        (2u)
+#define CAN_NOMINAL_SP_REACHED (812u)
+#elif (CAN_CLOCK_HZ == 8000000u) && (CAN_BITRATE == 500000u) && (CAN_SAMPLE_POINT == 875u)
+#define CAN_NOMINAL_PRESDIV    (0u)
+#define CAN_NOMINAL_PROPSEG    (10u)
+#define CAN_NOMINAL_PSEG1      (1u)
+#define CAN_NOMINAL_PSEG2      (1u)
+#define CAN_NOMINAL_RJW        (1u)
+#define CAN_NOMINAL_SP_REACHED (875u)
+#elif (CAN_CLOCK_HZ == 8000000u) && (CAN_BITRATE == 1000000u) && (CAN_SAMPLE_POINT == 800u)
+#define CAN_NOMINAL_PRESDIV    (0u)
+#define CAN_NOMINAL_PROPSEG    (2u)
+#define CAN_NOMINAL_PSEG1      (1u)
+#define CAN_NOMINAL_PSEG2      (1u)
+#define CAN_NOMINAL_RJW        (1u)
+#define CAN_NOMINAL_SP_REACHED (750u)
+#elif (CAN_CLOCK_HZ == 8000000u) && (CAN_BITRATE == 1000000u) && (CAN_SAMPLE_POINT == 875u)
+#define CAN_NOMINAL_PRESDIV    (0u)
+#define CAN_NOMINAL_PROPSEG    (2u)
+#define CAN_NOMINAL_PSEG1      (1u)
+#define CAN_NOMINAL_PSEG2      (1u)
+#define CAN_NOMINAL_RJW        (1u)
+#define CAN_NOMINAL_SP_REACHED (750u)
+#elif (CAN_CLOCK_HZ == 16000000u) && (CAN_BITRATE == 125000u) && (CAN_SAMPLE_POINT == 800u)
+#define CAN_NOMINAL_PRESDIV    (1u)
+#define CAN_NOMINAL_PROPSEG    (36u)
+#define CAN_NOMINAL_PSEG1      (12u)
+#define CAN_NOMINAL_PSEG2      (12u)
+#define CAN_NOMINAL_RJW        (12u)
+#define CAN_NOMINAL_SP_REACHED (796u)
+#elif (CAN_CLOCK_HZ == 16000000u) && (CAN_BITRATE == 125000u) && (CAN_SAMPLE_POINT == 875u)
+#define CAN_NOMINAL_PRESDIV    (1u)
+#define CAN_NOMINAL_PROPSEG    (46u)
+#define CAN_NOMINAL_PSEG1      (7u)
+#define CAN_NOMINAL_PSEG2      (7u)
+#define CAN_NOMINAL_RJW        (7u)
+#define CAN_NOMINAL_SP_REACHED (875u)
+#elif (CAN_CLOCK_HZ == 16000000u) && (CAN_BITRATE == 250000u) && (CAN_SAMPLE_POINT == 800u)
+#define CAN_NOMINAL_PRESDIV    (0u)
+#define CAN_NOMINAL_PROPSEG    (36u)
+#define CAN_NOMINAL_PSEG1      (12u)
+#define CAN_NOMINAL_PSEG2      (12u)
+#define CAN_NOMINAL_RJW        (12u)
+#define CAN_NOMINAL_SP_REACHED (796u)
+#elif (CAN_CLOCK_HZ == 16000000u) && (CAN_BITRATE == 250000u) && (CAN_SAMPLE_POINT == 875u)
+#define CAN_NOMINAL_PRESDIV    (0u)
+#define CAN_NOMINAL_PROPSEG    (46u)
+#define CAN_NOMINAL_PSEG1      (7u)
+#define CAN_NOMINAL_PSEG2      (7u)
+#define CAN_NOMINAL_RJW        (7u)
+#define CAN_NOMINAL_SP_REACHED (875u)
+#elif (CAN_CLOCK_HZ == 16000000u) && (CAN_BITRATE == 500000u) && (CAN_SAMPLE_POINT == 800u)
+#define CAN_NOMINAL_PRESDIV    (0u)
+#define CAN_NOMINAL_PROPSEG    (18u)
+#define CAN_NOMINAL_PSEG1      (5u)
+#define CAN_NOMINAL_PSEG2      (5u)
+#define CAN_NOMINAL_RJW        (5u)
+#define CAN_NOMINAL_SP_REACHED (812u)
+#elif (CAN_CLOCK_HZ == 16000000u) && (CAN_BITRATE == 500000u) && (CAN_SAMPLE_POINT == 875u)
+#define CAN_NOMINAL_PRESDIV    (0u)
+#define CAN_NOMINAL_PROPSEG    (22u)
+#define CAN_NOMINAL_PSEG1      (3u)
+#define CAN_NOMINAL_PSEG2      (3u)
+#define CAN_NOMINAL_RJW        (3u)
+#define CAN_NOMINAL_SP_REACHED (875u)
+#elif (CAN_CLOCK_HZ == 16000000u) && (CAN_BITRATE == 1000000u) && (CAN_SAMPLE_POINT == 800u)
+#define CAN_NOMINAL_PRESDIV    (0u)
+#define CAN_NOMINAL_PROPSEG    (8u)
+#define CAN_NOMINAL_PSEG1      (2u)
+#define CAN_NOMINAL_PSEG2      (2u)
+#define CAN_NOMINAL_RJW        (2u)
+#define CAN_NOMINAL_SP_REACHED (812u)
+#elif (CAN_CLOCK_HZ == 16000000u) && (CAN_BITRATE == 1000000u) && (CAN_SAMPLE_POINT == 875u)
+#define CAN_NOMINAL_PRESDIV    (0u)
+#define CAN_NOMINAL_PROPSEG    (10u)
+#define CAN_NOMINAL_PSEG1      (1u)
+#define CAN_NOMINAL_PSEG2      (1u)
+#define CAN_NOMINAL_RJW        (1u)
+#define CAN_NOMINAL_SP_REACHED (875u)
+#elif (CAN_CLOCK_HZ == 40000000u) && (CAN_BITRATE == 125000u) && (CAN_SAMPLE_POINT == 800u)
+#define CAN_NOMINAL_PRESDIV    (3u)
+#define CAN_NOMINAL_PROPSEG    (46u)
+#define CAN_NOMINAL_PSEG1      (15u)
+#define CAN_NOMINAL_PSEG2      (15u)
+#define CAN_NOMINAL_RJW        (15u)
+#define CAN_NOMINAL_SP_REACHED (800u)
+#elif (CAN_CLOCK_HZ == 40000000u) && (CAN_BITRATE == 125000u) && (CAN_SAMPLE_POINT == 875u)
+#define CAN_NOMINAL_PRESDIV    (3u)
+#define CAN_NOMINAL_PROPSEG    (58u)
+#define CAN_NOMINAL_PSEG1      (9u)
+#define CAN_NOMINAL_PSEG2      (9u)
+#define CAN_NOMINAL_RJW        (9u)
+#define CAN_NOMINAL_SP_REACHED (875u)
+#elif (CAN_CLOCK_HZ == 40000000u) && (CAN_BITRATE == 250000u) && (CAN_SAMPLE_POINT == 800u)
+#define CAN_NOMINAL_PRESDIV    (1u)
+#define CAN_NOMINAL_PROPSEG    (46u)
+#define CAN_NOMINAL_PSEG1      (15u)
+#define CAN_NOMINAL_PSEG2      (15u)
+#define CAN_NOMINAL_RJW        (15u)
+#define CAN_NOMINAL_SP_REACHED (800u)
+#elif (CAN_CLOCK_HZ == 40000000u) && (CAN_BITRATE == 250000u) && (CAN_SAMPLE_POINT == 875u)
+#define CAN_NOMINAL_PRESDIV    (1u)
+#define CAN_NOMINAL_PROPSEG    (58u)
+#define CAN_NOMINAL_PSEG1      (9u)
+#define CAN_NOMINAL_PSEG2      (9u)
+#define CAN_NOMINAL_RJW        (9u)
+#define CAN_NOMINAL_SP_REACHED (875u)
+#elif (CAN_CLOCK_HZ == 40000000u) && (CAN_BITRATE == 500000u) && (CAN_SAMPLE_POINT == 800u)
+#define CAN_NOMINAL_PRESDIV    (0u)
+#define CAN_NOMINAL_PROPSEG    (46u)
+#define CAN_NOMINAL_PSEG1      (15u)
+#define CAN_NOMINAL_PSEG2      (15u)
+#define CAN_NOMINAL_RJW        (15u)
+#define CAN_NOMINAL_SP_REACHED (800u)
+#elif (CAN_CLOCK_HZ == 40000000u) && (CAN_BITRATE == 500000u) && (CAN_SAMPLE_POINT == 875u)
+#define CAN_NOMINAL_PRESDIV    (0u)
+#define CAN_NOMINAL_PROPSEG    (58u)
+#define CAN_NOMINAL_PSEG1      (9u)
+#define CAN_NOMINAL_PSEG2      (9u)
+#define CAN_NOMINAL_RJW        (9u)
+#define CAN_NOMINAL_SP_REACHED (875u)
+#elif (CAN_CLOCK_HZ == 40000000u) && (CAN_BITRATE == 1000000u) && (CAN_SAMPLE_POINT == 800u)
+#define CAN_NOMINAL_PRESDIV    (0u)
+#define CAN_NOMINAL_PROPSEG    (22u)
+#define CAN_NOMINAL_PSEG1      (7u)
+#define CAN_NOMINAL_PSEG2      (7u)
+#define CAN_NOMINAL_RJW        (7u)
+#define CAN_NOMINAL_SP_REACHED (800u)
+#elif (CAN_CLOCK_HZ == 40000000u) && (CAN_BITRATE == 1000000u) && (CAN_SAMPLE_POINT == 875u)
+#define CAN_NOMINAL_PRESDIV    (0u)
+#define CAN_NOMINAL_PROPSEG    (28u)
+#define CAN_NOMINAL_PSEG1      (4u)
+#define CAN_NOMINAL_PSEG2      (4u)
+#define CAN_NOMINAL_RJW        (4u)
+#define CAN_NOMINAL_SP_REACHED (875u)
+#elif (CAN_CLOCK_HZ == 48000000u) && (CAN_BITRATE == 125000u) && (CAN_SAMPLE_POINT == 800u)
+#define CAN_NOMINAL_PRESDIV    (3u)
+#define CAN_NOMINAL_PROPSEG    (56u)
+#define CAN_NOMINAL_PSEG1      (18u)
+#define CAN_NOMINAL_PSEG2      (18u)
+#define CAN_NOMINAL_RJW        (18u)
+#define CAN_NOMINAL_SP_REACHED (802u)
+#elif (CAN_CLOCK_HZ == 48000000u) && (CAN_BITRATE == 125000u) && (CAN_SAMPLE_POINT == 875u)
+#define CAN_NOMINAL_PRESDIV    (3u)
+#define CAN_NOMINAL_PROPSEG    (63u)
+#define CAN_NOMINAL_PSEG1      (18u)
+#define CAN_NOMINAL_PSEG2      (11u)
+#define CAN_NOMINAL_RJW        (11u)
+#define CAN_NOMINAL_SP_REACHED (875u)
+#elif (CAN_CLOCK_HZ == 48000000u) && (CAN_BITRATE == 250000u) && (CAN_SAMPLE_POINT == 800u)
+#define CAN_NOMINAL_PRESDIV    (1u)
+#define CAN_NOMINAL_PROPSEG    (56u)
+#define CAN_NOMINAL_PSEG1      (18u)
+#define CAN_NOMINAL_PSEG2      (18u)
+#define CAN_NOMINAL_RJW        (18u)
+#define CAN_NOMINAL_SP_REACHED (802u)
+#elif (CAN_CLOCK_HZ == 48000000u) && (CAN_BITRATE == 250000u) && (CAN_SAMPLE_POINT == 875u)
+#define CAN_NOMINAL_PRESDIV    (1u)
+#define CAN_NOMINAL_PROPSEG    (63u)
+#define CAN_NOMINAL_PSEG1      (18u)
+#define CAN_NOMINAL_PSEG2      (11u)
+#define CAN_NOMINAL_RJW        (11u)
+#define CAN_NOMINAL_SP_REACHED (875u)
+#elif (CAN_CLOCK_HZ == 48000000u) && (CAN_BITRATE == 500000u) && (CAN_SAMPLE_POINT == 800u)
+#define CAN_NOMINAL_PRESDIV    (0u)
+#define CAN_NOMINAL_PROPSEG    (56u)
+#define CAN_NOMINAL_PSEG1      (18u)
+#define CAN_NOMINAL_PSEG2      (18u)
+#define CAN_NOMINAL_RJW        (18u)
+#define CAN_NOMINAL_SP_REACHED (802u)
+#elif (CAN_CLOCK_HZ == 48000000u) && (CAN_BITRATE == 500000u) && (CAN_SAMPLE_POINT == 875u)
+#define CAN_NOMINAL_PRESDIV    (0u)
+#define CAN_NOMINAL_PROPSEG    (63u)
+#define CAN_NOMINAL_PSEG1      (18u)
+#define CAN_NOMINAL_PSEG2      (11u)
+#define CAN_NOMINAL_RJW        (11u)
+#define CAN_NOMINAL_SP_REACHED (875u)
+#elif (CAN_CLOCK_HZ == 48000000u) && (CAN_BITRATE == 1000000u) && (CAN_SAMPLE_POINT == 800u)
+#define CAN_NOMINAL_PRESDIV    (0u)
+#define CAN_NOMINAL_PROPSEG    (26u)
+#define CAN_NOMINAL_PSEG1      (9u)
+#define CAN_NOMINAL_PSEG2      (9u)
+#define CAN_NOMINAL_RJW        (9u)
+#define CAN_NOMINAL_SP_REACHED (791u)
+#elif (CAN_CLOCK_HZ == 48000000u) && (CAN_BITRATE == 1000000u) && (CAN_SAMPLE_POINT == 875u)
+#define CAN_NOMINAL_PRESDIV    (0u)
+#define CAN_NOMINAL_PROPSEG    (34u)
+#define CAN_NOMINAL_PSEG1      (5u)
+#define CAN_NOMINAL_PSEG2      (5u)
+#define CAN_NOMINAL_RJW        (5u)
+#define CAN_NOMINAL_SP_REACHED (875u)
+#elif (CAN_CLOCK_HZ == 80000000u) && (CAN_BITRATE == 125000u) && (CAN_SAMPLE_POINT == 800u)
+#define CAN_NOMINAL_PRESDIV    (7u)
+#define CAN_NOMINAL_PROPSEG    (46u)
+#define CAN_NOMINAL_PSEG1      (15u)
+#define CAN_NOMINAL_PSEG2      (15u)
+#define CAN_NOMINAL_RJW        (15u)
+#define CAN_NOMINAL_SP_REACHED (800u)
+#elif (CAN_CLOCK_HZ == 80000000u) && (CAN_BITRATE == 125000u) && (CAN_SAMPLE_POINT == 875u)
+#define CAN_NOMINAL_PRESDIV    (7u)
+#define CAN_NOMINAL_PROPSEG    (58u)
+#define CAN_NOMINAL_PSEG1      (9u)
+#define CAN_NOMINAL_PSEG2      (9u)
+#define CAN_NOMINAL_RJW        (9u)
+#define CAN_NOMINAL_SP_REACHED (875u)
+#elif (CAN_CLOCK_HZ == 80000000u) && (CAN_BITRATE == 250000u) && (CAN_SAMPLE_POINT == 800u)
+#define CAN_NOMINAL_PRESDIV    (3u)
+#define CAN_NOMINAL_PROPSEG    (46u)
+#define CAN_NOMINAL_PSEG1      (15u)
+#define CAN_NOMINAL_PSEG2      (15u)
+#define CAN_NOMINAL_RJW        (15u)
+#define CAN_NOMINAL_SP_REACHED (800u)
+#elif (CAN_CLOCK_HZ == 80000000u) && (CAN_BITRATE == 250000u) && (CAN_SAMPLE_POINT == 875u)
+#define CAN_NOMINAL_PRESDIV    (3u)
+#define CAN_NOMINAL_PROPSEG    (58u)
+#define CAN_NOMINAL_PSEG1      (9u)
+#define CAN_NOMINAL_PSEG2      (9u)
+#define CAN_NOMINAL_RJW        (9u)
+#define CAN_NOMINAL_SP_REACHED (875u)
+#elif (CAN_CLOCK_HZ == 80000000u) && (CAN_BITRATE == 500000u) && (CAN_SAMPLE_POINT == 800u)
+#define CAN_NOMINAL_PRESDIV    (1u)
+#define CAN_NOMINAL_PROPSEG    (46u)
+#define CAN_NOMINAL_PSEG1      (15u)
+#define CAN_NOMINAL_PSEG2      (15u)
+#define CAN_NOMINAL_RJW        (15u)
+#define CAN_NOMINAL_SP_REACHED (800u)
+#elif (CAN_CLOCK_HZ == 80000000u) && (CAN_BITRATE == 500000u) && (CAN_SAMPLE_POINT == 875u)
+#define CAN_NOMINAL_PRESDIV    (1u)
+#define CAN_NOMINAL_PROPSEG    (58u)
+#define CAN_NOMINAL_PSEG1      (9u)
+#define CAN_NOMINAL_PSEG2      (9u)
+#define CAN_NOMINAL_RJW        (9u)
+#define CAN_NOMINAL_SP_REACHED (875u)
+#elif (CAN_CLOCK_HZ == 80000000u) && (CAN_BITRATE == 1000000u) && (CAN_SAMPLE_POINT == 800u)
+#define CAN_NOMINAL_PRESDIV    (0u)
+#define CAN_NOMINAL_PROPSEG    (46u)
+#define CAN_NOMINAL_PSEG1      (15u)
+#define CAN_NOMINAL_PSEG2      (15u)
+#define CAN_NOMINAL_RJW        (15u)
+#define CAN_NOMINAL_SP_REACHED (800u)
+#elif (CAN_CLOCK_HZ == 80000000u) && (CAN_BITRATE == 1000000u) && (CAN_SAMPLE_POINT == 875u)
+#define CAN_NOMINAL_PRESDIV    (0u)
+#define CAN_NOMINAL_PROPSEG    (58u)
+#define CAN_NOMINAL_PSEG1      (9u)
+#define CAN_NOMINAL_PSEG2      (9u)
+#define CAN_NOMINAL_RJW        (9u)
+#define CAN_NOMINAL_SP_REACHED (875u)
+#else
+#error "No bit timing for CAN_CLOCK_HZ, CAN_BITRATE and CAN_SAMPLE_POINT, add them to tools/bit_timing_table.py"
+#endif
+
+/* CAN FD arbitration phase, CAN0_CBT */
+#if (CAN_FD_CLOCK_HZ == 40000000u) && (CAN_FD_NOMINAL_BITRATE == 125000u) && (CAN_SAMPLE_POINT == 800u)
+#define CAN_FD_NOMINAL_PRESDIV    (3u)
+#define CAN_FD_NOMINAL_PROPSEG    (46u)
+#define CAN_FD_NOMINAL_PSEG1      (15u)
+#define CAN_FD_NOMINAL_PSEG2      (15u)
+#define CAN_FD_NOMINAL_RJW        (15u)
+#define CAN_FD_NOMINAL_SP_REACHED (800u)
+#elif (CAN_FD_CLOCK_HZ == 40000000u) && (CAN_FD_NOMINAL_BITRATE == 125000u) && (CAN_SAMPLE_POINT == 875u)
+#define CAN_FD_NOMINAL_PRESDIV    (3u)
+#define CAN_FD_NOMINAL_PROPSEG    (58u)
+#define CAN_FD_NOMINAL_PSEG1      (9u)
+#define CAN_FD_NOMINAL_PSEG2      (9u)
+#define CAN_FD_NOMINAL_RJW        (9u)
+#define CAN_FD_NOMINAL_SP_REACHED (875u)
+#elif (CAN_FD_CLOCK_HZ == 40000000u) && (CAN_FD_NOMINAL_BITRATE == 250000u) && (CAN_SAMPLE_POINT == 800u)
+#define CAN_FD_NOMINAL_PRESDIV    (1u)
+#define CAN_FD_NOMINAL_PROPSEG    (46u)
+#define CAN_FD_NOMINAL_PSEG1      (15u)
+#define CAN_FD_NOMINAL_PSEG2      (15u)
+#define CAN_FD_NOMINAL_RJW        (15u)
+#define CAN_FD_NOMINAL_SP_REACHED (800u)
+#elif (CAN_FD_CLOCK_HZ == 40000000u) && (CAN_FD_NOMINAL_BITRATE == 250000u) && (CAN_SAMPLE_POINT == 875u)
+#define CAN_FD_NOMINAL_PRESDIV    (1u)
+#define CAN_FD_NOMINAL_PROPSEG    (58u)
+#define CAN_FD_NOMINAL_PSEG1      (9u)
+#define CAN_FD_NOMINAL_PSEG2      (9u)
+#define CAN_FD_NOMINAL_RJW        (9u)
+#define CAN_FD_NOMINAL_SP_REACHED (875u)
+#elif (CAN_FD_CLOCK_HZ == 40000000u) && (CAN_FD_NOMINAL_BITRATE == 500000u) && (CAN_SAMPLE_POINT == 800u)
+#define CAN_FD_NOMINAL_PRESDIV    (0u)
+#define CAN_FD_NOMINAL_PROPSEG    (46u)
+#define CAN_FD_NOMINAL_PSEG1      (15u)
+#define CAN_FD_NOMINAL_PSEG2      (15u)
+#define CAN_FD_NOMINAL_RJW        (15u)
+#define CAN_FD_NOMINAL_SP_REACHED (800u)
+#elif (CAN_FD_CLOCK_HZ == 40000000u) && (CAN_FD_NOMINAL_BITRATE == 500000u) && (CAN_SAMPLE_POINT == 875u)
+#define CAN_FD_NOMINAL_PRESDIV    (0u)
+#define CAN_FD_NOMINAL_PROPSEG    (58u)
+#define CAN_FD_NOMINAL_PSEG1      (9u)
+#define CAN_FD_NOMINAL_PSEG2      (9u)
+#define CAN_FD_NOMINAL_RJW        (9u)
+#define CAN_FD_NOMINAL_SP_REACHED (875u)
+#elif (CAN_FD_CLOCK_HZ == 40000000u) && (CAN_FD_NOMINAL_BITRATE == 1000000u) && (CAN_SAMPLE_POINT == 800u)
+#define CAN_FD_NOMINAL_PRESDIV    (0u)
+#define CAN_FD_NOMINAL_PROPSEG    (22u)
+#define CAN_FD_NOMINAL_PSEG1      (7u)
+#define CAN_FD_NOMINAL_PSEG2      (7u)
+#define CAN_FD_NOMINAL_RJW        (7u)
+#define CAN_FD_NOMINAL_SP_REACHED (800u)
+#elif (CAN_FD_CLOCK_HZ == 40000000u) && (CAN_FD_NOMINAL_BITRATE == 1000000u) && (CAN_SAMPLE_POINT == 875u)
+#define CAN_FD_NOMINAL_PRESDIV    (0u)
+#define CAN_FD_NOMINAL_PROPSEG    (28u)
+#define CAN_FD_NOMINAL_PSEG1      (4u)
+#define CAN_FD_NOMINAL_PSEG2      (4u)
+#define CAN_FD_NOMINAL_RJW        (4u)
+#define CAN_FD_NOMINAL_SP_REACHED (875u)
+#elif (CAN_FD_CLOCK_HZ == 48000000u) && (CAN_FD_NOMINAL_BITRATE == 125000u) && (CAN_SAMPLE_POINT == 800u)
+#define CAN_FD_NOMINAL_PRESDIV    (3u)
+#define CAN_FD_NOMINAL_PROPSEG    (56u)
+#define CAN_FD_NOMINAL_PSEG1      (18u)
+#define CAN_FD_NOMINAL_PSEG2      (18u)
+#define CAN_FD_NOMINAL_RJW        (18u)
+#define CAN_FD_NOMINAL_SP_REACHED (802u)
+#elif (CAN_FD_CLOCK_HZ == 48000000u) && (CAN_FD_NOMINAL_BITRATE == 125000u) && (CAN_SAMPLE_POINT == 875u)
+#define CAN_FD_NOMINAL_PRESDIV    (3u)
+#define CAN_FD_NOMINAL_PROPSEG    (63u)
+#define CAN_FD_NOMINAL_PSEG1      (18u)
+#define CAN_FD_NOMINAL_PSEG2      (11u)
+#define CAN_FD_NOMINAL_RJW        (11u)
+#define CAN_FD_NOMINAL_SP_REACHED (875u)
+#elif (CAN_FD_CLOCK_HZ == 48000000u) && (CAN_FD_NOMINAL_BITRATE == 250000u) && (CAN_SAMPLE_POINT == 800u)
+#define CAN_FD_NOMINAL_PRESDIV    (1u)
+#define CAN_FD_NOMINAL_PROPSEG    (56u)
+#define CAN_FD_NOMINAL_PSEG1      (18u)
+#define CAN_FD_NOMINAL_PSEG2      (18u)
+#define CAN_FD_NOMINAL_RJW        (18u)
+#define CAN_FD_NOMINAL_SP_REACHED (802u)
+#elif (CAN_FD_CLOCK_HZ == 48000000u) && (CAN_FD_NOMINAL_BITRATE == 250000u) && (CAN_SAMPLE_POINT == 875u)
+#define CAN_FD_NOMINAL_PRESDIV    (1u)
+#define CAN_FD_NOMINAL_PROPSEG    (63u)
+#define CAN_FD_NOMINAL_PSEG1      (18u)
+#define CAN_FD_NOMINAL_PSEG2      (11u)
+#define CAN_FD_NOMINAL_RJW        (11u)
+#define CAN_FD_NOMINAL_SP_REACHED (875u)
+#elif (CAN_FD_CLOCK_HZ == 48000000u) && (CAN_FD_NOMINAL_BITRATE == 500000u) && (CAN_SAMPLE_POINT == 800u)
+#define CAN_FD_NOMINAL_PRESDIV    (0u)
+#define CAN_FD_NOMINAL_PROPSEG    (56u)
+#define CAN_FD_NOMINAL_PSEG1      (18u)
+#define CAN_FD_NOMINAL_PSEG2      (18u)
+#define CAN_FD_NOMINAL_RJW        (18u)
+#define CAN_FD_NOMINAL_SP_REACHED (802u)
+#elif (CAN_FD_CLOCK_HZ == 48000000u) && (CAN_FD_NOMINAL_BITRATE == 500000u) && (CAN_SAMPLE_POINT == 875u)
+#define CAN_FD_NOMINAL_PRESDIV    (0u)
+#define CAN_FD_NOMINAL_PROPSEG    (63u)
+#define CAN_FD_NOMINAL_PSEG1      (18u)
+#define CAN_FD_NOMINAL_PSEG2      (11u)
+#define CAN_FD_NOMINAL_RJW        (11u)
+#define CAN_FD_NOMINAL_SP_REACHED (875u)
+#elif (CAN_FD_CLOCK_HZ == 48000000u) && (CAN_FD_NOMINAL_BITRATE == 1000000u) && (CAN_SAMPLE_POINT == 800u)
+#define CAN_FD_NOMINAL_PRESDIV    (0u)
+#define CAN_FD_NOMINAL_PROPSEG    (26u)
+#define CAN_FD_NOMINAL_PSEG1      (9u)
+#define CAN_FD_NOMINAL_PSEG2      (9u)
+#define CAN_FD_NOMINAL_RJW        (9u)
+#define CAN_FD_NOMINAL_SP_REACHED (791u)
+#elif (CAN_FD_CLOCK_HZ == 48000000u) && (CAN_FD_NOMINAL_BITRATE == 1000000u) && (CAN_SAMPLE_POINT == 875u)
+#define CAN_FD_NOMINAL_PRESDIV    (0u)
+#define CAN_FD_NOMINAL_PROPSEG    (34u)
+#define CAN_FD_NOMINAL_PSEG1      (5u)
+#define CAN_FD_NOMINAL_PSEG2      (5u)
+#define CAN_FD_NOMINAL_RJW        (5u)
+#define CAN_FD_NOMINAL_SP_REACHED (875u)
+#elif (CAN_FD_CLOCK_HZ == 80000000u) && (CAN_FD_NOMINAL_BITRATE == 125000u) && (CAN_SAMPLE_POINT == 800u)
+#define CAN_FD_NOMINAL_PRESDIV    (7u)
+#define CAN_FD_NOMINAL_PROPSEG    (46u)
+#define CAN_FD_NOMINAL_PSEG1      (15u)
+#define CAN_FD_NOMINAL_PSEG2      (15u)
+#define CAN_FD_NOMINAL_RJW        (15u)
+#define CAN_FD_NOMINAL_SP_REACHED (800u)
+#elif (CAN_FD_CLOCK_HZ == 80000000u) && (CAN_FD_NOMINAL_BITRATE == 125000u) && (CAN_SAMPLE_POINT == 875u)
+#define CAN_FD_NOMINAL_PRESDIV    (7u)
+#define CAN_FD_NOMINAL_PROPSEG    (58u)
+#define CAN_FD_NOMINAL_PSEG1      (9u)
+#define CAN_FD_NOMINAL_PSEG2      (9u)
+#define CAN_FD_NOMINAL_RJW        (9u)
+#define CAN_FD_NOMINAL_SP_REACHED (875u)
+#elif (CAN_FD_CLOCK_HZ == 80000000u) && (CAN_FD_NOMINAL_BITRATE == 250000u) && (CAN_SAMPLE_POINT == 800u)
+#define CAN_FD_NOMINAL_PRESDIV    (3u)
+#define CAN_FD_NOMINAL_PROPSEG    (46u)
+#define CAN_FD_NOMINAL_PSEG1      (15u)
+#define CAN_FD_NOMINAL_PSEG2      (15u)
+#define CAN_FD_NOMINAL_RJW        (15u)
+#define CAN_FD_NOMINAL_SP_REACHED (800u)
+#elif (CAN_FD_CLOCK_HZ == 80000000u) && (CAN_FD_NOMINAL_BITRATE == 250000u) && (CAN_SAMPLE_POINT == 875u)
+#define CAN_FD_NOMINAL_PRESDIV    (3u)
+#define CAN_FD_NOMINAL_PROPSEG    (58u)
+#define CAN_FD_NOMINAL_PSEG1      (9u)
+#define CAN_FD_NOMINAL_PSEG2      (9u)
+#define CAN_FD_NOMINAL_RJW        (9u)
+#define CAN_FD_NOMINAL_SP_REACHED (875u)
+#elif (CAN_FD_CLOCK_HZ == 80000000u) && (CAN_FD_NOMINAL_BITRATE == 500000u) && (CAN_SAMPLE_POINT == 800u)
+#define CAN_FD_NOMINAL_PRESDIV    (1u)
+#define CAN_FD_NOMINAL_PROPSEG    (46u)
+#define CAN_FD_NOMINAL_PSEG1      (15u)
+#define CAN_FD_NOMINAL_PSEG2      (15u)
+#define CAN_FD_NOMINAL_RJW        (15u)
+#define CAN_FD_NOMINAL_SP_REACHED (800u)
+#elif (CAN_FD_CLOCK_HZ == 80000000u) && (CAN_FD_NOMINAL_BITRATE == 500000u) && (CAN_SAMPLE_POINT == 875u)
+#define CAN_FD_NOMINAL_PRESDIV    (1u)
+#define CAN_FD_NOMINAL_PROPSEG    (58u)
+#define CAN_FD_NOMINAL_PSEG1      (9u)
+#define CAN_FD_NOMINAL_PSEG2      (9u)
+#define CAN_FD_NOMINAL_RJW        (9u)
+#define CAN_FD_NOMINAL_SP_REACHED (875u)
+#elif (CAN_FD_CLOCK_HZ == 80000000u) && (CAN_FD_NOMINAL_BITRATE == 1000000u) && (CAN_SAMPLE_POINT == 800u)
+#define CAN_FD_NOMINAL_PRESDIV    (0u)
+#define CAN_FD_NOMINAL_PROPSEG    (46u)
+#define CAN_FD_NOMINAL_PSEG1      (15u)
+#define CAN_FD_NOMINAL_PSEG2      (15u)
+#define CAN_FD_NOMINAL_RJW        (15u)
+#define CAN_FD_NOMINAL_SP_REACHED (800u)
+#elif (CAN_FD_CLOCK_HZ == 80000000u) && (CAN_FD_NOMINAL_BITRATE == 1000000u) && (CAN_SAMPLE_POINT == 875u)
+#define CAN_FD_NOMINAL_PRESDIV    (0u)
+#define CAN_FD_NOMINAL_PROPSEG    (58u)
+#define CAN_FD_NOMINAL_PSEG1      (9u)
+#define CAN_FD_NOMINAL_PSEG2      (9u)
+#define CAN_FD_NOMINAL_RJW        (9u)
+#define CAN_FD_NOMINAL_SP_REACHED (875u)
+#else
+#error "No bit timing for CAN_FD_CLOCK_HZ, CAN_FD_NOMINAL_BITRATE and CAN_SAMPLE_POINT, add them to tools/bit_timing_table.py"
+#endif
+
+/* CAN FD data phase, CAN0_FDCBT */
+#if (CAN_FD_CLOCK_HZ == 40000000u) && (CAN_FD_DATA_BITRATE == 2000000u) && (CAN_FD_DATA_SAMPLE_POINT == 700u)
+#define CAN_FD_DATA_PRESDIV    (0u)
+#define CAN_FD_DATA_PROPSEG    (7u)
+#define CAN_FD_DATA_PSEG1      (5u)
+#define CAN_FD_DATA_PSEG2      (5u)
+#define CAN_FD_DATA_RJW        (5u)
+#define CAN_FD_DATA_SP_REACHED (700u)
+#elif (CAN_FD_CLOCK_HZ == 40000000u) && (CAN_FD_DATA_BITRATE == 2000000u) && (CAN_FD_DATA_SAMPLE_POINT == 750u)
+#define CAN_FD_DATA_PRESDIV    (0u)
+#define CAN_FD_DATA_PROPSEG    (9u)
+#define CAN_FD_DATA_PSEG1      (4u)
+#define CAN_FD_DATA_PSEG2      (4u)
+#define CAN_FD_DATA_RJW        (4u)
+#define CAN_FD_DATA_SP_REACHED (750u)
+#elif (CAN_FD_CLOCK_HZ == 40000000u) && (CAN_FD_DATA_BITRATE == 2000000u) && (CAN_FD_DATA_SAMPLE_POINT == 800u)
+#define CAN_FD_DATA_PRESDIV    (0u)
+#define CAN_FD_DATA_PROPSEG    (11u)
+#define CAN_FD_DATA_PSEG1      (3u)
+#define CAN_FD_DATA_PSEG2      (3u)
+#define CAN_FD_DATA_RJW        (3u)
+#define CAN_FD_DATA_SP_REACHED (800u)
+#elif (CAN_FD_CLOCK_HZ == 40000000u) && (CAN_FD_DATA_BITRATE == 4000000u) && (CAN_FD_DATA_SAMPLE_POINT == 700u)
+#define CAN_FD_DATA_PRESDIV    (0u)
+#define CAN_FD_DATA_PROPSEG    (3u)
+#define CAN_FD_DATA_PSEG1      (2u)
+#define CAN_FD_DATA_PSEG2      (2u)
+#define CAN_FD_DATA_RJW        (2u)
+#define CAN_FD_DATA_SP_REACHED (700u)
+#elif (CAN_FD_CLOCK_HZ == 40000000u) && (CAN_FD_DATA_BITRATE == 4000000u) && (CAN_FD_DATA_SAMPLE_POINT == 750u)
+#define CAN_FD_DATA_PRESDIV    (0u)
+#define CAN_FD_DATA_PROPSEG    (5u)
+#define CAN_FD_DATA_PSEG1      (1u)
+#define CAN_FD_DATA_PSEG2      (1u)
+#define CAN_FD_DATA_RJW        (1u)
+#define CAN_FD_DATA_SP_REACHED (800u)
+#elif (CAN_FD_CLOCK_HZ == 40000000u) && (CAN_FD_DATA_BITRATE == 4000000u) && (CAN_FD_DATA_SAMPLE_POINT == 800u)
+#define CAN_FD_DATA_PRESDIV    (0u)
+#define CAN_FD_DATA_PROPSEG    (5u)
+#define CAN_FD_DATA_PSEG1      (1u)
+#define CAN_FD_DATA_PSEG2      (1u)
+#define CAN_FD_DATA_RJW        (1u)
+#define CAN_FD_DATA_SP_REACHED (800u)
+#elif (CAN_FD_CLOCK_HZ == 40000000u) && (CAN_FD_DATA_BITRATE == 5000000u) && (CAN_FD_DATA_SAMPLE_POINT == 700u)
+#define CAN_FD_DATA_PRESDIV    (0u)
+#define CAN_FD_DATA_PROPSEG    (3u)
+#define CAN_FD_DATA_PSEG1      (1u)
+#define CAN_FD_DATA_PSEG2      (1u)
+#define CAN_FD_DATA_RJW        (1u)
+#define CAN_FD_DATA_SP_REACHED (750u)
+#elif (CAN_FD_CLOCK_HZ == 40000000u) && (CAN_FD_DATA_BITRATE == 5000000u) && (CAN_FD_DATA_SAMPLE_POINT == 750u)
+#define CAN_FD_DATA_PRESDIV    (0u)
+#define CAN_FD_DATA_PROPSEG    (3u)
+#define CAN_FD_DATA_PSEG1      (1u)
+#define CAN_FD_DATA_PSEG2      (1u)
+#define CAN_FD_DATA_RJW        (1u)
+#define CAN_FD_DATA_SP_REACHED (750u)
+#elif (CAN_FD_CLOCK_HZ == 40000000u) && (CAN_FD_DATA_BITRATE == 5000000u) && (CAN_FD_DATA_SAMPLE_POINT == 800u)
+#define CAN_FD_DATA_PRESDIV    (0u)
+#define CAN_FD_DATA_PROPSEG    (3u)
+#define CAN_FD_DATA_PSEG1      (1u)
+#define CAN_FD_DATA_PSEG2      (1u)
+#define CAN_FD_DATA_RJW        (1u)
+#define CAN_FD_DATA_SP_REACHED (750u)
+#elif (CAN_FD_CLOCK_HZ == 40000000u) && (CAN_FD_DATA_BITRATE == 8000000u) && (CAN_FD_DATA_SAMPLE_POINT == 700u)
+#define CAN_FD_DATA_PRESDIV    (0u)
+#define CAN_FD_DATA_PROPSEG    (0u)
+#define CAN_FD_DATA_PSEG1      (1u)
+#define CAN_FD_DATA_PSEG2      (1u)
+#define CAN_FD_DATA_RJW        (1u)
+#define CAN_FD_DATA_SP_REACHED (600u)
+#elif (CAN_FD_CLOCK_HZ == 40000000u) && (CAN_FD_DATA_BITRATE == 8000000u) && (CAN_FD_DATA_SAMPLE_POINT == 750u)
+#define CAN_FD_DATA_PRESDIV    (0u)
+#define CAN_FD_DATA_PROPSEG    (0u)
+#define CAN_FD_DATA_PSEG1      (1u)
+#define CAN_FD_DATA_PSEG2      (1u)
+#define CAN_FD_DATA_RJW        (1u)
+#define CAN_FD_DATA_SP_REACHED (600u)
+#elif (CAN_FD_CLOCK_HZ == 40000000u) && (CAN_FD_DATA_BITRATE == 8000000u) && (CAN_FD_DATA_SAMPLE_POINT == 800u)
+#define CAN_FD_DATA_PRESDIV    (0u)
+#define CAN_FD_DATA_PROPSEG    (0u)
+#define CAN_FD_DATA_PSEG1      (1u)
+#define CAN_FD_DATA_PSEG2      (1u)
+#define CAN_FD_DATA_RJW        (1u)
+#define CAN_FD_DATA_SP_REACHED (600u)
+#elif (CAN_FD_CLOCK_HZ == 48000000u) && (CAN_FD_DATA_BITRATE == 2000000u) && (CAN_FD_DATA_SAMPLE_POINT == 700u)
+#define CAN_FD_DATA_PRESDIV    (0u)
+#define CAN_FD_DATA_PROPSEG    (9u)
+#define CAN_FD_DATA_PSEG1      (6u)
+#define CAN_FD_DATA_PSEG2      (6u)
+#define CAN_FD_DATA_RJW        (6u)
+#define CAN_FD_DATA_SP_REACHED (708u)
+#elif (CAN_FD_CLOCK_HZ == 48000000u) && (CAN_FD_DATA_BITRATE == 2000000u) && (CAN_FD_DATA_SAMPLE_POINT == 750u)
+#define CAN_FD_DATA_PRESDIV    (0u)
+#define CAN_FD_DATA_PROPSEG    (11u)
+#define CAN_FD_DATA_PSEG1      (5u)
+#define CAN_FD_DATA_PSEG2      (5u)
+#define CAN_FD_DATA_RJW        (5u)
+#define CAN_FD_DATA_SP_REACHED (750u)
+#elif (CAN_FD_CLOCK_HZ == 48000000u) && (CAN_FD_DATA_BITRATE == 2000000u) && (CAN_FD_DATA_SAMPLE_POINT == 800u)
+#define CAN_FD_DATA_PRESDIV    (0u)
+#define CAN_FD_DATA_PROPSEG    (13u)
+#define CAN_FD_DATA_PSEG1      (4u)
+#define CAN_FD_DATA_PSEG2      (4u)
+#define CAN_FD_DATA_RJW        (4u)
+#define CAN_FD_DATA_SP_REACHED (791u)
+#elif (CAN_FD_CLOCK_HZ == 48000000u) && (CAN_FD_DATA_BITRATE == 4000000u) && (CAN_FD_DATA_SAMPLE_POINT == 700u)
+#define CAN_FD_DATA_PRESDIV    (0u)
+#define CAN_FD_DATA_PROPSEG    (3u)
+#define CAN_FD_DATA_PSEG1      (3u)
+#define CAN_FD_DATA_PSEG2      (3u)
+#define CAN_FD_DATA_RJW        (3u)
+#define CAN_FD_DATA_SP_REACHED (666u)
+#elif (CAN_FD_CLOCK_HZ == 48000000u) && (CAN_FD_DATA_BITRATE == 4000000u) && (CAN_FD_DATA_SAMPLE_POINT == 750u)
+#define CAN_FD_DATA_PRESDIV    (0u)
+#define CAN_FD_DATA_PROPSEG    (5u)
+#define CAN_FD_DATA_PSEG1      (2u)
+#define CAN_FD_DATA_PSEG2      (2u)
+#define CAN_FD_DATA_RJW        (2u)
+#define CAN_FD_DATA_SP_REACHED (750u)
+#elif (CAN_FD_CLOCK_HZ == 48000000u) && (CAN_FD_DATA_BITRATE == 4000000u) && (CAN_FD_DATA_SAMPLE_POINT == 800u)
+#define CAN_FD_DATA_PRESDIV    (0u)
+#define CAN_FD_DATA_PROPSEG    (7u)
+#define CAN_FD_DATA_PSEG1      (1u)
+#define CAN_FD_DATA_PSEG2      (1u)
+#define CAN_FD_DATA_RJW        (1u)
+#define CAN_FD_DATA_SP_REACHED (833u)
+#elif (CAN_FD_CLOCK_HZ == 48000000u) && (CAN_FD_DATA_BITRATE == 8000000u) && (CAN_FD_DATA_SAMPLE_POINT == 700u)
+#define CAN_FD_DATA_PRESDIV    (0u)
+#define CAN_FD_DATA_PROPSEG    (1u)
+#define CAN_FD_DATA_PSEG1      (1u)
+#define CAN_FD_DATA_PSEG2      (1u)
+#define CAN_FD_DATA_RJW        (1u)
+#define CAN_FD_DATA_SP_REACHED (666u)
+#elif (CAN_FD_CLOCK_HZ == 48000000u) && (CAN_FD_DATA_BITRATE == 8000000u) && (CAN_FD_DATA_SAMPLE_POINT == 750u)
+#define CAN_FD_DATA_PRESDIV    (0u)
+#define CAN_FD_DATA_PROPSEG    (1u)
+#define CAN_FD_DATA_PSEG1      (1u)
+#define CAN_FD_DATA_PSEG2      (1u)
+#define CAN_FD_DATA_RJW        (1u)
+#define CAN_FD_DATA_SP_REACHED (666u)
+#elif (CAN_FD_CLOCK_HZ == 48000000u) && (CAN_FD_DATA_BITRATE == 8000000u) && (CAN_FD_DATA_SAMPLE_POINT == 800u)
+#define CAN_FD_DATA_PRESDIV    (0u)
+#define CAN_FD_DATA_PROPSEG    (1u)
+#define CAN_FD_DATA_PSEG1      (1u)
+#define CAN_FD_DATA_PSEG2      (1u)
+#define CAN_FD_DATA_RJW        (1u)
+#define CAN_FD_DATA_SP_REACHED (666u)
+#elif (CAN_FD_CLOCK_HZ == 80000000u) && (CAN_FD_DATA_BITRATE == 2000000u) && (CAN_FD_DATA_SAMPLE_POINT == 700u)
+#define CAN_FD_DATA_PRESDIV    (1u)
+#define CAN_FD_DATA_PROPSEG    (7u)
+#define CAN_FD_DATA_PSEG1      (5u)
+#define CAN_FD_DATA_PSEG2      (5u)
+#define CAN_FD_DATA_RJW        (5u)
+#define CAN_FD_DATA_SP_REACHED (700u)
+#elif (CAN_FD_CLOCK_HZ == 80000000u) && (CAN_FD_DATA_BITRATE == 2000000u) && (CAN_FD_DATA_SAMPLE_POINT == 750u)
+#define CAN_FD_DATA_PRESDIV    (1u)
+#define CAN_FD_DATA_PROPSEG    (9u)
+#define CAN_FD_DATA_PSEG1      (4u)
+#define CAN_FD_DATA_PSEG2      (4u)
+#define CAN_FD_DATA_RJW        (4u)
+#define CAN_FD_DATA_SP_REACHED (750u)
+#elif (CAN_FD_CLOCK_HZ == 80000000u) && (CAN_FD_DATA_BITRATE == 2000000u) && (CAN_FD_DATA_SAMPLE_POINT == 800u)
+#define CAN_FD_DATA_PRESDIV    (0u)
+#define CAN_FD_DATA_PROPSEG    (23u)
+#define CAN_FD_DATA_PSEG1      (7u)
+#define CAN_FD_DATA_PSEG2      (7u)
+#define CAN_FD_DATA_RJW        (7u)
+#define CAN_FD_DATA_SP_REACHED (800u)
+#elif (CAN_FD_CLOCK_HZ == 80000000u) && (CAN_FD_DATA_BITRATE == 4000000u) && (CAN_FD_DATA_SAMPLE_POINT == 700u)
+#define CAN_FD_DATA_PRESDIV    (0u)
+#define CAN_FD_DATA_PROPSEG    (7u)
+#define CAN_FD_DATA_PSEG1      (5u)
+#define CAN_FD_DATA_PSEG2      (5u)
+#define CAN_FD_DATA_RJW        (5u)
+#define CAN_FD_DATA_SP_REACHED (700u)
+#elif (CAN_FD_CLOCK_HZ == 80000000u) && (CAN_FD_DATA_BITRATE == 4000000u) && (CAN_FD_DATA_SAMPLE_POINT == 750u)
+#define CAN_FD_DATA_PRESDIV    (0u)
+#define CAN_FD_DATA_PROPSEG    (9u)
+#define CAN_FD_DATA_PSEG1      (4u)
+#define CAN_FD_DATA_PSEG2      (4u)
+#define CAN_FD_DATA_RJW        (4u)
+#define CAN_FD_DATA_SP_REACHED (750u)
+#elif (CAN_FD_CLOCK_HZ == 80000000u) && (CAN_FD_DATA_BITRATE == 4000000u) && (CAN_FD_DATA_SAMPLE_POINT == 800u)
+#define CAN_FD_DATA_PRESDIV    (0u)
+#define CAN_FD_DATA_PROPSEG    (11u)
+#define CAN_FD_DATA_PSEG1      (3u)
+#define CAN_FD_DATA_PSEG2      (3u)
+#define CAN_FD_DATA_RJW        (3u)
+#define CAN_FD_DATA_SP_REACHED (800u)
+#elif (CAN_FD_CLOCK_HZ == 80000000u) && (CAN_FD_DATA_BITRATE == 5000000u) && (CAN_FD_DATA_SAMPLE_POINT == 700u)
+#define CAN_FD_DATA_PRESDIV    (0u)
+#define CAN_FD_DATA_PROPSEG    (5u)
+#define CAN_FD_DATA_PSEG1      (4u)
+#define CAN_FD_DATA_PSEG2      (4u)
+#define CAN_FD_DATA_RJW        (4u)
+#define CAN_FD_DATA_SP_REACHED (687u)
+#elif (CAN_FD_CLOCK_HZ == 80000000u) && (CAN_FD_DATA_BITRATE == 5000000u) && (CAN_FD_DATA_SAMPLE_POINT == 750u)
+#define CAN_FD_DATA_PRESDIV    (0u)
+#define CAN_FD_DATA_PROPSEG    (7u)
+#define CAN_FD_DATA_PSEG1      (3u)
+#define CAN_FD_DATA_PSEG2      (3u)
+#define CAN_FD_DATA_RJW        (3u)
+#define CAN_FD_DATA_SP_REACHED (750u)
+#elif (CAN_FD_CLOCK_HZ == 80000000u) && (CAN_FD_DATA_BITRATE == 5000000u) && (CAN_FD_DATA_SAMPLE_POINT == 800u)
+#define CAN_FD_DATA_PRESDIV    (0u)
+#define CAN_FD_DATA_PROPSEG    (9u)
+#define CAN_FD_DATA_PSEG1      (2u)
+#define CAN_FD_DATA_PSEG2      (2u)
+#define CAN_FD_DATA_RJW        (2u)
+#define CAN_FD_DATA_SP_REACHED (812u)
+#elif (CAN_FD_CLOCK_HZ == 80000000u) && (CAN_FD_DATA_BITRATE == 8000000u) && (CAN_FD_DATA_SAMPLE_POINT == 700u)
+#define CAN_FD_DATA_PRESDIV    (0u)
+#define CAN_FD_DATA_PROPSEG    (3u)
+#define CAN_FD_DATA_PSEG1      (2u)
+#define CAN_FD_DATA_PSEG2      (2u)
+#define CAN_FD_DATA_RJW        (2u)
+#define CAN_FD_DATA_SP_REACHED (700u)
+#elif (CAN_FD_CLOCK_HZ == 80000000u) && (CAN_FD_DATA_BITRATE == 8000000u) && (CAN_FD_DATA_SAMPLE_POINT == 750u)
+#define CAN_FD_DATA_PRESDIV    (0u)
+#define CAN_FD_DATA_PROPSEG    (5u)
+#define CAN_FD_DATA_PSEG1      (1u)
+#define CAN_FD_DATA_PSEG2      (1u)
+#define CAN_FD_DATA_RJW        (1u)
+#define CAN_FD_DATA_SP_REACHED (800u)
+#elif (CAN_FD_CLOCK_HZ == 80000000u) && (CAN_FD_DATA_BITRATE == 8000000u) && (CAN_FD_DATA_SAMPLE_POINT == 800u)
+#define CAN_FD_DATA_PRESDIV    (0u)
+#define CAN_FD_DATA_PROPSEG    (5u)
+#define CAN_FD_DATA_PSEG1      (1u)
+#define CAN_FD_DATA_PSEG2      (1u)
+#define CAN_FD_DATA_RJW        (1u)
+#define CAN_FD_DATA_SP_REACHED (800u)
+#else
+#error "No bit timing for CAN_FD_CLOCK_HZ, CAN_FD_DATA_BITRATE and CAN_FD_DATA_SAMPLE_POINT, add them to tools/bit_timing_table.py"
+#endif
+
+#endif /* FLEXCAN_INCLUDE_CAN_BIT_TIMING_TABLE_H_ */
@@ -0,0 +1,135 @@
+/**
+ * @file
+ * Header file for the CANopen slave: NMT, heartbeat, SDO server and PDOs
+ */
+
+#ifndef FLEXCAN_INCLUDE_CAN_CANOPEN_H_
+#define FLEXCAN_INCLUDE_CAN_CANOPEN_H_
+
+#include <FlexCAN/include/CAN_RXFIFO.h>
+
+/* Number of receive and transmit PDOs */
+#define CO_RPDOS              (4u)
+#define CO_TPDOS              (4u)
+
+/* Objects mapped into one PDO at most */
+#define CO_PDO_MAPPINGS       (8u)
+
+/* Longest wait for the next segment of a segmented SDO transfer */
+#define CO_SDO_TIMEOUT_MS     (1000u)
+
+/* COB-ID value that selects the predefined connection set for the PDO and node */
+#define CO_DEFAULT_COB_ID     (0u)
+
+/* Access rights of an object */
+#define CO_READ               (1u << 0)
+#define CO_WRITE              (1u << 1)
+
+/**
+ *  NMT states, valued as in the heartbeat
+ */
+typedef enum{
+	Co_initialising = 0,
+	Co_stopped = 4,
+	Co_operational = 5,
+	Co_pre_operational = 127
+} co_nmt_state_t;
+
+/**
+ *  Object dictionary entry, the dictionary is sorted by index then subindex
+ */
+typedef struct{
+	uint16_t index;
+	uint8_t subindex;
+	uint8_t access;               /* CO_READ and/or CO_WRITE */
+	uint32_t size;                /* Bytes of the object, 1, 2 or 4 for the PDO mappable ones */
+	void* data;
+} co_object_t;
+
+/**
+ *  Node configuration
+ */
+typedef struct{
+	FlexCAN_instance_t can;
+	uint8_t node_id;              /* 1 to 127 */
+	uint16_t heartbeat_ms;        /* Heartbeat producer period, 0 for none */
+	const co_object_t* objects;   /* Object dictionary */
+	uint32_t object_count;
+	void (*reset)(void);          /* Called on the NMT reset node command, or NULL */
+} co_config_t;
+
+/**
+ * Start the node, which sends its boot-up message and enters pre-operational
+ *
+ * @param [in] config The node configuration, its object dictionary must outlive the node
+ * @return Success If the node started
+ * @return Failure If the node ID is out of range or the dictionary isn't sorted
+ */
+status_t co_init(const co_config_t* config);
+
+/**
+ * Current NMT state of the node
+ *
+ * @return The NMT state
+ */
+co_nmt_state_t co_state(void);
+
+/**
+ * Map a receive PDO. Every mapping is compiled into a shift and a mask over the 64 bits of
+ * the PDO, so a received PDO updates each object with a couple of word operations.
+ *
+ * @param [in] pdo     Index of the receive PDO, from 0
+ * @param [in] cob_id  COB-ID of the PDO, or CO_DEFAULT_COB_ID for 0x200 + 0x100 * pdo + node ID
+ * @param [in] mapping Mapped objects in the 0x1600 format: index << 16 | subindex << 8 | bit length
+ * @param [in] count   Number of mapped objects, 0 disables the PDO
+ * @return Success If the PDO was mapped
+ * @return Failure If an object is missing, not writable, longer than its storage, or the mapping exceeds 64 bits
+ */
+status_t co_map_rpdo(uint8_t pdo, uint32_t cob_id, const uint32_t* mapping, uint8_t count);
+
+/**
+ * Map a transmit PDO, compiled like the receive ones
+ *
+ * @param [in] pdo      Index of the transmit PDO, from 0
+ * @param [in] cob_id   COB-ID of the PDO, or CO_DEFAULT_COB_ID for 0x180 + 0x100 * pdo + node ID
+ * @param [in] mapping  Mapped objects in the 0x1A00 format: index << 16 | subindex << 8 | bit length
+ * @param [in] count    Number of mapped objects, 0 disables the PDO
+ * @param [in] event_ms Period of the PDO while operational, 0 for sending it through co_send_tpdo() only
+ * @return Success If the PDO was mapped
+ * @return Failure If an object is missing, not readable, longer than its storage, or the mapping exceeds 64 bits
+ */
+status_t co_map_tpdo(uint8_t pdo, uint32_t cob_id, const uint32_t* mapping, uint8_t count, uint16_t event_ms);
+
+/**
+ * Queue a transmit PDO with the current values of its objects
+ *
+ * @param [in] pdo Index of the transmit PDO
+ * @return Success If the PDO was queued
+ * @return BufferFull If the transmission queue is full
+ * @return Failure If the node isn't operational or the PDO isn't mapped
+ */
+status_t co_send_tpdo(uint8_t pdo);
+
+/**
+ * Handle a received frame addressed to the node: NMT, SDO requests and receive PDOs.
+ * An SDO request received while the response to the previous one waits for the
+ * transmission queue is ignored, except an abort.
+ * Must be called from the context that otherwise calls transmit_frame().
+ *
+ * @param [in] frame The received frame
+ * @return Success If the node took the frame
+ * @return Failure If the frame isn't for the node
+ */
+status_t co_frame(const frame_t* frame);
+
+/**
+ * Hand the frames waiting in the reception ring to the node, frames it doesn't take are handed
+ * to dispatch_frame(), then send the heartbeat and the periodic PDOs due.
+ * Must be called periodically from the context that otherwise calls receive_frame() and
+ * transmit_frame().
+ *
+ * @return The number of frames taken from the ring
+ */
+uint32_t co_poll(void);
+
+#endif /* FLEXCAN_INCLUDE_CAN_CANOPEN_H_ */
@@ -0,0 +1,90 @@
+/**
+ * @file
+ * Header file for the cyclic transmission of periodic frames
+ */
+
+#ifndef FLEXCAN_INCLUDE_CAN_CYCLIC_H_
+#define FLEXCAN_INCLUDE_CAN_CYCLIC_H_
+
+#include <FlexCAN/include/CAN_RXFIFO.h>
+
+/* Number of periodic frames in the schedule */
+#define CYCLIC_ENTRIES        (32u)
+
+/* LPIT0 functional clock, SOSCDIV2 fed by the 8 MHz crystal as for FlexCAN */
+#define CYCLIC_CLOCK_HZ       (8000000u)
+
+/* Scheduler tick, the unit of the periods and offsets */
+#define CYCLIC_TICK_HZ        (1000u)
+
+/* Offset value that lets cyclic_add() pick the offset */
+#define CYCLIC_AUTO_OFFSET    (0xFFFFFFFFu)
+
+/**
+ *  Fills the payload of a periodic frame right before its release, called from the LPIT0 interrupt
+ */
+typedef void (*cyclic_source_t)(frame_t* frame);
+
+/**
+ *  Periodic frame of the schedule
+ */
+typedef struct{
+	FlexCAN_instance_t can;
+	uint32_t ID;                  /* Standard ID, or extended ID ORed with CAN_ID_EXT */
+	uint32_t period;              /* Release period in ticks */
+	uint32_t offset;               /* First release in ticks from the start, or CYCLIC_AUTO_OFFSET */
+	uint8_t prio;                 /* Local transmission priority, see transmit_frame_prio() */
+	cyclic_source_t source;       /* Payload source */
+} cyclic_entry_t;
+
+/**
+ *  Release counters of a periodic frame
+ */
+typedef struct{
+	uint32_t offset;               /* Offset in use, the chosen one for CYCLIC_AUTO_OFFSET */
+	uint32_t released;             /* Frames handed to the message buffer interrupt */
+	uint32_t missed;               /* Releases lost because TX_QUEUE_SIZE frames were pending */
+	uint32_t worst_release_jitter; /* Longest delay from the tick to the hand-off to the message buffer
+	                                * interrupt, in LPIT0 clock cycles. Arbitration delay isn't included */
+	uint64_t total_release_jitter; /* Sum of the delays from the tick to the hand-off */
+} cyclic_stats_t;
+
+/**
+ * Add a periodic frame to the schedule. With CYCLIC_AUTO_OFFSET the offset is the one within
+ * the period that makes the fewest releases coincide with the frames already added, so
+ * adding the shortest periods first spreads the bus load best.
+ * Must be called before cyclic_start().
+ *
+ * @param [in] entry The periodic frame
+ * @return Success If the frame was added
+ * @return BufferFull If there are CYCLIC_ENTRIES frames already
+ * @return Failure If the period is 0, the offset isn't below the period, the priority is
+ *                 above TX_PRIO_LOWEST or the source is NULL
+ */
+status_t cyclic_add(const cyclic_entry_t* entry);
+
+/**
+ * Start releasing the periodic frames from LPIT0 channel 0, every tick the frames due are
+ * handed to transmit_frame_ISR(). Call after FlexCAN_init_RXFIFO(), which starts the clock
+ * the LPIT0 runs from.
+ *
+ * @return Success If the scheduler was started
+ * @return Failure If the SOSC clock isn't running
+ */
+status_t cyclic_start(void);
+
+/**
+ * Stop releasing the periodic frames, cyclic_start() restarts the schedule from its beginning
+ */
+void cyclic_stop(void);
+
+/**
+ * Copy the release counters of a periodic frame
+ *
+ * @param [in] entry  Index of the frame in the order it was added
+ * @param [out] stats Where the counters are copied
+ * @return Success If the frame exists
+ */
+status_t get_cyclic_stats(uint32_t entry, cyclic_stats_t* stats);
+
+#endif /* FLEXCAN_INCLUDE_CAN_CYCLIC_H_ */
@@ -0,0 +1,55 @@
+/**
+ * @file
+ * Header file for dispatching received frames to per-ID handlers
+ */
+
+#ifndef FLEXCAN_INCLUDE_CAN_DISPATCH_H_
+#define FLEXCAN_INCLUDE_CAN_DISPATCH_H_
+
+#include <FlexCAN/include/CAN_RXFIFO.h>
+
+/* Number of registrations for standard IDs, per instance */
+#define DISPATCH_STD_ENTRIES  (32u)
+
+/* Number of registrations for extended IDs, per instance */
+#define DISPATCH_EXT_ENTRIES  (64u)
+
+/**
+ * Register a handler for the IDs matching an ID/mask pair on an instance, each instance has
+ * its own registrations. Standard IDs are looked up in a
+ * direct table covering the whole 11-bit space; extended IDs in a sorted table with one
+ * binary search per distinct mask. When several registrations match a frame, the one whose
+ * mask cares about the most bits wins, the latest one on a tie for standard IDs.
+ * Must not be called while frames are being dispatched.
+ *
+ * @param [in] can     The FlexCAN instance whose frames are handled
+ * @param [in] id      Standard ID, or extended ID ORed with CAN_ID_EXT
+ * @param [in] mask    Bits of the ID that must match, right-aligned like the ID
+ * @param [in] handler Handler of the matching frames
+ * @return Success If the handler was registered
+ * @return BufferFull If the table for the kind of ID is full
+ * @return Failure If the handler is NULL or the instance doesn't exist
+ */
+status_t dispatch_register(FlexCAN_instance_t can, uint32_t id, uint32_t mask, rx_callback_t handler);
+
+/**
+ * Call the handler registered for the frame's ID on the instance that received it
+ *
+ * @param [in] can   The FlexCAN instance that received the frame
+ * @param [in] frame The received frame
+ * @return Success If a handler was called
+ * @return Failure If no registration matches the ID
+ */
+status_t dispatch_frame(FlexCAN_instance_t can, const frame_t* frame);
+
+/**
+ * Dispatch every frame waiting in the reception ring in place, without copying them out,
+ * releasing them once handled. Frames without a handler are discarded.
+ * Must be called from the context that otherwise calls receive_frame().
+ *
+ * @param [in] can The FlexCAN instance whose reception ring is dispatched
+ * @return The number of frames taken from the ring
+ */
+uint32_t dispatch_received(FlexCAN_instance_t can);
+
+#endif /* FLEXCAN_INCLUDE_CAN_DISPATCH_H_ */
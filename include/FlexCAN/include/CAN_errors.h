@@ -0,0 +1,91 @@
+/**
+ * @file
+ * Header file for the FlexCAN error management
+ */
+
+#ifndef FLEXCAN_INCLUDE_CAN_ERRORS_H_
+#define FLEXCAN_INCLUDE_CAN_ERRORS_H_
+
+#include <FlexCAN/include/CAN_RXFIFO.h>
+
+/**
+ * Fault confinement states of the node
+ */
+typedef enum{
+	Error_active = 0,
+	Error_passive = 1,
+	Bus_off = 2
+} fault_state_t;
+
+/**
+ * Types of bus errors counted in the histogram
+ */
+typedef enum{
+	Bit0_error = 0,  /* Dominant bit sent, recessive read */
+	Bit1_error,      /* Recessive bit sent, dominant read */
+	Stuff_error,
+	Form_error,
+	CRC_error,
+	Ack_error,
+	Error_types      /* Number of error types */
+} error_type_t;
+
+/**
+ * Ways of leaving the bus-off state
+ */
+typedef enum{
+	Recovery_automatic = 0, /* The module rejoins by itself after 128 occurrences of 11 recessive bits */
+	Recovery_manual = 1     /* error_poll() lets the module rejoin after a backoff time */
+} recovery_t;
+
+/**
+ *  Bus-off recovery policy
+ */
+typedef struct{
+	recovery_t recovery;
+	uint32_t backoff_ms;      /* Wait before the first manual restart after a bus-off */
+	uint32_t backoff_max_ms;  /* Limit of the backoff, doubled on every bus-off that happens
+	                             before the node stayed error active for backoff_max_ms */
+} error_policy_t;
+
+/**
+ *  Snapshot of the error counters
+ */
+typedef struct{
+	fault_state_t state;
+	uint8_t tx_errors;          /* Transmit error counter, from ECR */
+	uint8_t rx_errors;          /* Receive error counter, from ECR */
+	uint32_t transitions;       /* Fault confinement state changes */
+	uint32_t bus_offs;          /* Times the node went bus-off */
+	uint32_t recoveries;        /* Times the node completed a bus-off recovery */
+	uint32_t errors[Error_types];
+} error_stats_t;
+
+/**
+ * Start monitoring the bus errors through the error and bus-off interrupts of an instance and
+ * apply the bus-off recovery policy. Call after the FlexCAN was initialized.
+ *
+ * @param [in] can The FlexCAN instance
+ * @param [in] policy The bus-off recovery policy
+ * @return Success If the monitoring was started
+ */
+status_t errors_init(FlexCAN_instance_t can, const error_policy_t* policy);
+
+/**
+ * Track the return to error active, which raises no interrupt, and restart a node held in
+ * bus-off by the manual policy once its backoff elapsed. Call periodically from the application.
+ *
+ * @param [in] can The FlexCAN instance
+ * @param [in] now_ms A free running millisecond counter
+ */
+void error_poll(FlexCAN_instance_t can, uint32_t now_ms);
+
+/**
+ * Copy the error counters
+ *
+ * @param [in] can The FlexCAN instance
+ * @param [out] stats Where the counters are copied
+ */
+void get_error_stats(FlexCAN_instance_t can, error_stats_t* stats);
+
+#endif /* FLEXCAN_INCLUDE_CAN_ERRORS_H_ */
@@ -0,0 +1,63 @@
+/**
+ * @file
+ * Header file for compiling accept lists into RX FIFO ID filter tables
+ */
+
+#ifndef FLEXCAN_INCLUDE_CAN_FILTER_COMPILER_H_
+#define FLEXCAN_INCLUDE_CAN_FILTER_COMPILER_H_
+
+#include <FlexCAN/include/CAN_RXFIFO.h>
+
+/**
+ *  Software check for the frames a compiled table over-accepts
+ */
+typedef struct{
+	const uint32_t* accept; /* Sorted accept list */
+	uint32_t count;         /* Number of IDs in the accept list */
+} residual_filter_t;
+
+/**
+ * Compile a list of accepted IDs into the fewest ID/mask filters for install_filters().
+ * IDs differing in a single bit are merged without loss first, then, while the result is
+ * above budget, or at most at budget with the false positive fraction staying under the
+ * tolerated one, the pair of filters whose merge adds the fewest IDs to those the table
+ * already accepts is merged. That count is exact for standard IDs and for extended lists
+ * whose IDs differ in at most 11 bits, otherwise overlaps between filters make it a lower bound.
+ *
+ * Each merge searches every pair of filters, so compiling n IDs takes up to O(n^3) steps,
+ * O(n^4) for the widest extended lists: run it on the host or once at start-up, not in a loop.
+ *
+ * @param [in,out] ids            Accept list, sorted and deduplicated in place
+ * @param [in]     count          Number of IDs in the accept list
+ * @param [in]     extended       1 if the list holds 29-bit extended IDs, 0 for 11-bit standard ones
+ * @param [in]     budget         Maximum number of filters the table can take
+ * @param [in]     tolerated_fp   Tolerated fraction of accepted IDs not in the list, in per mille
+ * @param [out]    filters        Array of at least count entries receiving the filters
+ * @param [out]    residual       Software check for the over-accepted IDs, may be NULL
+ * @return The number of filters written, 0 if the list was empty
+ */
+uint32_t compile_filters(uint32_t* ids, uint32_t count, uint8_t extended, uint32_t budget,
+                         uint32_t tolerated_fp, filter_t* filters, residual_filter_t* residual);
+
+/**
+ * Number of IDs accepted by a set of filters that are not in the accept list, exact for
+ * standard IDs and an upper bound for extended ones
+ *
+ * @param [in] filters  Filters as compiled by compile_filters()
+ * @param [in] count    Number of filters
+ * @param [in] accepted Number of IDs in the accept list
+ * @return The number of false positive IDs, for extended IDs overlaps between filters are counted twice
+ */
+uint32_t filters_false_positives(const filter_t* filters, uint32_t count, uint32_t accepted);
+
+/**
+ * Check a received ID against the accept list with a binary search
+ *
+ * @param [in] residual The residual filter filled by compile_filters()
+ * @param [in] id       The received ID
+ * @return Success If the ID is in the accept list
+ * @return Failure If the ID was over-accepted by the table and must be dropped
+ */
+status_t residual_accepts(const residual_filter_t* residual, uint32_t id);
+
+#endif /* FLEXCAN_INCLUDE_CAN_FILTER_COMPILER_H_ */
@@ -0,0 +1,83 @@
+/**
+ * @file
+ * Header file for forwarding frames between the FlexCAN instances
+ */
+
+#ifndef FLEXCAN_INCLUDE_CAN_GATEWAY_H_
+#define FLEXCAN_INCLUDE_CAN_GATEWAY_H_
+
+#include <FlexCAN/include/CAN_RXFIFO.h>
+
+/* Number of routes in the routing table */
+#define GATEWAY_ROUTES        (16u)
+
+/* Rewrite value that forwards the frame with its own ID */
+#define GATEWAY_KEEP_ID       (0xFFFFFFFFu)
+
+/**
+ *  Route of the frames received by an instance whose ID matches an ID/mask pair
+ */
+typedef struct{
+	FlexCAN_instance_t source;
+	uint32_t ID;                  /* Standard ID, or extended ID ORed with CAN_ID_EXT */
+	uint32_t mask;                /* Bits of the ID that must match, right-aligned like the ID */
+	FlexCAN_instance_t destination;
+	uint32_t rewrite_ID;          /* ID of the forwarded frame, or GATEWAY_KEEP_ID */
+	uint32_t min_interval;        /* Least time between two forwarded frames in source timer ticks, 0 for no limit */
+} route_t;
+
+/**
+ *  Counters of a route
+ */
+typedef struct{
+	uint32_t forwarded;           /* Frames queued on the destination */
+	uint32_t dropped;             /* Frames lost because the destination queue was full */
+	uint32_t rate_limited;        /* Frames discarded for arriving before min_interval elapsed */
+	uint32_t worst_latency;       /* Longest time from reception to queuing, in source timer ticks */
+	uint64_t total_latency;       /* Sum of the times from reception to queuing, over the forwarded frames */
+} route_stats_t;
+
+/**
+ * Replace the routing table and clear the route counters. A frame is forwarded by every route
+ * it matches. Must not be called while frames are being forwarded.
+ *
+ * @param [in] routes The routes
+ * @param [in] count  Number of routes
+ * @return Success If the table was installed
+ * @return BufferFull If there are more than GATEWAY_ROUTES routes
+ * @return Failure If a route has the same source and destination
+ */
+status_t gateway_init(const route_t* routes, uint32_t count);
+
+/**
+ * Forward a received frame through the matching routes
+ *
+ * @param [in] source The instance that received the frame
+ * @param [in] frame  The received frame, its ID is restored before returning
+ * @param [in] now    Current time of the source timer, from FlexCAN_timer_now()
+ * @return Success If at least one route matched
+ * @return Failure If no route matches the ID
+ */
+status_t gateway_forward(FlexCAN_instance_t source, frame_t* frame, uint64_t now);
+
+/**
+ * Forward every frame waiting in the reception ring of an instance straight from the ring into
+ * the destination transmission queues, releasing them once handled. Frames no route matches
+ * are handed to dispatch_frame(). Must be called from the context that otherwise calls
+ * receive_frame().
+ *
+ * @param [in] source The FlexCAN instance whose reception ring is forwarded
+ * @return The number of frames taken from the ring
+ */
+uint32_t gateway_poll(FlexCAN_instance_t source);
+
+/**
+ * Copy the counters of a route
+ *
+ * @param [in] route  Index of the route in the table given to gateway_init()
+ * @param [out] stats Where the counters are copied
+ * @return Success If the route exists
+ */
+status_t get_route_stats(uint32_t route, route_stats_t* stats);
+
+#endif /* FLEXCAN_INCLUDE_CAN_GATEWAY_H_ */
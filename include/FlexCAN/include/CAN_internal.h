@@ -0,0 +1,36 @@
+/**
+ * @file
+ * Header file for the definitions shared by the FlexCAN driver modules, not part of the API
+ */
+
+#ifndef FLEXCAN_INCLUDE_CAN_INTERNAL_H_
+#define FLEXCAN_INCLUDE_CAN_INTERNAL_H_
+
+#include "register_bit_fields.h"
+#include "s32_core_cm4.h"
+
+/* Prevent the compiler from reordering the memory accesses around it */
+#define COMPILER_BARRIER()      __asm volatile ("" : : : "memory")
+
+/* Critical sections against the driver interrupts. In host builds the simulator runs the
+ * handlers as the NVIC would and masks them like PRIMASK */
+#if defined(HOST_REGISTERS)
+void host_interrupts_disable(void);
+void host_interrupts_enable(void);
+
+#define CRITICAL_ENTER()        host_interrupts_disable()
+#define CRITICAL_EXIT()         host_interrupts_enable()
+#else
+#define CRITICAL_ENTER()        DISABLE_INTERRUPTS()
+#define CRITICAL_EXIT()         ENABLE_INTERRUPTS()
+#endif
+
+/* Set the priority of an interrupt and enable it, discarding a stale pending request */
+static inline void enable_IRQ(IRQn_Type irq, uint8_t priority)
+{
+    S32_NVIC->IP[irq] = priority;
+    S32_NVIC->ICPR[irq >> 5] = 1u << (irq & 0x1Fu);
+    S32_NVIC->ISER[irq >> 5] = 1u << (irq & 0x1Fu);
+}
+
+#endif /* FLEXCAN_INCLUDE_CAN_INTERNAL_H_ */
@@ -0,0 +1,125 @@
+/**
+ * @file
+ * Header file for the ISO-TP (ISO 15765-2) transport layer
+ */
+
+#ifndef FLEXCAN_INCLUDE_CAN_ISOTP_H_
+#define FLEXCAN_INCLUDE_CAN_ISOTP_H_
+
+#include <FlexCAN/include/CAN_RXFIFO.h>
+
+/* Number of sessions open at once */
+#define ISOTP_SESSIONS        (4u)
+
+/* N_Bs and N_Cr, the longest wait for a flow control or a consecutive frame */
+#define ISOTP_TIMEOUT_MS      (1000u)
+
+/* Flow control frames with the wait status accepted in a row before the transfer is given up */
+#define ISOTP_WFT_MAX         (10u)
+
+/* Value of the unused bytes of a frame */
+#define ISOTP_PADDING         (0xCCu)
+
+/**
+ *  Addressing and flow control parameters of a session
+ */
+typedef struct{
+	FlexCAN_instance_t can;
+	uint32_t tx_ID;               /* ID of the frames sent, standard or ORed with CAN_ID_EXT */
+	uint32_t rx_ID;               /* ID of the frames received */
+	uint8_t block_size;           /* Consecutive frames the peer sends between flow controls, 0 for all */
+	uint8_t st_min;               /* Separation time requested from the peer, encoded as in the flow control */
+} isotp_config_t;
+
+/**
+ *  Progress of a transfer
+ */
+typedef enum{
+	Isotp_idle = 0,               /* No transfer started */
+	Isotp_busy = 1,
+	Isotp_done = 2,
+	Isotp_timeout = 3,            /* The peer stopped answering */
+	Isotp_overflow = 4,           /* The message doesn't fit the receiver's buffer */
+	Isotp_sequence = 5,           /* A consecutive frame came out of order */
+	Isotp_aborted = 6             /* The peer asked to wait more than ISOTP_WFT_MAX times */
+} isotp_result_t;
+
+/**
+ * Open a session for a pair of IDs
+ *
+ * @param [in] config The addressing and flow control parameters
+ * @param [out] session Handle of the session
+ * @return Success If the session was opened
+ * @return BufferFull If ISOTP_SESSIONS sessions are open
+ * @return Failure If the block size or the separation time are not valid
+ */
+status_t isotp_open(const isotp_config_t* config, uint8_t* session);
+
+/**
+ * Start sending a message, whose bytes are segmented straight from the caller's buffer.
+ * Messages above 4095 bytes use the 32-bit first frame length.
+ *
+ * @param [in] session Handle of the session
+ * @param [in] data    The message, must stay untouched until the transfer ends
+ * @param [in] length  Number of bytes, at least 1
+ * @return Success If the transfer started
+ * @return BufferFull If a transfer is in progress
+ * @return Failure If the session isn't open or the length is 0
+ */
+status_t isotp_send(uint8_t session, const uint8_t* data, uint32_t length);
+
+/**
+ * Provide the buffer the next received message is reassembled into, straight from the
+ * reception ring. Messages arriving without a buffer are rejected with an overflow flow
+ * control, a single frame message too big for the buffer ends the reception with Isotp_overflow.
+ *
+ * @param [in] session Handle of the session
+ * @param [out] buffer Where the message is written, must stay available until the transfer ends
+ * @param [in] size    Size of the buffer in bytes
+ * @return Success If the buffer is in place
+ * @return BufferFull If a message is being received
+ * @return Failure If the session isn't open
+ */
+status_t isotp_receive(uint8_t session, uint8_t* buffer, uint32_t size);
+
+/**
+ * Progress of the message being sent, reading a finished result sets the session back to idle
+ *
+ * @param [in] session Handle of the session
+ * @return The progress of the transfer, Isotp_idle if the handle isn't valid
+ */
+isotp_result_t isotp_send_result(uint8_t session);
+
+/**
+ * Progress of the message being received, reading a finished result sets the session back to
+ * idle, which takes a new buffer through isotp_receive()
+ *
+ * @param [in] session Handle of the session
+ * @param [out] length Number of bytes of the message once done
+ * @return The progress of the transfer, Isotp_idle if the handle isn't valid
+ */
+isotp_result_t isotp_receive_result(uint8_t session, uint32_t* length);
+
+/**
+ * Handle a received frame if a session listens to its ID.
+ * Must be called from the context that otherwise calls transmit_frame().
+ *
+ * @param [in] can   The FlexCAN instance that received the frame
+ * @param [in] frame The received frame
+ * @return Success If a session took the frame
+ * @return Failure If no session listens to the ID
+ */
+status_t isotp_frame(FlexCAN_instance_t can, const frame_t* frame);
+
+/**
+ * Hand the frames waiting in the reception ring to the sessions, frames no session listens
+ * to are handed to dispatch_frame(), then send the segments due and check the timeouts.
+ * Must be called periodically from the context that otherwise calls receive_frame() and
+ * transmit_frame(), as often as the shortest separation time in use.
+ *
+ * @param [in] can The FlexCAN instance
+ * @return The number of frames taken from the ring
+ */
+uint32_t isotp_poll(FlexCAN_instance_t can);
+
+#endif /* FLEXCAN_INCLUDE_CAN_ISOTP_H_ */
@@ -0,0 +1,126 @@
+/**
+ * @file
+ * Header file for the SAE J1939 network and transport layers
+ */
+
+#ifndef FLEXCAN_INCLUDE_CAN_J1939_H_
+#define FLEXCAN_INCLUDE_CAN_J1939_H_
+
+#include <FlexCAN/include/CAN_RXFIFO.h>
+
+/* Number of PGNs with a receive handler */
+#define J1939_HANDLERS        (32u)
+
+/* Number of multi-packet messages being received and sent at once */
+#define J1939_RX_SESSIONS     (4u)
+#define J1939_TX_SESSIONS     (4u)
+
+/* Largest multi-packet message received, every receive session holds a buffer of this size.
+ * The protocol allows up to 1785 bytes */
+#define J1939_MAX_MESSAGE     (512u)
+
+/* Packets the receiver lets through per clear to send */
+#define J1939_CTS_PACKETS     (16u)
+
+/* Time between the packets of a broadcast announce message */
+#define J1939_BAM_GAP_MS      (50u)
+
+/* Special addresses */
+#define J1939_GLOBAL_ADDRESS  (0xFFu)
+#define J1939_NULL_ADDRESS    (0xFEu)
+
+/**
+ *  Handler of a received message, called from j1939_poll()
+ */
+typedef void (*j1939_handler_t)(uint32_t pgn, uint8_t source, const uint8_t* data, uint16_t length);
+
+/**
+ *  Progress of a message being sent
+ */
+typedef enum{
+	J1939_idle = 0,               /* No message sent from this session */
+	J1939_busy = 1,
+	J1939_done = 2,
+	J1939_aborted = 3,            /* The receiver aborted the transfer */
+	J1939_timeout = 4             /* The receiver stopped answering */
+} j1939_result_t;
+
+/**
+ * Start the node on an instance and claim an address. A NAME with the arbitrary address
+ * capable bit (63) set moves to another address in 128..247 when it loses a claim, otherwise
+ * it ends with the null address.
+ *
+ * @param [in] can     The FlexCAN instance
+ * @param [in] name    The 64-bit NAME of the node
+ * @param [in] address The preferred address
+ * @return Success If the claim was started
+ * @return Failure If the address is not below J1939_NULL_ADDRESS
+ */
+status_t j1939_init(FlexCAN_instance_t can, uint64_t name, uint8_t address);
+
+/**
+ * Address the node claimed
+ *
+ * @return The address, or J1939_NULL_ADDRESS while the claim is in progress or after it failed
+ */
+uint8_t j1939_address(void);
+
+/**
+ * Register the handler of a PGN, for PDU1 PGNs the destination byte must be 0. The handlers
+ * are found with a binary search. Must not be called from a handler.
+ *
+ * @param [in] pgn     The parameter group number
+ * @param [in] handler Handler of the messages of that PGN
+ * @return Success If the handler was registered or replaced the previous one
+ * @return BufferFull If there are J1939_HANDLERS handlers already
+ * @return Failure If the handler is NULL
+ */
+status_t j1939_register(uint32_t pgn, j1939_handler_t handler);
+
+/**
+ * Start sending a message, with a single frame up to 8 bytes, with the broadcast announce
+ * message to the global address and with RTS/CTS otherwise. The packets are taken straight
+ * from the caller's buffer.
+ *
+ * @param [in] pgn         The parameter group number
+ * @param [in] priority    Priority field of the ID, 0 (most urgent) to 7
+ * @param [in] destination Destination address, ignored for PDU2 PGNs which are always global
+ * @param [in] data        The message, must stay untouched until the transfer ends
+ * @param [in] length      Number of bytes, up to 1785
+ * @param [out] session    Handle for j1939_send_result(), or NULL
+ * @return Success If the message was queued or the transfer started
+ * @return BufferFull If the transmission queue is full, no session is free, or a transfer to the same destination is in progress
+ * @return Failure If no address is claimed or a parameter is out of range
+ */
+status_t j1939_send(uint32_t pgn, uint8_t priority, uint8_t destination, const uint8_t* data,
+                    uint16_t length, uint8_t* session);
+
+/**
+ * Progress of a multi-packet message being sent, reading a finished result frees the session
+ *
+ * @param [in] session Handle given by j1939_send()
+ * @return The progress of the transfer
+ */
+j1939_result_t j1939_send_result(uint8_t session);
+
+/**
+ * Handle a received frame addressed to the node or to the global address.
+ * Must be called from the context that otherwise calls transmit_frame().
+ *
+ * @param [in] frame The received frame
+ * @return Success If the frame was a J1939 frame handled by the node
+ * @return Failure If it is a standard frame, or nothing handles its PGN
+ */
+status_t j1939_frame(const frame_t* frame);
+
+/**
+ * Hand the frames waiting in the reception ring to the node, frames it doesn't handle are
+ * handed to dispatch_frame(), then advance the address claim and the transfers.
+ * Must be called periodically from the context that otherwise calls receive_frame() and
+ * transmit_frame().
+ *
+ * @return The number of frames taken from the ring
+ */
+uint32_t j1939_poll(void);
+
+#endif /* FLEXCAN_INCLUDE_CAN_J1939_H_ */
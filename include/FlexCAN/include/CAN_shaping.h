@@ -0,0 +1,89 @@
+/**
+ * @file
+ * Header file for shaping the transmitted traffic per ID
+ */
+
+#ifndef FLEXCAN_INCLUDE_CAN_SHAPING_H_
+#define FLEXCAN_INCLUDE_CAN_SHAPING_H_
+
+#include <FlexCAN/include/CAN_RXFIFO.h>
+
+/* Number of shaped IDs, across both instances */
+#define SHAPING_RULES         (32u)
+
+/* Number of token buckets shared by groups of IDs */
+#define SHAPING_BUCKETS       (8u)
+
+/* Bucket value of a rule that belongs to no group */
+#define SHAPING_NO_BUCKET     (0xFFu)
+
+#if SHAPING_RULES > 254u
+#error "SHAPING_RULES must fit the 8-bit indices of the lookup table"
+#endif
+
+/**
+ *  Shaping of the frames an instance transmits with one ID
+ */
+typedef struct{
+	FlexCAN_instance_t can;
+	uint32_t ID;                  /* Standard ID, or extended ID ORed with CAN_ID_EXT */
+	uint32_t min_interval;        /* Least time between two transmissions in timer ticks, 0 for no limit */
+	uint8_t on_change;            /* Withhold frames whose payload equals the last transmitted one */
+	uint8_t bucket;               /* Token bucket of the ID group, or SHAPING_NO_BUCKET */
+} shaping_rule_t;
+
+/**
+ *  Counters of the shaping stage
+ */
+typedef struct{
+	uint32_t passed;              /* Frames handed to transmit_frame() */
+	uint32_t interval;            /* Frames withheld for arriving before min_interval elapsed */
+	uint32_t unchanged;           /* Frames withheld for repeating the last payload */
+	uint32_t bucket_empty;        /* Frames withheld for lack of tokens in their group */
+} shaping_stats_t;
+
+/**
+ * Configure the token bucket of a group of IDs. The bucket starts full and gains one token
+ * every refill_ticks, each frame of the group spends one.
+ * Must not be called while frames are being transmitted through transmit_frame_shaped().
+ *
+ * @param [in] bucket       Index of the bucket
+ * @param [in] capacity     Most tokens the bucket holds, the longest burst of the group
+ * @param [in] refill_ticks Timer ticks per token, the sustained interval of the group
+ * @return Success If the bucket was configured
+ * @return Failure If the index is out of range or a parameter is 0
+ */
+status_t shaping_set_bucket(uint8_t bucket, uint32_t capacity, uint32_t refill_ticks);
+
+/**
+ * Add the shaping of an ID, found in constant time by a hash of the instance and ID.
+ * Must not be called while frames are being transmitted through transmit_frame_shaped().
+ *
+ * @param [in] rule The shaping of the ID
+ * @return Success If the rule was added
+ * @return BufferFull If there are SHAPING_RULES rules already
+ * @return Failure If the ID already has a rule, or the bucket is out of range or not
+ *                 configured by shaping_set_bucket() yet
+ */
+status_t shaping_add_rule(const shaping_rule_t* rule);
+
+/**
+ * Queue a frame for transmission unless the shaping of its ID withholds it. IDs without a rule
+ * go straight to transmit_frame(). Not reentrant, call from a single context per instance.
+ *
+ * @param [in] can The FlexCAN instance
+ * @param [in] frame The frame to transmit
+ * @return Success If the frame was queued
+ * @return Suppressed If the shaping withheld the frame
+ * @return BufferFull If the transmission queue is full, the shaping state is left untouched
+ */
+status_t transmit_frame_shaped(FlexCAN_instance_t can, frame_t* frame);
+
+/**
+ * Copy the shaping counters
+ *
+ * @param [out] stats Where the counters are copied
+ */
+void get_shaping_stats(shaping_stats_t* stats);
+
+#endif /* FLEXCAN_INCLUDE_CAN_SHAPING_H_ */
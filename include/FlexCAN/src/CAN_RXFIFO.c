@@ -3,193 +3,1659 @@
  */
 
 #include <FlexCAN/include/CAN_RXFIFO.h>
-#include "register_bit_fields.h"
-
-
-/* Structure for the CAN bit timings */
- typedef struct {
-    uint8_t PRESDIV;
-    uint8_t PROPSEG;
-    uint8_t PSEG1;
-    uint8_t PSEG2;
-    uint8_t RJW;
-} CAN_bit_timings_t;
-
-
-/* CAN bit timings for 500 Kbit/s  */
-CAN_bit_timings_t timings = {
-        .PRESDIV = 0,
-        .PROPSEG = 5,
-        .PSEG1 = 5,
-        .PSEG2 = 2,
-        .RJW = 2,
-};
+#include <FlexCAN/include/CAN_bit_timing.h>
+#include <FlexCAN/include/CAN_internal.h>
+#include "S32K142_features.h"
+
 
 /* The message buffers and RX FIFO have different structures in the register_bit_fields header,
- * and the RX FIFO and the Message Buffer used for transmission are the 0th of each type */
+ * the RX FIFO output is the 0th of its type */
 typedef enum {
-    RX_FIFO = 0,
-    TX_MB = 0
+    RX_FIFO = 0
 } MB_index_Enum;
 
-status_t FlexCAN_init_RXFIFO(void)
+/* Message buffer CODE field values used by the driver */
+typedef enum {
+    MB_CODE_RX_INACTIVE = 0x0,
+    MB_CODE_RX_EMPTY    = 0x4,
+    MB_CODE_RX_OVERRUN  = 0x6,
+    MB_CODE_TX_INACTIVE = 0x8,
+    MB_CODE_TX_ABORT    = 0x9,
+    MB_CODE_TX_DATA     = 0xC
+} MB_code_Enum;
+
+/* Classic_MessageBuffer[0] is the 8th message buffer of the module, the ones before it
+ * are taken by the RX FIFO and its ID filter table */
+#define CLASSIC_MB_OFFSET       (8u)
+
+/* Most transmission message buffers of an instance */
+#define TX_MB_MAX               (8u)
+
+/* Bit masks of the IFLAG1 flags used by the RX FIFO */
+#define IFLAG1_RXFIFO_AVAILABLE (1u << 5)
+#define IFLAG1_RXFIFO_WARNING   (1u << 6)
+#define IFLAG1_RXFIFO_OVERFLOW  (1u << 7)
+
+/* eDMA source address modulo of the RX FIFO output, 2^4 = sizeof(rx_fifo_entry_t) bytes */
+#define EDMA_ATTR_SMOD_16_BYTES (4u)
+
+/* Clock gate bit of the PCC registers */
+#define PCC_CGC                 (1u << 30)
+
+/* Field of the RX FIFO control/status word with the number of the filter that accepted the frame */
+#define RXFIFO_CS_IDHIT_SHIFT   (23u)
+
+/* Local priority field of the message buffer ID word, above the 29 bits of the ID */
+#define TX_KEY_PRIO_SHIFT       (29u)
+
+/* Binary min-heap size, it takes at most TX_QUEUE_SIZE frames from the queue so the aborted
+ * ones always fit back in */
+#define TX_HEAP_SIZE            (TX_QUEUE_SIZE + TX_MB_MAX)
+
+/* Message buffer RAM region 0 spans 512 bytes from the RX FIFO output (message buffer 0) */
+#define MB_RAM_BYTES            (512u)
+
+/* Message buffer layout in CAN FD mode, every one holds an 8-byte header plus the payload */
+#define FD_MB_STRIDE            (8u + CAN_FD_PAYLOAD_BYTES)
+#define FD_MB_COUNT             (MB_RAM_BYTES / FD_MB_STRIDE)
+#define FD_TX_MB_COUNT          (2u)
+#define FD_RX_MB_COUNT          (FD_MB_COUNT - FD_TX_MB_COUNT)
+#define FD_RX_EXT_MB_COUNT      (2u)
+#define IFLAG1_FD_RX_MBS        ((1u << FD_RX_MB_COUNT) - 1u)
+
+#if CAN_FD_PAYLOAD_BYTES == 8u
+#define FD_MBDSR                CAN0_FDCTRL_MBDSR0_00
+#elif CAN_FD_PAYLOAD_BYTES == 16u
+#define FD_MBDSR                CAN0_FDCTRL_MBDSR0_01
+#elif CAN_FD_PAYLOAD_BYTES == 32u
+#define FD_MBDSR                CAN0_FDCTRL_MBDSR0_10
+#elif CAN_FD_PAYLOAD_BYTES == 64u
+#define FD_MBDSR                CAN0_FDCTRL_MBDSR0_11
+#else
+#error "CAN_FD_PAYLOAD_BYTES must be 8, 16, 32 or 64"
+#endif
+
+/* Fields of the control/status and ID words of a message buffer */
+#define MB_CS_EDL               (1u << 31)
+#define MB_CS_BRS               (1u << 30)
+#define MB_CS_CODE_SHIFT        (24u)
+#define MB_CS_DLC_SHIFT         (16u)
+#define MB_ID_STD_SHIFT         (18u)
+#define MB_CS_SRR               (1u << 22)
+#define MB_CS_IDE_SHIFT         (21u)
+
+/* Message buffer ID word of a frame ID, extended IDs at [28..0] and standard ones at [28..18],
+ * selected by the CAN_ID_EXT flag without branching */
+#define MB_ID_WORD(id)          (((id) & CAN_ID_MASK) << ((((id) >> 31) ^ 1u) * MB_ID_STD_SHIFT))
+
+/* Frame ID of a message buffer ID word and the IDE bit of its control/status word */
+#define FRAME_ID(word, ide)     ((((word) & CAN_ID_MASK) >> (((ide) ^ 1u) * MB_ID_STD_SHIFT)) | ((uint32_t)(ide) << 31))
+
+/* IDE and SRR bits of the control/status word for a frame ID, SRR is sent recessive in extended frames */
+#define MB_CS_ID_FLAGS(id)      ((((id) >> 31) * (MB_CS_SRR | (1u << MB_CS_IDE_SHIFT))))
+
+/* Largest transceiver delay compensation offset, in protocol engine clock cycles */
+#define TDCOFF_MAX              (31u)
+
+/* Frame waiting for transmission, its timestamp holds the time the MB interrupt took it from
+ * the queue until it is confirmed. The key ranks it as the arbitration does with local priority
+ * enabled, and the sequence number the heap gave it keeps frames of equal key in queuing order */
+typedef struct {
+    frame_t frame;
+    uint32_t key;
+    uint32_t seq;
+} tx_entry_t;
+
+/* Fixed resources and message buffer layout of a FlexCAN instance */
+typedef struct {
+    CAN0_Type* base;
+    volatile uint32_t* pcc;   /* PCC register gating the module clock */
+    IRQn_Type rx_irq;         /* Interrupt of the RX FIFO flags */
+    IRQn_Type tx_irq;         /* Interrupt of the transmission and hot message buffers */
+    uint8_t mb_count;
+    uint8_t tx_mb_first;      /* First transmission message buffer, as a Classic_MessageBuffer index */
+    uint8_t tx_mb_count;
+    uint8_t hot_mb_count;     /* Message buffers right below the transmission ones dedicated to hot IDs */
+    uint8_t fd_capable;
+    uint8_t dma_channel;      /* eDMA channel that moves the RX FIFO entries in DMA mode */
+    uint8_t dma_request;      /* DMAMUX source of the RX FIFO */
+    void (*pins)(void);       /* Pin multiplexing, NULL when left to the application */
+} FlexCAN_resources_t;
+
+/* Queues, rings and counters of a FlexCAN instance */
+typedef struct {
+    /* Software ring filled from the RX FIFO interrupt, head is only written by the ISR
+     * and tail only by receive_frame(), so no locking is needed between both sides */
+    frame_t rx_ring[RX_RING_SIZE];
+    volatile uint32_t rx_head;
+    volatile uint32_t rx_tail;
+
+    /* Reception counters, only written by the interrupts and receive_frames_DMA(), which takes
+     * the filter hits over from the RX FIFO interrupt and masks the interrupts to count the
+     * received frames. Here dropped only counts the hot message buffer overruns, get_rx_stats()
+     * adds the rest */
+    volatile rx_stats_t rx_stats;
+
+    /* Software queue drained into the pending heap by the MB interrupt,
+     * head is only written by transmit_frame_prio() and tail only by the ISR */
+    tx_entry_t tx_queue[TX_QUEUE_SIZE];
+    volatile uint32_t tx_head;
+    volatile uint32_t tx_tail;
+
+    /* Binary min-heap of the pending frames, owned by the ISR */
+    tx_entry_t tx_heap[TX_HEAP_SIZE];
+    uint32_t tx_heap_count;
+
+    /* Sequence number of the next frame entering the heap, from the queue or transmit_frame_ISR() */
+    uint32_t tx_seq;
+
+    /* One bit per transmission message buffer not holding a pending frame, owned by the ISR */
+    volatile uint32_t tx_free_mbs;
+
+    /* One bit per transmission message buffer whose frame is being aborted, owned by the ISR */
+    uint32_t tx_aborting;
+
+    /* Copy of the frame loaded in each transmission message buffer, for its confirmation or requeue */
+    tx_entry_t tx_inflight[TX_MB_MAX];
+
+    /* Handler of the frames received by each hot message buffer */
+    rx_callback_t hot_callbacks[HOT_MB_COUNT];
+
+    /* Worst-case queuing delay per identifier, only written by the ISR */
+    volatile tx_delay_t tx_delays[TX_DELAY_SLOTS];
+    volatile uint32_t tx_delay_count;
+
+    /* Confirmations of transmitted frames, head is only written by the ISR and tail by transmitted_frame() */
+    frame_t tx_done_ring[TX_DONE_RING_SIZE];
+    volatile uint32_t tx_done_head;
+    volatile uint32_t tx_done_tail;
+
+    /* Free running timer extended to 64 bits, and its 16-bit value when last sampled */
+    uint64_t timer_extended;
+    uint16_t timer_last;
+
+    /* Frequency of the free running timer, one tick per nominal bit */
+    uint32_t timer_hz;
+
+    /* Optional monotonic clock used to count the timer wraparounds while no interrupt samples it */
+    uint64_t (*anchor_now)(void);
+    uint32_t anchor_hz;
+    uint64_t anchor_last;
+
+    /* Circular buffer written by the eDMA channel, tail is only written by receive_frames_DMA() */
+    rx_fifo_entry_t rx_dma_ring[RX_DMA_RING_SIZE];
+    uint32_t rx_dma_tail;
+
+    /* Set when the module runs in CAN FD mode, the message buffer interrupts then serve the FD mailboxes */
+    uint8_t fd_mode;
+} FlexCAN_state_t;
+
+/* FlexCAN0 transceiver pins of the board */
+static void CAN0_pins(void)
+{
+    PCC->PCC_PORTE_b.CGC = PCC_PCC_PORTE_CGC_1;   /* Clock gating to PORT E */
+    PORTE->PORTE_PCR4_b.MUX = PORTE_PCR4_MUX_101; /* CAN0_RX at PORT E pin 4 */
+    PORTE->PORTE_PCR5_b.MUX = PORTE_PCR5_MUX_101; /* CAN0_TX at PORT E pin 5 */
+}
+
+/* FlexCAN0 keeps its last 8 message buffers for transmission, with the hot ones below them.
+ * FlexCAN1 has a single interrupt for its 16 message buffers and keeps the last 4 for
+ * transmission, which leaves room for 24 ID filter table elements */
+static const FlexCAN_resources_t resources[FlexCAN_instances] = {
+    {
+        .base         = CAN0,
+        .pcc          = &PCC->PCC_FlexCAN0,
+        .rx_irq       = CAN0_ORed_0_15_MB_IRQn,
+        .tx_irq       = CAN0_ORed_16_31_MB_IRQn,
+        .mb_count     = FEATURE_CAN0_MAX_MB_NUM,
+        .tx_mb_first  = 16,
+        .tx_mb_count  = 8,
+        .hot_mb_count = HOT_MB_COUNT,
+        .fd_capable   = 1,
+        .dma_channel  = 0,
+        .dma_request  = EDMA_REQ_FLEXCAN0,
+        .pins         = CAN0_pins,
+    },
+    {
+        .base         = CAN1,
+        .pcc          = &PCC->PCC_FlexCAN1,
+        .rx_irq       = CAN1_ORed_0_15_MB_IRQn,
+        .tx_irq       = CAN1_ORed_0_15_MB_IRQn,
+        .mb_count     = FEATURE_CAN1_MAX_MB_NUM,
+        .tx_mb_first  = 4,
+        .tx_mb_count  = 4,
+        .hot_mb_count = 0,
+        .fd_capable   = 0,
+        .dma_channel  = 1,
+        .dma_request  = EDMA_REQ_FLEXCAN1,
+        .pins         = 0,
+    },
+};
+
+static FlexCAN_state_t state[FlexCAN_instances];
+
+/* CAN FD data length codes above 8 map to these payload lengths */
+static const uint8_t fd_lengths[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64 };
+
+/* Software ring filled from the FD reception message buffers, same scheme as rx_ring.
+ * Only FlexCAN0 has CAN FD, so it is not part of the instance state */
+static fd_frame_t rx_fd_ring[RX_FD_RING_SIZE];
+static volatile uint32_t rx_fd_head = 0;
+static volatile uint32_t rx_fd_tail = 0;
+
+static void load_tx_mailboxes(FlexCAN_instance_t can, uint64_t now);
+
+/* Address of a message buffer in CAN FD mode */
+static volatile uint32_t* fd_mailbox(CAN0_Type* base, uint32_t mb)
+{
+    return (volatile uint32_t*)((volatile uint8_t*)&base->Classic_RX_FIFO[0] + (mb * FD_MB_STRIDE));
+}
+
+/* First hot message buffer, right below the transmission ones, as a Classic_MessageBuffer index */
+static uint32_t hot_mb_first(const FlexCAN_resources_t* res)
+{
+    return (uint32_t)res->tx_mb_first - res->hot_mb_count;
+}
+
+/* IFLAG1 bits of count message buffers from a Classic_MessageBuffer index */
+static uint32_t iflag1_mbs(uint32_t first, uint32_t count)
+{
+    return ((1u << count) - 1u) << (first + CLASSIC_MB_OFFSET);
+}
+
+/* Pend the interrupt serving the transmission message buffers */
+static void pend_tx_IRQ(const FlexCAN_resources_t* res)
+{
+    S32_NVIC->ISPR[res->tx_irq >> 5] = 1u << (res->tx_irq & 0x1Fu);
+}
+
+/* Advance the extended timer to the current free running timer value and return it,
+ * only called from the MB interrupts or with interrupts disabled */
+static uint64_t timer_sample(FlexCAN_instance_t can)
 {
+    FlexCAN_state_t* st = &state[can];
+    uint16_t now = resources[can].base->CAN0_TIMER_b.TIMER;
+    uint32_t delta = (uint16_t)(now - st->timer_last);
+
+    if( st->anchor_now != 0 )
+    {
+        uint64_t anchor = st->anchor_now();
+
+        /* Bit times elapsed according to the anchor reveal the wraparounds the timer can't show,
+         * rounded to the wraparound count closest to the anchor estimate */
+        uint64_t elapsed = ((anchor - st->anchor_last) * st->timer_hz) / st->anchor_hz;
+        if( elapsed > delta )
+        {
+            delta += (uint32_t)(((elapsed - delta) + 0x8000u) >> 16) << 16;
+        }
+
+        st->anchor_last = anchor;
+    }
+
+    st->timer_extended += delta;
+    st->timer_last = now;
+
+    return st->timer_extended;
+}
+
+/* Reconstruct a 16-bit timestamp captured no more than one wraparound before the given extended time */
+static uint64_t timestamp_extend(uint64_t now, uint16_t timestamp)
+{
+    return now - (uint16_t)((uint16_t)now - timestamp);
+}
+
+/* Attribute a received frame to the filter that accepted it */
+static void count_filter_hit(FlexCAN_state_t* st, uint32_t idhit)
+{
+    st->rx_stats.filter_hits[(idhit < FILTER_HIT_COUNTERS) ? idhit : (FILTER_HIT_COUNTERS - 1u)]++;
+}
+
+/* Request freeze mode and block until the module acknowledges it */
+static void freeze_enter(CAN0_Type* base)
+{
+    base->CAN0_MCR_b.HALT = CAN0_MCR_HALT_1;
+    base->CAN0_MCR_b.FRZ  = CAN0_MCR_FRZ_1;
+
+    while(!(base->CAN0_MCR_b.FRZACK));
+}
+
+/* Leave freeze mode and block until the module is synchronized to the bus again */
+static void freeze_exit(CAN0_Type* base)
+{
+    base->CAN0_MCR_b.HALT = CAN0_MCR_HALT_0;
+    base->CAN0_MCR_b.FRZ  = CAN0_MCR_FRZ_0;
+
+    while(base->CAN0_MCR_b.FRZACK);
+
+    while(base->CAN0_MCR_b.NOTRDY);
+}
+
+status_t FlexCAN_init_RXFIFO(FlexCAN_instance_t can)
+{
+    const FlexCAN_resources_t* res = &resources[can];
+    FlexCAN_state_t* st = &state[can];
+    CAN0_Type* base = res->base;
+    const CAN_bit_timings_t* timings = &CAN_timings;
+
     /* Set asynchronous clock source SOSCDIV2 for feeding @ 8 Mhz to FlexCAN ----------*/
-    /* System Oscillator (SOSC) initialization for 8Mhz external crystal */
-    SCG->SCG_SOSCCSR_b.LK       = SCG_SOSCCSR_LK_0;         /* Ensure the register is unlocked */
-    SCG->SCG_SOSCCSR_b.SOSCEN   = SCG_SOSCCSR_SOSCEN_0;     /* Disable SOSC for setup */
-    SCG->SCG_SOSCCFG_b.EREFS    = SCG_SOSCCFG_EREFS_1;      /* Setup external crystal for SOSC reference */
-    SCG->SCG_SOSCCFG_b.RANGE    = SCG_SOSCCFG_RANGE_10;     /* Select 8Mhz range */
-    SCG->SCG_SOSCCSR_b.SOSCEN   = SCG_SOSCCSR_SOSCEN_1;     /* Enable SOSC reference */
-    SCG->SCG_SOSCDIV_b.SOSCDIV2 = SCG_SOSCDIV_SOSCDIV2_001; /* Asynch source for FlexCAN */
-    SCG->SCG_SOSCCSR_b.LK       = SCG_SOSCCSR_LK_1;         /* Lock the register from accidental writes */
-
-    /* Poll for valid SOSC reference, needs 4096 cycles */
-    while(!(SCG->SCG_SOSCCSR_b.SOSCVLD));
-
-    /*-------------------------------- FlexCAN0 Startup  ----------------------------------*/
-    PCC->PCC_FlexCAN0_b.CGC   = PCC_PCC_FlexCAN0_CGC_1; /* FlexCAN0 clock gating */
-    CAN0->CAN0_MCR_b.MDIS     = CAN0_MCR_MDIS_1;        /* Disable FlexCAN module for clock source selection */
-    CAN0->CAN0_CTRL1_b.CLKSRC = CAN0_CTRL1_CLKSRC_0;    /* Select SOSCDIV2 as source (8Mhz)*/
-    CAN0->CAN0_MCR_b.MDIS     = CAN0_MCR_MDIS_0;        /* Enable FlexCAN peripheral */
-    CAN0->CAN0_MCR_b.HALT     = CAN0_MCR_HALT_1;        /* Request freeze mode eBtry */
-    CAN0->CAN0_MCR_b.FRZ      = CAN0_MCR_FRZ_1;
+    /* System Oscillator (SOSC) initialization for 8Mhz external crystal, once for both
+     * instances since disabling it would stop the one already running */
+    if( !(SCG->SCG_SOSCCSR_b.SOSCVLD) )
+    {
+        SCG->SCG_SOSCCSR_b.LK       = SCG_SOSCCSR_LK_0;         /* Ensure the register is unlocked */
+        SCG->SCG_SOSCCSR_b.SOSCEN   = SCG_SOSCCSR_SOSCEN_0;     /* Disable SOSC for setup */
+        SCG->SCG_SOSCCFG_b.EREFS    = SCG_SOSCCFG_EREFS_1;      /* Setup external crystal for SOSC reference */
+        SCG->SCG_SOSCCFG_b.RANGE    = SCG_SOSCCFG_RANGE_10;     /* Select 8Mhz range */
+        SCG->SCG_SOSCCSR_b.SOSCEN   = SCG_SOSCCSR_SOSCEN_1;     /* Enable SOSC reference */
+        SCG->SCG_SOSCDIV_b.SOSCDIV2 = SCG_SOSCDIV_SOSCDIV2_001; /* Asynch source for FlexCAN */
+        SCG->SCG_SOSCCSR_b.LK       = SCG_SOSCCSR_LK_1;         /* Lock the register from accidental writes */
+
+        /* Poll for valid SOSC reference, needs 4096 cycles */
+        while(!(SCG->SCG_SOSCCSR_b.SOSCVLD));
+    }
+
+    /*-------------------------------- FlexCAN Startup  ----------------------------------*/
+    *res->pcc |= PCC_CGC;                               /* FlexCAN clock gating */
+    base->CAN0_MCR_b.MDIS     = CAN0_MCR_MDIS_1;        /* Disable FlexCAN module for clock source selection */
+    base->CAN0_CTRL1_b.CLKSRC = CAN0_CTRL1_CLKSRC_0;    /* Select SOSCDIV2 as source (8Mhz)*/
+    base->CAN0_MCR_b.MDIS     = CAN0_MCR_MDIS_0;        /* Enable FlexCAN peripheral */
+    base->CAN0_MCR_b.HALT     = CAN0_MCR_HALT_1;        /* Request freeze mode eBtry */
+    base->CAN0_MCR_b.FRZ      = CAN0_MCR_FRZ_1;
 
     /* Block for freeze mode entry */
-    while(!(CAN0->CAN0_MCR_b.FRZACK));
+    while(!(base->CAN0_MCR_b.FRZACK));
 
     /* Enable individual masks for RX FIFO ID table */
-    CAN0->CAN0_MCR_b.IRMQ = CAN0_MCR_IRMQ_1;
+    base->CAN0_MCR_b.IRMQ = CAN0_MCR_IRMQ_1;
 
     /* Disable self reception */
-    CAN0->CAN0_MCR_b.SRXDIS = CAN0_MCR_SRXDIS_1;
+    base->CAN0_MCR_b.SRXDIS = CAN0_MCR_SRXDIS_1;
+
+    /* Classic frames only, after FlexCAN_init_FD() as well */
+    base->CAN0_MCR_b.FDEN = CAN0_MCR_FDEN_0;
 
     /* Enable RX FIFO */
-    CAN0->CAN0_MCR_b.RFEN = CAN0_MCR_RFEN_1;
+    base->CAN0_MCR_b.RFEN = CAN0_MCR_RFEN_1;
 
     /* One full ID per ID filter table element  */
-    CAN0->CAN0_MCR_b.IDAM = CAN0_MCR_IDAM_00;
+    base->CAN0_MCR_b.IDAM = CAN0_MCR_IDAM_00;
 
     /* Choose 8 ID filter elements for RX FIFO */
-    CAN0->CAN0_CTRL2_b.RFFN = 0;
+    base->CAN0_CTRL2_b.RFFN = 0;
+
+    /* Match the hot message buffers before the RX FIFO */
+    base->CAN0_CTRL2_b.MRP = CAN0_CTRL2_MRP_1;
+
+    /* Arbitrate the transmission message buffers by their PRIO field then their ID, and let
+     * a pending transmission be aborted in favour of a more urgent frame */
+    base->CAN0_MCR_b.LPRIOEN = 1;
+    base->CAN0_MCR_b.AEN = 1;
+
+    /* Use every message buffer, the last ones are for transmission */
+    base->CAN0_MCR_b.MAXMB = res->mb_count - 1u;
+
+    /* Message buffer RAM is undefined out of reset, park every message buffer */
+    for(uint8_t i = 0; i < res->tx_mb_first; i++)
+    {
+        base->Classic_MessageBuffer[i].CODE = MB_CODE_RX_INACTIVE;
+    }
+    for(uint8_t i = res->tx_mb_first; i < (res->tx_mb_first + res->tx_mb_count); i++)
+    {
+        base->Classic_MessageBuffer[i].CODE = MB_CODE_TX_INACTIVE;
+    }
+
+    st->tx_free_mbs = (1u << res->tx_mb_count) - 1u;
+    st->timer_hz = CAN_BITRATE;
+    st->fd_mode = 0;
+
+    /* Drop the flags a previous initialization left, in CAN FD mode BUF5I is a mailbox's */
+    base->CAN0_IFLAG1 = 0xFFFFFFFFu;
+
+    /* Interrupt on frames available in RX FIFO, its warning and overflow, and on completed transmissions */
+    base->CAN0_IMASK1 = IFLAG1_RXFIFO_AVAILABLE | IFLAG1_RXFIFO_WARNING | IFLAG1_RXFIFO_OVERFLOW |
+                        iflag1_mbs(res->tx_mb_first, res->tx_mb_count);
 
-    /* CAN Bit Timing (CBT) configuration for a bitrate of 500 Kbit/s with 16 time quantas,
-       in accordance with Bosch 2012 specification */
-    CAN0->CAN0_CTRL1_b.PRESDIV = timings.PRESDIV;
-    CAN0->CAN0_CTRL1_b.PROPSEG = timings.PROPSEG;
-    CAN0->CAN0_CTRL1_b.PSEG1   = timings.PSEG1;
-    CAN0->CAN0_CTRL1_b.PSEG2   = timings.PSEG2;
-    CAN0->CAN0_CTRL1_b.RJW     = timings.RJW;
+    /* CAN Bit Timing (CBT) configuration through the extended register, whose wider fields
+       the solver searches, in accordance with Bosch 2012 specification */
+    base->CAN0_CBT_b.EPRESDIV = timings->PRESDIV;
+    base->CAN0_CBT_b.EPROPSEG = timings->PROPSEG;
+    base->CAN0_CBT_b.EPSEG1   = timings->PSEG1;
+    base->CAN0_CBT_b.EPSEG2   = timings->PSEG2;
+    base->CAN0_CBT_b.ERJW     = timings->RJW;
+    base->CAN0_CBT_b.BTF      = 1;
 
     /* Exit from freeze mode */
-    CAN0->CAN0_MCR_b.HALT = CAN0_MCR_HALT_0;
-    CAN0->CAN0_MCR_b.FRZ  = CAN0_MCR_FRZ_0;
+    base->CAN0_MCR_b.HALT = CAN0_MCR_HALT_0;
+    base->CAN0_MCR_b.FRZ  = CAN0_MCR_FRZ_0;
 
     /* Block for freeze mode exit */
-    while(CAN0->CAN0_MCR_b.FRZACK);
+    while(base->CAN0_MCR_b.FRZACK);
 
     /* Block for module ready flag */
-    while(CAN0->CAN0_MCR_b.NOTRDY);
+    while(base->CAN0_MCR_b.NOTRDY);
 
     /* Pin multiplexing for FlexCAN */
-    PCC->PCC_PORTE_b.CGC = PCC_PCC_PORTE_CGC_1;   /* Clock gating to PORT E */
-    PORTE->PORTE_PCR4_b.MUX = PORTE_PCR4_MUX_101; /* CAN0_RX at PORT E pin 4 */
-    PORTE->PORTE_PCR5_b.MUX = PORTE_PCR5_MUX_101; /* CAN0_TX at PORT E pin 5 */
+    if( res->pins != 0 )
+    {
+        res->pins();
+    }
+
+    /* Enable the interrupt that drains the RX FIFO into the reception ring */
+    enable_IRQ(res->rx_irq, CAN_MB_IRQ_PRIORITY);
+
+    /* Enable the interrupt that completes and refills the transmission message buffers */
+    if( res->tx_irq != res->rx_irq )
+    {
+        enable_IRQ(res->tx_irq, CAN_MB_IRQ_PRIORITY);
+    }
 
     /* Success code if this point is reached */
     return Success;
 
 }
 
-status_t install_ID(uint32_t id)
+status_t FlexCAN_init_FD(FlexCAN_instance_t can)
 {
-    /* Request freeze mode entry */
-    CAN0->CAN0_MCR_b.HALT = CAN0_MCR_HALT_1;
-    CAN0->CAN0_MCR_b.FRZ  = CAN0_MCR_FRZ_1;
+    const FlexCAN_resources_t* res = &resources[can];
+    CAN0_Type* base = res->base;
+    const CAN_bit_timings_t* timings = &CAN_FD_nominal_timings;
+    const CAN_bit_timings_t* fd_timings = &CAN_FD_data_timings;
 
-    /* Block for freeze mode entry */
-    while (!(CAN0->CAN0_MCR_b.FRZACK));
+    if( !res->fd_capable )
+    {
+        return Failure;
+    }
 
-    /* Configure the ID, from the ID filter table */
-    CAN0->ID_TABLE_RXFIFO[0].STD_ID = id;
+    /*-------------------------------- FlexCAN Startup  ----------------------------------*/
+    *res->pcc |= PCC_CGC;                               /* FlexCAN clock gating */
+    base->CAN0_MCR_b.MDIS     = CAN0_MCR_MDIS_1;        /* Disable FlexCAN module for clock source selection */
+    base->CAN0_CTRL1_b.CLKSRC = CAN0_CTRL1_CLKSRC_1;    /* Select the peripheral clock, fast enough for the data phase */
+    base->CAN0_MCR_b.MDIS     = CAN0_MCR_MDIS_0;        /* Enable FlexCAN peripheral */
 
-    /* All-bits care mask for ID filter table of RX FIFO */
-    CAN0->CAN0_RXIMR0_b.MI = 0x7FF << 19;
+    freeze_enter(base);
 
-    /* Exit from freeze mode */
-    CAN0->CAN0_MCR_b.HALT = CAN0_MCR_HALT_0;
-    CAN0->CAN0_MCR_b.FRZ  = CAN0_MCR_FRZ_0;
+    /* Individual masks per message buffer, no self reception, no RX FIFO */
+    base->CAN0_MCR_b.IRMQ   = CAN0_MCR_IRMQ_1;
+    base->CAN0_MCR_b.SRXDIS = CAN0_MCR_SRXDIS_1;
+    base->CAN0_MCR_b.RFEN   = CAN0_MCR_RFEN_0;
 
-    /* Block for freeze mode exit */
-    while(CAN0->CAN0_MCR_b.FRZACK);
+    /* CAN FD with bit rate switching, ISO CRC and the payload size of every message buffer */
+    base->CAN0_MCR_b.FDEN         = CAN0_MCR_FDEN_1;
+    base->CAN0_CTRL2_b.ISOCANFDEN = 1;
+    base->CAN0_FDCTRL_b.FDRATE    = CAN0_FDCTRL_FDRATE_1;
+    base->CAN0_FDCTRL_b.MBDSR0    = FD_MBDSR;
+    base->CAN0_MCR_b.MAXMB        = FD_MB_COUNT - 1u;
 
-    /* Block for module ready flag */
-    while(CAN0->CAN0_MCR_b.NOTRDY);
+    /* Nominal phase timings */
+    base->CAN0_CBT_b.EPRESDIV = timings->PRESDIV;
+    base->CAN0_CBT_b.EPROPSEG = timings->PROPSEG;
+    base->CAN0_CBT_b.EPSEG1   = timings->PSEG1;
+    base->CAN0_CBT_b.EPSEG2   = timings->PSEG2;
+    base->CAN0_CBT_b.ERJW     = timings->RJW;
+    base->CAN0_CBT_b.BTF      = 1;
+
+    /* Data phase timings */
+    base->CAN0_FDCBT_b.FPRESDIV = fd_timings->PRESDIV;
+    base->CAN0_FDCBT_b.FPROPSEG = fd_timings->PROPSEG;
+    base->CAN0_FDCBT_b.FPSEG1   = fd_timings->PSEG1;
+    base->CAN0_FDCBT_b.FPSEG2   = fd_timings->PSEG2;
+    base->CAN0_FDCBT_b.FRJW     = fd_timings->RJW;
+
+    /* Transceiver delay compensation: the secondary sample point sits at the data phase
+     * sample point, measured in protocol engine clock cycles from the start of the bit */
+    uint32_t tdc_offset = (1u + fd_timings->PROPSEG + (fd_timings->PSEG1 + 1u)) * (fd_timings->PRESDIV + 1u);
+    if( tdc_offset <= TDCOFF_MAX )
+    {
+        base->CAN0_FDCTRL_b.TDCOFF = tdc_offset;
+        base->CAN0_FDCTRL_b.TDCEN  = CAN0_FDCTRL_TDCEN_1;
+    }
+    else
+    {
+        base->CAN0_FDCTRL_b.TDCEN  = CAN0_FDCTRL_TDCEN_0;
+    }
+
+    /* Reception message buffers accept every ID, the IDE bit is always compared so the last
+     * FD_RX_EXT_MB_COUNT of them take the extended IDs. The rest wait for transmissions */
+    for(uint32_t mb = 0; mb < FD_MB_COUNT; mb++)
+    {
+        volatile uint32_t* mailbox = fd_mailbox(base, mb);
+
+        if( mb < FD_RX_MB_COUNT )
+        {
+            uint32_t extended = (mb >= (FD_RX_MB_COUNT - FD_RX_EXT_MB_COUNT)) ? 1u : 0u;
+
+            mailbox[1] = 0;
+            mailbox[0] = ((uint32_t)MB_CODE_RX_EMPTY << MB_CS_CODE_SHIFT) | (extended << MB_CS_IDE_SHIFT);
+            (&base->CAN0_RXIMR0)[mb] = 0;
+        }
+        else
+        {
+            mailbox[0] = (uint32_t)MB_CODE_TX_INACTIVE << MB_CS_CODE_SHIFT;
+        }
+    }
+
+    /* Interrupt on every reception message buffer */
+    base->CAN0_IMASK1 = IFLAG1_FD_RX_MBS;
+
+    freeze_exit(base);
+
+    /* Pin multiplexing for FlexCAN */
+    if( res->pins != 0 )
+    {
+        res->pins();
+    }
+
+    state[can].fd_mode = 1;
+    state[can].timer_hz = CAN_FD_NOMINAL_BITRATE;
+
+    /* Both message buffer interrupts drain the reception message buffers */
+    enable_IRQ(res->rx_irq, CAN_MB_IRQ_PRIORITY);
+    if( res->tx_irq != res->rx_irq )
+    {
+        enable_IRQ(res->tx_irq, CAN_MB_IRQ_PRIORITY);
+    }
 
     return Success;
 }
 
-status_t transmit_frame(frame_t* frame)
+uint8_t FD_dlc_to_length(uint8_t dlc)
 {
-    /* Insert he payload for transmission */
-    for(uint8_t i = 0; i < MAX_MTU_WORDS; i++)
+    return fd_lengths[dlc & 0xFu];
+}
+
+uint8_t FD_length_to_dlc(uint8_t length)
+{
+    uint8_t dlc = 0;
+
+    while( (dlc < 15u) && (fd_lengths[dlc] < length) )
     {
-        CAN0->Classic_MessageBuffer[TX_MB].payload[i] = frame->payload[i];
+        dlc++;
     }
 
-    /* Set the frame's destination ID */
-    //CAN0->Classic_MessageBuffer[TX_MB].STD_ID = 0;
-    CAN0->Classic_MessageBuffer[TX_MB].STD_ID = frame->ID;
+    return dlc;
+}
+
+status_t transmit_frame_FD(FlexCAN_instance_t can, fd_frame_t* frame)
+{
+    CAN0_Type* base = resources[can].base;
 
-    /* Fill rest of parameters for transmission and send */
-    CAN0->Classic_MessageBuffer[TX_MB].EDL =  0;   /* No extended data length */
-    CAN0->Classic_MessageBuffer[TX_MB].BRS =  0;   /* No bit-rate switch */
-    CAN0->Classic_MessageBuffer[TX_MB].ESI =  0;
-    CAN0->Classic_MessageBuffer[TX_MB].SRR =  0;
-    CAN0->Classic_MessageBuffer[TX_MB].IDE =  0;   /* Standard UD */
-    CAN0->Classic_MessageBuffer[TX_MB].RTR =  0;
-    CAN0->Classic_MessageBuffer[TX_MB].DLC = 0x8;  /* 8 bytes of payload */
-    CAN0->Classic_MessageBuffer[TX_MB].CODE = 0xC; /* Frame is sent when this field is written */
+    /* Default return value */
+    status_t status = BufferFull;
 
-    /* After a successful transmission the interrupt flag of the corresponding message buffer is set */
-    while(!(CAN0->CAN0_IFLAG1_b.BUF31TO8I));
+    if( !state[can].fd_mode || (frame->length > CAN_FD_PAYLOAD_BYTES) )
+    {
+        return Failure;
+    }
 
-    /* Clear the flag previously polled (W1C register) */
-    CAN0->CAN0_IFLAG1_b.BUF31TO8I = 1;
+    for(uint32_t mb = FD_RX_MB_COUNT; mb < FD_MB_COUNT; mb++)
+    {
+        volatile uint32_t* mailbox = fd_mailbox(base, mb);
 
-    /* Return successful transmission request status */
-    return Success;
+        /* Only a message buffer whose previous frame already left can be reused */
+        if( ((mailbox[0] >> MB_CS_CODE_SHIFT) & 0xFu) != MB_CODE_TX_INACTIVE )
+        {
+            continue;
+        }
+
+        uint8_t dlc = FD_length_to_dlc(frame->length);
+
+        /* Clear the flag left by the previous transmission (w1c register), so the completion
+         * of this one can be observed */
+        base->CAN0_IFLAG1 = 1u << mb;
+
+        /* Insert the payload, padded up to the length the DLC encodes */
+        for(uint8_t i = 0; i < ((fd_lengths[dlc] + 3u) / 4u); i++)
+        {
+            mailbox[2u + i] = frame->payload[i];
+        }
+
+        /* Set the frame's destination ID */
+        mailbox[1] = MB_ID_WORD(frame->ID);
+
+        /* Extended data length, optional bit rate switch, and send by writing the CODE */
+        mailbox[0] = MB_CS_EDL | (frame->BRS ? MB_CS_BRS : 0u) | MB_CS_ID_FLAGS(frame->ID) |
+                     ((uint32_t)MB_CODE_TX_DATA << MB_CS_CODE_SHIFT) |
+                     ((uint32_t)dlc << MB_CS_DLC_SHIFT);
 
+        status = Success;
+        break;
+    }
+
+    return status;
 }
 
-status_t receive_frame(frame_t* frame)
+status_t receive_frame_FD(FlexCAN_instance_t can, fd_frame_t* frame)
 {
 
     /* Default output and return values */
     status_t status = Failure;
 
-    /* Check if the RX FIFO received */
-    if( CAN0->CAN0_IFLAG1_b.BUF5I )
+    /* Snapshot of the producer index */
+    uint32_t head = rx_fd_head;
+
+    /* Check if the ring holds any frame */
+    if( state[can].fd_mode && (rx_fd_tail != head) )
     {
-        /* Harvest the ID */
-        frame->ID = CAN0->Classic_RX_FIFO[RX_FIFO].STD_ID;
+        /* Copy the oldest frame out of the ring */
+        *frame = rx_fd_ring[rx_fd_tail & (RX_FD_RING_SIZE - 1u)];
 
-        /* Harvest the payload */
-        for(uint8_t i = 0; i < MAX_MTU_WORDS; i++)
+        /* Release the slot only after the copy is complete */
+        COMPILER_BARRIER();
+        rx_fd_tail = rx_fd_tail + 1u;
+
+        /* Return success status code */
+        status = Success;
+    }
+
+    return status;
+}
+
+/* Copy every full reception message buffer of FlexCAN0 into the FD ring, only called from the MB interrupts */
+static void drain_rx_FD(void)
+{
+    uint32_t full = CAN0->CAN0_IFLAG1 & IFLAG1_FD_RX_MBS;
+
+    while( full )
+    {
+        uint32_t mb = (uint32_t)__builtin_ctz(full);
+        full &= full - 1u;
+
+        volatile uint32_t* mailbox = fd_mailbox(CAN0, mb);
+        uint32_t head = rx_fd_head;
+
+        /* Reading the control/status word locks the message buffer */
+        uint32_t cs = mailbox[0];
+        uint8_t room = ((head - rx_fd_tail) < RX_FD_RING_SIZE) ? 1u : 0u;
+        fd_frame_t* slot = &rx_fd_ring[head & (RX_FD_RING_SIZE - 1u)];
+
+        if( room )
         {
-            frame->payload[i] = CAN0->Classic_RX_FIFO[RX_FIFO].payload[i];
+            slot->ID = FRAME_ID(mailbox[1], (cs >> MB_CS_IDE_SHIFT) & 1u);
+            slot->length = fd_lengths[(cs >> MB_CS_DLC_SHIFT) & 0xFu];
+            slot->BRS = (cs & MB_CS_BRS) ? 1u : 0u;
+
+            for(uint8_t i = 0; i < ((slot->length + 3u) / 4u); i++)
+            {
+                slot->payload[i] = mailbox[2u + i];
+            }
         }
 
-        /* Force update of the RX FIFO by clearing its flag (w1c register) */
-        CAN0->CAN0_IFLAG1_b.BUF5I = 1;
+        /* Sampling the free running timer unlocks the message buffer, and happens after the
+         * frame arrived so its timestamp is never ahead of it */
+        uint64_t now = timer_sample(FlexCAN_0);
 
-        /* Return success status code */
-        status = Success;
+        if( room )
+        {
+            slot->timestamp = timestamp_extend(now, (uint16_t)cs);
+
+            /* Publish the frame only after it is completely written */
+            COMPILER_BARRIER();
+            rx_fd_head = head + 1u;
+        }
+        else
+        {
+            state[FlexCAN_0].rx_stats.ring_overruns++;
+        }
+
+        /* Clear the flag (w1c register) */
+        CAN0->CAN0_IFLAG1 = 1u << mb;
+    }
+}
+
+status_t install_ID(FlexCAN_instance_t can, uint32_t id)
+{
+    /* All-bits care filter for the standard or extended ID */
+    filter_t filter = {
+            .ID = id & CAN_ID_MASK,
+            .mask = (id & CAN_ID_EXT) ? CAN_ID_MASK : 0x7FFu,
+            .extended = (uint8_t)(id >> 31),
+    };
+
+    return install_filters(can, &filter, 1, 0);
+}
+
+/* Encode a filter as one ID filter table field of the given format (IDAM value), returning
+ * its value and mask right-aligned. Returns Failure if the format would drop cared bits. */
+static status_t encode_filter(const filter_t* filter, uint8_t format, uint32_t* value, uint32_t* mask)
+{
+    status_t status = Success;
+    uint32_t id = filter->ID;
+    uint32_t care = filter->mask;
+
+    if( format == CAN0_MCR_IDAM_00 )
+    {
+        /* RTR [31], IDE [30], standard ID [29..19] or extended ID [29..1] */
+        uint8_t shift = filter->extended ? 1u : 19u;
+        *value = ((uint32_t)filter->extended << 30) | (id << shift);
+        *mask  = (1u << 30) | (care << shift);
+    }
+    else if( format == CAN0_MCR_IDAM_01 )
+    {
+        /* RTR [15], IDE [14], standard ID [13..3] or extended ID bits [28..15] at [13..0] */
+        if( filter->extended )
+        {
+            status = (care & 0x7FFFu) ? Failure : Success;
+            *value = (1u << 14) | (id >> 15);
+            *mask  = (1u << 14) | (care >> 15);
+        }
+        else
+        {
+            *value = id << 3;
+            *mask  = (1u << 14) | (care << 3);
+        }
+    }
+    else
+    {
+        /* Standard ID bits [10..3] or extended ID bits [28..21] */
+        uint8_t shift = filter->extended ? 21u : 3u;
+        status = (care & ((1u << shift) - 1u)) ? Failure : Success;
+        *value = (id >> shift) & 0xFFu;
+        *mask  = (care >> shift) & 0xFFu;
     }
 
     return status;
 }
 
+status_t install_filters(FlexCAN_instance_t can, const filter_t* filters, uint32_t count, uint16_t* slots)
+{
+    const FlexCAN_resources_t* res = &resources[can];
+    CAN0_Type* base = res->base;
+
+    /* The ID filter table and masks as raw words, the table runs into the message buffers area */
+    volatile uint32_t* table = (volatile uint32_t*)&base->ID_TABLE_RXFIFO[0];
+    volatile uint32_t* rximr = &base->CAN0_RXIMR0;
+
+    /* Largest RFFN whose ID filter table (which ends at message buffer 7 + 2 * RFFN) stays below
+     * the hot message buffers, and the number of table elements it gives */
+    uint32_t rffn_max = hot_mb_first(res) / 2u;
+    uint32_t max_elements = 8u * (rffn_max + 1u);
+
+    uint8_t format = CAN0_MCR_IDAM_11;
+    uint32_t per_element = 1;
+    uint32_t elements = 0;
+    uint32_t value, mask;
+
+    /* Pick the most precise format where the whole list fits and is representable */
+    for(uint8_t f = CAN0_MCR_IDAM_00; (count != 0) && (f <= CAN0_MCR_IDAM_10); f++)
+    {
+        uint32_t fits = (((count + (1u << f) - 1u) >> f) <= max_elements);
+
+        for(uint32_t n = 0; fits && (n < count); n++)
+        {
+            fits = (encode_filter(&filters[n], f, &value, &mask) == Success);
+        }
+
+        if( fits )
+        {
+            format = f;
+            per_element = 1u << f;
+            elements = (count + per_element - 1u) / per_element;
+            break;
+        }
+    }
+
+    if( (count != 0) && (format == CAN0_MCR_IDAM_11) )
+    {
+        return Failure;
+    }
+
+    /* Smallest table holding every element, and the elements covered by individual masks,
+     * one RX individual mask register per message buffer */
+    uint32_t rffn = (elements == 0) ? 0 : ((elements + 7u) / 8u) - 1u;
+    uint32_t table_elements = 8u * (rffn + 1u);
+    uint32_t individual = 8u + (2u * rffn);
+    individual = (individual < res->mb_count) ? individual : res->mb_count;
+
+    /* Width in bits of each field of an element */
+    uint32_t width = 32u / per_element;
+    uint32_t field_mask = (width == 32u) ? 0xFFFFFFFFu : ((1u << width) - 1u);
+
+    /* Intersection of the masks of the elements that fall under the global mask */
+    uint32_t global_mask = 0xFFFFFFFFu;
+    uint8_t global_used = 0;
+
+    /* Without filters format D rejects every frame, and the table is filled with a format A
+     * element that only matches an extended remote frame of ID 0x1FFFFFFF under an all care
+     * mask, so no zero filled element is left to accept standard ID 0 */
+    uint32_t last_value = (1u << 31) | (1u << 30) | (CAN_ID_MASK << 1);
+    uint32_t last_mask = 0xFFFFFFFFu;
+
+    freeze_enter(base);
+
+    base->CAN0_MCR_b.IDAM = format;
+    base->CAN0_CTRL2_b.RFFN = rffn;
+
+    for(uint32_t e = 0; e < elements; e++)
+    {
+        uint32_t element_value = 0;
+        uint32_t element_mask = 0;
+
+        for(uint32_t k = 0; k < per_element; k++)
+        {
+            /* Fields are filled from the most significant one, a short last element repeats
+             * its first filter so the spare fields accept nothing new */
+            uint32_t n = (e * per_element) + k;
+            n = (n < count) ? n : (e * per_element);
+
+            encode_filter(&filters[n], format, &value, &mask);
+
+            uint32_t shift = 32u - (width * (k + 1u));
+            element_value |= (value & field_mask) << shift;
+            element_mask  |= (mask & field_mask) << shift;
+
+            if( (slots != 0) && (n == (e * per_element) + k) )
+            {
+                slots[n] = (uint16_t)n;
+            }
+        }
+
+        table[e] = element_value;
+
+        if( e < individual )
+        {
+            rximr[e] = element_mask;
+        }
+        else
+        {
+            global_mask &= element_mask;
+            global_used = 1;
+        }
+
+        last_value = element_value;
+        last_mask = element_mask;
+    }
+
+    /* Unused elements repeat the last programmed one, if it wasn't under the global mask
+     * the global mask is made equal to its own so the copies accept exactly the same frames */
+    if( !global_used )
+    {
+        global_mask = last_mask;
+    }
+
+    for(uint32_t e = elements; e < table_elements; e++)
+    {
+        table[e] = last_value;
+
+        if( e < individual )
+        {
+            rximr[e] = last_mask;
+        }
+    }
+
+    base->CAN0_RXFGMASK = global_mask;
+
+    freeze_exit(base);
+
+    return Success;
+}
+
+status_t enable_RX_DMA(FlexCAN_instance_t can)
+{
+    const FlexCAN_resources_t* res = &resources[can];
+    FlexCAN_state_t* st = &state[can];
+    uint8_t channel = res->dma_channel;
+
+    /* Clock gating to the DMA channel multiplexor */
+    PCC->PCC_DMAMUX_b.CGC = PCC_PCC_DMAMUX_CGC_1;
+
+    /* Detach the channel from its source while its descriptor is written */
+    DMAMUX->CHCFG[channel] = 0;
+    EDMA->CERQ = channel;
+
+    /* Each request reads the whole 16-byte RX FIFO output in 32-bit accesses, which pops the FIFO.
+     * The source modulo keeps the address inside the 16-byte aligned output, so it wraps back to
+     * its start after every minor loop instead of running into the ID filter table */
+    EDMA->TCD[channel].SADDR         = (uint32_t)(uintptr_t)&res->base->Classic_RX_FIFO[RX_FIFO];
+    EDMA->TCD[channel].SOFF          = sizeof(uint32_t);
+    EDMA->TCD[channel].ATTR          = (EDMA_ATTR_SMOD_16_BYTES << 11) | (2u << 8) | 2u; /* 32-bit source and destination */
+    EDMA->TCD[channel].NBYTES.MLNO   = sizeof(rx_fifo_entry_t);
+    EDMA->TCD[channel].SLAST         = 0;
+
+    /* The destination walks the buffer one entry per request and wraps after the major loop */
+    EDMA->TCD[channel].DADDR         = (uint32_t)(uintptr_t)&st->rx_dma_ring[0];
+    EDMA->TCD[channel].DOFF          = sizeof(uint32_t);
+    EDMA->TCD[channel].CITER.ELINKNO = RX_DMA_RING_SIZE;
+    EDMA->TCD[channel].BITER.ELINKNO = RX_DMA_RING_SIZE;
+    EDMA->TCD[channel].DLASTSGA      = (uint32_t)(-(int32_t)sizeof(st->rx_dma_ring));
+
+    /* No interrupt and no request disabling at the end of the major loop, it runs forever */
+    EDMA->TCD[channel].CSR = 0;
+
+    st->rx_dma_tail = 0;
+
+    /* Route the RX FIFO request of the instance to the channel and enable it */
+    DMAMUX->CHCFG[channel] = (1u << 7) | res->dma_request;
+    EDMA->SERQ = channel;
+
+    freeze_enter(res->base);
+
+    /* Frames available in RX FIFO raise DMA requests instead of the interrupt */
+    res->base->CAN0_IMASK1 &= ~IFLAG1_RXFIFO_AVAILABLE;
+    res->base->CAN0_MCR_b.DMA = CAN0_MCR_DMA_1;
+
+    freeze_exit(res->base);
+
+    return Success;
+}
+
+/* Number of entries the DMA completed and receive_frames_DMA() or lend_frames_DMA() didn't consume */
+static uint32_t rx_dma_available(FlexCAN_instance_t can)
+{
+    FlexCAN_state_t* st = &state[can];
+
+    /* The destination address points past the last entry the DMA completed */
+    uint32_t head = (EDMA->TCD[resources[can].dma_channel].DADDR - (uint32_t)(uintptr_t)&st->rx_dma_ring[0]) / sizeof(rx_fifo_entry_t);
+
+    /* Entries written since the last call, accounting for the wraparound */
+    return (head - st->rx_dma_tail) & (RX_DMA_RING_SIZE - 1u);
+}
+
+uint32_t receive_frames_DMA(FlexCAN_instance_t can, frame_t* frames, uint32_t max)
+{
+    FlexCAN_state_t* st = &state[can];
+    uint32_t available = rx_dma_available(can);
+    uint32_t count = (available < max) ? available : max;
+    uint64_t now = FlexCAN_timer_now(can);
+
+    for(uint32_t n = 0; n < count; n++)
+    {
+        rx_fifo_entry_t* entry = &st->rx_dma_ring[st->rx_dma_tail];
+
+        frames[n].ID = FRAME_ID(entry->ID, (entry->CS >> MB_CS_IDE_SHIFT) & 1u);
+        frames[n].timestamp = timestamp_extend(now, (uint16_t)entry->CS);
+
+        count_filter_hit(st, entry->CS >> RXFIFO_CS_IDHIT_SHIFT);
+
+        for(uint8_t i = 0; i < MAX_MTU_WORDS; i++)
+        {
+            frames[n].payload[i] = entry->payload[i];
+        }
+
+        st->rx_dma_tail = (st->rx_dma_tail + 1u) & (RX_DMA_RING_SIZE - 1u);
+    }
+
+    /* The hot message buffer interrupt counts its receptions in the same counter */
+    CRITICAL_ENTER();
+    st->rx_stats.received += count;
+    CRITICAL_EXIT();
+
+    return count;
+}
+
+uint32_t lend_frames_DMA(FlexCAN_instance_t can, rx_fifo_entry_t** entries)
+{
+    FlexCAN_state_t* st = &state[can];
+    uint32_t available = rx_dma_available(can);
+    uint32_t until_end = RX_DMA_RING_SIZE - st->rx_dma_tail;
+
+    *entries = &st->rx_dma_ring[st->rx_dma_tail];
+
+    return (available < until_end) ? available : until_end;
+}
+
+void release_frames_DMA(FlexCAN_instance_t can, uint32_t count)
+{
+    state[can].rx_dma_tail = (state[can].rx_dma_tail + count) & (RX_DMA_RING_SIZE - 1u);
+}
+
+/* Rank of a frame as the arbitration sees it with local priority enabled: PRIO, then the ID word */
+static uint32_t tx_key(const frame_t* frame, uint8_t prio)
+{
+    return ((uint32_t)prio << TX_KEY_PRIO_SHIFT) | MB_ID_WORD(frame->ID);
+}
+
+/* Whether a pending frame goes before another, frames of equal rank keep their queuing order */
+static uint8_t tx_before(const tx_entry_t* a, const tx_entry_t* b)
+{
+    return (a->key < b->key) || ((a->key == b->key) && ((int32_t)(a->seq - b->seq) < 0));
+}
+
+static void tx_heap_push(FlexCAN_state_t* st, const tx_entry_t* entry)
+{
+    uint32_t i = st->tx_heap_count++;
+
+    /* Sift the hole up until the entry fits */
+    while( i > 0u )
+    {
+        uint32_t parent = (i - 1u) / 2u;
+
+        if( !tx_before(entry, &st->tx_heap[parent]) )
+        {
+            break;
+        }
+
+        st->tx_heap[i] = st->tx_heap[parent];
+        i = parent;
+    }
+
+    st->tx_heap[i] = *entry;
+}
+
+static void tx_heap_pop(FlexCAN_state_t* st, tx_entry_t* entry)
+{
+    *entry = st->tx_heap[0];
+
+    tx_entry_t* last = &st->tx_heap[--st->tx_heap_count];
+    uint32_t i = 0;
+
+    /* Sift the hole left at the root down until the last entry fits */
+    for(;;)
+    {
+        uint32_t child = (2u * i) + 1u;
+
+        if( child >= st->tx_heap_count )
+        {
+            break;
+        }
+
+        if( ((child + 1u) < st->tx_heap_count) && tx_before(&st->tx_heap[child + 1u], &st->tx_heap[child]) )
+        {
+            child++;
+        }
+
+        if( !tx_before(&st->tx_heap[child], last) )
+        {
+            break;
+        }
+
+        st->tx_heap[i] = st->tx_heap[child];
+        i = child;
+    }
+
+    st->tx_heap[i] = *last;
+}
+
+/* Keep the worst queuing delay of the identifier, only called from the MB interrupt */
+static void track_tx_delay(FlexCAN_state_t* st, uint32_t id, uint64_t delay)
+{
+    uint32_t count = st->tx_delay_count;
+    uint32_t i = 0;
+
+    while( (i < count) && (st->tx_delays[i].ID != id) )
+    {
+        i++;
+    }
+
+    if( i == count )
+    {
+        if( count == TX_DELAY_SLOTS )
+        {
+            return;
+        }
+
+        st->tx_delays[i].ID = id;
+        st->tx_delays[i].sent = 0;
+        st->tx_delays[i].worst_delay = 0;
+
+        /* Publish the slot only after it is completely written */
+        COMPILER_BARRIER();
+        st->tx_delay_count = count + 1u;
+    }
+
+    uint32_t ticks = (delay > 0xFFFFFFFFu) ? 0xFFFFFFFFu : (uint32_t)delay;
+
+    st->tx_delays[i].sent++;
+
+    if( ticks > st->tx_delays[i].worst_delay )
+    {
+        st->tx_delays[i].worst_delay = ticks;
+    }
+}
+
+status_t transmit_frame(FlexCAN_instance_t can, frame_t* frame)
+{
+    return transmit_frame_prio(can, frame, 0);
+}
+
+status_t transmit_frame_prio(FlexCAN_instance_t can, frame_t* frame, uint8_t prio)
+{
+    FlexCAN_state_t* st = &state[can];
+
+    /* In CAN FD mode the MB interrupts only drain the FD mailboxes, nothing would send the queue */
+    if( (prio > TX_PRIO_LOWEST) || st->fd_mode )
+    {
+        return Failure;
+    }
+
+    /* Default return value */
+    status_t status = BufferFull;
+
+    /* Snapshot of the producer index */
+    uint32_t head = st->tx_head;
+
+    /* Check if the queue has room for the frame */
+    if( (head - st->tx_tail) < TX_QUEUE_SIZE )
+    {
+        tx_entry_t* entry = &st->tx_queue[head & (TX_QUEUE_SIZE - 1u)];
+
+        /* Copy the frame into the queue */
+        entry->frame = *frame;
+        entry->key = tx_key(frame, prio);
+
+        /* Publish the frame only after it is completely written */
+        COMPILER_BARRIER();
+        st->tx_head = head + 1u;
+
+        /* Pend the MB interrupt so it takes the frame right away, stamps its queuing time, and
+         * loads it into an idle message buffer or aborts a less urgent frame for it */
+        pend_tx_IRQ(&resources[can]);
+
+        status = Success;
+    }
+
+    return status;
+}
+
+uint32_t transmit_batch(FlexCAN_instance_t can, const frame_t* frames, uint32_t count)
+{
+    FlexCAN_state_t* st = &state[can];
+
+    /* Nothing sends the queue in CAN FD mode, as for transmit_frame_prio() */
+    if( st->fd_mode )
+    {
+        return 0;
+    }
+
+    /* Snapshot of the producer index, and room left in the queue */
+    uint32_t head = st->tx_head;
+    uint32_t room = TX_QUEUE_SIZE - (head - st->tx_tail);
+    uint32_t accepted = (count < room) ? count : room;
+
+    /* Copy the frames into the queue */
+    for(uint32_t i = 0; i < accepted; i++)
+    {
+        tx_entry_t* entry = &st->tx_queue[(head + i) & (TX_QUEUE_SIZE - 1u)];
+
+        entry->frame = frames[i];
+        entry->key = tx_key(&frames[i], 0);
+    }
+
+    if( accepted )
+    {
+        /* Publish the whole burst only after it is completely written */
+        COMPILER_BARRIER();
+        st->tx_head = head + accepted;
+
+        /* One interrupt takes the burst and fills every idle message buffer */
+        pend_tx_IRQ(&resources[can]);
+    }
+
+    return accepted;
+}
+
+status_t transmit_frame_ISR(FlexCAN_instance_t can, const frame_t* frame, uint8_t prio)
+{
+    FlexCAN_state_t* st = &state[can];
+
+    if( (prio > TX_PRIO_LOWEST) || st->fd_mode )
+    {
+        return Failure;
+    }
+
+    uint64_t now = timer_sample(can);
+
+    /* Take the frames queued so far first, this one goes after them on equal rank */
+    load_tx_mailboxes(can, now);
+
+    if( st->tx_heap_count >= TX_QUEUE_SIZE )
+    {
+        return BufferFull;
+    }
+
+    tx_entry_t entry = {
+            .frame = *frame,
+            .key = tx_key(frame, prio),
+            .seq = st->tx_seq++,
+    };
+
+    entry.frame.timestamp = now;
+    tx_heap_push(st, &entry);
+
+    load_tx_mailboxes(can, now);
+
+    return Success;
+}
+
+/* Whether a loaded message buffer holds a frame of that rank, which the arbitration could
+ * otherwise send after one queued later in a lower message buffer */
+static uint8_t tx_rank_inflight(const FlexCAN_resources_t* res, FlexCAN_state_t* st, uint32_t key)
+{
+    for(uint32_t busy = ~st->tx_free_mbs & ((1u << res->tx_mb_count) - 1u); busy; busy &= busy - 1u)
+    {
+        if( st->tx_inflight[__builtin_ctz(busy)].key == key )
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* Move queued frames into the idle transmission message buffers by rank, and abort a less
+ * urgent loaded frame when none is idle, only called from the MB interrupt at time now */
+static void load_tx_mailboxes(FlexCAN_instance_t can, uint64_t now)
+{
+    const FlexCAN_resources_t* res = &resources[can];
+    FlexCAN_state_t* st = &state[can];
+
+    /* Take the queued frames into the heap, keeping room for the aborted ones */
+    while( (st->tx_tail != st->tx_head) && (st->tx_heap_count < TX_QUEUE_SIZE) )
+    {
+        tx_entry_t* entry = &st->tx_queue[st->tx_tail & (TX_QUEUE_SIZE - 1u)];
+
+        /* Queuing time, transmit_frame_prio() pends this interrupt for every frame */
+        entry->frame.timestamp = now;
+        entry->seq = st->tx_seq++;
+        tx_heap_push(st, entry);
+
+        /* Release the queue slot */
+        COMPILER_BARRIER();
+        st->tx_tail = st->tx_tail + 1u;
+    }
+
+    while( st->tx_free_mbs && st->tx_heap_count && !tx_rank_inflight(res, st, st->tx_heap[0].key) )
+    {
+        /* Take the lowest idle message buffer */
+        uint32_t mb = (uint32_t)__builtin_ctz(st->tx_free_mbs);
+        st->tx_free_mbs &= st->tx_free_mbs - 1u;
+
+        /* Keep the most urgent frame around for its transmission confirmation */
+        tx_heap_pop(st, &st->tx_inflight[mb]);
+        frame_t* frame = &st->tx_inflight[mb].frame;
+
+        /* The message buffer as raw words, so standard and extended IDs take the same path */
+        volatile uint32_t* mailbox = (volatile uint32_t*)&res->base->Classic_MessageBuffer[res->tx_mb_first + mb];
+
+        /* Insert the payload for transmission */
+        for(uint8_t i = 0; i < MAX_MTU_WORDS; i++)
+        {
+            mailbox[2u + i] = frame->payload[i];
+        }
+
+        /* Set the frame's destination ID and its local priority, the key holds both */
+        mailbox[1] = st->tx_inflight[mb].key;
+
+        /* Classic frame of 8 bytes, IDE and SRR for extended IDs, and send by writing the CODE */
+        mailbox[0] = MB_CS_ID_FLAGS(frame->ID) |
+                     ((uint32_t)MB_CODE_TX_DATA << MB_CS_CODE_SHIFT) |
+                     (8u << MB_CS_DLC_SHIFT);
+    }
+
+    /* With every message buffer loaded, abort the least urgent frame if the most urgent pending
+     * one outranks it. One abort at a time, its frame goes back to the heap when it completes */
+    if( !st->tx_free_mbs && st->tx_heap_count && !st->tx_aborting )
+    {
+        uint32_t victim = 0;
+
+        for(uint32_t mb = 1; mb < res->tx_mb_count; mb++)
+        {
+            if( tx_before(&st->tx_inflight[victim], &st->tx_inflight[mb]) )
+            {
+                victim = mb;
+            }
+        }
+
+        if( st->tx_heap[0].key < st->tx_inflight[victim].key )
+        {
+            /* The abort completes with IFLAG set and CODE either ABORT, or TX_INACTIVE if the
+             * frame was already being transmitted */
+            st->tx_aborting = 1u << victim;
+            res->base->Classic_MessageBuffer[res->tx_mb_first + victim].CODE = MB_CODE_TX_ABORT;
+        }
+    }
+}
+
+status_t install_hot_ID(FlexCAN_instance_t can, uint8_t slot, uint32_t id, rx_callback_t callback)
+{
+    const FlexCAN_resources_t* res = &resources[can];
+    CAN0_Type* base = res->base;
+
+    if( state[can].fd_mode || (slot >= res->hot_mb_count) || (callback == 0) )
+    {
+        return Failure;
+    }
+
+    uint32_t first = hot_mb_first(res);
+    uint32_t mb = first + CLASSIC_MB_OFFSET + slot;
+    volatile uint32_t* mailbox = (volatile uint32_t*)&base->Classic_MessageBuffer[first + slot];
+    volatile uint32_t* rximr = &base->CAN0_RXIMR0;
+
+    /* The individual masks are only writable in freeze mode */
+    freeze_enter(base);
+
+    /* Take the message buffer out of matching while it is rewritten */
+    mailbox[0] = (uint32_t)MB_CODE_RX_INACTIVE << MB_CS_CODE_SHIFT;
+    base->CAN0_IFLAG1 = 1u << mb;
+
+    state[can].hot_callbacks[slot] = callback;
+
+    /* Every ID bit cares, the IDE bit is always compared */
+    mailbox[1] = MB_ID_WORD(id);
+    rximr[mb] = (id & CAN_ID_EXT) ? CAN_ID_MASK : (0x7FFu << MB_ID_STD_SHIFT);
+
+    /* Arm the message buffer for the standard or extended ID */
+    mailbox[0] = ((uint32_t)MB_CODE_RX_EMPTY << MB_CS_CODE_SHIFT) | ((id >> 31) << MB_CS_IDE_SHIFT);
+    base->CAN0_IMASK1 |= 1u << mb;
+
+    freeze_exit(base);
+
+    return Success;
+}
+
+/* Hand the frames of the full hot message buffers to their callbacks, only called from the MB interrupt */
+static void dispatch_hot_MBs(FlexCAN_instance_t can)
+{
+    const FlexCAN_resources_t* res = &resources[can];
+    FlexCAN_state_t* st = &state[can];
+    CAN0_Type* base = res->base;
+    uint32_t first = hot_mb_first(res);
+
+    for(uint32_t full = (base->CAN0_IFLAG1 & base->CAN0_IMASK1 & iflag1_mbs(first, res->hot_mb_count)) >> (first + CLASSIC_MB_OFFSET); full; full &= full - 1u)
+    {
+        uint32_t slot = (uint32_t)__builtin_ctz(full);
+        volatile uint32_t* mailbox = (volatile uint32_t*)&base->Classic_MessageBuffer[first + slot];
+        frame_t frame;
+
+        /* Reading the control/status word locks the message buffer */
+        uint32_t cs = mailbox[0];
+
+        frame.ID = FRAME_ID(mailbox[1], (cs >> MB_CS_IDE_SHIFT) & 1u);
+
+        for(uint8_t i = 0; i < MAX_MTU_WORDS; i++)
+        {
+            frame.payload[i] = mailbox[2u + i];
+        }
+
+        /* Sampling the free running timer unlocks the message buffer, and happens after the
+         * frame arrived so its timestamp is never ahead of it */
+        frame.timestamp = timestamp_extend(timer_sample(can), (uint16_t)cs);
+
+        /* Clear the flag (w1c register) */
+        base->CAN0_IFLAG1 = 1u << (first + CLASSIC_MB_OFFSET + slot);
+
+        /* A frame was overwritten before this one was read */
+        if( ((cs >> MB_CS_CODE_SHIFT) & 0xFu) == MB_CODE_RX_OVERRUN )
+        {
+            st->rx_stats.dropped++;
+        }
+
+        st->rx_stats.received++;
+
+        st->hot_callbacks[slot](&frame);
+    }
+}
+
+/* Serve the hot and transmission message buffers of an instance */
+static void tx_IRQ(FlexCAN_instance_t can)
+{
+    const FlexCAN_resources_t* res = &resources[can];
+    FlexCAN_state_t* st = &state[can];
+    CAN0_Type* base = res->base;
+
+    /* Latency critical frames first */
+    dispatch_hot_MBs(can);
+
+    /* Harvest the message buffers whose frame already left or was aborted and clear their flags (w1c register) */
+    uint32_t done = base->CAN0_IFLAG1 & iflag1_mbs(res->tx_mb_first, res->tx_mb_count);
+    base->CAN0_IFLAG1 = done;
+
+    uint64_t now = timer_sample(can);
+
+    /* Confirm every transmitted frame with the time its mailbox captured */
+    for(uint32_t pending = done >> (res->tx_mb_first + CLASSIC_MB_OFFSET); pending; pending &= pending - 1u)
+    {
+        uint32_t mb = (uint32_t)__builtin_ctz(pending);
+        frame_t* frame = &st->tx_inflight[mb].frame;
+
+        st->tx_aborting &= ~(1u << mb);
+
+        /* An aborted frame goes back to the heap with its rank and queuing order */
+        if( base->Classic_MessageBuffer[res->tx_mb_first + mb].CODE == MB_CODE_TX_ABORT )
+        {
+            tx_heap_push(st, &st->tx_inflight[mb]);
+            continue;
+        }
+
+        uint64_t sent = timestamp_extend(now, base->Classic_MessageBuffer[res->tx_mb_first + mb].TIMESTAMP);
+
+        track_tx_delay(st, frame->ID, sent - frame->timestamp);
+        frame->timestamp = sent;
+
+        uint32_t head = st->tx_done_head;
+
+        if( (head - st->tx_done_tail) < TX_DONE_RING_SIZE )
+        {
+            st->tx_done_ring[head & (TX_DONE_RING_SIZE - 1u)] = *frame;
+
+            /* Publish the confirmation only after it is completely written */
+            COMPILER_BARRIER();
+            st->tx_done_head = head + 1u;
+        }
+    }
+
+    /* Those message buffers are idle again */
+    st->tx_free_mbs |= done >> (res->tx_mb_first + CLASSIC_MB_OFFSET);
+
+    /* Refill them with the most urgent pending frames */
+    load_tx_mailboxes(can, now);
+}
+
+uint32_t get_tx_delays(FlexCAN_instance_t can, tx_delay_t* delays, uint32_t max)
+{
+    FlexCAN_state_t* st = &state[can];
+    uint32_t count = (st->tx_delay_count < max) ? st->tx_delay_count : max;
+
+    for(uint32_t i = 0; i < count; i++)
+    {
+        delays[i].ID          = st->tx_delays[i].ID;
+        delays[i].sent        = st->tx_delays[i].sent;
+        delays[i].worst_delay = st->tx_delays[i].worst_delay;
+    }
+
+    return count;
+}
+
+void get_rx_stats(FlexCAN_instance_t can, rx_stats_t* stats)
+{
+    volatile rx_stats_t* counters = &state[can].rx_stats;
+
+    stats->received       = counters->received;
+    stats->fifo_warnings  = counters->fifo_warnings;
+    stats->fifo_overflows = counters->fifo_overflows;
+    stats->ring_overruns  = counters->ring_overruns;
+    stats->dropped        = counters->fifo_overflows + counters->ring_overruns + counters->dropped;
+
+    for(uint32_t i = 0; i < FILTER_HIT_COUNTERS; i++)
+    {
+        stats->filter_hits[i] = counters->filter_hits[i];
+    }
+}
+
+status_t transmitted_frame(FlexCAN_instance_t can, frame_t* frame)
+{
+    FlexCAN_state_t* st = &state[can];
+
+    /* Default output and return values */
+    status_t status = Failure;
+
+    /* Snapshot of the producer index */
+    uint32_t head = st->tx_done_head;
+
+    if( st->tx_done_tail != head )
+    {
+        /* Copy the oldest confirmation out of the ring and release its slot */
+        *frame = st->tx_done_ring[st->tx_done_tail & (TX_DONE_RING_SIZE - 1u)];
+        COMPILER_BARRIER();
+        st->tx_done_tail = st->tx_done_tail + 1u;
+
+        status = Success;
+    }
+
+    return status;
+}
+
+uint64_t FlexCAN_timer_now(FlexCAN_instance_t can)
+{
+    /* The extended timer is shared with the MB interrupts */
+    CRITICAL_ENTER();
+    uint64_t now = timer_sample(can);
+    CRITICAL_EXIT();
+
+    return now;
+}
+
+void set_timestamp_anchor(FlexCAN_instance_t can, uint64_t (*anchor)(void), uint32_t hz)
+{
+    FlexCAN_state_t* st = &state[can];
+
+    CRITICAL_ENTER();
+
+    /* Sample the timer with the previous anchor first so the new one starts from a known point */
+    (void)timer_sample(can);
+    st->anchor_now = anchor;
+    st->anchor_hz = hz;
+    st->anchor_last = (anchor != 0) ? anchor() : 0;
+
+    CRITICAL_EXIT();
+}
+
+status_t receive_frame(FlexCAN_instance_t can, frame_t* frame)
+{
+    frame_t* lent;
+
+    /* Default output and return values */
+    status_t status = lend_frame(can, &lent);
+
+    if( status == Success )
+    {
+        /* Copy the oldest frame out of the ring and give the slot back */
+        *frame = *lent;
+        release_frames(can, 1);
+    }
+
+    return status;
+}
+
+status_t lend_frame(FlexCAN_instance_t can, frame_t** frame)
+{
+    return lend_frames(can, frame) ? Success : Failure;
+}
+
+uint32_t lend_frames(FlexCAN_instance_t can, frame_t** frames)
+{
+    FlexCAN_state_t* st = &state[can];
+
+    /* Snapshot of the producer index */
+    uint32_t head = st->rx_head;
+    uint32_t index = st->rx_tail & (RX_RING_SIZE - 1u);
+
+    /* Frames stored from the oldest one up to the head or the end of the ring */
+    uint32_t available = head - st->rx_tail;
+    uint32_t until_end = RX_RING_SIZE - index;
+
+    *frames = &st->rx_ring[index];
+
+    /* Don't let the caller read the slots before the head snapshot */
+    COMPILER_BARRIER();
+
+    return (available < until_end) ? available : until_end;
+}
+
+void release_frames(FlexCAN_instance_t can, uint32_t count)
+{
+    /* Release the slots only after the caller is done reading them */
+    COMPILER_BARRIER();
+    state[can].rx_tail = state[can].rx_tail + count;
+}
+
+/* Serve the RX FIFO of an instance */
+static void rx_fifo_IRQ(FlexCAN_instance_t can)
+{
+    FlexCAN_state_t* st = &state[can];
+    CAN0_Type* base = resources[can].base;
+
+    /* Count and acknowledge the RX FIFO warning and overflow (w1c register) */
+    uint32_t events = base->CAN0_IFLAG1 & (IFLAG1_RXFIFO_WARNING | IFLAG1_RXFIFO_OVERFLOW);
+    if( events )
+    {
+        base->CAN0_IFLAG1 = events;
+        st->rx_stats.fifo_warnings += (events & IFLAG1_RXFIFO_WARNING) ? 1u : 0u;
+        st->rx_stats.fifo_overflows += (events & IFLAG1_RXFIFO_OVERFLOW) ? 1u : 0u;
+    }
+
+    /* Drain every frame pending in the RX FIFO, unless the DMA owns it */
+    while( base->CAN0_IFLAG1 & base->CAN0_IMASK1 & IFLAG1_RXFIFO_AVAILABLE )
+    {
+        uint32_t head = st->rx_head;
+
+        /* Sampled after the frame reached the FIFO output, so its timestamp is never ahead of it */
+        uint64_t now = timer_sample(can);
+
+        /* Only store the frame if the consumer left a free slot */
+        if( (head - st->rx_tail) < RX_RING_SIZE )
+        {
+            frame_t* slot = &st->rx_ring[head & (RX_RING_SIZE - 1u)];
+
+            /* The FIFO output as raw words, read once each */
+            volatile uint32_t* output = (volatile uint32_t*)&base->Classic_RX_FIFO[RX_FIFO];
+            uint32_t cs = output[0];
+
+            /* Harvest the reception time and the standard or extended ID */
+            slot->timestamp = timestamp_extend(now, (uint16_t)cs);
+            slot->ID = FRAME_ID(output[1], (cs >> MB_CS_IDE_SHIFT) & 1u);
+
+            count_filter_hit(st, cs >> RXFIFO_CS_IDHIT_SHIFT);
+            st->rx_stats.received++;
+
+            /* Harvest the payload */
+            for(uint8_t i = 0; i < MAX_MTU_WORDS; i++)
+            {
+                slot->payload[i] = base->Classic_RX_FIFO[RX_FIFO].payload[i];
+            }
+
+            /* Publish the frame only after it is completely written */
+            COMPILER_BARRIER();
+            st->rx_head = head + 1u;
+        }
+        else
+        {
+            st->rx_stats.ring_overruns++;
+        }
+
+        /* Force update of the RX FIFO by clearing its flag (w1c register) */
+        base->CAN0_IFLAG1 = IFLAG1_RXFIFO_AVAILABLE;
+    }
+}
+
+void CAN0_ORed_0_15_MB_IRQHandler(void)
+{
+    if( state[FlexCAN_0].fd_mode )
+    {
+        drain_rx_FD();
+        return;
+    }
+
+    rx_fifo_IRQ(FlexCAN_0);
+}
+
+void CAN0_ORed_16_31_MB_IRQHandler(void)
+{
+    if( state[FlexCAN_0].fd_mode )
+    {
+        drain_rx_FD();
+        return;
+    }
+
+    tx_IRQ(FlexCAN_0);
+}
+
+void CAN1_ORed_0_15_MB_IRQHandler(void)
+{
+    /* A single interrupt serves the RX FIFO and the transmission message buffers of FlexCAN1 */
+    rx_fifo_IRQ(FlexCAN_1);
+    tx_IRQ(FlexCAN_1);
+}
+
 void greenLED_init(void)
 {
     PCC->PCC_PORTD_b.CGC = PCC_PCC_PORTD_CGC_1; /* Clock gating */
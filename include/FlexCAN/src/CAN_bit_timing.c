@@ -0,0 +1,197 @@
+/**
+ * Source file
+ */
+
+#include <FlexCAN/include/CAN_bit_timing.h>
+#include <FlexCAN/include/CAN_bit_timing_table.h>
+
+
+/* Ranges of the bit timing fields in time quanta (not register encodings) */
+typedef struct {
+    uint16_t presdiv_max;
+    uint8_t propseg_min;
+    uint8_t propseg_max;
+    uint8_t pseg1_max;
+    uint8_t pseg2_max;
+    uint8_t rjw_max;
+    uint8_t tq_min;
+    uint8_t tq_max;
+} bit_timing_limits_t;
+
+/* Indexed by bit_timing_phase_t: CAN0_CBT extended fields and CAN0_FDCBT fields */
+static const bit_timing_limits_t limits[] = {
+        {
+                .presdiv_max = 1024,
+                .propseg_min = 1,
+                .propseg_max = 64,
+                .pseg1_max = 32,
+                .pseg2_max = 32,
+                .rjw_max = 32,
+                .tq_min = 8,
+                .tq_max = 129,
+        },
+        {
+                .presdiv_max = 1024,
+                .propseg_min = 0,
+                .propseg_max = 31,
+                .pseg1_max = 8,
+                .pseg2_max = 8,
+                .rjw_max = 8,
+                .tq_min = 5,
+                .tq_max = 48,
+        },
+};
+
+/* Minimum phase segment 2 length supported by the protocol engine */
+#define PSEG2_MIN   (2u)
+
+/* Time quanta per bit and before the sample point of table entries, FPROPSEG isn't offset */
+#define NOMINAL_TQ(p)       (1u + ((p##PROPSEG) + 1u) + ((p##PSEG1) + 1u) + ((p##PSEG2) + 1u))
+#define DATA_TQ(p)          (1u + (p##PROPSEG) + ((p##PSEG1) + 1u) + ((p##PSEG2) + 1u))
+#define SAMPLE_POINT(p, tq) ((((tq) - ((p##PSEG2) + 1u)) * 1000u) / (tq))
+
+/* Distance between the sample point reached and the configured one */
+#define SP_ERROR(reached, wanted) (((reached) > (wanted)) ? ((reached) - (wanted)) : ((wanted) - (reached)))
+
+/* The table entries selected for the configuration must produce its bitrates exactly, fit the
+ * register fields and sample within CAN_SP_TOLERANCE, so a wrong entry fails the build */
+_Static_assert(((CAN_NOMINAL_PRESDIV + 1u) * NOMINAL_TQ(CAN_NOMINAL_) * CAN_BITRATE) == CAN_CLOCK_HZ,
+               "CAN_NOMINAL_* don't produce CAN_BITRATE");
+_Static_assert((CAN_NOMINAL_PRESDIV < 1024u) && (CAN_NOMINAL_PROPSEG < 64u) && (CAN_NOMINAL_PSEG1 < 32u) &&
+               (CAN_NOMINAL_PSEG2 < 32u) && (CAN_NOMINAL_PSEG2 >= (PSEG2_MIN - 1u)) &&
+               (CAN_NOMINAL_RJW <= CAN_NOMINAL_PSEG1) && (CAN_NOMINAL_RJW <= CAN_NOMINAL_PSEG2),
+               "CAN_NOMINAL_* exceed the CAN0_CBT fields");
+_Static_assert(SAMPLE_POINT(CAN_NOMINAL_, NOMINAL_TQ(CAN_NOMINAL_)) == CAN_NOMINAL_SP_REACHED,
+               "CAN_NOMINAL_SP_REACHED doesn't match the segments");
+_Static_assert(SP_ERROR(CAN_NOMINAL_SP_REACHED, CAN_SAMPLE_POINT) <= CAN_SP_TOLERANCE,
+               "No bit timing samples within CAN_SP_TOLERANCE of CAN_SAMPLE_POINT");
+
+_Static_assert(((CAN_FD_NOMINAL_PRESDIV + 1u) * NOMINAL_TQ(CAN_FD_NOMINAL_) * CAN_FD_NOMINAL_BITRATE) == CAN_FD_CLOCK_HZ,
+               "CAN_FD_NOMINAL_* don't produce CAN_FD_NOMINAL_BITRATE");
+_Static_assert((CAN_FD_NOMINAL_PRESDIV < 1024u) && (CAN_FD_NOMINAL_PROPSEG < 64u) && (CAN_FD_NOMINAL_PSEG1 < 32u) &&
+               (CAN_FD_NOMINAL_PSEG2 < 32u) && (CAN_FD_NOMINAL_PSEG2 >= (PSEG2_MIN - 1u)) &&
+               (CAN_FD_NOMINAL_RJW <= CAN_FD_NOMINAL_PSEG1) && (CAN_FD_NOMINAL_RJW <= CAN_FD_NOMINAL_PSEG2),
+               "CAN_FD_NOMINAL_* exceed the CAN0_CBT fields");
+_Static_assert(SAMPLE_POINT(CAN_FD_NOMINAL_, NOMINAL_TQ(CAN_FD_NOMINAL_)) == CAN_FD_NOMINAL_SP_REACHED,
+               "CAN_FD_NOMINAL_SP_REACHED doesn't match the segments");
+_Static_assert(SP_ERROR(CAN_FD_NOMINAL_SP_REACHED, CAN_SAMPLE_POINT) <= CAN_SP_TOLERANCE,
+               "No CAN FD nominal bit timing samples within CAN_SP_TOLERANCE of CAN_SAMPLE_POINT");
+
+_Static_assert(((CAN_FD_DATA_PRESDIV + 1u) * DATA_TQ(CAN_FD_DATA_) * CAN_FD_DATA_BITRATE) == CAN_FD_CLOCK_HZ,
+               "CAN_FD_DATA_* don't produce CAN_FD_DATA_BITRATE");
+_Static_assert((CAN_FD_DATA_PRESDIV < 1024u) && (CAN_FD_DATA_PROPSEG < 32u) && (CAN_FD_DATA_PSEG1 < 8u) &&
+               (CAN_FD_DATA_PSEG2 < 8u) && (CAN_FD_DATA_PSEG2 >= (PSEG2_MIN - 1u)) &&
+               (CAN_FD_DATA_RJW <= CAN_FD_DATA_PSEG1) && (CAN_FD_DATA_RJW <= CAN_FD_DATA_PSEG2),
+               "CAN_FD_DATA_* exceed the CAN0_FDCBT fields");
+_Static_assert(SAMPLE_POINT(CAN_FD_DATA_, DATA_TQ(CAN_FD_DATA_)) == CAN_FD_DATA_SP_REACHED,
+               "CAN_FD_DATA_SP_REACHED doesn't match the segments");
+_Static_assert(SP_ERROR(CAN_FD_DATA_SP_REACHED, CAN_FD_DATA_SAMPLE_POINT) <= CAN_SP_TOLERANCE,
+               "No CAN FD data bit timing samples within CAN_SP_TOLERANCE of CAN_FD_DATA_SAMPLE_POINT");
+
+const CAN_bit_timings_t CAN_timings = {
+        .PRESDIV = CAN_NOMINAL_PRESDIV,
+        .PROPSEG = CAN_NOMINAL_PROPSEG,
+        .PSEG1   = CAN_NOMINAL_PSEG1,
+        .PSEG2   = CAN_NOMINAL_PSEG2,
+        .RJW     = CAN_NOMINAL_RJW,
+};
+
+const CAN_bit_timings_t CAN_FD_nominal_timings = {
+        .PRESDIV = CAN_FD_NOMINAL_PRESDIV,
+        .PROPSEG = CAN_FD_NOMINAL_PROPSEG,
+        .PSEG1   = CAN_FD_NOMINAL_PSEG1,
+        .PSEG2   = CAN_FD_NOMINAL_PSEG2,
+        .RJW     = CAN_FD_NOMINAL_RJW,
+};
+
+const CAN_bit_timings_t CAN_FD_data_timings = {
+        .PRESDIV = CAN_FD_DATA_PRESDIV,
+        .PROPSEG = CAN_FD_DATA_PROPSEG,
+        .PSEG1   = CAN_FD_DATA_PSEG1,
+        .PSEG2   = CAN_FD_DATA_PSEG2,
+        .RJW     = CAN_FD_DATA_RJW,
+};
+
+status_t solve_bit_timings(uint32_t clock_hz, uint32_t bitrate, uint16_t sample_point,
+                           uint16_t tolerance, bit_timing_phase_t phase, CAN_bit_timings_t* timings)
+{
+    const bit_timing_limits_t* limit = &limits[phase];
+
+    status_t status = Failure;
+    uint32_t best_error = (uint32_t)tolerance + 1u;
+
+    for(uint32_t presdiv = 1; (presdiv <= limit->presdiv_max) && (bitrate != 0); presdiv++)
+    {
+        /* Only exact bitrates are considered */
+        if( clock_hz % (bitrate * presdiv) )
+        {
+            continue;
+        }
+
+        uint32_t tq = clock_hz / (bitrate * presdiv);
+
+        /* Time quanta per bit only shrink with bigger prescalers */
+        if( tq < limit->tq_min )
+        {
+            break;
+        }
+
+        if( tq > limit->tq_max )
+        {
+            continue;
+        }
+
+        /* Everything before the sample point but the sync segment, rounded to the nearest quantum */
+        int32_t tseg1 = (int32_t)(((sample_point * tq) + 500u) / 1000u) - 1;
+        int32_t pseg2 = (int32_t)tq - 1 - tseg1;
+
+        /* Clamp phase segment 2 to its range, moving the sample point accordingly */
+        if( pseg2 < (int32_t)PSEG2_MIN )
+        {
+            pseg2 = PSEG2_MIN;
+        }
+        if( pseg2 > (int32_t)limit->pseg2_max )
+        {
+            pseg2 = limit->pseg2_max;
+        }
+        tseg1 = (int32_t)tq - 1 - pseg2;
+
+        /* Phase segment 1 mirrors phase segment 2 where possible, the rest is propagation */
+        int32_t pseg1 = (pseg2 < limit->pseg1_max) ? pseg2 : limit->pseg1_max;
+        if( pseg1 > (tseg1 - limit->propseg_min) )
+        {
+            pseg1 = tseg1 - limit->propseg_min;
+        }
+        if( (tseg1 - pseg1) > limit->propseg_max )
+        {
+            pseg1 = tseg1 - limit->propseg_max;
+        }
+        int32_t propseg = tseg1 - pseg1;
+
+        if( (pseg1 < 1) || (pseg1 > limit->pseg1_max) || (propseg < limit->propseg_min) )
+        {
+            continue;
+        }
+
+        uint32_t actual = ((uint32_t)(tseg1 + 1) * 1000u) / tq;
+        uint32_t error = (actual > sample_point) ? (actual - sample_point) : (sample_point - actual);
+
+        /* Strictly better only, so the smallest prescaler (most quanta) wins ties */
+        if( error < best_error )
+        {
+            int32_t rjw = (pseg1 < pseg2) ? pseg1 : pseg2;
+            rjw = (rjw < limit->rjw_max) ? rjw : limit->rjw_max;
+
+            timings->PRESDIV = (uint16_t)(presdiv - 1u);
+            timings->PROPSEG = (uint8_t)((phase == Data_phase) ? propseg : (propseg - 1)); /* FPROPSEG isn't offset */
+            timings->PSEG1   = (uint8_t)(pseg1 - 1);
+            timings->PSEG2   = (uint8_t)(pseg2 - 1);
+            timings->RJW     = (uint8_t)(rjw - 1);
+
+            best_error = error;
+            status = Success;
+        }
+    }
+
+    return status;
+}
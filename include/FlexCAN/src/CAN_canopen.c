@@ -0,0 +1,688 @@
+/**
+ * Source file
+ */
+
+#include <FlexCAN/include/CAN_canopen.h>
+#include <FlexCAN/include/CAN_dispatch.h>
+
+
+/* Function codes of the predefined connection set, added to the node ID */
+#define COB_NMT             (0x000u)
+#define COB_TPDO1           (0x180u)
+#define COB_RPDO1           (0x200u)
+#define COB_SDO_TX          (0x580u)
+#define COB_SDO_RX          (0x600u)
+#define COB_HEARTBEAT       (0x700u)
+
+/* NMT commands */
+#define NMT_START           (0x01u)
+#define NMT_STOP            (0x02u)
+#define NMT_PRE_OPERATIONAL (0x80u)
+#define NMT_RESET_NODE      (0x81u)
+#define NMT_RESET_COMM      (0x82u)
+
+/* SDO client command specifiers, the upper three bits of the first byte */
+#define CCS_DOWNLOAD_SEGMENT  (0u)
+#define CCS_DOWNLOAD_INITIATE (1u)
+#define CCS_UPLOAD_INITIATE   (2u)
+#define CCS_UPLOAD_SEGMENT    (3u)
+#define CCS_ABORT             (4u)
+
+/* SDO abort codes */
+#define ABORT_TOGGLE        (0x05030000u)
+#define ABORT_TIMEOUT       (0x05040000u)
+#define ABORT_COMMAND       (0x05040001u)
+#define ABORT_WRITE_ONLY    (0x06010001u)
+#define ABORT_READ_ONLY     (0x06010002u)
+#define ABORT_NO_OBJECT     (0x06020000u)
+#define ABORT_LENGTH        (0x06070010u)
+
+/* Bytes of a Classical CAN frame, and the data bytes of an SDO segment */
+#define FRAME_BYTES         (8u)
+#define SEGMENT_BYTES       (7u)
+
+/* Free running timer ticks, one per nominal bit */
+#define TICKS_PER_MS        (CAN_BITRATE / 1000u)
+
+/**
+ *  Copy of one mapped object between its storage and the 64 bits of a PDO,
+ *  numbered little-endian as CANopen transmits them
+ */
+typedef struct {
+    void* data;
+    uint32_t mask;
+    uint8_t shift;
+    uint8_t size;
+} co_copy_t;
+
+/**
+ *  Compiled PDO
+ */
+typedef struct {
+    uint32_t cob_id;
+    uint8_t count;
+    co_copy_t copies[CO_PDO_MAPPINGS];
+    uint16_t event_ms;
+    uint64_t due;
+} co_pdo_t;
+
+/**
+ *  Segmented SDO transfer in progress
+ */
+typedef struct {
+    uint8_t active;
+    uint8_t upload;
+    uint8_t toggle;
+    const co_object_t* object;
+    uint32_t offset;
+    uint64_t deadline;
+} co_sdo_t;
+
+static co_config_t node;
+static co_nmt_state_t nmt_state = Co_initialising;
+
+/* Messages kept until the transmission queue takes them */
+static uint8_t bootup_pending = 0;
+static uint8_t sdo_pending = 0;
+static frame_t sdo_response;
+
+static uint64_t heartbeat_due = 0;
+
+static co_pdo_t rpdos[CO_RPDOS];
+static co_pdo_t tpdos[CO_TPDOS];
+
+static co_sdo_t sdo;
+
+/* Byte of a frame, the FlexCAN holds the first byte in the upper bits of each word */
+static uint8_t get_byte(const frame_t* frame, uint32_t i)
+{
+    return (uint8_t)(frame->payload[i >> 2] >> (24u - ((i & 3u) * 8u)));
+}
+
+/* Frame of the given COB-ID from bytes in transmission order, the rest zero */
+static void pack_frame(frame_t* frame, uint32_t cob_id, const uint8_t* bytes, uint32_t count)
+{
+    frame->ID = cob_id;
+    frame->payload[0] = 0;
+    frame->payload[1] = 0;
+
+    for(uint32_t i = 0; i < count; i++)
+    {
+        frame->payload[i >> 2] |= (uint32_t)bytes[i] << (24u - ((i & 3u) * 8u));
+    }
+}
+
+/* Object of an index and subindex, by binary search, NULL if missing */
+static const co_object_t* find_object(uint16_t index, uint8_t subindex)
+{
+    uint32_t key = ((uint32_t)index << 8) | subindex;
+    uint32_t low = 0;
+    uint32_t high = node.object_count;
+
+    while( low < high )
+    {
+        uint32_t mid = (low + high) / 2u;
+        const co_object_t* object = &node.objects[mid];
+        uint32_t mid_key = ((uint32_t)object->index << 8) | object->subindex;
+
+        if( mid_key == key )
+        {
+            return object;
+        }
+
+        if( mid_key < key )
+        {
+            low = mid + 1u;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    return 0;
+}
+
+status_t co_init(const co_config_t* config)
+{
+    if( (config->node_id == 0u) || (config->node_id > 127u) )
+    {
+        return Failure;
+    }
+
+    for(uint32_t i = 1; i < config->object_count; i++)
+    {
+        const co_object_t* a = &config->objects[i - 1u];
+        const co_object_t* b = &config->objects[i];
+
+        if( (((uint32_t)a->index << 8) | a->subindex) >= (((uint32_t)b->index << 8) | b->subindex) )
+        {
+            return Failure;
+        }
+    }
+
+    node = *config;
+
+    for(uint8_t i = 0; i < CO_RPDOS; i++)
+    {
+        rpdos[i].count = 0;
+    }
+
+    for(uint8_t i = 0; i < CO_TPDOS; i++)
+    {
+        tpdos[i].count = 0;
+    }
+
+    sdo.active = 0;
+    sdo_pending = 0;
+    bootup_pending = 1;
+    nmt_state = Co_pre_operational;
+
+    return Success;
+}
+
+co_nmt_state_t co_state(void)
+{
+    return nmt_state;
+}
+
+/* Compile a mapping into copies, checking the objects allow the given access */
+static status_t compile_pdo(co_pdo_t* pdo, uint32_t cob_id, const uint32_t* mapping, uint8_t count, uint8_t access)
+{
+    uint32_t shift = 0;
+
+    if( count > CO_PDO_MAPPINGS )
+    {
+        return Failure;
+    }
+
+    for(uint8_t i = 0; i < count; i++)
+    {
+        const co_object_t* object = find_object((uint16_t)(mapping[i] >> 16), (uint8_t)(mapping[i] >> 8));
+        uint32_t bits = mapping[i] & 0xFFu;
+
+        if( (object == 0) || !(object->access & access) || (bits == 0u) || (bits > 32u) ||
+            ((object->size != 1u) && (object->size != 2u) && (object->size != 4u)) ||
+            (bits > (object->size * 8u)) || ((shift + bits) > 64u) )
+        {
+            pdo->count = 0;
+            return Failure;
+        }
+
+        pdo->copies[i].data = object->data;
+        pdo->copies[i].mask = (bits == 32u) ? 0xFFFFFFFFu : ((1u << bits) - 1u);
+        pdo->copies[i].shift = (uint8_t)shift;
+        pdo->copies[i].size = (uint8_t)object->size;
+
+        shift += bits;
+    }
+
+    pdo->cob_id = cob_id;
+    pdo->count = count;
+
+    return Success;
+}
+
+status_t co_map_rpdo(uint8_t pdo, uint32_t cob_id, const uint32_t* mapping, uint8_t count)
+{
+    if( pdo >= CO_RPDOS )
+    {
+        return Failure;
+    }
+
+    if( cob_id == CO_DEFAULT_COB_ID )
+    {
+        cob_id = COB_RPDO1 + (0x100u * pdo) + node.node_id;
+    }
+
+    return compile_pdo(&rpdos[pdo], cob_id, mapping, count, CO_WRITE);
+}
+
+status_t co_map_tpdo(uint8_t pdo, uint32_t cob_id, const uint32_t* mapping, uint8_t count, uint16_t event_ms)
+{
+    if( pdo >= CO_TPDOS )
+    {
+        return Failure;
+    }
+
+    if( cob_id == CO_DEFAULT_COB_ID )
+    {
+        cob_id = COB_TPDO1 + (0x100u * pdo) + node.node_id;
+    }
+
+    tpdos[pdo].event_ms = event_ms;
+    tpdos[pdo].due = 0;
+
+    return compile_pdo(&tpdos[pdo], cob_id, mapping, count, CO_READ);
+}
+
+/* Received PDO into the dictionary: one 64-bit little-endian load, then a shift and a mask per object */
+static void apply_rpdo(const co_pdo_t* pdo, const frame_t* frame)
+{
+    uint64_t data = __builtin_bswap32(frame->payload[0]) | ((uint64_t)__builtin_bswap32(frame->payload[1]) << 32);
+
+    for(uint8_t i = 0; i < pdo->count; i++)
+    {
+        const co_copy_t* copy = &pdo->copies[i];
+        uint32_t value = (uint32_t)(data >> copy->shift) & copy->mask;
+
+        if( copy->size == 4u )
+        {
+            *(uint32_t*)copy->data = value;
+        }
+        else if( copy->size == 2u )
+        {
+            *(uint16_t*)copy->data = (uint16_t)value;
+        }
+        else
+        {
+            *(uint8_t*)copy->data = (uint8_t)value;
+        }
+    }
+}
+
+status_t co_send_tpdo(uint8_t pdo)
+{
+    if( (pdo >= CO_TPDOS) || (tpdos[pdo].count == 0u) || (nmt_state != Co_operational) )
+    {
+        return Failure;
+    }
+
+    const co_pdo_t* tpdo = &tpdos[pdo];
+    uint64_t data = 0;
+    frame_t frame;
+
+    for(uint8_t i = 0; i < tpdo->count; i++)
+    {
+        const co_copy_t* copy = &tpdo->copies[i];
+        uint32_t value;
+
+        if( copy->size == 4u )
+        {
+            value = *(const uint32_t*)copy->data;
+        }
+        else if( copy->size == 2u )
+        {
+            value = *(const uint16_t*)copy->data;
+        }
+        else
+        {
+            value = *(const uint8_t*)copy->data;
+        }
+
+        data |= (uint64_t)(value & copy->mask) << copy->shift;
+    }
+
+    frame.ID = tpdo->cob_id;
+    frame.payload[0] = __builtin_bswap32((uint32_t)data);
+    frame.payload[1] = __builtin_bswap32((uint32_t)(data >> 32));
+
+    return transmit_frame(node.can, &frame);
+}
+
+/* Queue an SDO response, kept pending while the transmission queue is full */
+static void sdo_respond(const uint8_t* bytes)
+{
+    pack_frame(&sdo_response, COB_SDO_TX + node.node_id, bytes, FRAME_BYTES);
+    sdo_pending = (transmit_frame(node.can, &sdo_response) != Success);
+}
+
+static void sdo_abort(uint16_t index, uint8_t subindex, uint32_t code)
+{
+    uint8_t bytes[FRAME_BYTES] = {
+            (uint8_t)(CCS_ABORT << 5), (uint8_t)index, (uint8_t)(index >> 8), subindex,
+            (uint8_t)code, (uint8_t)(code >> 8), (uint8_t)(code >> 16), (uint8_t)(code >> 24)
+    };
+
+    sdo.active = 0;
+    sdo_respond(bytes);
+}
+
+/* Initiate download or upload, answered with an expedited transfer when the object fits */
+static void sdo_initiate(uint8_t ccs, const uint8_t* request, uint64_t now)
+{
+    uint16_t index = (uint16_t)(request[1] | (request[2] << 8));
+    uint8_t subindex = request[3];
+    const co_object_t* object = find_object(index, subindex);
+    uint8_t response[FRAME_BYTES] = { 0, request[1], request[2], subindex, 0, 0, 0, 0 };
+
+    /* A new request ends the transfer in progress */
+    sdo.active = 0;
+
+    if( object == 0 )
+    {
+        sdo_abort(index, subindex, ABORT_NO_OBJECT);
+        return;
+    }
+
+    if( ccs == CCS_DOWNLOAD_INITIATE )
+    {
+        uint8_t expedited = (request[0] >> 1) & 1u;
+        uint8_t sized = request[0] & 1u;
+        uint32_t size = expedited ? (4u - ((request[0] >> 2) & 3u)) :
+                        (request[4] | ((uint32_t)request[5] << 8) | ((uint32_t)request[6] << 16) | ((uint32_t)request[7] << 24));
+
+        if( !(object->access & CO_WRITE) )
+        {
+            sdo_abort(index, subindex, ABORT_READ_ONLY);
+            return;
+        }
+
+        if( sized && (size != object->size) )
+        {
+            sdo_abort(index, subindex, ABORT_LENGTH);
+            return;
+        }
+
+        if( expedited )
+        {
+            if( object->size > 4u )
+            {
+                sdo_abort(index, subindex, ABORT_LENGTH);
+                return;
+            }
+
+            for(uint32_t i = 0; i < object->size; i++)
+            {
+                ((uint8_t*)object->data)[i] = request[4u + i];
+            }
+        }
+        else
+        {
+            sdo = (co_sdo_t){ .active = 1, .upload = 0, .object = object, .deadline = now + (CO_SDO_TIMEOUT_MS * TICKS_PER_MS) };
+        }
+
+        response[0] = 0x60u;
+    }
+    else
+    {
+        if( !(object->access & CO_READ) )
+        {
+            sdo_abort(index, subindex, ABORT_WRITE_ONLY);
+            return;
+        }
+
+        if( object->size <= 4u )
+        {
+            /* Expedited with the size indicated by the unused bytes */
+            response[0] = (uint8_t)(0x43u | ((4u - object->size) << 2));
+
+            for(uint32_t i = 0; i < object->size; i++)
+            {
+                response[4u + i] = ((const uint8_t*)object->data)[i];
+            }
+        }
+        else
+        {
+            response[0] = 0x41u;
+            response[4] = (uint8_t)object->size;
+            response[5] = (uint8_t)(object->size >> 8);
+            response[6] = (uint8_t)(object->size >> 16);
+            response[7] = (uint8_t)(object->size >> 24);
+
+            sdo = (co_sdo_t){ .active = 1, .upload = 1, .object = object, .deadline = now + (CO_SDO_TIMEOUT_MS * TICKS_PER_MS) };
+        }
+    }
+
+    sdo_respond(response);
+}
+
+/* Next segment of the transfer in progress */
+static void sdo_segment(uint8_t ccs, const uint8_t* request, uint64_t now)
+{
+    uint8_t toggle = (request[0] >> 4) & 1u;
+    uint8_t response[FRAME_BYTES] = { 0 };
+    const co_object_t* object = sdo.object;
+
+    if( !sdo.active || (sdo.upload != (ccs == CCS_UPLOAD_SEGMENT)) )
+    {
+        sdo_abort(0, 0, ABORT_COMMAND);
+        return;
+    }
+
+    if( toggle != sdo.toggle )
+    {
+        sdo_abort(object->index, object->subindex, ABORT_TOGGLE);
+        return;
+    }
+
+    uint32_t left = object->size - sdo.offset;
+    uint32_t count;
+    uint8_t last;
+
+    if( sdo.upload )
+    {
+        count = (left < SEGMENT_BYTES) ? left : SEGMENT_BYTES;
+        last = (count == left);
+
+        for(uint32_t i = 0; i < count; i++)
+        {
+            response[1u + i] = ((const uint8_t*)object->data)[sdo.offset + i];
+        }
+
+        response[0] = (uint8_t)((toggle << 4) | ((SEGMENT_BYTES - count) << 1) | last);
+    }
+    else
+    {
+        count = SEGMENT_BYTES - ((request[0] >> 1) & 7u);
+        last = request[0] & 1u;
+
+        /* The segments must add up to the object exactly */
+        if( (count > left) || (last && (count != left)) )
+        {
+            sdo_abort(object->index, object->subindex, ABORT_LENGTH);
+            return;
+        }
+
+        for(uint32_t i = 0; i < count; i++)
+        {
+            ((uint8_t*)object->data)[sdo.offset + i] = request[1u + i];
+        }
+
+        response[0] = (uint8_t)(0x20u | (toggle << 4));
+    }
+
+    sdo.offset += count;
+    sdo.toggle ^= 1u;
+    sdo.deadline = now + (CO_SDO_TIMEOUT_MS * TICKS_PER_MS);
+    sdo.active = !last;
+
+    sdo_respond(response);
+}
+
+static void sdo_request(const frame_t* frame)
+{
+    uint8_t request[FRAME_BYTES];
+
+    for(uint32_t i = 0; i < FRAME_BYTES; i++)
+    {
+        request[i] = get_byte(frame, i);
+    }
+
+    uint8_t ccs = request[0] >> 5;
+
+    /* The client must wait for the response before its next request. One sent anyway is
+     * dropped unprocessed, so the pending response isn't overwritten and the dictionary isn't
+     * changed without a confirmation; the client times out. An abort needs no response and
+     * makes the pending one stale */
+    if( sdo_pending && (ccs != CCS_ABORT) )
+    {
+        return;
+    }
+
+    if( (ccs == CCS_DOWNLOAD_INITIATE) || (ccs == CCS_UPLOAD_INITIATE) )
+    {
+        sdo_initiate(ccs, request, frame->timestamp);
+    }
+    else if( (ccs == CCS_DOWNLOAD_SEGMENT) || (ccs == CCS_UPLOAD_SEGMENT) )
+    {
+        sdo_segment(ccs, request, frame->timestamp);
+    }
+    else if( ccs == CCS_ABORT )
+    {
+        sdo.active = 0;
+        sdo_pending = 0;
+    }
+    else
+    {
+        sdo_abort((uint16_t)(request[1] | (request[2] << 8)), request[3], ABORT_COMMAND);
+    }
+}
+
+static void nmt_command(uint8_t command)
+{
+    switch( command )
+    {
+        case NMT_START:
+            nmt_state = Co_operational;
+            break;
+
+        case NMT_STOP:
+            nmt_state = Co_stopped;
+            break;
+
+        case NMT_PRE_OPERATIONAL:
+            nmt_state = Co_pre_operational;
+            break;
+
+        case NMT_RESET_NODE:
+        case NMT_RESET_COMM:
+            if( (command == NMT_RESET_NODE) && (node.reset != 0) )
+            {
+                node.reset();
+            }
+
+            /* Back through initialising, which announces itself with the boot-up message */
+            sdo.active = 0;
+            bootup_pending = 1;
+            nmt_state = Co_pre_operational;
+            break;
+
+        default:
+            break;
+    }
+}
+
+status_t co_frame(const frame_t* frame)
+{
+    uint32_t cob_id = frame->ID;
+
+    if( (nmt_state == Co_initialising) || (cob_id & CAN_ID_EXT) )
+    {
+        return Failure;
+    }
+
+    /* Receive PDOs first, they are the hot path */
+    for(uint8_t i = 0; i < CO_RPDOS; i++)
+    {
+        if( (rpdos[i].count != 0u) && (rpdos[i].cob_id == cob_id) )
+        {
+            if( nmt_state == Co_operational )
+            {
+                apply_rpdo(&rpdos[i], frame);
+            }
+
+            return Success;
+        }
+    }
+
+    if( cob_id == COB_NMT )
+    {
+        uint8_t target = get_byte(frame, 1);
+
+        if( (target == 0u) || (target == node.node_id) )
+        {
+            nmt_command(get_byte(frame, 0));
+        }
+
+        return Success;
+    }
+
+    if( cob_id == (COB_SDO_RX + node.node_id) )
+    {
+        if( nmt_state != Co_stopped )
+        {
+            sdo_request(frame);
+        }
+
+        return Success;
+    }
+
+    return Failure;
+}
+
+uint32_t co_poll(void)
+{
+    uint32_t total = 0;
+    frame_t* frames;
+    uint32_t count;
+
+    if( nmt_state == Co_initialising )
+    {
+        return 0;
+    }
+
+    /* Frames are read in place, bounded to one ring's worth */
+    while( (total < RX_RING_SIZE) && ((count = lend_frames(node.can, &frames)) != 0u) )
+    {
+        for(uint32_t i = 0; i < count; i++)
+        {
+            if( co_frame(&frames[i]) != Success )
+            {
+                (void)dispatch_frame(node.can, &frames[i]);
+            }
+        }
+
+        release_frames(node.can, count);
+        total += count;
+    }
+
+    uint64_t now = FlexCAN_timer_now(node.can);
+    frame_t frame;
+
+    if( bootup_pending )
+    {
+        uint8_t bootup = 0;
+
+        pack_frame(&frame, COB_HEARTBEAT + node.node_id, &bootup, 1);
+
+        if( transmit_frame(node.can, &frame) == Success )
+        {
+            bootup_pending = 0;
+            heartbeat_due = now + ((uint64_t)node.heartbeat_ms * TICKS_PER_MS);
+        }
+    }
+    else if( node.heartbeat_ms && ((int64_t)(now - heartbeat_due) >= 0) )
+    {
+        uint8_t state = (uint8_t)nmt_state;
+
+        pack_frame(&frame, COB_HEARTBEAT + node.node_id, &state, 1);
+
+        if( transmit_frame(node.can, &frame) == Success )
+        {
+            heartbeat_due += (uint64_t)node.heartbeat_ms * TICKS_PER_MS;
+        }
+    }
+
+    if( sdo_pending )
+    {
+        sdo_pending = (transmit_frame(node.can, &sdo_response) != Success);
+    }
+    else if( sdo.active && ((int64_t)(now - sdo.deadline) >= 0) )
+    {
+        sdo_abort(sdo.object->index, sdo.object->subindex, ABORT_TIMEOUT);
+    }
+
+    for(uint8_t i = 0; (nmt_state == Co_operational) && (i < CO_TPDOS); i++)
+    {
+        co_pdo_t* tpdo = &tpdos[i];
+
+        if( tpdo->event_ms && tpdo->count && ((int64_t)(now - tpdo->due) >= 0) &&
+            (co_send_tpdo(i) == Success) )
+        {
+            tpdo->due = now + ((uint64_t)tpdo->event_ms * TICKS_PER_MS);
+        }
+    }
+
+    return total;
+}
@@ -0,0 +1,207 @@
+/**
+ * Source file
+ */
+
+#include <FlexCAN/include/CAN_cyclic.h>
+#include <FlexCAN/include/CAN_internal.h>
+
+
+/* LPIT0 channel 0 flag */
+#define LPIT_CH0            (1u << 0)
+
+/* PCC clock source option of SOSCDIV2 */
+#define PCC_PCS_SOSCDIV2    (1u)
+
+/* Reload value of channel 0, one timeout per tick */
+#define CYCLIC_TVAL         ((CYCLIC_CLOCK_HZ / CYCLIC_TICK_HZ) - 1u)
+
+static cyclic_entry_t entries[CYCLIC_ENTRIES];
+static uint32_t entry_count = 0;
+
+/* Release counters, only written by the interrupt once started */
+static cyclic_stats_t cyclic_stats[CYCLIC_ENTRIES];
+
+/* Tick of the next release of each frame, and the ticks elapsed since the start */
+static uint32_t next_release[CYCLIC_ENTRIES];
+static uint32_t cyclic_tick = 0;
+
+static uint32_t gcd(uint32_t a, uint32_t b)
+{
+    while( b != 0u )
+    {
+        uint32_t r = a % b;
+        a = b;
+        b = r;
+    }
+
+    return a;
+}
+
+/* Offset within the period whose releases coincide the least with the frames already added.
+ * Two frames meet iff their offsets are congruent modulo the gcd g of their periods, and then
+ * g / (other period) of the releases of the new frame hit one of the other's */
+static uint32_t spread_offset(uint32_t period)
+{
+    uint32_t best = 0;
+    uint64_t best_cost = UINT64_MAX;
+
+    for(uint32_t offset = 0; (offset < period) && (best_cost != 0u); offset++)
+    {
+        uint64_t cost = 0;
+
+        for(uint32_t j = 0; j < entry_count; j++)
+        {
+            uint32_t g = gcd(period, entries[j].period);
+
+            if( ((offset + g - (entries[j].offset % g)) % g) == 0u )
+            {
+                cost += ((uint64_t)g << 16) / entries[j].period;
+            }
+        }
+
+        if( cost < best_cost )
+        {
+            best_cost = cost;
+            best = offset;
+        }
+    }
+
+    return best;
+}
+
+status_t cyclic_add(const cyclic_entry_t* entry)
+{
+    if( (entry->period == 0u) || (entry->prio > TX_PRIO_LOWEST) || (entry->source == 0) ||
+        ((entry->offset != CYCLIC_AUTO_OFFSET) && (entry->offset >= entry->period)) )
+    {
+        return Failure;
+    }
+
+    if( entry_count == CYCLIC_ENTRIES )
+    {
+        return BufferFull;
+    }
+
+    cyclic_entry_t* added = &entries[entry_count];
+    *added = *entry;
+
+    if( entry->offset == CYCLIC_AUTO_OFFSET )
+    {
+        added->offset = spread_offset(entry->period);
+    }
+
+    cyclic_stats[entry_count] = (cyclic_stats_t){ .offset = added->offset };
+    entry_count++;
+
+    return Success;
+}
+
+status_t cyclic_start(void)
+{
+    /* LPIT0 counts the SOSCDIV2 clock FlexCAN_init_RXFIFO() set up */
+    if( !(SCG->SCG_SOSCCSR_b.SOSCVLD) )
+    {
+        return Failure;
+    }
+
+    cyclic_stop();
+
+    /* The clock source can only be selected while the clock is gated */
+    PCC->PCC_LPIT_b.CGC = PCC_PCC_LPIT_CGC_0;
+    PCC->PCC_LPIT_b.PCS = PCC_PCS_SOSCDIV2;
+    PCC->PCC_LPIT_b.CGC = PCC_PCC_LPIT_CGC_1;
+
+    /* Enable the module, also while the core is halted by the debugger */
+    LPIT0->MCR = LPIT_MCR_M_CEN_MASK | LPIT_MCR_DBG_EN_MASK;
+
+    /* Channel 0 as a 32-bit periodic counter timing out once per tick */
+    LPIT0->TMR[0].TVAL = CYCLIC_TVAL;
+    LPIT0->TMR[0].TCTRL = 0;
+
+    cyclic_tick = 0;
+
+    for(uint32_t e = 0; e < entry_count; e++)
+    {
+        next_release[e] = entries[e].offset;
+    }
+
+    /* Acknowledge a stale timeout (w1c register) and interrupt on the next ones */
+    LPIT0->MSR = LPIT_CH0;
+    LPIT0->MIER |= LPIT_CH0;
+
+    /* Same priority as the message buffer interrupts, as transmit_frame_ISR() requires */
+    enable_IRQ(LPIT0_Ch0_IRQn, CAN_MB_IRQ_PRIORITY);
+
+    LPIT0->SETTEN = LPIT_CH0;
+
+    return Success;
+}
+
+void cyclic_stop(void)
+{
+    S32_NVIC->ICER[LPIT0_Ch0_IRQn >> 5] = 1u << (LPIT0_Ch0_IRQn & 0x1Fu);
+
+    if( PCC->PCC_LPIT_b.CGC )
+    {
+        LPIT0->CLRTEN = LPIT_CH0;
+        LPIT0->MIER &= ~LPIT_CH0;
+    }
+}
+
+status_t get_cyclic_stats(uint32_t entry, cyclic_stats_t* stats)
+{
+    if( entry >= entry_count )
+    {
+        return Failure;
+    }
+
+    /* The 64-bit sum is updated by the interrupt */
+    CRITICAL_ENTER();
+    *stats = cyclic_stats[entry];
+    CRITICAL_EXIT();
+
+    return Success;
+}
+
+void LPIT0_Ch0_IRQHandler(void)
+{
+    /* Acknowledge the timeout (w1c register) */
+    LPIT0->MSR = LPIT_CH0;
+
+    uint32_t tick = cyclic_tick++;
+
+    for(uint32_t e = 0; e < entry_count; e++)
+    {
+        const cyclic_entry_t* entry = &entries[e];
+        cyclic_stats_t* stats = &cyclic_stats[e];
+
+        if( (int32_t)(tick - next_release[e]) < 0 )
+        {
+            continue;
+        }
+
+        next_release[e] += entry->period;
+
+        frame_t frame;
+        frame.ID = entry->ID;
+        entry->source(&frame);
+
+        /* Clock cycles since the timeout, the counter reloaded TVAL then and counts down. This is
+         * the release delay only, the wait for arbitration after it isn't included */
+        uint32_t jitter = CYCLIC_TVAL - LPIT0->TMR[0].CVAL;
+
+        if( transmit_frame_ISR(entry->can, &frame, entry->prio) != Success )
+        {
+            stats->missed++;
+            continue;
+        }
+
+        stats->released++;
+        stats->total_release_jitter += jitter;
+
+        if( jitter > stats->worst_release_jitter )
+        {
+            stats->worst_release_jitter = jitter;
+        }
+    }
+}
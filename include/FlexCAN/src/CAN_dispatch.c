@@ -0,0 +1,245 @@
+/**
+ * Source file
+ */
+
+#include <FlexCAN/include/CAN_dispatch.h>
+
+
+/* Number of standard IDs */
+#define STD_ID_COUNT (0x800u)
+
+/**
+ *  Registration of a handler for an ID/mask pair
+ */
+typedef struct {
+    uint32_t ID;    /* Masked ID, without the CAN_ID_EXT flag */
+    uint32_t mask;
+    rx_callback_t handler;
+} dispatch_entry_t;
+
+/**
+ *  Run of extended registrations sharing a mask in the sorted table
+ */
+typedef struct {
+    uint32_t mask;
+    uint32_t first;
+    uint32_t count;
+} dispatch_group_t;
+
+/**
+ *  Registrations of a FlexCAN instance
+ */
+typedef struct {
+    /* Standard registrations, and for every standard ID the index of its registration plus one, 0 for none */
+    dispatch_entry_t std_entries[DISPATCH_STD_ENTRIES];
+    uint32_t std_count;
+    uint8_t std_table[STD_ID_COUNT];
+
+    /* Extended registrations sorted by mask, from the most cared bits down, then by ID */
+    dispatch_entry_t ext_entries[DISPATCH_EXT_ENTRIES];
+    uint32_t ext_count;
+
+    /* Runs of the sorted table, searched in order */
+    dispatch_group_t ext_groups[DISPATCH_EXT_ENTRIES];
+    uint32_t ext_group_count;
+} dispatch_table_t;
+
+static dispatch_table_t tables[FlexCAN_instances];
+
+#if DISPATCH_STD_ENTRIES > 255u
+#error "DISPATCH_STD_ENTRIES must fit the 8-bit indices of the standard table"
+#endif
+
+/* Whether registration a goes before b in the extended table */
+static uint8_t ext_before(const dispatch_entry_t* a, const dispatch_entry_t* b)
+{
+    uint32_t bits_a = (uint32_t)__builtin_popcount(a->mask);
+    uint32_t bits_b = (uint32_t)__builtin_popcount(b->mask);
+
+    if( bits_a != bits_b )
+    {
+        return bits_a > bits_b;
+    }
+
+    if( a->mask != b->mask )
+    {
+        return a->mask > b->mask;
+    }
+
+    return a->ID < b->ID;
+}
+
+static status_t register_std(dispatch_table_t* table, uint32_t id, uint32_t mask, rx_callback_t handler)
+{
+    if( table->std_count == DISPATCH_STD_ENTRIES )
+    {
+        return BufferFull;
+    }
+
+    dispatch_entry_t* entry = &table->std_entries[table->std_count];
+    entry->mask = mask & (STD_ID_COUNT - 1u);
+    entry->ID = id & entry->mask;
+    entry->handler = handler;
+    table->std_count++;
+
+    uint32_t bits = (uint32_t)__builtin_popcount(entry->mask);
+
+    /* Point every matching ID at the registration, unless a more precise one holds it */
+    for(uint32_t i = 0; i < STD_ID_COUNT; i++)
+    {
+        if( (i & entry->mask) != entry->ID )
+        {
+            continue;
+        }
+
+        uint8_t current = table->std_table[i];
+
+        if( (current == 0u) || ((uint32_t)__builtin_popcount(table->std_entries[current - 1u].mask) <= bits) )
+        {
+            table->std_table[i] = (uint8_t)table->std_count;
+        }
+    }
+
+    return Success;
+}
+
+static status_t register_ext(dispatch_table_t* table, uint32_t id, uint32_t mask, rx_callback_t handler)
+{
+    dispatch_entry_t* ext_entries = table->ext_entries;
+    dispatch_group_t* ext_groups = table->ext_groups;
+
+    if( table->ext_count == DISPATCH_EXT_ENTRIES )
+    {
+        return BufferFull;
+    }
+
+    dispatch_entry_t entry = {
+            .ID = id & mask & CAN_ID_MASK,
+            .mask = mask & CAN_ID_MASK,
+            .handler = handler,
+    };
+
+    /* Insert in order */
+    uint32_t i = table->ext_count;
+
+    while( (i > 0u) && ext_before(&entry, &ext_entries[i - 1u]) )
+    {
+        ext_entries[i] = ext_entries[i - 1u];
+        i--;
+    }
+
+    ext_entries[i] = entry;
+    table->ext_count++;
+
+    /* Rebuild the runs of equal masks */
+    uint32_t groups = 0;
+
+    for(uint32_t n = 0; n < table->ext_count; n++)
+    {
+        if( (n == 0u) || (ext_entries[n].mask != ext_entries[n - 1u].mask) )
+        {
+            ext_groups[groups].mask = ext_entries[n].mask;
+            ext_groups[groups].first = n;
+            ext_groups[groups].count = 0;
+            groups++;
+        }
+
+        ext_groups[groups - 1u].count++;
+    }
+
+    table->ext_group_count = groups;
+
+    return Success;
+}
+
+status_t dispatch_register(FlexCAN_instance_t can, uint32_t id, uint32_t mask, rx_callback_t handler)
+{
+    if( (handler == 0) || (can >= FlexCAN_instances) )
+    {
+        return Failure;
+    }
+
+    return (id & CAN_ID_EXT) ? register_ext(&tables[can], id, mask, handler) :
+                               register_std(&tables[can], id, mask, handler);
+}
+
+/* Handler of an extended ID, NULL if none matches */
+static rx_callback_t lookup_ext(const dispatch_table_t* table, uint32_t id)
+{
+    const dispatch_entry_t* ext_entries = table->ext_entries;
+
+    for(uint32_t g = 0; g < table->ext_group_count; g++)
+    {
+        uint32_t key = id & table->ext_groups[g].mask;
+        uint32_t low = table->ext_groups[g].first;
+        uint32_t high = low + table->ext_groups[g].count;
+
+        /* Binary search of the run, sorted by ID */
+        while( low < high )
+        {
+            uint32_t mid = low + ((high - low) / 2u);
+
+            if( ext_entries[mid].ID < key )
+            {
+                low = mid + 1u;
+            }
+            else if( ext_entries[mid].ID > key )
+            {
+                high = mid;
+            }
+            else
+            {
+                return ext_entries[mid].handler;
+            }
+        }
+    }
+
+    return 0;
+}
+
+status_t dispatch_frame(FlexCAN_instance_t can, const frame_t* frame)
+{
+    const dispatch_table_t* table = &tables[can];
+    rx_callback_t handler = 0;
+
+    if( frame->ID & CAN_ID_EXT )
+    {
+        handler = lookup_ext(table, frame->ID & CAN_ID_MASK);
+    }
+    else
+    {
+        uint8_t index = table->std_table[frame->ID & (STD_ID_COUNT - 1u)];
+        handler = (index != 0u) ? table->std_entries[index - 1u].handler : 0;
+    }
+
+    if( handler == 0 )
+    {
+        return Failure;
+    }
+
+    handler(frame);
+
+    return Success;
+}
+
+uint32_t dispatch_received(FlexCAN_instance_t can)
+{
+    uint32_t total = 0;
+    frame_t* frames;
+    uint32_t count;
+
+    /* Two spans when the frames wrap around the end of the ring, bounded to one ring's worth so
+     * a flood of frames doesn't hold the caller forever */
+    while( (total < RX_RING_SIZE) && ((count = lend_frames(can, &frames)) != 0u) )
+    {
+        for(uint32_t i = 0; i < count; i++)
+        {
+            (void)dispatch_frame(can, &frames[i]);
+        }
+
+        release_frames(can, count);
+        total += count;
+    }
+
+    return total;
+}
@@ -0,0 +1,239 @@
+/**
+ * Source file
+ */
+
+#include <FlexCAN/include/CAN_errors.h>
+#include <FlexCAN/include/CAN_internal.h>
+
+
+/* Error and status flags cleared by writing them back (w1c) */
+#define ESR1_ERRINT         (1u << 1)
+#define ESR1_BOFFINT        (1u << 2)
+#define ESR1_RWRNINT        (1u << 16)
+#define ESR1_TWRNINT        (1u << 17)
+#define ESR1_BOFFDONEINT    (1u << 19)
+
+/* Error bits of ESR1, cleared when the register is read */
+#define ESR1_STFERR         (1u << 10)
+#define ESR1_FRMERR         (1u << 11)
+#define ESR1_CRCERR         (1u << 12)
+#define ESR1_ACKERR         (1u << 13)
+#define ESR1_BIT0ERR        (1u << 14)
+#define ESR1_BIT1ERR        (1u << 15)
+
+/* Fault confinement field of ESR1 */
+#define ESR1_FLTCONF_SHIFT  (4u)
+
+/* Priority for the error interrupts, below the message buffer ones */
+#define CAN_ERROR_IRQ_PRIORITY (0x80u)
+
+/* Error monitoring of a FlexCAN instance */
+typedef struct {
+    /* Error counters, only written by the interrupts but for the state read back by error_poll() */
+    volatile error_stats_t stats;
+
+    error_policy_t policy;
+
+    /* Manual recovery bookkeeping, only used by error_poll(). The backoff only starts over once
+     * the node stayed error active since active_since, the poll that last saw it change state */
+    uint32_t backoff_ms;
+    uint32_t bus_off_since;
+    uint8_t bus_off_seen;
+    uint32_t active_since;
+    uint32_t active_transitions;
+
+    /* Set by the interrupt when a bus-off happens, cleared by error_poll() when it starts the backoff */
+    volatile uint8_t bus_off_pending;
+} error_state_t;
+
+static error_state_t errors[FlexCAN_instances];
+
+/* Registers and interrupts of each instance */
+static CAN0_Type* const bases[FlexCAN_instances] = { CAN0, CAN1 };
+static const IRQn_Type ored_irqs[FlexCAN_instances] = { CAN0_ORed_IRQn, CAN1_ORed_IRQn };
+static const IRQn_Type error_irqs[FlexCAN_instances] = { CAN0_Error_IRQn, CAN1_Error_IRQn };
+
+/* ESR1 error bits in error_type_t order */
+static const uint32_t error_bits[Error_types] = {
+        ESR1_BIT0ERR, ESR1_BIT1ERR, ESR1_STFERR, ESR1_FRMERR, ESR1_CRCERR, ESR1_ACKERR
+};
+
+/* Refresh the error counters and fault confinement state from a read of ESR1 */
+static void update_state(FlexCAN_instance_t can, uint32_t esr1)
+{
+    volatile error_stats_t* stats = &errors[can].stats;
+
+    /* Any read of ESR1 clears its error bits, so each read accounts them */
+    for(uint32_t i = 0; i < Error_types; i++)
+    {
+        stats->errors[i] += (esr1 & error_bits[i]) ? 1u : 0u;
+    }
+
+    uint32_t fltconf = (esr1 >> ESR1_FLTCONF_SHIFT) & 0x3u;
+    fault_state_t state = (fltconf == 0u) ? Error_active : ((fltconf == 1u) ? Error_passive : Bus_off);
+
+    if( state != stats->state )
+    {
+        stats->transitions++;
+        stats->state = state;
+    }
+
+    stats->tx_errors = bases[can]->CAN0_ECR_b.TXERRCNT;
+    stats->rx_errors = bases[can]->CAN0_ECR_b.RXERRCNT;
+}
+
+status_t errors_init(FlexCAN_instance_t can, const error_policy_t* policy)
+{
+    error_state_t* st = &errors[can];
+    CAN0_Type* base = bases[can];
+
+    st->policy = *policy;
+    st->backoff_ms = policy->backoff_ms;
+
+    /* The manual policy holds the node in bus-off until error_poll() releases it */
+    base->CAN0_CTRL1_b.BOFFREC = (policy->recovery == Recovery_manual) ? 1u : 0u;
+
+    /* Acknowledge stale flags (w1c register) and take the initial state */
+    uint32_t esr1 = base->CAN0_ESR1;
+    base->CAN0_ESR1 = ESR1_ERRINT | ESR1_BOFFINT | ESR1_RWRNINT | ESR1_TWRNINT | ESR1_BOFFDONEINT;
+    update_state(can, esr1);
+
+    /* Interrupt on bus errors, on bus-off and on bus-off recovery */
+    base->CAN0_CTRL1_b.ERRMSK = 1;
+    base->CAN0_CTRL1_b.BOFFMSK = 1;
+    base->CAN0_CTRL2_b.BOFFDONEMSK = 1;
+
+    enable_IRQ(ored_irqs[can], CAN_ERROR_IRQ_PRIORITY);
+    enable_IRQ(error_irqs[can], CAN_ERROR_IRQ_PRIORITY);
+
+    return Success;
+}
+
+void error_poll(FlexCAN_instance_t can, uint32_t now_ms)
+{
+    error_state_t* st = &errors[can];
+
+    /* Refresh the state, a return to error active raises no interrupt */
+    if( st->stats.state != Bus_off )
+    {
+        CRITICAL_ENTER();
+        update_state(can, bases[can]->CAN0_ESR1);
+        CRITICAL_EXIT();
+    }
+
+    if( st->policy.recovery != Recovery_manual )
+    {
+        return;
+    }
+
+    /* Start the backoff at the first poll after the bus-off */
+    if( st->bus_off_pending )
+    {
+        st->bus_off_pending = 0;
+        st->bus_off_since = now_ms;
+        st->bus_off_seen = 1;
+    }
+
+    /* The recovery clears the error counters, so error active alone says nothing. Only a node
+     * that stayed error active for backoff_max_ms starts over with the initial backoff. A state
+     * change the interrupts saw between two polls restarts the count as well */
+    uint32_t transitions = st->stats.transitions;
+
+    if( (st->stats.state != Error_active) || (transitions != st->active_transitions) )
+    {
+        st->active_transitions = transitions;
+        st->active_since = now_ms;
+    }
+    else if( (now_ms - st->active_since) >= st->policy.backoff_max_ms )
+    {
+        st->backoff_ms = st->policy.backoff_ms;
+    }
+
+    /* Backoff elapsed, let the module run the bus-off recovery sequence */
+    if( st->bus_off_seen && ((now_ms - st->bus_off_since) >= st->backoff_ms) )
+    {
+        st->bus_off_seen = 0;
+        bases[can]->CAN0_CTRL1_b.BOFFREC = 0;
+
+        /* Next bus-off before reaching error active waits twice as long */
+        st->backoff_ms = ((st->backoff_ms * 2u) < st->policy.backoff_max_ms) ? (st->backoff_ms * 2u) : st->policy.backoff_max_ms;
+    }
+}
+
+void get_error_stats(FlexCAN_instance_t can, error_stats_t* stats)
+{
+    volatile error_stats_t* counters = &errors[can].stats;
+
+    stats->state       = counters->state;
+    stats->tx_errors   = counters->tx_errors;
+    stats->rx_errors   = counters->rx_errors;
+    stats->transitions = counters->transitions;
+    stats->bus_offs    = counters->bus_offs;
+    stats->recoveries  = counters->recoveries;
+
+    for(uint32_t i = 0; i < Error_types; i++)
+    {
+        stats->errors[i] = counters->errors[i];
+    }
+}
+
+/* Serve the bus-off, bus-off done and warning flags of an instance */
+static void ored_IRQ(FlexCAN_instance_t can)
+{
+    error_state_t* st = &errors[can];
+    CAN0_Type* base = bases[can];
+    uint32_t esr1 = base->CAN0_ESR1;
+
+    /* Acknowledge only the flags that were set (w1c register) */
+    base->CAN0_ESR1 = esr1 & (ESR1_BOFFINT | ESR1_RWRNINT | ESR1_TWRNINT | ESR1_BOFFDONEINT);
+
+    if( esr1 & ESR1_BOFFINT )
+    {
+        st->stats.bus_offs++;
+        st->bus_off_pending = 1;
+    }
+
+    if( esr1 & ESR1_BOFFDONEINT )
+    {
+        st->stats.recoveries++;
+
+        /* Hold the node again on the next bus-off */
+        if( st->policy.recovery == Recovery_manual )
+        {
+            base->CAN0_CTRL1_b.BOFFREC = 1;
+        }
+    }
+
+    update_state(can, esr1);
+}
+
+/* Serve the error flag of an instance */
+static void error_IRQ(FlexCAN_instance_t can)
+{
+    /* Reading ESR1 clears its error bits */
+    uint32_t esr1 = bases[can]->CAN0_ESR1;
+
+    bases[can]->CAN0_ESR1 = ESR1_ERRINT;
+
+    update_state(can, esr1);
+}
+
+void CAN0_ORed_IRQHandler(void)
+{
+    ored_IRQ(FlexCAN_0);
+}
+
+void CAN0_Error_IRQHandler(void)
+{
+    error_IRQ(FlexCAN_0);
+}
+
+void CAN1_ORed_IRQHandler(void)
+{
+    ored_IRQ(FlexCAN_1);
+}
+
+void CAN1_Error_IRQHandler(void)
+{
+    error_IRQ(FlexCAN_1);
+}
@@ -0,0 +1,331 @@
+/**
+ * Source file
+ */
+
+#include <FlexCAN/include/CAN_filter_compiler.h>
+
+/* Active bits up to which compile_filters() maps the IDs the table accepts, every standard list */
+#define FILTER_MAP_BITS     (11u)
+#define FILTER_MAP_WORDS    ((1u << FILTER_MAP_BITS) / 32u)
+
+
+/* Number of IDs a filter accepts, 2 to the power of the don't care bits */
+static uint32_t filter_size(const filter_t* filter)
+{
+    uint32_t width = filter->extended ? 29u : 11u;
+    uint32_t cared = (uint32_t)__builtin_popcount(filter->mask);
+
+    return 1u << (width - cared);
+}
+
+/* Merge of two filters: only the bits both care about and agree on keep being cared */
+static filter_t filter_merge(const filter_t* a, const filter_t* b)
+{
+    filter_t merged = *a;
+
+    merged.mask = a->mask & b->mask & ~(a->ID ^ b->ID);
+    merged.ID   = a->ID & merged.mask;
+
+    return merged;
+}
+
+/* Check if every ID accepted by inner is accepted by outer */
+static uint8_t filter_covers(const filter_t* outer, const filter_t* inner)
+{
+    return ((inner->mask & outer->mask) == outer->mask) &&
+           ((inner->ID & outer->mask) == outer->ID);
+}
+
+/* Replace filters[i] with merged, dropping every other filter it covers, returns the new count */
+static uint32_t filter_replace(filter_t* filters, uint32_t count, uint32_t i, const filter_t* merged)
+{
+    filters[i] = *merged;
+
+    for(uint32_t j = 0; j < count; j++)
+    {
+        if( (j != i) && filter_covers(&filters[i], &filters[j]) )
+        {
+            count--;
+            filters[j] = filters[count];
+
+            /* The filter that was kept may have been moved into the removed slot */
+            if( i == count )
+            {
+                i = j;
+            }
+            j--;
+        }
+    }
+
+    return count;
+}
+
+/* Shell sort of the accept list followed by removal of repeated IDs, returns the new count */
+static uint32_t sort_unique(uint32_t* ids, uint32_t count)
+{
+    for(uint32_t gap = count / 2u; gap > 0; gap /= 2u)
+    {
+        for(uint32_t i = gap; i < count; i++)
+        {
+            uint32_t id = ids[i];
+            uint32_t j = i;
+
+            for(; (j >= gap) && (ids[j - gap] > id); j -= gap)
+            {
+                ids[j] = ids[j - gap];
+            }
+            ids[j] = id;
+        }
+    }
+
+    uint32_t unique = 0;
+
+    for(uint32_t i = 0; i < count; i++)
+    {
+        if( (unique == 0) || (ids[unique - 1u] != ids[i]) )
+        {
+            ids[unique++] = ids[i];
+        }
+    }
+
+    return unique;
+}
+
+/* Gather the bits of value selected by active into the low bits, keeping their order */
+static uint32_t compress(uint32_t value, uint32_t active)
+{
+    uint32_t packed = 0;
+
+    for(uint32_t bit = 1; active; active &= active - 1u, bit <<= 1)
+    {
+        if( value & active & (0u - active) )
+        {
+            packed |= bit;
+        }
+    }
+
+    return packed;
+}
+
+/* Count the IDs of a filter missing from the map of accepted IDs, or mark them accepted when add
+ * is set. The filter is compressed to the active bits, its don't care bits are in free. Counting
+ * stops once it exceeds limit */
+static uint32_t map_walk(uint32_t* map, uint32_t id, uint32_t free, uint32_t limit, uint8_t add)
+{
+    uint32_t missing = 0;
+    uint32_t sub = 0;
+
+    /* Every combination of the don't care bits */
+    do
+    {
+        uint32_t n = id | sub;
+        uint32_t bit = 1u << (n & 31u);
+
+        missing += (map[n >> 5] & bit) ? 0u : 1u;
+
+        if( add )
+        {
+            map[n >> 5] |= bit;
+        }
+
+        sub = (sub - free) & free;
+    } while( (sub != 0) && (missing <= limit) );
+
+    return missing;
+}
+
+/* Upper bound of the IDs of the table a filter accepts, overlaps between filters counted twice */
+static uint64_t filters_overlap(const filter_t* filters, uint32_t count, const filter_t* filter)
+{
+    uint32_t width = filter->extended ? 29u : 11u;
+    uint64_t total = 0;
+
+    for(uint32_t k = 0; k < count; k++)
+    {
+        /* Two filters intersect unless a bit both care about differs */
+        if( ((filters[k].ID ^ filter->ID) & filters[k].mask & filter->mask) == 0u )
+        {
+            total += 1ull << (width - (uint32_t)__builtin_popcount(filters[k].mask | filter->mask));
+        }
+    }
+
+    return total;
+}
+
+uint32_t compile_filters(uint32_t* ids, uint32_t count, uint8_t extended, uint32_t budget,
+                         uint32_t tolerated_fp, filter_t* filters, residual_filter_t* residual)
+{
+    uint32_t width_mask = extended ? 0x1FFFFFFFu : 0x7FFu;
+
+    count = sort_unique(ids, count);
+
+    if( residual != 0 )
+    {
+        residual->accept = ids;
+        residual->count = count;
+    }
+
+    /* Bits where the listed IDs differ, merges never stop caring about the others. When there
+     * are few enough of them, a map of the IDs the table accepts gives the exact merge costs */
+    uint32_t active = 0;
+    uint32_t map[FILTER_MAP_WORDS] = { 0 };
+
+    for(uint32_t i = 0; i < count; i++)
+    {
+        active |= (ids[i] ^ ids[0]) & width_mask;
+    }
+
+    uint8_t mapped = (__builtin_popcount(active) <= FILTER_MAP_BITS);
+
+    /* One all-bits care filter per accepted ID */
+    for(uint32_t i = 0; i < count; i++)
+    {
+        filters[i].ID = ids[i] & width_mask;
+        filters[i].mask = width_mask;
+        filters[i].extended = extended;
+
+        if( mapped )
+        {
+            (void)map_walk(map, compress(ids[i], active), 0, 0, 1);
+        }
+    }
+
+    uint32_t used = count;
+
+    /* Lossless pass: two filters with the same mask differing in one cared bit become one */
+    for(uint8_t merged_any = 1; merged_any; )
+    {
+        merged_any = 0;
+
+        for(uint32_t i = 0; i < used; i++)
+        {
+            for(uint32_t j = i + 1u; j < used; j++)
+            {
+                uint32_t diff = filters[i].ID ^ filters[j].ID;
+
+                if( (filters[i].mask == filters[j].mask) && (__builtin_popcount(diff) == 1) )
+                {
+                    filter_t merged = filter_merge(&filters[i], &filters[j]);
+                    used = filter_replace(filters, used, i, &merged);
+                    merged_any = 1;
+                    break;
+                }
+            }
+        }
+    }
+
+    /* IDs the table accepts besides the listed ones, exact with the map */
+    uint64_t false_positives = 0;
+
+    /* Lossy pass: above budget merge the pair that adds the fewest IDs to what the table already
+     * accepts, at or under budget only go on while within the tolerated false positives */
+    while( used > 1u )
+    {
+        uint32_t best_i = 0, best_j = 0;
+        uint64_t best_cost = UINT64_MAX;
+
+        for(uint32_t i = 0; (i < used) && (best_cost != 0u); i++)
+        {
+            for(uint32_t j = i + 1u; (j < used) && (best_cost != 0u); j++)
+            {
+                filter_t merged = filter_merge(&filters[i], &filters[j]);
+                uint64_t size = filter_size(&merged);
+                uint64_t cost;
+
+                if( mapped )
+                {
+                    uint32_t limit = (best_cost < size) ? (uint32_t)best_cost : (uint32_t)size;
+                    cost = map_walk(map, compress(merged.ID, active), compress(~merged.mask, active), limit, 0);
+                }
+                else
+                {
+                    uint64_t already = filters_overlap(filters, used, &merged);
+                    cost = (already < size) ? (size - already) : 0u;
+                }
+
+                if( cost < best_cost )
+                {
+                    best_cost = cost;
+                    best_i = i;
+                    best_j = j;
+                }
+            }
+        }
+
+        if( used <= budget )
+        {
+            uint64_t total = (mapped ? false_positives : filters_false_positives(filters, used, count)) + best_cost;
+
+            if( total * 1000u > (uint64_t)tolerated_fp * (count + total) )
+            {
+                break;
+            }
+        }
+
+        filter_t merged = filter_merge(&filters[best_i], &filters[best_j]);
+
+        if( mapped )
+        {
+            false_positives += map_walk(map, compress(merged.ID, active), compress(~merged.mask, active), UINT32_MAX, 1);
+        }
+
+        used = filter_replace(filters, used, best_i, &merged);
+    }
+
+    return used;
+}
+
+uint32_t filters_false_positives(const filter_t* filters, uint32_t count, uint32_t accepted)
+{
+    uint64_t total = 0;
+
+    if( (count != 0) && !filters[0].extended )
+    {
+        /* The standard ID space is small enough to count the union of the filters exactly */
+        for(uint32_t id = 0; id <= 0x7FFu; id++)
+        {
+            for(uint32_t i = 0; i < count; i++)
+            {
+                if( (id & filters[i].mask) == filters[i].ID )
+                {
+                    total++;
+                    break;
+                }
+            }
+        }
+    }
+    else
+    {
+        /* Extended filters of up to 2^29 IDs each, overlapping ones are counted twice */
+        for(uint32_t i = 0; i < count; i++)
+        {
+            total += filter_size(&filters[i]);
+        }
+    }
+
+    total = (total > accepted) ? (total - accepted) : 0u;
+
+    return (total > UINT32_MAX) ? UINT32_MAX : (uint32_t)total;
+}
+
+status_t residual_accepts(const residual_filter_t* residual, uint32_t id)
+{
+    uint32_t low = 0;
+    uint32_t high = residual->count;
+
+    while( low < high )
+    {
+        uint32_t middle = low + ((high - low) / 2u);
+
+        if( residual->accept[middle] < id )
+        {
+            low = middle + 1u;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return ((low < residual->count) && (residual->accept[low] == id)) ? Success : Failure;
+}
@@ -0,0 +1,139 @@
+/**
+ * Source file
+ */
+
+#include <FlexCAN/include/CAN_gateway.h>
+#include <FlexCAN/include/CAN_dispatch.h>
+
+
+/* Routing table, the IDs and masks are stored with the CAN_ID_EXT flag always cared so
+ * standard and extended IDs never match each other */
+static route_t routes[GATEWAY_ROUTES];
+static uint32_t route_count = 0;
+
+/* Route counters, and the reception time of the last frame each route forwarded */
+static route_stats_t route_stats[GATEWAY_ROUTES];
+static uint64_t last_forward[GATEWAY_ROUTES];
+
+status_t gateway_init(const route_t* table, uint32_t count)
+{
+    if( count > GATEWAY_ROUTES )
+    {
+        return BufferFull;
+    }
+
+    for(uint32_t r = 0; r < count; r++)
+    {
+        if( table[r].source == table[r].destination )
+        {
+            return Failure;
+        }
+    }
+
+    for(uint32_t r = 0; r < count; r++)
+    {
+        routes[r] = table[r];
+        routes[r].mask = (table[r].mask & CAN_ID_MASK) | CAN_ID_EXT;
+        routes[r].ID = table[r].ID & routes[r].mask;
+
+        route_stats[r] = (route_stats_t){ 0 };
+        last_forward[r] = 0;
+    }
+
+    route_count = count;
+
+    return Success;
+}
+
+status_t gateway_forward(FlexCAN_instance_t source, frame_t* frame, uint64_t now)
+{
+    status_t status = Failure;
+    uint32_t id = frame->ID;
+
+    for(uint32_t r = 0; r < route_count; r++)
+    {
+        const route_t* route = &routes[r];
+        route_stats_t* stats = &route_stats[r];
+
+        if( (route->source != source) || ((id & route->mask) != route->ID) )
+        {
+            continue;
+        }
+
+        status = Success;
+
+        /* Too soon after the previous frame of the route */
+        if( route->min_interval && stats->forwarded &&
+            ((frame->timestamp - last_forward[r]) < route->min_interval) )
+        {
+            stats->rate_limited++;
+            continue;
+        }
+
+        /* The frame is rewritten where it lies, the queue copies it out */
+        frame->ID = (route->rewrite_ID == GATEWAY_KEEP_ID) ? id : route->rewrite_ID;
+
+        if( transmit_frame(route->destination, frame) != Success )
+        {
+            stats->dropped++;
+            continue;
+        }
+
+        uint64_t latency = now - frame->timestamp;
+        uint32_t ticks = (latency > 0xFFFFFFFFu) ? 0xFFFFFFFFu : (uint32_t)latency;
+
+        stats->forwarded++;
+        stats->total_latency += ticks;
+
+        if( ticks > stats->worst_latency )
+        {
+            stats->worst_latency = ticks;
+        }
+
+        last_forward[r] = frame->timestamp;
+    }
+
+    frame->ID = id;
+
+    return status;
+}
+
+uint32_t gateway_poll(FlexCAN_instance_t source)
+{
+    uint32_t total = 0;
+    frame_t* frames;
+    uint32_t count;
+
+    /* Two spans when the frames wrap around the end of the ring, bounded to one ring's worth so
+     * a flood of frames doesn't hold the caller forever */
+    while( (total < RX_RING_SIZE) && ((count = lend_frames(source, &frames)) != 0u) )
+    {
+        /* One timer sample per span, every frame in it was received before */
+        uint64_t now = FlexCAN_timer_now(source);
+
+        for(uint32_t i = 0; i < count; i++)
+        {
+            if( gateway_forward(source, &frames[i], now) != Success )
+            {
+                (void)dispatch_frame(source, &frames[i]);
+            }
+        }
+
+        release_frames(source, count);
+        total += count;
+    }
+
+    return total;
+}
+
+status_t get_route_stats(uint32_t route, route_stats_t* stats)
+{
+    if( route >= route_count )
+    {
+        return Failure;
+    }
+
+    *stats = route_stats[route];
+
+    return Success;
+}
@@ -0,0 +1,589 @@
+/**
+ * Source file
+ */
+
+#include <FlexCAN/include/CAN_isotp.h>
+#include <FlexCAN/include/CAN_dispatch.h>
+
+
+/* Protocol control information, the upper nibble of the first byte */
+#define PCI_SINGLE          (0x0u)
+#define PCI_FIRST           (0x1u)
+#define PCI_CONSECUTIVE     (0x2u)
+#define PCI_FLOW_CONTROL    (0x3u)
+
+/* Flow status of a flow control frame */
+#define FS_CONTINUE         (0x0u)
+#define FS_WAIT             (0x1u)
+#define FS_OVERFLOW         (0x2u)
+
+/* Bytes of a Classical CAN frame, and the longest message with a 12-bit first frame length */
+#define FRAME_BYTES         (8u)
+#define FF_DL_12BIT_MAX     (4095u)
+
+/* Free running timer ticks, one per nominal bit */
+#define TICKS_PER_MS        (CAN_BITRATE / 1000u)
+
+/**
+ *  Stages of a message being sent
+ */
+typedef enum {
+    Send_first = 0,        /* Single or first frame not queued yet */
+    Send_wait_flow,        /* Waiting for the flow control of the next block */
+    Send_consecutive       /* Queuing the consecutive frames of a block */
+} send_stage_t;
+
+/**
+ *  Session state, the send and receive sides run independently
+ */
+typedef struct {
+    isotp_config_t config;
+    uint8_t open;
+
+    isotp_result_t send_result;
+    send_stage_t send_stage;
+    const uint8_t* send_data;
+    uint32_t send_length;
+    uint32_t send_offset;
+    uint8_t send_sn;
+    uint8_t send_block_left;     /* Consecutive frames left in the block, 0 for no limit */
+    uint8_t send_waits;
+    uint32_t send_st_min;        /* Separation time granted by the peer, in timer ticks */
+    uint64_t send_next;          /* Time the next consecutive frame is due */
+    uint64_t send_deadline;      /* Time the flow control wait gives up */
+
+    isotp_result_t receive_result;
+    uint8_t* receive_buffer;
+    uint32_t receive_size;
+    uint32_t receive_length;
+    uint32_t receive_offset;
+    uint8_t receive_sn;
+    uint8_t receive_block;       /* Consecutive frames received in the block */
+    uint8_t flow_pending;        /* Flow status to send plus one, 0 for none */
+    uint64_t receive_deadline;   /* Time the wait for the next consecutive frame gives up */
+} isotp_session_t;
+
+static isotp_session_t sessions[ISOTP_SESSIONS];
+
+/* Byte of a frame, the FlexCAN holds the first byte in the upper bits of each word */
+static uint8_t get_byte(const frame_t* frame, uint32_t i)
+{
+    return (uint8_t)(frame->payload[i >> 2] >> (24u - ((i & 3u) * 8u)));
+}
+
+static void set_byte(frame_t* frame, uint32_t i, uint8_t value)
+{
+    uint32_t shift = 24u - ((i & 3u) * 8u);
+
+    frame->payload[i >> 2] = (frame->payload[i >> 2] & ~(0xFFu << shift)) | ((uint32_t)value << shift);
+}
+
+/* Frame of the session's ID with every byte padded */
+static void blank_frame(const isotp_session_t* s, frame_t* frame)
+{
+    frame->ID = s->config.tx_ID;
+
+    for(uint8_t i = 0; i < MAX_MTU_WORDS; i++)
+    {
+        frame->payload[i] = ISOTP_PADDING * 0x01010101u;
+    }
+}
+
+/* Separation time of a flow control in timer ticks, reserved values mean the longest one */
+static uint32_t st_min_ticks(uint8_t st_min)
+{
+    if( st_min <= 0x7Fu )
+    {
+        return st_min * TICKS_PER_MS;
+    }
+
+    if( (st_min >= 0xF1u) && (st_min <= 0xF9u) )
+    {
+        return (uint32_t)(((uint64_t)(st_min - 0xF0u) * CAN_BITRATE) / 10000u);
+    }
+
+    return 0x7Fu * TICKS_PER_MS;
+}
+
+status_t isotp_open(const isotp_config_t* config, uint8_t* session)
+{
+    if( (config->st_min > 0x7Fu) && ((config->st_min < 0xF1u) || (config->st_min > 0xF9u)) )
+    {
+        return Failure;
+    }
+
+    for(uint8_t i = 0; i < ISOTP_SESSIONS; i++)
+    {
+        if( !sessions[i].open )
+        {
+            sessions[i] = (isotp_session_t){ .config = *config, .open = 1 };
+            *session = i;
+
+            return Success;
+        }
+    }
+
+    return BufferFull;
+}
+
+status_t isotp_send(uint8_t session, const uint8_t* data, uint32_t length)
+{
+    if( (session >= ISOTP_SESSIONS) || !sessions[session].open || (length == 0u) )
+    {
+        return Failure;
+    }
+
+    isotp_session_t* s = &sessions[session];
+
+    if( s->send_result == Isotp_busy )
+    {
+        return BufferFull;
+    }
+
+    s->send_data = data;
+    s->send_length = length;
+    s->send_offset = 0;
+    s->send_stage = Send_first;
+    s->send_result = Isotp_busy;
+
+    return Success;
+}
+
+status_t isotp_receive(uint8_t session, uint8_t* buffer, uint32_t size)
+{
+    if( (session >= ISOTP_SESSIONS) || !sessions[session].open )
+    {
+        return Failure;
+    }
+
+    isotp_session_t* s = &sessions[session];
+
+    if( s->receive_result == Isotp_busy )
+    {
+        return BufferFull;
+    }
+
+    s->receive_buffer = buffer;
+    s->receive_size = size;
+    s->receive_result = Isotp_idle;
+
+    return Success;
+}
+
+isotp_result_t isotp_send_result(uint8_t session)
+{
+    if( session >= ISOTP_SESSIONS )
+    {
+        return Isotp_idle;
+    }
+
+    isotp_result_t result = sessions[session].send_result;
+
+    if( result != Isotp_busy )
+    {
+        sessions[session].send_result = Isotp_idle;
+    }
+
+    return result;
+}
+
+isotp_result_t isotp_receive_result(uint8_t session, uint32_t* length)
+{
+    if( session >= ISOTP_SESSIONS )
+    {
+        *length = 0;
+        return Isotp_idle;
+    }
+
+    isotp_session_t* s = &sessions[session];
+    isotp_result_t result = s->receive_result;
+
+    *length = s->receive_offset;
+
+    if( result != Isotp_busy )
+    {
+        s->receive_result = Isotp_idle;
+
+        /* A finished message gives its buffer back to the caller */
+        if( result != Isotp_idle )
+        {
+            s->receive_buffer = 0;
+        }
+    }
+
+    return result;
+}
+
+/* Queue the pending flow control, kept pending while the transmission queue is full */
+static void send_flow_control(isotp_session_t* s)
+{
+    frame_t frame;
+
+    if( s->flow_pending == 0u )
+    {
+        return;
+    }
+
+    blank_frame(s, &frame);
+    set_byte(&frame, 0, (uint8_t)((PCI_FLOW_CONTROL << 4) | (s->flow_pending - 1u)));
+    set_byte(&frame, 1, s->config.block_size);
+    set_byte(&frame, 2, s->config.st_min);
+
+    if( transmit_frame(s->config.can, &frame) == Success )
+    {
+        s->flow_pending = 0;
+    }
+}
+
+/* Copy message bytes from a frame into the receive buffer, returning the number copied */
+static uint32_t take_bytes(isotp_session_t* s, const frame_t* frame, uint32_t first)
+{
+    uint32_t count = FRAME_BYTES - first;
+    uint32_t left = s->receive_length - s->receive_offset;
+
+    count = (count < left) ? count : left;
+
+    for(uint32_t i = 0; i < count; i++)
+    {
+        s->receive_buffer[s->receive_offset + i] = get_byte(frame, first + i);
+    }
+
+    s->receive_offset += count;
+
+    return count;
+}
+
+static void receive_first(isotp_session_t* s, const frame_t* frame)
+{
+    uint32_t length = ((uint32_t)(get_byte(frame, 0) & 0xFu) << 8) | get_byte(frame, 1);
+    uint32_t first = 2;
+
+    /* Escape sequence, the length follows on 32 bits */
+    if( length == 0u )
+    {
+        length = ((uint32_t)get_byte(frame, 2) << 24) | ((uint32_t)get_byte(frame, 3) << 16) |
+                 ((uint32_t)get_byte(frame, 4) << 8) | get_byte(frame, 5);
+        first = 6;
+
+        /* ISO 15765-2 ignores an escaped length that fits the 12-bit field */
+        if( length <= FF_DL_12BIT_MAX )
+        {
+            return;
+        }
+    }
+    /* ISO 15765-2 ignores a first frame for a message that fits a single frame */
+    else if( length < FRAME_BYTES )
+    {
+        return;
+    }
+
+    /* A new message over one in progress replaces it, a finished one must be read first */
+    uint8_t ready = (s->receive_result == Isotp_idle) || (s->receive_result == Isotp_busy);
+
+    if( (s->receive_buffer == 0) || !ready || (length > s->receive_size) )
+    {
+        if( s->receive_result == Isotp_busy )
+        {
+            s->receive_result = Isotp_overflow;
+        }
+
+        s->flow_pending = FS_OVERFLOW + 1u;
+        send_flow_control(s);
+        return;
+    }
+
+    s->receive_length = length;
+    s->receive_offset = 0;
+    s->receive_sn = 1;
+    s->receive_block = 0;
+    s->receive_result = Isotp_busy;
+    s->receive_deadline = frame->timestamp + (ISOTP_TIMEOUT_MS * TICKS_PER_MS);
+
+    (void)take_bytes(s, frame, first);
+
+    s->flow_pending = FS_CONTINUE + 1u;
+    send_flow_control(s);
+}
+
+static void receive_consecutive(isotp_session_t* s, const frame_t* frame)
+{
+    if( s->receive_result != Isotp_busy )
+    {
+        return;
+    }
+
+    if( (get_byte(frame, 0) & 0xFu) != s->receive_sn )
+    {
+        s->receive_result = Isotp_sequence;
+        return;
+    }
+
+    s->receive_sn = (s->receive_sn + 1u) & 0xFu;
+    s->receive_deadline = frame->timestamp + (ISOTP_TIMEOUT_MS * TICKS_PER_MS);
+
+    (void)take_bytes(s, frame, 1);
+
+    if( s->receive_offset == s->receive_length )
+    {
+        s->receive_result = Isotp_done;
+        return;
+    }
+
+    /* End of the block, let the peer go on */
+    if( (s->config.block_size != 0u) && (++s->receive_block == s->config.block_size) )
+    {
+        s->receive_block = 0;
+        s->flow_pending = FS_CONTINUE + 1u;
+        send_flow_control(s);
+    }
+}
+
+static void receive_flow_control(isotp_session_t* s, const frame_t* frame)
+{
+    if( (s->send_result != Isotp_busy) || (s->send_stage != Send_wait_flow) )
+    {
+        return;
+    }
+
+    uint8_t status = get_byte(frame, 0) & 0xFu;
+
+    if( status == FS_CONTINUE )
+    {
+        s->send_block_left = get_byte(frame, 1);
+        s->send_st_min = st_min_ticks(get_byte(frame, 2));
+        s->send_waits = 0;
+        s->send_next = frame->timestamp;
+        s->send_stage = Send_consecutive;
+    }
+    else if( status == FS_WAIT )
+    {
+        s->send_deadline = frame->timestamp + (ISOTP_TIMEOUT_MS * TICKS_PER_MS);
+
+        if( ++s->send_waits > ISOTP_WFT_MAX )
+        {
+            s->send_result = Isotp_aborted;
+        }
+    }
+    else
+    {
+        s->send_result = Isotp_overflow;
+    }
+}
+
+status_t isotp_frame(FlexCAN_instance_t can, const frame_t* frame)
+{
+    status_t status = Failure;
+
+    for(uint8_t i = 0; i < ISOTP_SESSIONS; i++)
+    {
+        isotp_session_t* s = &sessions[i];
+
+        if( !s->open || (s->config.can != can) || (s->config.rx_ID != frame->ID) )
+        {
+            continue;
+        }
+
+        status = Success;
+
+        uint8_t pci = get_byte(frame, 0) >> 4;
+
+        if( pci == PCI_SINGLE )
+        {
+            uint32_t length = get_byte(frame, 0) & 0xFu;
+            uint8_t ready = (s->receive_result == Isotp_idle) || (s->receive_result == Isotp_busy);
+
+            /* Ignored without a buffer or while a finished message waits to be read, like a first
+             * frame it replaces a message in progress */
+            if( (s->receive_buffer == 0) || !ready || (length == 0u) || (length >= FRAME_BYTES) )
+            {
+                continue;
+            }
+
+            /* No flow control to refuse it with, the receiver learns of it from the result */
+            if( length > s->receive_size )
+            {
+                s->receive_offset = 0;
+                s->receive_result = Isotp_overflow;
+                continue;
+            }
+
+            s->receive_length = length;
+            s->receive_offset = 0;
+            (void)take_bytes(s, frame, 1);
+            s->receive_result = Isotp_done;
+        }
+        else if( pci == PCI_FIRST )
+        {
+            receive_first(s, frame);
+        }
+        else if( pci == PCI_CONSECUTIVE )
+        {
+            receive_consecutive(s, frame);
+        }
+        else if( pci == PCI_FLOW_CONTROL )
+        {
+            receive_flow_control(s, frame);
+        }
+    }
+
+    return status;
+}
+
+/* Queue the segments of the message being sent that are due at time now */
+static void service_send(isotp_session_t* s, uint64_t now)
+{
+    frame_t frame;
+
+    if( s->send_result != Isotp_busy )
+    {
+        return;
+    }
+
+    if( s->send_stage == Send_first )
+    {
+        uint32_t first;
+
+        blank_frame(s, &frame);
+
+        if( s->send_length < FRAME_BYTES )
+        {
+            set_byte(&frame, 0, (uint8_t)s->send_length);
+            first = 1;
+        }
+        else if( s->send_length <= FF_DL_12BIT_MAX )
+        {
+            set_byte(&frame, 0, (uint8_t)((PCI_FIRST << 4) | (s->send_length >> 8)));
+            set_byte(&frame, 1, (uint8_t)s->send_length);
+            first = 2;
+        }
+        else
+        {
+            set_byte(&frame, 0, (uint8_t)(PCI_FIRST << 4));
+            set_byte(&frame, 1, 0);
+            set_byte(&frame, 2, (uint8_t)(s->send_length >> 24));
+            set_byte(&frame, 3, (uint8_t)(s->send_length >> 16));
+            set_byte(&frame, 4, (uint8_t)(s->send_length >> 8));
+            set_byte(&frame, 5, (uint8_t)s->send_length);
+            first = 6;
+        }
+
+        uint32_t count = FRAME_BYTES - first;
+        count = (count < s->send_length) ? count : s->send_length;
+
+        for(uint32_t i = 0; i < count; i++)
+        {
+            set_byte(&frame, first + i, s->send_data[i]);
+        }
+
+        if( transmit_frame(s->config.can, &frame) != Success )
+        {
+            return;
+        }
+
+        s->send_offset = count;
+
+        if( s->send_offset == s->send_length )
+        {
+            s->send_result = Isotp_done;
+            return;
+        }
+
+        s->send_sn = 1;
+        s->send_waits = 0;
+        s->send_deadline = now + (ISOTP_TIMEOUT_MS * TICKS_PER_MS);
+        s->send_stage = Send_wait_flow;
+    }
+
+    if( s->send_stage == Send_wait_flow )
+    {
+        if( (int64_t)(now - s->send_deadline) >= 0 )
+        {
+            s->send_result = Isotp_timeout;
+        }
+
+        return;
+    }
+
+    /* Consecutive frames, as many as the separation time and the queue allow */
+    while( (int64_t)(now - s->send_next) >= 0 )
+    {
+        uint32_t count = s->send_length - s->send_offset;
+        count = (count < (FRAME_BYTES - 1u)) ? count : (FRAME_BYTES - 1u);
+
+        blank_frame(s, &frame);
+        set_byte(&frame, 0, (uint8_t)((PCI_CONSECUTIVE << 4) | s->send_sn));
+
+        for(uint32_t i = 0; i < count; i++)
+        {
+            set_byte(&frame, 1u + i, s->send_data[s->send_offset + i]);
+        }
+
+        if( transmit_frame(s->config.can, &frame) != Success )
+        {
+            return;
+        }
+
+        s->send_offset += count;
+        s->send_sn = (s->send_sn + 1u) & 0xFu;
+        s->send_next = now + s->send_st_min;
+
+        if( s->send_offset == s->send_length )
+        {
+            s->send_result = Isotp_done;
+            return;
+        }
+
+        /* End of the block, wait for the peer's go-ahead */
+        if( (s->send_block_left != 0u) && (--s->send_block_left == 0u) )
+        {
+            s->send_deadline = now + (ISOTP_TIMEOUT_MS * TICKS_PER_MS);
+            s->send_stage = Send_wait_flow;
+            return;
+        }
+    }
+}
+
+uint32_t isotp_poll(FlexCAN_instance_t can)
+{
+    uint32_t total = 0;
+    frame_t* frames;
+    uint32_t count;
+
+    /* Frames are read in place, bounded to one ring's worth */
+    while( (total < RX_RING_SIZE) && ((count = lend_frames(can, &frames)) != 0u) )
+    {
+        for(uint32_t i = 0; i < count; i++)
+        {
+            if( isotp_frame(can, &frames[i]) != Success )
+            {
+                (void)dispatch_frame(can, &frames[i]);
+            }
+        }
+
+        release_frames(can, count);
+        total += count;
+    }
+
+    uint64_t now = FlexCAN_timer_now(can);
+
+    for(uint8_t i = 0; i < ISOTP_SESSIONS; i++)
+    {
+        isotp_session_t* s = &sessions[i];
+
+        if( !s->open || (s->config.can != can) )
+        {
+            continue;
+        }
+
+        send_flow_control(s);
+
+        if( (s->receive_result == Isotp_busy) && ((int64_t)(now - s->receive_deadline) >= 0) )
+        {
+            s->receive_result = Isotp_timeout;
+        }
+
+        service_send(s, now);
+    }
+
+    return total;
+}
@@ -0,0 +1,824 @@
+/**
+ * Source file
+ */
+
+#include <FlexCAN/include/CAN_j1939.h>
+#include <FlexCAN/include/CAN_dispatch.h>
+
+
+/* PGNs handled by the network and transport layers */
+#define PGN_REQUEST             (0x0EA00u)
+#define PGN_ADDRESS_CLAIMED     (0x0EE00u)
+#define PGN_TP_CM               (0x0EC00u)
+#define PGN_TP_DT               (0x0EB00u)
+
+/* Control bytes of the transport connection management messages */
+#define TP_RTS                  (16u)
+#define TP_CTS                  (17u)
+#define TP_EOMA                 (19u)
+#define TP_BAM                  (32u)
+#define TP_ABORT                (255u)
+
+/* Abort reasons */
+#define ABORT_RESOURCES         (2u)
+#define ABORT_TIMEOUT           (3u)
+
+/* Default priorities of the claims and of the transport frames */
+#define PRIORITY_CLAIM          (6u)
+#define PRIORITY_TP             (7u)
+
+/* PDU formats below this one carry a destination address in the PDU specific byte */
+#define PDU2_FIRST_PF           (240u)
+
+/* Bytes of a Classical CAN frame, the data bytes of a transport packet, and the longest message */
+#define FRAME_BYTES             (8u)
+#define PACKET_BYTES            (7u)
+#define MESSAGE_MAX             (255u * PACKET_BYTES)
+
+/* Addresses an arbitrary address capable node picks from */
+#define ARBITRARY_FIRST         (128u)
+#define ARBITRARY_LAST          (247u)
+
+/* Free running timer ticks, one per nominal bit */
+#define TICKS_PER_MS            (CAN_BITRATE / 1000u)
+
+/* Claim settle time and transport timeouts T1 to T4 */
+#define CLAIM_WAIT_TICKS        (250u * TICKS_PER_MS)
+#define T1_TICKS                (750u * TICKS_PER_MS)
+#define T2_TICKS                (1250u * TICKS_PER_MS)
+#define T3_TICKS                (1250u * TICKS_PER_MS)
+#define T4_TICKS                (1050u * TICKS_PER_MS)
+
+#if J1939_MAX_MESSAGE > MESSAGE_MAX
+#error "J1939_MAX_MESSAGE must not exceed 1785 bytes"
+#endif
+
+/**
+ *  Stages of the address claim
+ */
+typedef enum {
+    Claim_none = 0,        /* j1939_init() not called */
+    Claim_pending,         /* Claim sent, waiting for contenders */
+    Claim_done,
+    Claim_failed           /* Cannot claim, the node sits at the null address */
+} claim_state_t;
+
+/**
+ *  Stages of a multi-packet message being sent
+ */
+typedef enum {
+    Tx_announce = 0,       /* RTS or BAM not queued yet */
+    Tx_wait_cts,
+    Tx_sending,
+    Tx_wait_ack
+} tx_stage_t;
+
+/**
+ *  Multi-packet message being received into its own buffer
+ */
+typedef struct {
+    uint8_t active;
+    uint8_t bam;
+    uint8_t source;
+    uint32_t pgn;
+    uint16_t size;
+    uint8_t packets;
+    uint8_t next;               /* Sequence number expected next */
+    uint8_t window_end;         /* Last sequence number of the clear to send window */
+    uint8_t cts_pending;        /* Clear to send to queue */
+    uint8_t ack_pending;        /* End of message acknowledge to queue, the message was delivered */
+    uint64_t deadline;
+    uint8_t data[J1939_MAX_MESSAGE];
+} rx_session_t;
+
+/**
+ *  Multi-packet message being sent straight from the caller's buffer
+ */
+typedef struct {
+    j1939_result_t result;
+    tx_stage_t stage;
+    uint8_t watched;            /* The caller reads the result, otherwise the session frees itself */
+    uint8_t bam;
+    uint8_t destination;
+    uint32_t pgn;
+    const uint8_t* data;
+    uint16_t length;
+    uint8_t packets;
+    uint8_t next;               /* Sequence number sent next */
+    uint8_t window_end;
+    uint64_t due;               /* Time the next packet may be queued */
+    uint64_t deadline;
+} tx_session_t;
+
+static FlexCAN_instance_t node_can;
+static uint64_t node_name;
+static uint8_t node_address = J1939_NULL_ADDRESS;
+static claim_state_t claim_state = Claim_none;
+static uint8_t claim_pending = 0;
+static uint8_t claim_tries = 0;
+static uint64_t claim_deadline = 0;
+
+/* Handlers sorted by PGN */
+static uint32_t handler_pgns[J1939_HANDLERS];
+static j1939_handler_t handlers[J1939_HANDLERS];
+static uint32_t handler_count = 0;
+
+static rx_session_t rx_sessions[J1939_RX_SESSIONS];
+static tx_session_t tx_sessions[J1939_TX_SESSIONS];
+
+/* Byte of a frame, the FlexCAN holds the first byte in the upper bits of each word */
+static uint8_t get_byte(const frame_t* frame, uint32_t i)
+{
+    return (uint8_t)(frame->payload[i >> 2] >> (24u - ((i & 3u) * 8u)));
+}
+
+/* Queue a frame from the node, bytes past count are padded */
+static status_t send_frame(uint8_t priority, uint32_t pgn, uint8_t destination, const uint8_t* bytes, uint32_t count)
+{
+    frame_t frame;
+
+    /* PDU1 PGNs carry the destination in their low byte */
+    uint32_t pdu = (((pgn >> 8) & 0xFFu) < PDU2_FIRST_PF) ? ((pgn & 0x3FF00u) | destination) : pgn;
+
+    frame.ID = CAN_ID_EXT | ((uint32_t)priority << 26) | (pdu << 8) | node_address;
+
+    for(uint8_t i = 0; i < MAX_MTU_WORDS; i++)
+    {
+        frame.payload[i] = 0xFFFFFFFFu;
+    }
+
+    for(uint32_t i = 0; i < count; i++)
+    {
+        uint32_t shift = 24u - ((i & 3u) * 8u);
+        frame.payload[i >> 2] = (frame.payload[i >> 2] & ~(0xFFu << shift)) | ((uint32_t)bytes[i] << shift);
+    }
+
+    return transmit_frame(node_can, &frame);
+}
+
+/* Queue a transport connection management message, the PGN of the transfer fills its last bytes */
+static status_t send_cm(uint8_t destination, uint8_t control, uint8_t b1, uint8_t b2, uint8_t b3, uint8_t b4, uint32_t pgn)
+{
+    uint8_t bytes[FRAME_BYTES] = { control, b1, b2, b3, b4, (uint8_t)pgn, (uint8_t)(pgn >> 8), (uint8_t)(pgn >> 16) };
+
+    return send_frame(PRIORITY_TP, PGN_TP_CM, destination, bytes, FRAME_BYTES);
+}
+
+static uint8_t packet_count(uint16_t length)
+{
+    return (uint8_t)((length + PACKET_BYTES - 1u) / PACKET_BYTES);
+}
+
+status_t j1939_init(FlexCAN_instance_t can, uint64_t name, uint8_t address)
+{
+    if( address >= J1939_NULL_ADDRESS )
+    {
+        return Failure;
+    }
+
+    node_can = can;
+    node_name = name;
+    node_address = address;
+    claim_state = Claim_pending;
+    claim_pending = 1;
+    claim_tries = 0;
+
+    return Success;
+}
+
+uint8_t j1939_address(void)
+{
+    return (claim_state == Claim_done) ? node_address : J1939_NULL_ADDRESS;
+}
+
+status_t j1939_register(uint32_t pgn, j1939_handler_t handler)
+{
+    if( handler == 0 )
+    {
+        return Failure;
+    }
+
+    uint32_t i = 0;
+
+    while( (i < handler_count) && (handler_pgns[i] < pgn) )
+    {
+        i++;
+    }
+
+    if( (i < handler_count) && (handler_pgns[i] == pgn) )
+    {
+        handlers[i] = handler;
+        return Success;
+    }
+
+    if( handler_count == J1939_HANDLERS )
+    {
+        return BufferFull;
+    }
+
+    /* Open a slot keeping the table sorted */
+    for(uint32_t j = handler_count; j > i; j--)
+    {
+        handler_pgns[j] = handler_pgns[j - 1u];
+        handlers[j] = handlers[j - 1u];
+    }
+
+    handler_pgns[i] = pgn;
+    handlers[i] = handler;
+    handler_count++;
+
+    return Success;
+}
+
+/* Handler of a PGN, NULL if none */
+static j1939_handler_t find_handler(uint32_t pgn)
+{
+    uint32_t low = 0;
+    uint32_t high = handler_count;
+
+    while( low < high )
+    {
+        uint32_t mid = (low + high) / 2u;
+
+        if( handler_pgns[mid] == pgn )
+        {
+            return handlers[mid];
+        }
+
+        if( handler_pgns[mid] < pgn )
+        {
+            low = mid + 1u;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    return 0;
+}
+
+status_t j1939_send(uint32_t pgn, uint8_t priority, uint8_t destination, const uint8_t* data,
+                    uint16_t length, uint8_t* session)
+{
+    if( (claim_state != Claim_done) || (priority > 7u) || (pgn > 0x3FFFFu) || (length > MESSAGE_MAX) )
+    {
+        return Failure;
+    }
+
+    /* PDU2 PGNs have no destination */
+    if( ((pgn >> 8) & 0xFFu) >= PDU2_FIRST_PF )
+    {
+        destination = J1939_GLOBAL_ADDRESS;
+    }
+
+    if( length <= FRAME_BYTES )
+    {
+        return send_frame(priority, pgn, destination, data, length);
+    }
+
+    uint8_t free_index = J1939_TX_SESSIONS;
+
+    for(uint8_t i = 0; i < J1939_TX_SESSIONS; i++)
+    {
+        tx_session_t* s = &tx_sessions[i];
+
+        /* One transfer at a time per destination, the transport frames don't tell them apart */
+        if( (s->result == J1939_busy) && (s->destination == destination) )
+        {
+            return BufferFull;
+        }
+
+        if( (free_index == J1939_TX_SESSIONS) && (s->result == J1939_idle) )
+        {
+            free_index = i;
+        }
+    }
+
+    if( free_index == J1939_TX_SESSIONS )
+    {
+        return BufferFull;
+    }
+
+    if( session != 0 )
+    {
+        *session = free_index;
+    }
+
+    tx_session_t* free_session = &tx_sessions[free_index];
+
+    *free_session = (tx_session_t){
+            .result = J1939_busy,
+            .stage = Tx_announce,
+            .watched = (session != 0),
+            .bam = (destination == J1939_GLOBAL_ADDRESS),
+            .destination = destination,
+            .pgn = pgn,
+            .data = data,
+            .length = length,
+            .packets = packet_count(length),
+    };
+
+    return Success;
+}
+
+j1939_result_t j1939_send_result(uint8_t session)
+{
+    if( session >= J1939_TX_SESSIONS )
+    {
+        return J1939_idle;
+    }
+
+    j1939_result_t result = tx_sessions[session].result;
+
+    if( result != J1939_busy )
+    {
+        tx_sessions[session].result = J1939_idle;
+    }
+
+    return result;
+}
+
+/* End a transfer being sent */
+static void finish_tx(tx_session_t* s, j1939_result_t result)
+{
+    s->result = s->watched ? result : J1939_idle;
+}
+
+/* Address claimed by another node, the lowest NAME keeps the address */
+static void contend_claim(uint8_t source, uint64_t name, uint64_t now)
+{
+    if( ((claim_state != Claim_pending) && (claim_state != Claim_done)) || (source != node_address) || (name == node_name) )
+    {
+        return;
+    }
+
+    claim_pending = 1;
+
+    /* Ours wins, tell the contender again */
+    if( node_name < name )
+    {
+        return;
+    }
+
+    if( (node_name >> 63) && (claim_tries < (ARBITRARY_LAST - ARBITRARY_FIRST)) )
+    {
+        node_address = ((node_address < ARBITRARY_FIRST) || (node_address >= ARBITRARY_LAST)) ? ARBITRARY_FIRST : (node_address + 1u);
+        claim_tries++;
+        claim_state = Claim_pending;
+        claim_deadline = now + CLAIM_WAIT_TICKS;
+    }
+    else
+    {
+        /* Cannot claim, announced from the null address */
+        node_address = J1939_NULL_ADDRESS;
+        claim_state = Claim_failed;
+    }
+}
+
+static rx_session_t* find_rx(uint8_t source, uint8_t bam)
+{
+    for(uint8_t i = 0; i < J1939_RX_SESSIONS; i++)
+    {
+        if( rx_sessions[i].active && (rx_sessions[i].source == source) && (rx_sessions[i].bam == bam) )
+        {
+            return &rx_sessions[i];
+        }
+    }
+
+    return 0;
+}
+
+static tx_session_t* find_tx(uint8_t destination, uint32_t pgn)
+{
+    for(uint8_t i = 0; i < J1939_TX_SESSIONS; i++)
+    {
+        tx_session_t* s = &tx_sessions[i];
+
+        if( (s->result == J1939_busy) && !s->bam && (s->destination == destination) && (s->pgn == pgn) )
+        {
+            return s;
+        }
+    }
+
+    return 0;
+}
+
+/* Announced transfer, RTS or BAM, from a node */
+static void open_rx(uint8_t source, uint8_t bam, uint16_t size, uint8_t packets, uint32_t pgn, uint64_t now)
+{
+    /* A new announcement from the same node replaces its transfer in progress */
+    rx_session_t* s = find_rx(source, bam);
+
+    for(uint8_t i = 0; (s == 0) && (i < J1939_RX_SESSIONS); i++)
+    {
+        if( !rx_sessions[i].active )
+        {
+            s = &rx_sessions[i];
+        }
+    }
+
+    if( (s == 0) || (size > J1939_MAX_MESSAGE) || (size <= FRAME_BYTES) || (packets != packet_count(size)) )
+    {
+        if( !bam )
+        {
+            (void)send_cm(source, TP_ABORT, ABORT_RESOURCES, 0xFF, 0xFF, 0xFF, pgn);
+        }
+
+        if( s != 0 )
+        {
+            s->active = 0;
+        }
+
+        return;
+    }
+
+    s->active = 1;
+    s->bam = bam;
+    s->source = source;
+    s->pgn = pgn;
+    s->size = size;
+    s->packets = packets;
+    s->next = 1;
+    s->cts_pending = !bam;
+    s->ack_pending = 0;
+    s->deadline = now + (bam ? T1_TICKS : T2_TICKS);
+}
+
+static void receive_cm(uint8_t source, uint8_t destination, const uint8_t* bytes, uint64_t now)
+{
+    uint32_t pgn = bytes[5] | ((uint32_t)bytes[6] << 8) | ((uint32_t)bytes[7] << 16);
+    uint16_t size = (uint16_t)(bytes[1] | (bytes[2] << 8));
+    uint8_t global = (destination == J1939_GLOBAL_ADDRESS);
+    tx_session_t* tx = find_tx(source, pgn);
+
+    if( (bytes[0] == TP_BAM) && global )
+    {
+        open_rx(source, 1, size, bytes[3], pgn, now);
+    }
+    else if( global )
+    {
+        /* The rest are point to point */
+    }
+    else if( bytes[0] == TP_RTS )
+    {
+        open_rx(source, 0, size, bytes[3], pgn, now);
+    }
+    else if( (bytes[0] == TP_CTS) && (tx != 0) && (tx->stage == Tx_wait_cts) &&
+             (bytes[2] != 0u) && (bytes[2] <= tx->packets) )
+    {
+        if( bytes[1] == 0u )
+        {
+            /* Hold the connection open */
+            tx->deadline = now + T4_TICKS;
+        }
+        else
+        {
+            uint32_t end = (uint32_t)bytes[2] + bytes[1] - 1u;
+
+            tx->next = bytes[2];
+            tx->window_end = (uint8_t)((end < tx->packets) ? end : tx->packets);
+            tx->due = now;
+            tx->stage = Tx_sending;
+        }
+    }
+    else if( (bytes[0] == TP_EOMA) && (tx != 0) && (tx->stage == Tx_wait_ack) )
+    {
+        finish_tx(tx, J1939_done);
+    }
+    else if( bytes[0] == TP_ABORT )
+    {
+        if( tx != 0 )
+        {
+            finish_tx(tx, J1939_aborted);
+        }
+
+        rx_session_t* rx = find_rx(source, 0);
+
+        if( (rx != 0) && (rx->pgn == pgn) )
+        {
+            rx->active = 0;
+        }
+    }
+}
+
+static void receive_dt(uint8_t source, uint8_t destination, const uint8_t* bytes, uint64_t now)
+{
+    rx_session_t* s = find_rx(source, destination == J1939_GLOBAL_ADDRESS);
+
+    if( (s == 0) || s->ack_pending || (s->next > s->packets) )
+    {
+        return;
+    }
+
+    /* Out of sequence, ask again from the packet expected */
+    if( bytes[0] != s->next )
+    {
+        s->cts_pending = !s->bam;
+        return;
+    }
+
+    uint32_t offset = (uint32_t)(s->next - 1u) * PACKET_BYTES;
+    uint32_t count = s->size - offset;
+    count = (count < PACKET_BYTES) ? count : PACKET_BYTES;
+
+    for(uint32_t i = 0; i < count; i++)
+    {
+        s->data[offset + i] = bytes[1u + i];
+    }
+
+    s->next++;
+    s->deadline = now + T1_TICKS;
+
+    if( s->next > s->packets )
+    {
+        j1939_handler_t handler = find_handler(s->pgn);
+
+        if( handler != 0 )
+        {
+            handler(s->pgn, s->source, s->data, s->size);
+        }
+
+        /* A connection stays open until its acknowledge is queued */
+        s->active = !s->bam;
+        s->ack_pending = !s->bam;
+    }
+    else if( !s->bam && (s->next > s->window_end) )
+    {
+        s->cts_pending = 1;
+        s->deadline = now + T2_TICKS;
+    }
+}
+
+status_t j1939_frame(const frame_t* frame)
+{
+    if( !(frame->ID & CAN_ID_EXT) || (claim_state == Claim_none) )
+    {
+        return Failure;
+    }
+
+    uint32_t id = frame->ID & CAN_ID_MASK;
+    uint8_t source = (uint8_t)id;
+    uint32_t pgn = (id >> 8) & 0x3FFFFu;
+    uint8_t destination = J1939_GLOBAL_ADDRESS;
+
+    if( ((pgn >> 8) & 0xFFu) < PDU2_FIRST_PF )
+    {
+        destination = (uint8_t)pgn;
+        pgn &= 0x3FF00u;
+    }
+
+    /* Address claims concern every node, the rest only the ones addressed */
+    if( (destination != J1939_GLOBAL_ADDRESS) && (destination != node_address) && (pgn != PGN_ADDRESS_CLAIMED) )
+    {
+        return Failure;
+    }
+
+    uint8_t bytes[FRAME_BYTES];
+
+    for(uint32_t i = 0; i < FRAME_BYTES; i++)
+    {
+        bytes[i] = get_byte(frame, i);
+    }
+
+    if( pgn == PGN_ADDRESS_CLAIMED )
+    {
+        uint64_t name = 0;
+
+        for(uint32_t i = FRAME_BYTES; i > 0u; i--)
+        {
+            name = (name << 8) | bytes[i - 1u];
+        }
+
+        contend_claim(source, name, frame->timestamp);
+        return Success;
+    }
+
+    if( pgn == PGN_TP_CM )
+    {
+        receive_cm(source, destination, bytes, frame->timestamp);
+        return Success;
+    }
+
+    if( pgn == PGN_TP_DT )
+    {
+        receive_dt(source, destination, bytes, frame->timestamp);
+        return Success;
+    }
+
+    if( (pgn == PGN_REQUEST) && ((bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16)) == PGN_ADDRESS_CLAIMED) )
+    {
+        claim_pending = 1;
+        return Success;
+    }
+
+    j1939_handler_t handler = find_handler(pgn);
+
+    if( handler == 0 )
+    {
+        return Failure;
+    }
+
+    handler(pgn, source, bytes, FRAME_BYTES);
+
+    return Success;
+}
+
+/* Queue the pending control messages and check the timeout of a message being received */
+static void service_rx(rx_session_t* s, uint64_t now)
+{
+    if( !s->active )
+    {
+        return;
+    }
+
+    if( s->ack_pending )
+    {
+        if( send_cm(s->source, TP_EOMA, (uint8_t)s->size, (uint8_t)(s->size >> 8), s->packets, 0xFF, s->pgn) == Success )
+        {
+            s->active = 0;
+        }
+
+        return;
+    }
+
+    if( s->cts_pending )
+    {
+        uint32_t count = (uint32_t)s->packets - s->next + 1u;
+        count = (count < J1939_CTS_PACKETS) ? count : J1939_CTS_PACKETS;
+
+        if( send_cm(s->source, TP_CTS, (uint8_t)count, s->next, 0xFF, 0xFF, s->pgn) == Success )
+        {
+            s->cts_pending = 0;
+            s->window_end = (uint8_t)(s->next + count - 1u);
+            s->deadline = now + T2_TICKS;
+        }
+
+        return;
+    }
+
+    if( (int64_t)(now - s->deadline) >= 0 )
+    {
+        if( !s->bam )
+        {
+            (void)send_cm(s->source, TP_ABORT, ABORT_TIMEOUT, 0xFF, 0xFF, 0xFF, s->pgn);
+        }
+
+        s->active = 0;
+    }
+}
+
+/* Queue the packets due of a message being sent and check its timeouts */
+static void service_tx(tx_session_t* s, uint64_t now)
+{
+    if( s->result != J1939_busy )
+    {
+        return;
+    }
+
+    if( s->stage == Tx_announce )
+    {
+        uint8_t control = s->bam ? TP_BAM : TP_RTS;
+
+        /* No limit on the packets per clear to send */
+        if( send_cm(s->destination, control, (uint8_t)s->length, (uint8_t)(s->length >> 8), s->packets, 0xFF, s->pgn) != Success )
+        {
+            return;
+        }
+
+        s->next = 1;
+
+        if( s->bam )
+        {
+            s->window_end = s->packets;
+            s->due = now + (J1939_BAM_GAP_MS * TICKS_PER_MS);
+            s->stage = Tx_sending;
+        }
+        else
+        {
+            s->deadline = now + T3_TICKS;
+            s->stage = Tx_wait_cts;
+        }
+
+        return;
+    }
+
+    if( s->stage != Tx_sending )
+    {
+        if( (int64_t)(now - s->deadline) >= 0 )
+        {
+            (void)send_cm(s->destination, TP_ABORT, ABORT_TIMEOUT, 0xFF, 0xFF, 0xFF, s->pgn);
+            finish_tx(s, J1939_timeout);
+        }
+
+        return;
+    }
+
+    while( (s->next <= s->window_end) && ((int64_t)(now - s->due) >= 0) )
+    {
+        uint8_t bytes[FRAME_BYTES];
+        uint32_t offset = (uint32_t)(s->next - 1u) * PACKET_BYTES;
+        uint32_t count = s->length - offset;
+        count = (count < PACKET_BYTES) ? count : PACKET_BYTES;
+
+        bytes[0] = s->next;
+
+        for(uint32_t i = 0; i < count; i++)
+        {
+            bytes[1u + i] = s->data[offset + i];
+        }
+
+        if( send_frame(PRIORITY_TP, PGN_TP_DT, s->destination, bytes, 1u + count) != Success )
+        {
+            return;
+        }
+
+        s->next++;
+
+        /* Broadcast packets are spaced for the slowest receivers, connected ones go back to back */
+        if( s->bam )
+        {
+            s->due = now + (J1939_BAM_GAP_MS * TICKS_PER_MS);
+        }
+    }
+
+    if( s->next <= s->window_end )
+    {
+        return;
+    }
+
+    if( s->bam && (s->next > s->packets) )
+    {
+        finish_tx(s, J1939_done);
+        return;
+    }
+
+    s->deadline = now + T3_TICKS;
+    s->stage = (s->next > s->packets) ? Tx_wait_ack : Tx_wait_cts;
+}
+
+uint32_t j1939_poll(void)
+{
+    uint32_t total = 0;
+    frame_t* frames;
+    uint32_t count;
+
+    if( claim_state == Claim_none )
+    {
+        return 0;
+    }
+
+    /* Frames are read in place, bounded to one ring's worth */
+    while( (total < RX_RING_SIZE) && ((count = lend_frames(node_can, &frames)) != 0u) )
+    {
+        for(uint32_t i = 0; i < count; i++)
+        {
+            if( j1939_frame(&frames[i]) != Success )
+            {
+                (void)dispatch_frame(node_can, &frames[i]);
+            }
+        }
+
+        release_frames(node_can, count);
+        total += count;
+    }
+
+    uint64_t now = FlexCAN_timer_now(node_can);
+
+    if( claim_pending )
+    {
+        uint8_t name[FRAME_BYTES];
+
+        for(uint32_t i = 0; i < FRAME_BYTES; i++)
+        {
+            name[i] = (uint8_t)(node_name >> (8u * i));
+        }
+
+        if( send_frame(PRIORITY_CLAIM, PGN_ADDRESS_CLAIMED, J1939_GLOBAL_ADDRESS, name, FRAME_BYTES) == Success )
+        {
+            claim_pending = 0;
+
+            /* A fresh claim waits for contenders from the time it is on its way */
+            if( claim_state == Claim_pending )
+            {
+                claim_deadline = now + CLAIM_WAIT_TICKS;
+            }
+        }
+    }
+    else if( (claim_state == Claim_pending) && ((int64_t)(now - claim_deadline) >= 0) )
+    {
+        claim_state = Claim_done;
+    }
+
+    for(uint8_t i = 0; i < J1939_RX_SESSIONS; i++)
+    {
+        service_rx(&rx_sessions[i], now);
+    }
+
+    for(uint8_t i = 0; (claim_state == Claim_done) && (i < J1939_TX_SESSIONS); i++)
+    {
+        service_tx(&tx_sessions[i], now);
+    }
+
+    return total;
+}
@@ -0,0 +1,227 @@
+/**
+ * Source file
+ */
+
+#include <FlexCAN/include/CAN_shaping.h>
+
+
+/* Open addressing table of the rules, kept at most half full so a lookup probes few slots */
+#define HASH_BITS           (6u)
+#define HASH_SIZE           (1u << HASH_BITS)
+
+#if HASH_SIZE < (2u * SHAPING_RULES)
+#error "The shaping hash table must hold twice SHAPING_RULES slots"
+#endif
+
+/**
+ *  Shaping rule with the state of its ID
+ */
+typedef struct {
+    uint32_t key;
+    shaping_rule_t rule;
+    uint8_t sent;                     /* Whether a frame of the ID was transmitted yet */
+    uint64_t last_sent;               /* Timer value when the last frame was queued */
+    uint32_t last_payload[MAX_MTU_WORDS];
+} shaping_entry_t;
+
+/**
+ *  Token bucket of a group of IDs
+ */
+typedef struct {
+    uint32_t capacity;
+    uint32_t refill_ticks;
+    uint32_t tokens;
+    uint64_t last_refill;             /* Timer value the tokens were last brought up to */
+    FlexCAN_instance_t can;           /* Instance whose timer last refilled the bucket */
+} shaping_bucket_t;
+
+static shaping_entry_t entries[SHAPING_RULES];
+static uint32_t entry_count = 0;
+
+/* For every slot, the index of its rule plus one, 0 for an empty slot */
+static uint8_t hash_table[HASH_SIZE];
+
+static shaping_bucket_t buckets[SHAPING_BUCKETS];
+
+static shaping_stats_t shaping_stats;
+
+/* Lookup key of an ID on an instance: the ID bits, the CAN_ID_EXT flag at bit 29 and the instance above */
+static uint32_t shaping_key(FlexCAN_instance_t can, uint32_t id)
+{
+    return (id & CAN_ID_MASK) | ((id >> 31) << 29) | ((uint32_t)can << 30);
+}
+
+/* Home slot of a key, by Fibonacci hashing */
+static uint32_t hash_slot(uint32_t key)
+{
+    return (key * 2654435761u) >> (32u - HASH_BITS);
+}
+
+/* Rule of a key, NULL if the key has none */
+static shaping_entry_t* find_entry(uint32_t key)
+{
+    for(uint32_t slot = hash_slot(key); hash_table[slot] != 0u; slot = (slot + 1u) & (HASH_SIZE - 1u))
+    {
+        shaping_entry_t* entry = &entries[hash_table[slot] - 1u];
+
+        if( entry->key == key )
+        {
+            return entry;
+        }
+    }
+
+    return 0;
+}
+
+status_t shaping_set_bucket(uint8_t bucket, uint32_t capacity, uint32_t refill_ticks)
+{
+    if( (bucket >= SHAPING_BUCKETS) || (capacity == 0u) || (refill_ticks == 0u) )
+    {
+        return Failure;
+    }
+
+    buckets[bucket].capacity = capacity;
+    buckets[bucket].refill_ticks = refill_ticks;
+    buckets[bucket].tokens = capacity;
+    buckets[bucket].last_refill = 0;
+
+    return Success;
+}
+
+status_t shaping_add_rule(const shaping_rule_t* rule)
+{
+    uint32_t key = shaping_key(rule->can, rule->ID);
+
+    /* A bucket never configured has no refill period to divide by */
+    if( ((rule->bucket != SHAPING_NO_BUCKET) &&
+         ((rule->bucket >= SHAPING_BUCKETS) || (buckets[rule->bucket].refill_ticks == 0u))) ||
+        (find_entry(key) != 0) )
+    {
+        return Failure;
+    }
+
+    if( entry_count == SHAPING_RULES )
+    {
+        return BufferFull;
+    }
+
+    shaping_entry_t* entry = &entries[entry_count];
+    entry->key = key;
+    entry->rule = *rule;
+    entry->sent = 0;
+    entry_count++;
+
+    /* First empty slot from the home one */
+    uint32_t slot = hash_slot(key);
+    while( hash_table[slot] != 0u )
+    {
+        slot = (slot + 1u) & (HASH_SIZE - 1u);
+    }
+
+    hash_table[slot] = (uint8_t)entry_count;
+
+    return Success;
+}
+
+/* Bring the tokens of a bucket up to the given time, without losing the fraction of a token
+ * already accrued */
+static void refill_bucket(shaping_bucket_t* bucket, FlexCAN_instance_t can, uint64_t now)
+{
+    /* The instances have unrelated timers, a bucket shared by both restarts from the other's time */
+    if( bucket->can != can )
+    {
+        bucket->can = can;
+        bucket->last_refill = now;
+        return;
+    }
+
+    uint64_t earned = (now - bucket->last_refill) / bucket->refill_ticks;
+
+    if( earned >= (bucket->capacity - bucket->tokens) )
+    {
+        bucket->tokens = bucket->capacity;
+        bucket->last_refill = now;
+    }
+    else
+    {
+        bucket->tokens += (uint32_t)earned;
+        bucket->last_refill += earned * bucket->refill_ticks;
+    }
+}
+
+status_t transmit_frame_shaped(FlexCAN_instance_t can, frame_t* frame)
+{
+    shaping_entry_t* entry = find_entry(shaping_key(can, frame->ID));
+
+    if( entry == 0 )
+    {
+        shaping_stats.passed++;
+        return transmit_frame(can, frame);
+    }
+
+    uint64_t now = FlexCAN_timer_now(can);
+
+    if( entry->sent && entry->rule.min_interval && ((now - entry->last_sent) < entry->rule.min_interval) )
+    {
+        shaping_stats.interval++;
+        return Suppressed;
+    }
+
+    if( entry->sent && entry->rule.on_change )
+    {
+        uint32_t changed = 0;
+
+        for(uint8_t i = 0; i < MAX_MTU_WORDS; i++)
+        {
+            changed |= frame->payload[i] ^ entry->last_payload[i];
+        }
+
+        if( !changed )
+        {
+            shaping_stats.unchanged++;
+            return Suppressed;
+        }
+    }
+
+    shaping_bucket_t* bucket = 0;
+
+    if( entry->rule.bucket != SHAPING_NO_BUCKET )
+    {
+        bucket = &buckets[entry->rule.bucket];
+        refill_bucket(bucket, can, now);
+
+        if( bucket->tokens == 0u )
+        {
+            shaping_stats.bucket_empty++;
+            return Suppressed;
+        }
+    }
+
+    status_t status = transmit_frame(can, frame);
+
+    /* Only a queued frame spends a token and becomes the reference for the next ones */
+    if( status == Success )
+    {
+        if( bucket != 0 )
+        {
+            bucket->tokens--;
+        }
+
+        entry->sent = 1;
+        entry->last_sent = now;
+
+        for(uint8_t i = 0; i < MAX_MTU_WORDS; i++)
+        {
+            entry->last_payload[i] = frame->payload[i];
+        }
+
+        shaping_stats.passed++;
+    }
+
+    return status;
+}
+
+void get_shaping_stats(shaping_stats_t* stats)
+{
+    *stats = shaping_stats;
+}
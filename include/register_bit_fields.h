@@ -16,13 +16,22 @@
   #define __IO  volatile
 #endif
 
-/* Base address for the peripherals used, their respective type castings are locating at the bottom of the file */
-#define CAN0_BASE                   0x40024000UL
-#define SCG_BASE                    0x40064000UL
-#define PCC_BASE                    0x40065000UL
-#define PORTD_BASE                  0x4004C000UL
-#define PORTE_BASE                  0x4004D000UL
-#define PTD_BASE                    0x400FF0C0UL
+/* Interrupt numbers, base addresses and the NVIC, eDMA, DMAMUX and LPIT0 register layouts come from the
+ * vendor memory map. Its SCG and PCC layouts and its peripheral pointers give way to the bit field ones
+ * of this file, its DMA pointer to EDMA as it would expand in the DMA bit field of CAN0_MCR */
+#define SCG_Type    S32K142_SCG_Type
+#define PCC_Type    S32K142_PCC_Type
+#include "S32K142.h"
+#undef SCG_Type
+#undef PCC_Type
+#undef CAN0
+#undef CAN1
+#undef SCG
+#undef PCC
+#undef PORTD
+#undef PORTE
+#undef PTD
+#undef DMA
 
 
 /* =========================================================================================================================== */
@@ -288,16 +297,33 @@ typedef struct {                                /*!< (@ 0x40024000) CAN0 Structu
     __IO uint32_t IDE        : 1;
     __IO uint32_t SRR        : 1;
     __IO uint32_t IDHIT      : 9;
-          uint32_t            : 18;
-    __IO uint32_t STD_ID     : 11;
-          uint32_t            : 3;
+    union {
+      struct {
+            uint32_t            : 18;
+      __IO uint32_t STD_ID     : 11;
+            uint32_t            : 3;
+      };
+      struct {
+      __IO uint32_t EXT_ID     : 29;            /* Extended ID, valid when IDE is set */
+            uint32_t            : 3;
+      };
+    };
     __IO uint32_t payload[2];
   } Classic_RX_FIFO[6];
 
-  struct{
-          uint32_t            : 19;
-    __IO uint32_t STD_ID         : 11;
-          uint32_t            : 2;
+  /* Format A element */
+  union {
+    struct {
+            uint32_t            : 19;
+      __IO uint32_t STD_ID     : 11;
+            uint32_t            : 2;
+    };
+    struct {
+            uint32_t            : 1;
+      __IO uint32_t EXT_ID     : 29;
+      __IO uint32_t IDE        : 1;
+      __IO uint32_t RTR        : 1;
+    };
   } ID_TABLE_RXFIFO[8];
 
   struct {
@@ -312,9 +338,17 @@ typedef struct {                                /*!< (@ 0x40024000) CAN0 Structu
     __IO uint32_t ESI        : 1;
     __IO uint32_t BRS        : 1;
     __IO uint32_t EDL        : 1;
-          uint32_t            : 18;
-    __IO uint32_t STD_ID     : 11;
-    __IO uint32_t PRIO       : 3;
+    union {
+      struct {
+            uint32_t            : 18;
+      __IO uint32_t STD_ID     : 11;
+            uint32_t            : 3;
+      };
+      struct {
+      __IO uint32_t EXT_ID     : 29;            /* Extended ID, used when IDE is set */
+      __IO uint32_t PRIO       : 3;
+      };
+    };
     __IO uint32_t payload[2];
   } Classic_MessageBuffer[24];
 
@@ -2932,12 +2966,47 @@ typedef struct {                                /*!< (@ 0x4004D000) PORTE Struct
   } ;
 } PORTE_Type;                                   /*!< Size = 204 (0xcc)                                                         */
 
+#if defined(HOST_REGISTERS)
+#undef S32_NVIC
+#undef DMAMUX
+#undef LPIT0
+
+/* Host builds place every register block at an address the simulator in test/sim traps the
+ * accesses to, the linker defines these instances. The NVIC is moved below 2 GiB, in reach of
+ * the x86-64 addressing modes */
+extern CAN0_Type       host_CAN0;
+extern CAN0_Type       host_CAN1;
+extern SCG_Type        host_SCG;
+extern PCC_Type        host_PCC;
+extern PORTD_Type      host_PORTD;
+extern PORTE_Type      host_PORTE;
+extern PTD_Type        host_PTD;
+extern S32_NVIC_Type   host_S32_NVIC;
+extern DMA_Type        host_EDMA;
+extern DMAMUX_Type     host_DMAMUX;
+extern LPIT_Type       host_LPIT0;
+
+#define CAN0          (&host_CAN0)
+#define CAN1          (&host_CAN1)
+#define SCG           (&host_SCG)
+#define PCC           (&host_PCC)
+#define PORTD         (&host_PORTD)
+#define PORTE         (&host_PORTE)
+#define PTD           (&host_PTD)
+#define S32_NVIC      (&host_S32_NVIC)
+#define EDMA          (&host_EDMA)
+#define DMAMUX        (&host_DMAMUX)
+#define LPIT0         (&host_LPIT0)
+#else
 #define CAN0          ((CAN0_Type*)  CAN0_BASE)
+#define CAN1          ((CAN0_Type*)  CAN1_BASE)  /* Same layout as FlexCAN0, with 16 message buffers and no CAN FD */
 #define SCG           ((SCG_Type*)   SCG_BASE)
 #define PCC           ((PCC_Type*)   PCC_BASE)
 #define PORTD         ((PORTD_Type*) PORTD_BASE)
 #define PORTE         ((PORTE_Type*) PORTE_BASE)
 #define PTD           ((PTD_Type*)   PTD_BASE)
+#define EDMA          ((DMA_Type*)   DMA_BASE)
+#endif
 
 /* =========================================================================================================================== */
 /* ================                                           CAN0                                            ================ */
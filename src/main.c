@@ -38,11 +38,11 @@ int main(void)
 	status_t status;
 
 	/* Start the peripheral */
-	status = FlexCAN_init_RXFIFO();
+	status = FlexCAN_init_RXFIFO(FlexCAN_0);
 
 	/* Install the specified ID of the destination board */
 	if( status )
-    status = install_ID(ID);
+    status = install_ID(FlexCAN_0, ID);
 
 	greenLED_init();
 
@@ -51,7 +51,7 @@ int main(void)
     PTD->GPIOD_PTOR |= 1<<16;
 	/* BOARD_A kickstarts the transmission */
 	if( status )
-    transmit_frame(&Transmission_frame);
+    transmit_frame(FlexCAN_0, &Transmission_frame);
 #endif
 
 	/* Reception frame */
@@ -61,7 +61,7 @@ int main(void)
 	while(1)
     {
         /* Listen */
-	    status = receive_frame(&Reception_frame);
+	    status = receive_frame(FlexCAN_0, &Reception_frame);
 
 	    /* Echo back */
         if( status )
@@ -75,7 +75,7 @@ int main(void)
                 PTD->GPIOD_PTOR |= 1<<16;
             }
 
-            status = transmit_frame(&Transmission_frame);
+            status = transmit_frame(FlexCAN_0, &Transmission_frame);
         }
     }
 }
@@ -0,0 +1,977 @@
+/**
+ * Source file
+ */
+
+/*
+ * Throughput and cost of the driver on the simulated bus, run with make -C test bench.
+ *
+ * Every register access traps into the simulator. A trap costs microseconds of host time where
+ * the driver's code between two accesses costs nanoseconds, so host timings would measure the
+ * simulator; the register accesses and interrupts per frame are exact instead and are the
+ * figures to compare between driver versions, the trap cost is printed for scale.
+ * Simulated time runs at 1/slowdown of the wall clock so the traps don't starve the bus, the
+ * turnaround of the hot message buffer is in simulated time and shrinks as the slowdown grows.
+ * The reception ring is plain memory, so its consumer side is timed on the host: TSC cycles per
+ * frame of receive_frame() copying out against lend_frames() parsing in place, over drains of half
+ * a ring coming cold out of the simulator. The median drain is printed so the ticks of the
+ * simulator landing in one don't count. That cost doesn't depend on the bit rate, the bus runs
+ * saturated at CAN_BITRATE.
+ *
+ * Usage: bench_CAN [frames] [slowdown]
+ */
+
+#include "CAN_sim.h"
+#include <FlexCAN/include/CAN_internal.h>
+#include <FlexCAN/include/CAN_gateway.h>
+#include <FlexCAN/include/CAN_shaping.h>
+#include <FlexCAN/include/CAN_cyclic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define FRAMES_DEFAULT          (2000u)
+#define SLOWDOWN_DEFAULT        (8u)
+#define CALIBRATION_ACCESSES    (20000u)
+#define BIT_NS                  (1000000000u / CAN_BITRATE)
+
+/* Longest classical frame with 8 data bytes, stuff bits included */
+#define FRAME_BITS_MAX          (135u)
+
+#define HOT_REQUEST_ID          (0x055u)
+#define HOT_REPLY_ID            (0x056u)
+
+/* Latency under bursty load: an ID on a hot message buffer and one through the RX FIFO, sent
+ * together, behind bursts of bulk frames twice the FIFO depth. The main loop polls every POLL_NS */
+#define HOT_LATENCY_ID          (0x060u)
+#define FIFO_LATENCY_ID         (0x061u)
+#define BULK_ID                 (0x300u)
+#define BURST_FRAMES            (12u)
+#define BURST_PERIOD_NS         (4000000u)
+#define CONTROL_PERIOD_NS       (1100000u)
+#define POLL_NS                 (500000u)
+
+/* Gateway from FlexCAN0 to FlexCAN1 on a bus of its own, rewriting the ID */
+#define GATEWAY_ID              (0x310u)
+#define GATEWAY_REWRITE_ID      (0x510u)
+
+/* Cyclic schedule: jitter histogram bins of JITTER_BIN_US, the last one open ended, and the bus
+ * load over windows of one scheduler tick */
+#define JITTER_BINS             (8u)
+#define JITTER_BIN_US           (10u)
+#define CYCLIC_BASE_ID          (0x100u)
+
+/* Milliseconds to bit times, the unit of the shaping intervals */
+#define MS_TICKS(ms)            ((uint32_t)(((uint64_t)(ms) * 1000000u) / BIT_NS))
+
+typedef struct {
+    uint64_t count;
+    uint64_t total;
+    uint64_t worst;
+} latency_t;
+
+typedef struct {
+    uint64_t frames;
+    uint64_t lost;
+    uint64_t sim_ns;
+    uint64_t bus_bits;
+    sim_stats_t sim;
+} result_t;
+
+static sim_bus_t* bus;
+static sim_node_t* node;
+static sim_node_t* observer;
+static double trap_ns;
+static uint32_t slowdown;
+
+/* Parsing by a protocol layer, the same in place or on a copy */
+static volatile uint32_t parsed;
+
+static void parse(const frame_t* frame)
+{
+    parsed = parsed + (frame->ID ^ frame->payload[0] ^ frame->payload[1]);
+}
+
+/* Gaps in the generator's counter are frames lost on the way */
+static void check_sequence(result_t* result, uint32_t* expected, const frame_t* frame)
+{
+    result->lost += frame->payload[0] - *expected;
+    *expected = frame->payload[0] + 1u;
+    result->frames++;
+}
+
+static int compare_u64(const void* a, const void* b)
+{
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+
+    return (x > y) - (x < y);
+}
+
+static uint64_t cpu_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+
+    return ((uint64_t)ts.tv_sec * 1000000000u) + (uint64_t)ts.tv_nsec;
+}
+
+/* CPU ns per trapped access, from a GPIO register the simulator leaves alone */
+static double calibrate(void)
+{
+    uint64_t start = cpu_ns();
+
+    for(uint32_t i = 0; i < CALIBRATION_ACCESSES; i++)
+    {
+        (void)PTD->GPIOD_PDOR;
+    }
+
+    return (double)(cpu_ns() - start) / CALIBRATION_ACCESSES;
+}
+
+static void start(result_t* result)
+{
+    sim_bus_stats_t bus_stats;
+
+    sim_get_stats(&result->sim, 1);
+    sim_get_bus_stats(bus, &bus_stats, 1);
+    result->sim_ns = sim_now();
+}
+
+static void stop(result_t* result)
+{
+    sim_bus_stats_t bus_stats;
+
+    result->sim_ns = sim_now() - result->sim_ns;
+    sim_get_stats(&result->sim, 1);
+    sim_get_bus_stats(bus, &bus_stats, 1);
+    result->bus_bits = bus_stats.bits;
+}
+
+static void report(const char* name, const result_t* r)
+{
+    uint64_t accesses = r->sim.reads + r->sim.writes;
+    double frames = (r->frames != 0u) ? (double)r->frames : 1.0;
+
+    printf("%-10s %8llu %6llu %10.0f %6.1f%% %9.1f %9.2f\n", name,
+           (unsigned long long)r->frames, (unsigned long long)r->lost,
+           (double)r->frames * 1e9 / (double)r->sim_ns,
+           100.0 * (double)r->bus_bits * BIT_NS / (double)r->sim_ns,
+           (double)accesses / frames, (double)r->sim.interrupts / frames);
+}
+
+/* A node saturates the bus, the RX FIFO interrupt fills the ring and the main loop drains it, by
+ * copies through receive_frame() or in place through lend_frames() */
+static void bench_rx(uint32_t count, uint8_t lend)
+{
+    sim_frame_t frame = { .ID = 0x123, .dlc = 8 };
+    frame_t got;
+    frame_t* lent;
+    result_t result = { 0 };
+    uint32_t expected = 0;
+    uint64_t copies = 0;
+    uint64_t* cycles = calloc(count, sizeof(uint64_t));
+    uint32_t samples = 0;
+
+    install_ID(FlexCAN_0, 0x123);
+    sim_run(1000000);
+    while( receive_frame(FlexCAN_0, &got) == Success );
+
+    start(&result);
+    sim_node_generate(node, &frame, (uint64_t)FRAME_BITS_MAX * BIT_NS, count);
+
+    uint64_t deadline = sim_now() + ((uint64_t)count * FRAME_BITS_MAX * BIT_NS * 2u) + 10000000u;
+
+    while( (result.frames + result.lost < count) && (sim_now() < deadline) )
+    {
+        /* Half a ring of frames arrives between two drains */
+        sim_run((uint64_t)(RX_RING_SIZE / 2u) * FRAME_BITS_MAX * BIT_NS);
+
+        /* Everything that arrived, timed as a whole */
+        uint64_t begin = __builtin_ia32_rdtsc();
+        uint32_t n = 0;
+
+        if( lend )
+        {
+            for(uint32_t span; (span = lend_frames(FlexCAN_0, &lent)) != 0u; n += span)
+            {
+                for(uint32_t i = 0; i < span; i++)
+                {
+                    parse(&lent[i]);
+                    check_sequence(&result, &expected, &lent[i]);
+                }
+                release_frames(FlexCAN_0, span);
+            }
+        }
+        else
+        {
+            for(; receive_frame(FlexCAN_0, &got) == Success; n++)
+            {
+                parse(&got);
+                check_sequence(&result, &expected, &got);
+                copies++;
+            }
+        }
+
+        uint64_t spent = __builtin_ia32_rdtsc() - begin;
+
+        if( (n != 0u) && (samples < count) )
+        {
+            cycles[samples++] = spent / n;
+        }
+    }
+
+    stop(&result);
+    result.lost = count - result.frames;
+    report(lend ? "rx lend" : "rx copy", &result);
+
+    qsort(cycles, samples, sizeof(uint64_t), compare_u64);
+    printf("           %.2f frame_t copies per frame, %llu TSC cycles per frame to take and parse it\n",
+           (result.frames != 0u) ? (double)copies / (double)result.frames : 0.0,
+           (unsigned long long)((samples != 0u) ? cycles[samples / 2u] : 0u));
+    free(cycles);
+}
+
+/* The main loop queues frames as fast as the queue takes them */
+static void bench_tx(uint32_t count)
+{
+    frame_t frame = { .ID = 0x200 };
+    frame_t done;
+    sim_frame_t seen;
+    result_t result = { 0 };
+    tx_delay_t delays[TX_DELAY_SLOTS];
+    uint32_t queued = 0;
+
+    while( sim_node_receive(node, &seen) == Success );
+
+    start(&result);
+
+    uint64_t deadline = sim_now() + ((uint64_t)count * FRAME_BITS_MAX * BIT_NS * 2u) + 10000000u;
+
+    while( (result.frames < count) && (sim_now() < deadline) )
+    {
+        frame.payload[0] = queued;
+
+        if( (queued < count) && (transmit_frame(FlexCAN_0, &frame) == Success) )
+        {
+            queued++;
+            continue;
+        }
+
+        while( transmitted_frame(FlexCAN_0, &done) == Success );
+
+        while( sim_node_receive(node, &seen) == Success )
+        {
+            result.frames++;
+        }
+
+        sim_run(BIT_NS * 50u);
+    }
+
+    stop(&result);
+    result.lost = count - result.frames;
+    report("tx", &result);
+
+    uint32_t n = get_tx_delays(FlexCAN_0, delays, TX_DELAY_SLOTS);
+    for(uint32_t i = 0; i < n; i++)
+    {
+        if( delays[i].ID == 0x200u )
+        {
+            printf("           worst queuing delay of ID 0x200: %u bit times\n", (unsigned)delays[i].worst_delay);
+        }
+    }
+}
+
+/* A producer emits bursts of batch frames, one burst per batch frame times so the bus stays
+ * saturated, and hands each burst to transmit_batch(), retrying what the full queue turned away.
+ * The enqueue calls are measured apart: calls, trapped register accesses and TSC cycles per frame,
+ * the cycles mostly the traps of those accesses */
+static void bench_batch(uint32_t count, uint32_t batch)
+{
+    frame_t* frames = calloc(batch, sizeof(frame_t));
+    frame_t done;
+    sim_frame_t seen;
+    sim_stats_t before, after;
+    result_t result = { 0 };
+    uint32_t queued = 0;
+    uint32_t burst = 0;
+    uint32_t pending = 0;
+    uint64_t calls = 0;
+    uint64_t accesses = 0;
+    uint64_t cycles = 0;
+    uint64_t period = (uint64_t)batch * FRAME_BITS_MAX * BIT_NS;
+    char name[16];
+
+    while( sim_node_receive(node, &seen) == Success );
+
+    start(&result);
+
+    uint64_t next_burst = sim_now();
+    uint64_t deadline = sim_now() + ((uint64_t)count * FRAME_BITS_MAX * BIT_NS * 2u) + 10000000u;
+
+    while( (result.frames < count) && (sim_now() < deadline) )
+    {
+        if( (pending == 0u) && (queued < count) && (sim_now() >= next_burst) )
+        {
+            burst = ((count - queued) < batch) ? (count - queued) : batch;
+            for(uint32_t i = 0; i < burst; i++)
+            {
+                frames[i] = (frame_t){ .ID = 0x200, .payload = { queued + i, 0 } };
+            }
+            pending = burst;
+            next_burst += period;
+        }
+
+        if( pending != 0u )
+        {
+            sim_get_stats(&before, 0);
+            uint64_t begin = __builtin_ia32_rdtsc();
+
+            uint32_t n = transmit_batch(FlexCAN_0, &frames[burst - pending], pending);
+
+            cycles += __builtin_ia32_rdtsc() - begin;
+            sim_get_stats(&after, 0);
+            accesses += (after.reads + after.writes) - (before.reads + before.writes);
+            calls++;
+
+            queued += n;
+            pending -= n;
+        }
+
+        while( transmitted_frame(FlexCAN_0, &done) == Success );
+
+        while( sim_node_receive(node, &seen) == Success )
+        {
+            result.frames++;
+        }
+
+        sim_run(BIT_NS * 50u);
+    }
+
+    stop(&result);
+    result.lost = count - result.frames;
+    snprintf(name, sizeof(name), "batch %u", (unsigned)batch);
+    report(name, &result);
+    printf("           %.2f calls, %.1f register accesses, %llu TSC cycles per frame queued\n",
+           (queued != 0u) ? (double)calls / (double)queued : 0.0,
+           (queued != 0u) ? (double)accesses / (double)queued : 0.0,
+           (unsigned long long)((queued != 0u) ? cycles / queued : 0u));
+    free(frames);
+}
+
+/* Bulk frames keep the queue full at the lowest local priority while urgent frames of a higher
+ * ID are queued periodically. At priority 0 their queuing delay should stay around one frame; at
+ * the bulk priority they wait behind the whole queue, the inversion the scheduler prevents. Each
+ * run has its own IDs so the worst delays since startup don't mix */
+static void bench_mixed(const char* name, uint32_t count, uint8_t urgent_prio, uint32_t bulk_ID, uint32_t urgent_ID)
+{
+    frame_t bulk = { .ID = bulk_ID };
+    frame_t urgent = { .ID = urgent_ID };
+    frame_t done;
+    sim_frame_t seen;
+    result_t result = { 0 };
+    tx_delay_t delays[TX_DELAY_SLOTS];
+    uint32_t urgent_sent = 0;
+    uint32_t urgent_count = count / 10u;
+    uint64_t period = (uint64_t)FRAME_BITS_MAX * BIT_NS * 10u;
+
+    while( sim_node_receive(node, &seen) == Success );
+
+    start(&result);
+
+    uint64_t next_urgent = sim_now() + period;
+    uint64_t deadline = sim_now() + ((uint64_t)count * FRAME_BITS_MAX * BIT_NS * 2u) + 10000000u;
+
+    while( (result.frames < count) && (sim_now() < deadline) )
+    {
+        if( (urgent_sent < urgent_count) && (sim_now() >= next_urgent) &&
+            (transmit_frame_prio(FlexCAN_0, &urgent, urgent_prio) == Success) )
+        {
+            urgent_sent++;
+            next_urgent += period;
+        }
+
+        /* The urgent frame is queued first, the bulk frames take whatever room is left */
+        while( transmit_frame_prio(FlexCAN_0, &bulk, TX_PRIO_LOWEST) == Success );
+
+        while( transmitted_frame(FlexCAN_0, &done) == Success );
+
+        while( sim_node_receive(node, &seen) == Success )
+        {
+            result.frames++;
+        }
+
+        sim_run(BIT_NS * 50u);
+    }
+
+    stop(&result);
+
+    /* Let the queue empty so the next benchmark starts clean */
+    sim_run((uint64_t)TX_QUEUE_SIZE * 2u * FRAME_BITS_MAX * BIT_NS);
+    while( transmitted_frame(FlexCAN_0, &done) == Success );
+    while( sim_node_receive(node, &seen) == Success );
+
+    report(name, &result);
+
+    uint32_t n = get_tx_delays(FlexCAN_0, delays, TX_DELAY_SLOTS);
+    for(uint32_t i = 0; i < n; i++)
+    {
+        if( (delays[i].ID == bulk.ID) || (delays[i].ID == urgent.ID) )
+        {
+            printf("           worst queuing delay of %s ID 0x%03X: %u bit times over %u frames\n",
+                   (delays[i].ID == urgent.ID) ? "urgent" : "bulk",
+                   (unsigned)delays[i].ID, (unsigned)delays[i].worst_delay, (unsigned)delays[i].sent);
+        }
+    }
+}
+
+static volatile uint32_t replies = 0;
+static latency_t hot_latency;
+
+/* Reply from the message buffer interrupt */
+static void on_request(const frame_t* request)
+{
+    frame_t reply = { .ID = HOT_REPLY_ID, .payload = { request->payload[0], 0 } };
+
+    if( transmit_frame_ISR(FlexCAN_0, &reply, 0) == Success )
+    {
+        replies = replies + 1u;
+    }
+}
+
+static void record(latency_t* latency, uint64_t bits)
+{
+    latency->count++;
+    latency->total += bits;
+    latency->worst = (bits > latency->worst) ? bits : latency->worst;
+}
+
+static void print_latency(const char* path, uint32_t ID, const latency_t* latency)
+{
+    double count = (latency->count != 0u) ? (double)latency->count : 1.0;
+
+    printf("           %s ID 0x%03X: latency mean %.1f us, worst %.1f us over %llu frames\n", path, (unsigned)ID,
+           (double)latency->total * BIT_NS / count / 1000.0, (double)latency->worst * BIT_NS / 1000.0,
+           (unsigned long long)latency->count);
+}
+
+/* From the timestamp to the callback, in bit times. FlexCAN_timer_now() isn't for interrupts, the
+ * 16 bits of the timer cover the few frames in between */
+static void on_hot_latency(const frame_t* frame)
+{
+    record(&hot_latency, (uint16_t)(CAN0->CAN0_TIMER - (uint16_t)frame->timestamp));
+}
+
+/* Per-ID latency from the start of the frame to the application, through the hot message buffer
+ * callback and through the RX FIFO, ring and main loop, with bursts of bulk frames in between */
+static void bench_latency(uint32_t count)
+{
+    filter_t filters[2] = {
+        { .ID = FIFO_LATENCY_ID, .mask = 0x7FF, .extended = 0 },
+        { .ID = BULK_ID,         .mask = 0x7FF, .extended = 0 },
+    };
+    sim_node_t* talker = sim_node_create(bus);
+    sim_frame_t hot = { .ID = HOT_LATENCY_ID, .dlc = 8 };
+    sim_frame_t control = { .ID = FIFO_LATENCY_ID, .dlc = 8 };
+    sim_frame_t bulk = { .ID = BULK_ID, .dlc = 8 };
+    latency_t fifo = { 0 };
+    latency_t background = { 0 };
+    result_t result = { 0 };
+    frame_t got;
+    uint32_t sent = 0;
+
+    install_filters(FlexCAN_0, filters, 2, 0);
+    install_hot_ID(FlexCAN_0, 1, HOT_LATENCY_ID, on_hot_latency);
+    sim_run(1000000);
+    while( receive_frame(FlexCAN_0, &got) == Success );
+
+    start(&result);
+
+    uint64_t next_burst = sim_now();
+    uint64_t next_control = sim_now() + (CONTROL_PERIOD_NS / 2u);
+    uint64_t deadline = sim_now() + ((uint64_t)count * CONTROL_PERIOD_NS * 2u) + 10000000u;
+
+    for(uint64_t now = sim_now(); ((hot_latency.count < count) || (fifo.count < count)) && (now < deadline); now = sim_now())
+    {
+        if( now >= next_burst )
+        {
+            sim_node_generate(node, &bulk, (uint64_t)FRAME_BITS_MAX * BIT_NS, BURST_FRAMES);
+            next_burst += BURST_PERIOD_NS;
+        }
+
+        if( (sent < count) && (now >= next_control) )
+        {
+            sim_node_send(talker, &hot);
+            sim_node_send(talker, &control);
+            sent++;
+            next_control += CONTROL_PERIOD_NS;
+        }
+
+        while( receive_frame(FlexCAN_0, &got) == Success )
+        {
+            record((got.ID == FIFO_LATENCY_ID) ? &fifo : &background, FlexCAN_timer_now(FlexCAN_0) - got.timestamp);
+            result.frames++;
+        }
+
+        sim_run(POLL_NS);
+    }
+
+    stop(&result);
+    result.frames += hot_latency.count;
+    result.lost = (2u * (uint64_t)count) - hot_latency.count - fifo.count;
+    report("latency", &result);
+    print_latency("hot message buffer", HOT_LATENCY_ID, &hot_latency);
+    print_latency("RX FIFO", FIFO_LATENCY_ID, &fifo);
+    print_latency("RX FIFO bulk", BULK_ID, &background);
+}
+
+/* A node saturates the bus of FlexCAN0, the main loop polls the gateway every POLL_NS and each
+ * frame goes out of FlexCAN1 on a second bus with a node at its end. Throughput and the load are
+ * those of the source bus, the latency from the start of the frame on one bus to its start on
+ * the other, the observer giving the first. The route adds its reception to queuing latency.
+ * At the default slowdown the traps of the second controller's interrupts leave gaps between
+ * its frames and the queue drops some, a slowdown of 32 shows the gateway keeping up */
+static void bench_gateway(uint32_t count)
+{
+    filter_t filter = { .ID = GATEWAY_ID, .mask = 0x7FF, .extended = 0 };
+    route_t route = {
+        .source = FlexCAN_0, .ID = GATEWAY_ID, .mask = 0x7FF,
+        .destination = FlexCAN_1, .rewrite_ID = GATEWAY_REWRITE_ID, .min_interval = 0,
+    };
+    sim_bus_t* far = sim_bus_create(CAN_BITRATE);
+    sim_node_t* sink = sim_node_create(far);
+    sim_frame_t frame = { .ID = GATEWAY_ID, .dlc = 8 };
+    sim_frame_t seen;
+    frame_t done;
+    route_stats_t stats = { 0 };
+    latency_t latency = { 0 };
+    result_t result = { 0 };
+    uint64_t* sent = calloc(count, sizeof(uint64_t));
+
+    sim_attach(FlexCAN_1, far);
+    if( (FlexCAN_init_RXFIFO(FlexCAN_1) != Success) || (gateway_init(&route, 1) != Success) )
+    {
+        printf("gateway setup failed\n");
+        free(sent);
+        return;
+    }
+
+    install_filters(FlexCAN_0, &filter, 1, 0);
+    sim_run(1000000);
+    while( gateway_poll(FlexCAN_0) != 0u );
+    while( sim_node_receive(observer, &seen) == Success );
+
+    start(&result);
+    sim_node_generate(node, &frame, (uint64_t)FRAME_BITS_MAX * BIT_NS, count);
+
+    uint64_t deadline = sim_now() + ((uint64_t)count * FRAME_BITS_MAX * BIT_NS * 2u) + 10000000u;
+
+    /* Until every frame went out or was dropped by the full queue of FlexCAN1 */
+    while( ((result.frames + stats.dropped) < count) && (sim_now() < deadline) )
+    {
+        (void)gateway_poll(FlexCAN_0);
+        get_route_stats(0, &stats);
+        while( transmitted_frame(FlexCAN_1, &done) == Success );
+
+        while( sim_node_receive(observer, &seen) == Success )
+        {
+            if( (seen.ID == GATEWAY_ID) && (seen.payload[0] < count) )
+            {
+                sent[seen.payload[0]] = seen.time;
+            }
+        }
+
+        while( sim_node_receive(sink, &seen) == Success )
+        {
+            if( (seen.ID == GATEWAY_REWRITE_ID) && (seen.payload[0] < count) && (sent[seen.payload[0]] != 0u) )
+            {
+                record(&latency, (seen.time - sent[seen.payload[0]]) / BIT_NS);
+                result.frames++;
+            }
+        }
+
+        sim_run(POLL_NS);
+    }
+
+    stop(&result);
+    result.lost = count - result.frames;
+    report("gateway", &result);
+    print_latency("bus to bus", GATEWAY_ID, &latency);
+
+    printf("           reception to queuing mean %.1f us, worst %.1f us, %u forwarded, %u dropped\n",
+           (stats.forwarded != 0u) ? (double)stats.total_latency * BIT_NS / stats.forwarded / 1000.0 : 0.0,
+           (double)stats.worst_latency * BIT_NS / 1000.0, (unsigned)stats.forwarded, (unsigned)stats.dropped);
+    free(sent);
+}
+
+/**
+ *  Periodic ID of a recorded application and what its consumers need of it
+ */
+typedef struct {
+    uint32_t ID;
+    uint32_t period_ms;
+    uint32_t change_ms;       /* Payload change interval, 0 for every frame */
+    shaping_rule_t rule;      /* can and ID filled in, min_interval 0 and no bucket for no rule */
+} profile_entry_t;
+
+/* Engine speed sent every 2 ms with consumers reading it every 10 ms, a status repeating its
+ * payload for 100 ms at a time, three diagnostic IDs sharing a budget of one frame per 5 ms with
+ * bursts of 4, and an ID the shaping leaves alone */
+static const profile_entry_t profile[] = {
+    { 0x0A0, 2,  0,   { .min_interval = MS_TICKS(10), .bucket = SHAPING_NO_BUCKET } },
+    { 0x1B0, 5,  100, { .on_change = 1, .bucket = SHAPING_NO_BUCKET } },
+    { 0x2C0, 5,  0,   { .bucket = 0 } },
+    { 0x2C1, 5,  0,   { .bucket = 0 } },
+    { 0x2C2, 5,  0,   { .bucket = 0 } },
+    { 0x3D0, 10, 0,   { .bucket = SHAPING_NO_BUCKET } },
+};
+
+#define PROFILE_ENTRIES         (sizeof(profile) / sizeof(profile[0]))
+
+/* The profile replayed for span_ns through transmit_frame(), then through the shaping stage,
+ * the node counting what reaches the bus. Frames the full queue refused count as lost */
+static void run_profile(const char* name, uint64_t span_ns, uint8_t shaped, result_t* result)
+{
+    uint64_t next[PROFILE_ENTRIES];
+    uint32_t sent[PROFILE_ENTRIES] = { 0 };
+    frame_t done;
+    sim_frame_t seen;
+
+    while( sim_node_receive(node, &seen) == Success );
+
+    start(result);
+
+    uint64_t begin = sim_now();
+    for(uint32_t i = 0; i < PROFILE_ENTRIES; i++)
+    {
+        next[i] = begin;
+    }
+
+    for(uint64_t now = begin; now < (begin + span_ns); now = sim_now())
+    {
+        for(uint32_t i = 0; i < PROFILE_ENTRIES; i++)
+        {
+            if( now < next[i] )
+            {
+                continue;
+            }
+
+            /* The payload of the recorded frame, either a counter or the change interval it's in */
+            uint64_t elapsed_ms = (next[i] - begin) / 1000000u;
+            uint32_t value = (profile[i].change_ms != 0u) ? (uint32_t)(elapsed_ms / profile[i].change_ms) : sent[i];
+            frame_t frame = { .ID = profile[i].ID, .payload = { value, 0 } };
+
+            status_t status = shaped ? transmit_frame_shaped(FlexCAN_0, &frame) : transmit_frame(FlexCAN_0, &frame);
+            if( status == BufferFull )
+            {
+                result->lost++;
+            }
+
+            sent[i]++;
+            next[i] += (uint64_t)profile[i].period_ms * 1000000u;
+        }
+
+        while( transmitted_frame(FlexCAN_0, &done) == Success );
+
+        while( sim_node_receive(node, &seen) == Success )
+        {
+            result->frames++;
+        }
+
+        sim_run(BIT_NS * 50u);
+    }
+
+    /* The last frames queued leave the bus */
+    sim_run(1000000);
+    while( sim_node_receive(node, &seen) == Success )
+    {
+        result->frames++;
+    }
+
+    stop(result);
+    report(name, result);
+}
+
+/* Bus load of the recorded profile without and with the shaping of its consumers' needs */
+static void bench_shaping(uint32_t count)
+{
+    result_t plain = { 0 };
+    result_t shaped = { 0 };
+    shaping_stats_t stats;
+
+    /* About count frames of the profile without shaping */
+    uint32_t per_second = 0;
+    for(uint32_t i = 0; i < PROFILE_ENTRIES; i++)
+    {
+        per_second += 1000u / profile[i].period_ms;
+    }
+    uint64_t span_ns = (uint64_t)count * 1000000000u / per_second;
+
+    run_profile("unshaped", span_ns, 0, &plain);
+
+    shaping_set_bucket(0, 4, MS_TICKS(5));
+    for(uint32_t i = 0; i < PROFILE_ENTRIES; i++)
+    {
+        shaping_rule_t rule = profile[i].rule;
+
+        if( (rule.min_interval == 0u) && (rule.on_change == 0u) && (rule.bucket == SHAPING_NO_BUCKET) )
+        {
+            continue;
+        }
+
+        rule.can = FlexCAN_0;
+        rule.ID = profile[i].ID;
+        shaping_add_rule(&rule);
+    }
+
+    run_profile("shaped", span_ns, 1, &shaped);
+
+    double plain_load = (double)plain.bus_bits / (double)plain.sim_ns;
+    double shaped_load = (double)shaped.bus_bits / (double)shaped.sim_ns;
+
+    get_shaping_stats(&stats);
+    printf("           %u passed, withheld %u by interval, %u unchanged, %u by bucket, %.1f%% of the bus load saved\n",
+           (unsigned)stats.passed, (unsigned)stats.interval, (unsigned)stats.unchanged, (unsigned)stats.bucket_empty,
+           (plain_load != 0.0) ? 100.0 * (plain_load - shaped_load) / plain_load : 0.0);
+}
+
+/* Periods in ticks of the ECU schedule, the shortest first so the automatic offsets spread them */
+static const uint32_t cyclic_periods[] = { 10, 10, 10, 10, 20, 20, 20, 20, 100, 100, 100, 100 };
+
+#define CYCLIC_COUNT            (sizeof(cyclic_periods) / sizeof(cyclic_periods[0]))
+
+static void cyclic_counter(frame_t* frame)
+{
+    static uint32_t counter = 0;
+
+    frame->payload[0] = counter++;
+    frame->payload[1] = 0;
+}
+
+/* The schedule released from LPIT0 with automatic offsets, the observer timing every frame on the
+ * bus. The jitter of a frame is its start of frame past the earliest one of its ID on the period
+ * grid, release and arbitration delays included. The peak load is the most bus time the frames
+ * starting within one tick take, against the frames of every ID starting together at offset 0 */
+static void bench_cyclic(uint32_t count)
+{
+    uint32_t per_second = 0;
+    uint32_t aligned_bits = 0;
+    frame_t done;
+    sim_frame_t seen;
+    result_t result = { 0 };
+
+    for(uint32_t i = 0; i < CYCLIC_COUNT; i++)
+    {
+        cyclic_entry_t entry = {
+            .can = FlexCAN_0, .ID = CYCLIC_BASE_ID + i, .period = cyclic_periods[i],
+            .offset = CYCLIC_AUTO_OFFSET, .prio = (uint8_t)(i / 4u), .source = cyclic_counter,
+        };
+
+        if( cyclic_add(&entry) != Success )
+        {
+            printf("cyclic_add failed\n");
+            return;
+        }
+
+        per_second += CYCLIC_TICK_HZ / cyclic_periods[i];
+        aligned_bits += FRAME_BITS_MAX;
+    }
+
+    /* About count frames, the SOF times of each ID and the bits starting within each tick */
+    uint32_t ticks = (uint32_t)(((uint64_t)count * CYCLIC_TICK_HZ) / per_second);
+    uint32_t per_ID = count + 1u;
+    uint64_t* sof = calloc((size_t)CYCLIC_COUNT * per_ID, sizeof(uint64_t));
+    uint32_t* frames = calloc(CYCLIC_COUNT, sizeof(uint32_t));
+    uint64_t* window_bits = calloc(ticks + 1u, sizeof(uint64_t));
+    uint64_t tick_ns = 1000000000u / CYCLIC_TICK_HZ;
+
+    while( sim_node_receive(observer, &seen) == Success );
+
+    start(&result);
+    uint64_t begin = sim_now();
+    cyclic_start();
+
+    while( sim_now() < (begin + ((uint64_t)ticks * tick_ns)) )
+    {
+        sim_run(tick_ns);
+
+        while( transmitted_frame(FlexCAN_0, &done) == Success );
+
+        while( sim_node_receive(observer, &seen) == Success )
+        {
+            uint32_t i = seen.ID - CYCLIC_BASE_ID;
+            uint64_t window = (seen.time - begin) / tick_ns;
+
+            if( (i >= CYCLIC_COUNT) || (window > ticks) )
+            {
+                continue;
+            }
+
+            window_bits[window] += sim_frame_bits(&seen);
+            if( frames[i] < per_ID )
+            {
+                sof[(i * per_ID) + frames[i]++] = seen.time;
+            }
+            result.frames++;
+        }
+    }
+
+    cyclic_stop();
+    stop(&result);
+    report("cyclic", &result);
+
+    uint64_t peak = 0;
+    for(uint32_t w = 0; w < ticks; w++)
+    {
+        peak = (window_bits[w] > peak) ? window_bits[w] : peak;
+    }
+    printf("           peak load %.1f%% of a %u us tick, %.1f%% with every offset at 0\n",
+           100.0 * (double)peak * BIT_NS / (double)tick_ns, (unsigned)(tick_ns / 1000u),
+           100.0 * (double)aligned_bits * BIT_NS / (double)tick_ns);
+
+    printf("           jitter histogram, bins of %u us:\n", (unsigned)JITTER_BIN_US);
+    for(uint32_t i = 0; i < CYCLIC_COUNT; i++)
+    {
+        uint64_t period_ns = (uint64_t)cyclic_periods[i] * tick_ns;
+        uint64_t* times = &sof[i * per_ID];
+        uint32_t bins[JITTER_BINS] = { 0 };
+        uint64_t earliest = UINT64_MAX;
+        uint64_t worst = 0;
+        cyclic_stats_t stats;
+
+        /* Each start of frame brought back to the first period */
+        for(uint32_t k = 0; k < frames[i]; k++)
+        {
+            uint64_t phase = times[k] - (k * period_ns);
+            earliest = (phase < earliest) ? phase : earliest;
+        }
+
+        for(uint32_t k = 0; k < frames[i]; k++)
+        {
+            uint64_t jitter = times[k] - (k * period_ns) - earliest;
+            uint32_t bin = (uint32_t)(jitter / (JITTER_BIN_US * 1000u));
+
+            bins[(bin < JITTER_BINS) ? bin : (JITTER_BINS - 1u)]++;
+            worst = (jitter > worst) ? jitter : worst;
+        }
+
+        get_cyclic_stats(i, &stats);
+        printf("           ID 0x%03X %3u ms offset %2u:", (unsigned)(CYCLIC_BASE_ID + i), (unsigned)cyclic_periods[i],
+               (unsigned)stats.offset);
+        for(uint32_t b = 0; b < JITTER_BINS; b++)
+        {
+            printf(" %4u", (unsigned)bins[b]);
+        }
+        printf("  worst %.0f us, release %.1f us\n", (double)worst / 1000.0,
+               (double)stats.worst_release_jitter * 1e6 / CYCLIC_CLOCK_HZ);
+    }
+
+    free(sof);
+    free(frames);
+    free(window_bits);
+}
+
+/* Request to the hot message buffer, answered straight from its interrupt, timed by a node
+   that sees both since the requesting node doesn't receive its own frames */
+static void bench_turnaround(uint32_t count)
+{
+    sim_frame_t request = { .ID = HOT_REQUEST_ID, .dlc = 8 };
+    sim_frame_t seen;
+    result_t result = { 0 };
+    uint64_t total = 0;
+    uint64_t worst = 0;
+
+    install_hot_ID(FlexCAN_0, 0, HOT_REQUEST_ID, on_request);
+    sim_run(1000000);
+    while( sim_node_receive(observer, &seen) == Success );
+
+    start(&result);
+
+    for(uint32_t i = 0; i < count; i++)
+    {
+        uint64_t sent = 0;
+        uint64_t deadline = sim_now() + 20000000u;
+
+        request.payload[0] = i;
+        sim_node_send(node, &request);
+
+        while( sim_now() < deadline )
+        {
+            if( sim_node_receive(observer, &seen) != Success )
+            {
+                sim_run(BIT_NS * 10u);
+                continue;
+            }
+
+            if( (seen.ID == HOT_REQUEST_ID) && (seen.payload[0] == (uint8_t)i) )
+            {
+                sent = seen.time + ((uint64_t)(sim_frame_bits(&request) - 3u) * BIT_NS);
+            }
+            else if( (sent != 0u) && (seen.ID == HOT_REPLY_ID) && (seen.payload[0] == (uint8_t)i) )
+            {
+                /* From the end of the request to the start of the reply */
+                uint64_t turnaround = seen.time - sent;
+
+                total += turnaround;
+                worst = (turnaround > worst) ? turnaround : worst;
+                result.frames++;
+                break;
+            }
+        }
+    }
+
+    stop(&result);
+    result.lost = count - result.frames;
+    report("hot reply", &result);
+    printf("           turnaround mean %.1f us, worst %.1f us of simulated time\n",
+           (result.frames != 0u) ? (double)total / (double)result.frames / 1000.0 : 0.0, (double)worst / 1000.0);
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t frames = (argc > 1) ? (uint32_t)strtoul(argv[1], 0, 0) : FRAMES_DEFAULT;
+    slowdown = (argc > 2) ? (uint32_t)strtoul(argv[2], 0, 0) : SLOWDOWN_DEFAULT;
+
+    sim_config_t config = { .slowdown = slowdown, .tick_ns = 50000, .osc_hz = 8000000, .periph_hz = 48000000 };
+
+    if( sim_init(&config) != Success )
+    {
+        printf("sim_init failed\n");
+        return 1;
+    }
+
+    bus = sim_bus_create(CAN_BITRATE);
+    sim_attach(FlexCAN_0, bus);
+    node = sim_node_create(bus);
+    observer = sim_node_create(bus);
+
+    if( FlexCAN_init_RXFIFO(FlexCAN_0) != Success )
+    {
+        printf("FlexCAN_init_RXFIFO failed\n");
+        return 1;
+    }
+
+    trap_ns = calibrate();
+
+    printf("%u frames at %u bit/s, slowdown %u, %.0f ns of CPU time per trapped register access\n\n",
+           frames, (unsigned)CAN_BITRATE, slowdown, trap_ns);
+    printf("%-10s %8s %6s %10s %7s %9s %9s\n", "", "frames", "lost", "frames/s", "load",
+           "access/f", "irq/f");
+
+    bench_rx(frames, 0);
+    bench_rx(frames, 1);
+    bench_tx(frames);
+    bench_batch(frames, 1);
+    bench_batch(frames, 4);
+    bench_batch(frames, 16);
+    bench_batch(frames, 64);
+    bench_mixed("mixed", frames, 0, 0x300, 0x480);
+    bench_mixed("mixed fifo", frames, TX_PRIO_LOWEST, 0x301, 0x481);
+    bench_turnaround(frames / 10u);
+    bench_latency(frames / 10u);
+    bench_gateway(frames);
+    bench_shaping(frames / 2u);
+    bench_cyclic(frames / 2u);
+
+    return 0;
+}
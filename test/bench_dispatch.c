@@ -0,0 +1,153 @@
+/**
+ * Source file
+ */
+
+/*
+ * Cost of dispatch_frame() per frame against the number of registered IDs, run with
+ * make -C test bench. Next to it the linear comparison of the ID against every registration
+ * that applications do in the super-loop without it. Standard IDs go through the direct
+ * table, extended IDs with one mask through a single binary search, and extended IDs with
+ * a mask each through one binary search per mask, the worst case of the sorted table.
+ * Registrations can't be removed, each kind grows its own table in steps.
+ */
+
+#include <FlexCAN/include/CAN_dispatch.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define LOOKUPS     (1u << 20)
+#define FRAMES      (256u)
+
+typedef enum{
+    STANDARD,
+    EXTENDED,
+    EXTENDED_MASKS,
+} id_kind_t;
+
+typedef struct {
+    uint32_t ID;
+    uint32_t mask;
+} registration_t;
+
+static volatile uint32_t handled = 0;
+
+static void handler(const frame_t* frame)
+{
+    (void)frame;
+    handled++;
+}
+
+static double elapsed_ns(const struct timespec* start, const struct timespec* end)
+{
+    return ((double)(end->tv_sec - start->tv_sec) * 1e9) + (double)(end->tv_nsec - start->tv_nsec);
+}
+
+/* A new registration of the kind, distinct from the previous ones with overwhelming odds */
+static registration_t make_registration(id_kind_t kind, uint32_t n)
+{
+    registration_t r;
+
+    switch( kind )
+    {
+        case STANDARD:
+            r.mask = 0x7FFu;
+            r.ID = (((uint32_t)rand() & 0x3Fu) << 5) | n;
+            break;
+        case EXTENDED:
+            r.mask = CAN_ID_MASK;
+            r.ID = CAN_ID_EXT | ((uint32_t)rand() & CAN_ID_MASK);
+            break;
+        default:
+            /* Every mask ignores a different bit */
+            r.mask = CAN_ID_MASK & ~(1u << n);
+            r.ID = CAN_ID_EXT | ((uint32_t)rand() & r.mask);
+            break;
+    }
+
+    return r;
+}
+
+/* Time both lookups over frames matching the registrations, in ns per frame */
+static void measure(FlexCAN_instance_t can, const registration_t* registrations, uint32_t count,
+                    double* dispatch_ns, double* linear_ns)
+{
+    static frame_t frames[FRAMES];
+    struct timespec start, end;
+
+    for(uint32_t i = 0; i < FRAMES; i++)
+    {
+        frames[i].ID = registrations[(uint32_t)rand() % count].ID;
+    }
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+    for(uint32_t i = 0; i < LOOKUPS; i++)
+    {
+        (void)dispatch_frame(can, &frames[i % FRAMES]);
+    }
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &end);
+    *dispatch_ns = elapsed_ns(&start, &end) / LOOKUPS;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+    for(uint32_t i = 0; i < LOOKUPS; i++)
+    {
+        const frame_t* frame = &frames[i % FRAMES];
+
+        for(uint32_t r = 0; r < count; r++)
+        {
+            if( ((frame->ID ^ registrations[r].ID) & (CAN_ID_EXT | registrations[r].mask)) == 0u )
+            {
+                handler(frame);
+                break;
+            }
+        }
+    }
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &end);
+    *linear_ns = elapsed_ns(&start, &end) / LOOKUPS;
+}
+
+/* Grow the table of the kind up to count registrations, measuring at every step */
+static void run(const char* name, id_kind_t kind, uint32_t count)
+{
+    static registration_t registrations[DISPATCH_EXT_ENTRIES];
+    uint32_t registered = 0;
+
+    /* Standard and extended IDs have tables of their own, the extended IDs with a mask each go
+     * to the other instance so they don't share the extended table */
+    FlexCAN_instance_t can = (kind == EXTENDED_MASKS) ? FlexCAN_1 : FlexCAN_0;
+
+    for(uint32_t step = 1; step <= count; step *= 2u)
+    {
+        while( registered < step )
+        {
+            registrations[registered] = make_registration(kind, registered);
+            if( dispatch_register(can, registrations[registered].ID, registrations[registered].mask, handler) != Success )
+            {
+                printf("dispatch_register failed\n");
+                exit(1);
+            }
+            registered++;
+        }
+
+        double dispatch_ns, linear_ns;
+        uint32_t before = handled;
+
+        measure(can, registrations, registered, &dispatch_ns, &linear_ns);
+
+        printf("%-16s %6u %12.1f %10.1f %8s\n", name, (unsigned)registered, dispatch_ns, linear_ns,
+               ((handled - before) == (2u * LOOKUPS)) ? "yes" : "NO");
+    }
+}
+
+int main(void)
+{
+    srand(1);
+
+    printf("%-16s %6s %12s %10s %8s\n", "IDs", "count", "dispatch ns", "linear ns", "handled");
+
+    run("standard", STANDARD, DISPATCH_STD_ENTRIES);
+    run("extended", EXTENDED, DISPATCH_EXT_ENTRIES);
+    run("extended masks", EXTENDED_MASKS, DISPATCH_EXT_ENTRIES / 4u);
+
+    return 0;
+}
@@ -0,0 +1,93 @@
+/**
+ * Source file
+ */
+
+/*
+ * Table entries and false positives of compile_filters() on synthetic accept lists, run with
+ * make -C test bench. Random lists spread over the whole standard ID space, clustered ones
+ * take a few ranges of neighbouring IDs as DBC files tend to, the J1939 one varies the PGN of
+ * extended IDs. The false positives of extended IDs are the upper bound of
+ * filters_false_positives(), the fraction is taken over every ID the table accepts.
+ */
+
+#include <FlexCAN/include/CAN_filter_compiler.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define IDS_MAX     (500u)
+
+typedef enum{
+    RANDOM,
+    CLUSTERED,
+    J1939,
+} list_kind_t;
+
+static uint32_t make_list(uint32_t* ids, uint32_t count, list_kind_t kind)
+{
+    for(uint32_t i = 0; i < count; i++)
+    {
+        switch( kind )
+        {
+            case RANDOM:
+                ids[i] = (uint32_t)rand() & 0x7FFu;
+                break;
+            case CLUSTERED:
+                ids[i] = ((((uint32_t)rand() % 6u) * 0x150u) + ((uint32_t)rand() % 48u)) & 0x7FFu;
+                break;
+            default:
+                /* Priority 6, PGNs of the proprietary B range, a few source addresses */
+                ids[i] = (6u << 26) | ((0xFF00u + ((uint32_t)rand() & 0xFFu)) << 8) | ((uint32_t)rand() % 4u);
+                break;
+        }
+    }
+
+    return count;
+}
+
+static void run(const char* name, list_kind_t kind, uint32_t count, uint32_t budget, uint32_t tolerated)
+{
+    static uint32_t ids[IDS_MAX];
+    static filter_t filters[IDS_MAX];
+    residual_filter_t residual;
+    struct timespec start, end;
+
+    srand(count + budget);
+    make_list(ids, count, kind);
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+    uint32_t used = compile_filters(ids, count, (kind == J1939) ? 1u : 0u, budget, tolerated, filters, &residual);
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &end);
+
+    uint32_t false_positives = filters_false_positives(filters, used, residual.count);
+    double us = ((double)(end.tv_sec - start.tv_sec) * 1e6) + ((double)(end.tv_nsec - start.tv_nsec) / 1e3);
+
+    printf("%-10s %6u %6u %6u %7u %8u %7.1f%% %10.0f\n", name, (unsigned)residual.count, (unsigned)budget,
+           (unsigned)tolerated, (unsigned)used, (unsigned)false_positives,
+           100.0 * (double)false_positives / (double)(residual.count + false_positives), us);
+}
+
+int main(void)
+{
+    static const uint32_t counts[] = { 50, 200, 500 };
+    static const uint32_t budgets[] = { 8, 32, 104 };
+
+    printf("%-10s %6s %6s %6s %7s %8s %8s %10s\n", "list", "IDs", "budget", "tol", "entries",
+           "false+", "fraction", "cpu us");
+
+    for(uint32_t c = 0; c < (sizeof(counts) / sizeof(counts[0])); c++)
+    {
+        for(uint32_t b = 0; b < (sizeof(budgets) / sizeof(budgets[0])); b++)
+        {
+            run("random", RANDOM, counts[c], budgets[b], 0);
+            run("clustered", CLUSTERED, counts[c], budgets[b], 0);
+            run("j1939", J1939, counts[c], budgets[b], 0);
+        }
+    }
+
+    /* Trading table entries for a software check */
+    run("clustered", CLUSTERED, 200, 104, 50);
+    run("clustered", CLUSTERED, 200, 104, 200);
+
+    return 0;
+}
@@ -0,0 +1,2833 @@
+/**
+ * Source file
+ */
+
+#define _GNU_SOURCE
+
+#include "CAN_sim.h"
+#include <FlexCAN/include/CAN_internal.h>
+#include "S32K142_features.h"
+#include <errno.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+
+/* Trap flag of EFLAGS, single-steps the instruction the fault handler returns to */
+#define EFLAGS_TF               (1u << 8)
+
+/* Write bit of the page fault error code */
+#define PF_ERR_WRITE            (2u)
+
+#define PAGE_BYTES              (4096u)
+#define NS_PER_S                (1000000000u)
+
+/* Longest gap between two clock readings still counted as simulated time, see sim_time() */
+#define HOST_STALL_NS           (1000000u)
+
+/* Word index of a register in its block */
+#define CAN_REG(field)          (offsetof(CAN0_Type, field) / sizeof(uint32_t))
+#define PCC_REG(field)          (offsetof(PCC_Type, field) / sizeof(uint32_t))
+#define SCG_REG(field)          (offsetof(SCG_Type, field) / sizeof(uint32_t))
+#define LPIT_REG(field)         (offsetof(LPIT_Type, field) / sizeof(uint32_t))
+#define NVIC_REG(field)         (offsetof(S32_NVIC_Type, field) / sizeof(uint32_t))
+#define EDMA_REG(field)         (offsetof(DMA_Type, field) / sizeof(uint32_t))
+
+/* FlexCAN register words */
+#define R_MCR                   CAN_REG(CAN0_MCR)
+#define R_CTRL1                 CAN_REG(CAN0_CTRL1)
+#define R_TIMER                 CAN_REG(CAN0_TIMER)
+#define R_RXMGMASK              CAN_REG(CAN0_RXMGMASK)
+#define R_RX14MASK              CAN_REG(CAN0_RX14MASK)
+#define R_RX15MASK              CAN_REG(CAN0_RX15MASK)
+#define R_ECR                   CAN_REG(CAN0_ECR)
+#define R_ESR1                  CAN_REG(CAN0_ESR1)
+#define R_IMASK1                CAN_REG(CAN0_IMASK1)
+#define R_IFLAG1                CAN_REG(CAN0_IFLAG1)
+#define R_CTRL2                 CAN_REG(CAN0_CTRL2)
+#define R_ESR2                  CAN_REG(CAN0_ESR2)
+#define R_CRCR                  CAN_REG(CAN0_CRCR)
+#define R_RXFGMASK              CAN_REG(CAN0_RXFGMASK)
+#define R_RXFIR                 CAN_REG(CAN0_RXFIR)
+#define R_CBT                   CAN_REG(CAN0_CBT)
+#define R_MB0                   CAN_REG(Classic_RX_FIFO)
+#define R_ID_TABLE              CAN_REG(ID_TABLE_RXFIFO)
+#define R_RXIMR0                CAN_REG(CAN0_RXIMR0)
+#define R_FDCTRL                CAN_REG(CAN0_FDCTRL)
+#define R_FDCBT                 CAN_REG(CAN0_FDCBT)
+#define R_FDCRC                 CAN_REG(CAN0_FDCRC)
+
+/* Words of a message buffer, and the message buffer RAM */
+#define MB_WORDS                (4u)
+#define MB_MAX                  (32u)
+#define MB_CS                   (0u)
+#define MB_ID                   (1u)
+#define MB_WORDS_MAX            (2u + MAX_FD_MTU_WORDS)
+
+/* MCR fields */
+#define MCR_MAXMB               (0x7Fu)
+#define MCR_IDAM_SHIFT          (8u)
+#define MCR_FDEN                (1u << 11)
+#define MCR_AEN                 (1u << 12)
+#define MCR_DMA                 (1u << 15)
+#define MCR_LPRIOEN             (1u << 13)
+#define MCR_IRMQ                (1u << 16)
+#define MCR_SRXDIS              (1u << 17)
+#define MCR_LPMACK              (1u << 20)
+#define MCR_FRZACK              (1u << 24)
+#define MCR_SOFTRST             (1u << 25)
+#define MCR_NOTRDY              (1u << 27)
+#define MCR_HALT                (1u << 28)
+#define MCR_RFEN                (1u << 29)
+#define MCR_FRZ                 (1u << 30)
+#define MCR_MDIS                (1u << 31)
+#define MCR_STATUS              (MCR_LPMACK | MCR_FRZACK | MCR_NOTRDY)
+#define MCR_FREEZE_ONLY         (0x2083FB7Fu)
+#define MCR_RESET               (0xD890000Fu)
+
+/* CTRL1 fields */
+#define CTRL1_LBUF              (1u << 4)
+#define CTRL1_BOFFREC           (1u << 6)
+#define CTRL1_RWRNMSK           (1u << 10)
+#define CTRL1_TWRNMSK           (1u << 11)
+#define CTRL1_CLKSRC            (1u << 13)
+#define CTRL1_ERRMSK            (1u << 14)
+#define CTRL1_BOFFMSK           (1u << 15)
+#define CTRL1_FREEZE_ONLY       (0xFFFF10BFu)
+
+/* CTRL2 fields */
+#define CTRL2_MRP               (1u << 18)
+#define CTRL2_RFFN_SHIFT        (24u)
+#define CTRL2_BOFFDONEMSK       (1u << 30)
+#define CTRL2_FREEZE_ONLY       (0x0FFFFFFFu)
+#define CTRL2_RESET             (0x00B00000u)
+
+/* CBT fields */
+#define CBT_BTF                 (1u << 31)
+
+/* ESR1 fields */
+#define ESR1_ERRINT             (1u << 1)
+#define ESR1_BOFFINT            (1u << 2)
+#define ESR1_FLTCONF_SHIFT      (4u)
+#define ESR1_IDLE               (1u << 7)
+#define ESR1_ACKERR             (1u << 13)
+#define ESR1_RWRNINT            (1u << 16)
+#define ESR1_TWRNINT            (1u << 17)
+#define ESR1_SYNCH              (1u << 18)
+#define ESR1_BOFFDONEINT        (1u << 19)
+#define ESR1_W1C                (0x003B0006u)
+#define ESR1_READ_CLEAR         (0xDC00FC00u)
+
+/* ECR fields, the passive limit, the bus-off limit and the recessive bits of a bus-off recovery */
+#define ECR_RXERRCNT_SHIFT      (8u)
+#define ERROR_PASSIVE           (128u)
+#define ERROR_BUS_OFF           (256u)
+#define RECOVERY_BITS           (128u * 11u)
+
+/* IFLAG1 bits of the RX FIFO */
+#define IFLAG1_BUF0I            (1u << 0)
+#define IFLAG1_BUF5I            (1u << 5)
+#define IFLAG1_BUF6I            (1u << 6)
+#define IFLAG1_BUF7I            (1u << 7)
+
+/* RX FIFO depth, the warning level, and the IDHIT field of its control/status word */
+#define FIFO_DEPTH              (6u)
+#define FIFO_WARNING            (5u)
+#define FIFO_IDHIT_SHIFT        (23u)
+
+/* FDCTRL */
+#define FDCTRL_MBDSR0_SHIFT     (16u)
+#define FDCTRL_FDRATE           (1u << 31)
+#define FDCTRL_RESET            (0x80000100u)
+
+/* Message buffer control/status word */
+#define CS_EDL                  (1u << 31)
+#define CS_BRS                  (1u << 30)
+#define CS_CODE_SHIFT           (24u)
+#define CS_SRR                  (1u << 22)
+#define CS_IDE                  (1u << 21)
+#define CS_RTR                  (1u << 20)
+#define CS_DLC_SHIFT            (16u)
+#define CS_TIMESTAMP            (0xFFFFu)
+#define ID_STD_SHIFT            (18u)
+#define ID_PRIO_SHIFT           (29u)
+
+/* Message buffer CODE values */
+typedef enum {
+    CODE_RX_INACTIVE = 0x0,
+    CODE_RX_FULL     = 0x2,
+    CODE_RX_EMPTY    = 0x4,
+    CODE_RX_OVERRUN  = 0x6,
+    CODE_TX_INACTIVE = 0x8,
+    CODE_TX_ABORT    = 0x9,
+    CODE_TX_DATA     = 0xC
+} code_t;
+
+/* Bits after the end of frame before the bus is idle, and idle bits to synchronize */
+#define INTERMISSION_BITS       (3u)
+#define SYNC_BITS               (11u)
+
+/* Longest stuffed part of a frame, and the CAN FD payloads the 17-bit CRC covers */
+#define STREAM_BITS_MAX         (640u)
+#define FD_CRC17_BYTES          (16u)
+
+/* SOSC start up time in crystal cycles */
+#define SOSC_STARTUP_CYCLES     (4096u)
+#define SOSCCSR_SOSCEN          (1u << 0)
+#define SOSCCSR_SOSCVLD         (1u << 24)
+
+/* Clock gate and presence bits of the PCC registers */
+#define PCC_CGC                 (1u << 30)
+#define PCC_PR                  (1u << 31)
+
+/* LPIT0 fields */
+#define LPIT_CHANNELS           (4u)
+#define LPIT_TCTRL_T_EN         (1u << 0)
+#define LPIT_TMR_WORDS          (4u)
+
+/* eDMA fields: the byte wide request enable registers, transfer attributes and channel status */
+#define EDMA_CHANNELS           (16u)
+#define EDMA_ALL_CHANNELS       (1u << 6)
+#define EDMA_ATTR_SMOD_SHIFT    (11u)
+#define EDMA_ATTR_SIZES         (0x0707u)
+#define EDMA_ATTR_SIZES_32      (0x0202u)
+#define EDMA_CITER_MASK         (0x7FFFu)
+#define EDMA_CSR_INTMAJOR       (1u << 1)
+#define EDMA_CSR_DREQ           (1u << 3)
+#define EDMA_CSR_DONE           (1u << 7)
+
+/* DMAMUX channel configuration */
+#define DMAMUX_ENBL             (1u << 7)
+#define DMAMUX_SOURCE           (0x3Fu)
+
+/* NVIC interrupts of the host */
+#define NVIC_IRQS               (240u)
+#define NVIC_WORDS              (NVIC_IRQS / 32u)
+#define NVIC_IP_OFFSET          (offsetof(S32_NVIC_Type, IP))
+
+/* Register blocks the driver accesses, at the addresses test/Makefile links them */
+typedef enum {
+    BLOCK_CAN0,
+    BLOCK_CAN1,
+    BLOCK_SCG,
+    BLOCK_PCC,
+    BLOCK_PORTD,
+    BLOCK_PORTE,
+    BLOCK_PTD,
+    BLOCK_NVIC,
+    BLOCK_EDMA,
+    BLOCK_DMAMUX,
+    BLOCK_LPIT0,
+    BLOCKS
+} block_id_t;
+
+#define BLOCK_WORDS_MAX         (sizeof(DMA_Type) / sizeof(uint32_t))
+
+typedef struct {
+    uintptr_t address;             /* Address the driver accesses */
+    uint32_t words;
+    uintptr_t page;                /* Pages holding the block */
+    size_t length;
+    volatile uint32_t* regs;       /* Same memory through the writable mapping of the simulator */
+    uint32_t before[BLOCK_WORDS_MAX];  /* Snapshot taken before the trapped instruction */
+    uint32_t fault_word;           /* Word the instruction faulted on, and whether it wrote */
+    uint8_t fault_write;
+    uint32_t fault_byte;           /* Byte of that word, for the byte wide registers */
+} block_t;
+
+/* State of a FlexCAN instance beyond its registers */
+typedef struct {
+    volatile uint32_t* regs;
+    uint32_t pcc_word;             /* PCC register gating its clock */
+    uint32_t mb_count;
+    sim_bus_t* bus;
+
+    /* Mode handshakes, times in simulated ns */
+    uint8_t disabled;              /* MDIS, low power acknowledged from lpm_at */
+    uint8_t freeze_requested;      /* FRZ and HALT, acknowledged from freeze_at */
+    uint8_t frozen;
+    uint64_t lpm_at;
+    uint64_t freeze_at;
+    uint64_t ready_at;             /* Synchronized to the bus from then on */
+
+    /* Free running timer, counting from timer_base since timer_since while running */
+    uint8_t timer_running;
+    uint64_t timer_since;
+    uint32_t timer_base;
+
+    /* Transmission message buffers waiting for the bus, the one on it, and requests made meanwhile */
+    uint32_t tx_pending;
+    uint64_t tx_since[MB_MAX];
+    int32_t tx_mb;
+    uint32_t tx_abort;
+    uint32_t tx_deactivated;
+
+    /* Fault confinement: off the bus until recovery_at, and later while BOFFREC holds it */
+    uint8_t bus_off;
+    uint64_t recovery_at;
+
+    /* RX FIFO, its output is fifo[0] */
+    uint32_t fifo[FIFO_DEPTH][MB_WORDS];
+    uint32_t fifo_count;
+
+    /* Message buffer locked by a read of its control/status word, and the frame held for it */
+    int32_t locked_mb;
+    uint8_t held;
+    int32_t held_mb;
+    uint32_t held_words[MB_WORDS_MAX];
+} controller_t;
+
+struct sim_bus {
+    uint32_t bitrate;
+    uint32_t data_bitrate;
+    uint8_t used;
+
+    /* Bit time a start of frame may begin at */
+    uint64_t idle_from;
+
+    /* Frame on the bus, times in bits */
+    uint8_t busy;
+    uint64_t sof;
+    uint64_t end;
+    sim_frame_t frame;
+    controller_t* sender_can;
+    int32_t sender_mb;
+    sim_node_t* sender_node;
+    uint32_t receivers;            /* Controllers on the bus at the start of frame */
+
+    sim_bus_stats_t stats;
+};
+
+struct sim_node {
+    sim_bus_t* bus;
+
+    /* Frames waiting for the bus, and the bit time each became ready */
+    sim_frame_t tx[SIM_NODE_QUEUE];
+    uint64_t tx_ready[SIM_NODE_QUEUE];
+    uint32_t tx_head;
+    uint32_t tx_tail;
+
+    sim_frame_t rx[SIM_NODE_RX_QUEUE];
+    uint32_t rx_head;
+    uint32_t rx_tail;
+
+    /* Periodic generator */
+    sim_frame_t gen_frame;
+    uint64_t gen_period;
+    uint64_t gen_next;
+    uint32_t gen_left;
+
+    sim_node_stats_t stats;
+};
+
+/* LPIT0 channel, counting since its enable */
+typedef struct {
+    uint8_t running;
+    uint64_t since;
+    uint64_t timeouts;
+} lpit_channel_t;
+
+/* Handlers of the driver, weak so a test links only the modules it needs */
+void LPIT0_Ch0_IRQHandler(void) __attribute__((weak));
+void CAN0_ORed_IRQHandler(void) __attribute__((weak));
+void CAN0_Error_IRQHandler(void) __attribute__((weak));
+void CAN0_ORed_0_15_MB_IRQHandler(void) __attribute__((weak));
+void CAN0_ORed_16_31_MB_IRQHandler(void) __attribute__((weak));
+void CAN1_ORed_IRQHandler(void) __attribute__((weak));
+void CAN1_Error_IRQHandler(void) __attribute__((weak));
+void CAN1_ORed_0_15_MB_IRQHandler(void) __attribute__((weak));
+
+static const sim_config_t default_config = {
+        .slowdown  = 1,
+        .tick_ns   = 50000,
+        .osc_hz    = 8000000,
+        .periph_hz = 48000000,
+};
+
+static sim_config_t config;
+static block_t blocks[BLOCKS];
+static controller_t controllers[FlexCAN_instances];
+static struct sim_bus buses[SIM_BUSES];
+static struct sim_node nodes[SIM_NODES];
+static uint32_t node_count = 0;
+static lpit_channel_t lpit[LPIT_CHANNELS];
+static uint64_t sosc_valid_at = UINT64_MAX;
+static uint32_t nvic_enabled[NVIC_WORDS];
+static uint32_t nvic_pending[NVIC_WORDS];
+static sim_stats_t stats;
+static uint64_t start_ns;
+static uint64_t clock_last_ns;
+static uint64_t clock_skipped_ns;
+
+/* Blocks opened for the instruction being stepped, the time of its access, and whether the
+ * interrupted context had the tick blocked */
+static volatile uint32_t trap_blocks = 0;
+static uint64_t trap_now;
+static uint8_t trap_tick_blocked;
+static uint64_t trap_entry;
+
+/* Simulated CPU: PRIMASK and whether a handler runs */
+static volatile sig_atomic_t cpu_masked = 0;
+static volatile sig_atomic_t cpu_in_handler = 0;
+static volatile int32_t cpu_active_irq = -1;
+
+/* Nesting of the simulator's own code, a tick arriving then is deferred */
+static volatile sig_atomic_t model_depth = 0;
+static volatile sig_atomic_t tick_deferred = 0;
+
+static void model_sync(uint64_t now);
+static void dispatch(void);
+static block_id_t block_of(uintptr_t address);
+
+static uint64_t wall_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t)ts.tv_sec * NS_PER_S) + (uint64_t)ts.tv_nsec;
+}
+
+/* Simulated time at a wall clock reading. The signals come every tick, so a longer gap between
+ * two readings means the host didn't run the process: only HOST_STALL_NS of it is counted, or a
+ * busy host would show up as interrupt latencies the target doesn't have. Called with the tick
+ * held off */
+static uint64_t sim_time(uint64_t wall)
+{
+    if( wall > clock_last_ns )
+    {
+        uint64_t gap = wall - clock_last_ns;
+
+        if( gap > HOST_STALL_NS )
+        {
+            clock_skipped_ns += gap - HOST_STALL_NS;
+        }
+        clock_last_ns = wall;
+    }
+
+    return (clock_last_ns - start_ns - clock_skipped_ns) / config.slowdown;
+}
+
+/* Report a misuse of the hardware the driver would fault on, and stop */
+static void sim_abort(const char* message)
+{
+    static const char prefix[] = "CAN_sim: ";
+
+    (void)!write(STDERR_FILENO, prefix, sizeof(prefix) - 1u);
+    (void)!write(STDERR_FILENO, message, strlen(message));
+    (void)!write(STDERR_FILENO, "\n", 1);
+    abort();
+}
+
+static void model_enter(void)
+{
+    model_depth = model_depth + 1;
+    COMPILER_BARRIER();
+}
+
+static void model_exit(void)
+{
+    COMPILER_BARRIER();
+    model_depth = model_depth - 1;
+
+    /* Run the tick that arrived meanwhile, its interrupts wait for the next trap or tick */
+    if( (model_depth == 0) && tick_deferred )
+    {
+        tick_deferred = 0;
+        model_depth = 1;
+        model_sync(sim_now());
+        model_depth = 0;
+    }
+}
+
+uint64_t sim_now(void)
+{
+    uint64_t now;
+
+    model_enter();
+    now = sim_time(wall_ns());
+    model_exit();
+
+    return now;
+}
+
+/*------------------------------------ Bus time ---------------------------------------*/
+
+/* Bit time of the bus at a simulated time, rounded down or up */
+static uint64_t bits_floor(const sim_bus_t* bus, uint64_t ns)
+{
+    return (uint64_t)(((unsigned __int128)ns * bus->bitrate) / NS_PER_S);
+}
+
+static uint64_t bits_ceil(const sim_bus_t* bus, uint64_t ns)
+{
+    return (uint64_t)((((unsigned __int128)ns * bus->bitrate) + NS_PER_S - 1u) / NS_PER_S);
+}
+
+/* Simulated time of a bit time of the bus */
+static uint64_t bits_ns(const sim_bus_t* bus, uint64_t bits)
+{
+    return (uint64_t)((((unsigned __int128)bits * NS_PER_S) + bus->bitrate - 1u) / bus->bitrate);
+}
+
+/* Byte of a payload in message buffer word order */
+static uint8_t payload_byte(const uint32_t* payload, uint32_t i)
+{
+    return (uint8_t)(payload[i / 4u] >> (24u - (8u * (i % 4u))));
+}
+
+/* Payload lengths of the CAN FD data length codes */
+static const uint8_t fd_lengths[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64 };
+
+static uint32_t frame_length(const sim_frame_t* frame)
+{
+    if( frame->edl )
+    {
+        return fd_lengths[frame->dlc & 0xFu];
+    }
+
+    return frame->rtr ? 0u : ((frame->dlc < 8u) ? frame->dlc : 8u);
+}
+
+/* A complementary stuff bit follows five equal bits, and starts the next run. Those following
+ * a bit from the given one on are counted in late as well */
+static uint32_t stuff_bits(const uint8_t* bits, uint32_t n, uint32_t from, uint32_t* late)
+{
+    uint32_t stuffed = 0;
+    uint32_t run = 1;
+    uint8_t last = bits[0];
+
+    *late = 0;
+    for(uint32_t i = 1; i < n; i++)
+    {
+        if( bits[i] == last )
+        {
+            run++;
+        }
+        else
+        {
+            last = bits[i];
+            run = 1;
+        }
+
+        if( run == 5u )
+        {
+            stuffed++;
+            *late += (i >= from) ? 1u : 0u;
+            last = (uint8_t)!last;
+            run = 1;
+        }
+    }
+
+    return stuffed;
+}
+
+/* Bits of a frame, and how many of them a CAN FD frame sends in its data phase: from the bit
+ * rate switch to the CRC delimiter */
+static uint32_t frame_bits(const sim_frame_t* frame, uint32_t* data_bits)
+{
+    uint8_t bits[STREAM_BITS_MAX];
+    uint32_t n = 0;
+    uint32_t extended = frame->ID >> 31;
+    uint32_t id = frame->ID & CAN_ID_MASK;
+    uint32_t length = frame_length(frame);
+    uint32_t brs = 0;
+    uint32_t late;
+
+    /* Start of frame, arbitration and control fields */
+    bits[n++] = 0;
+
+    uint32_t base = extended ? (id >> 18) : id;
+    for(int32_t b = 10; b >= 0; b--)
+    {
+        bits[n++] = (uint8_t)((base >> b) & 1u);
+    }
+
+    if( extended )
+    {
+        bits[n++] = 1;
+        bits[n++] = 1;
+        for(int32_t b = 17; b >= 0; b--)
+        {
+            bits[n++] = (uint8_t)((id >> b) & 1u);
+        }
+        bits[n++] = frame->edl ? 0u : frame->rtr;
+    }
+    else
+    {
+        bits[n++] = frame->edl ? 0u : frame->rtr;
+        bits[n++] = 0;
+    }
+
+    /* FDF, reserved bit, BRS and ESI of a CAN FD frame, the reserved bits of a classical one */
+    if( frame->edl )
+    {
+        bits[n++] = 1;
+        bits[n++] = 0;
+        brs = n;
+        bits[n++] = frame->brs;
+        bits[n++] = 0;
+    }
+    else
+    {
+        bits[n++] = 0;
+        if( extended )
+        {
+            bits[n++] = 0;
+        }
+    }
+
+    for(int32_t b = 3; b >= 0; b--)
+    {
+        bits[n++] = (uint8_t)((frame->dlc >> b) & 1u);
+    }
+
+    for(uint32_t i = 0; i < length; i++)
+    {
+        uint8_t byte = payload_byte(frame->payload, i);
+
+        for(int32_t b = 7; b >= 0; b--)
+        {
+            bits[n++] = (uint8_t)((byte >> b) & 1u);
+        }
+    }
+
+    /* CAN FD: the stuff count and the 17 or 21-bit CRC, with a fixed stuff bit before the
+     * stuff count and after every 4 bits, their values don't change the length */
+    if( frame->edl )
+    {
+        uint32_t stuffed = stuff_bits(bits, n, brs, &late);
+        uint32_t crc = 4u + ((length <= FD_CRC17_BYTES) ? 17u : 21u);
+        uint32_t fixed = 1u + (crc / 4u);
+
+        *data_bits = (n - 1u - brs) + late + crc + fixed;
+
+        /* CRC delimiter, ACK slot and delimiter, end of frame, intermission */
+        return n + stuffed + crc + fixed + 3u + 7u + INTERMISSION_BITS;
+    }
+
+    /* CRC-15 of the bits so far */
+    uint32_t crc = 0;
+    for(uint32_t i = 0; i < n; i++)
+    {
+        uint32_t next = bits[i] ^ ((crc >> 14) & 1u);
+        crc = (crc << 1) & 0x7FFFu;
+        crc ^= next ? 0x4599u : 0u;
+    }
+
+    for(int32_t b = 14; b >= 0; b--)
+    {
+        bits[n++] = (uint8_t)((crc >> b) & 1u);
+    }
+
+    *data_bits = 0;
+
+    /* CRC delimiter, ACK slot and delimiter, end of frame, intermission */
+    return n + stuff_bits(bits, n, n, &late) + 3u + 7u + INTERMISSION_BITS;
+}
+
+uint32_t sim_frame_bits(const sim_frame_t* frame)
+{
+    uint32_t data_bits;
+
+    return frame_bits(frame, &data_bits);
+}
+
+/* Nominal bit times a frame takes on a bus, its data phase at the data bit rate with BRS */
+static uint64_t frame_bit_times(const sim_bus_t* bus, const sim_frame_t* frame)
+{
+    uint32_t data_bits;
+    uint32_t bits = frame_bits(frame, &data_bits);
+
+    if( !frame->edl || !frame->brs )
+    {
+        return bits;
+    }
+
+    return (bits - data_bits) +
+           ((((uint64_t)data_bits * bus->bitrate) + bus->data_bitrate - 1u) / bus->data_bitrate);
+}
+
+uint64_t sim_frame_ns(const sim_bus_t* bus, const sim_frame_t* frame)
+{
+    return bits_ns(bus, frame_bit_times(bus, frame));
+}
+
+/* Arbitration field as the bus compares it, dominant bits first, the lowest wins */
+static uint32_t bus_key(const sim_frame_t* frame)
+{
+    uint32_t id = frame->ID & CAN_ID_MASK;
+
+    if( frame->ID & CAN_ID_EXT )
+    {
+        return ((id >> 18) << 21) | (1u << 20) | (1u << 19) | ((id & 0x3FFFFu) << 1) | frame->rtr;
+    }
+
+    return (id << 21) | ((uint32_t)frame->rtr << 20);
+}
+
+/*------------------------------------ FlexCAN ----------------------------------------*/
+
+static uint32_t controller_index(const controller_t* c)
+{
+    return (uint32_t)(c - controllers);
+}
+
+static uint8_t clock_enabled(const controller_t* c)
+{
+    return (blocks[BLOCK_PCC].regs[c->pcc_word] & PCC_CGC) ? 1u : 0u;
+}
+
+static uint32_t controller_clock(const controller_t* c)
+{
+    return (c->regs[R_CTRL1] & CTRL1_CLKSRC) ? config.periph_hz : config.osc_hz;
+}
+
+/* Bit rate the bit timing registers give, 0 if not an integer */
+static uint32_t controller_bitrate(const controller_t* c)
+{
+    uint32_t ctrl1 = c->regs[R_CTRL1];
+    uint32_t cbt = c->regs[R_CBT];
+    uint32_t clock = controller_clock(c);
+    uint32_t presdiv, tq;
+
+    if( cbt & CBT_BTF )
+    {
+        presdiv = ((cbt >> 21) & 0x3FFu) + 1u;
+        tq = 1u + (((cbt >> 10) & 0x3Fu) + 1u) + (((cbt >> 5) & 0x1Fu) + 1u) + ((cbt & 0x1Fu) + 1u);
+    }
+    else
+    {
+        presdiv = (ctrl1 >> 24) + 1u;
+        tq = 1u + ((ctrl1 & 0x7u) + 1u) + (((ctrl1 >> 19) & 0x7u) + 1u) + (((ctrl1 >> 16) & 0x7u) + 1u);
+    }
+
+    return (clock % (presdiv * tq)) ? 0u : (clock / (presdiv * tq));
+}
+
+/* Data phase bit rate of the FDCBT timings, 0 if not an integer. FPROPSEG isn't offset */
+static uint32_t controller_data_bitrate(const controller_t* c)
+{
+    uint32_t fdcbt = c->regs[R_FDCBT];
+    uint32_t clock = controller_clock(c);
+    uint32_t presdiv = ((fdcbt >> 20) & 0x3FFu) + 1u;
+    uint32_t tq = 1u + ((fdcbt >> 10) & 0x1Fu) + (((fdcbt >> 5) & 0x7u) + 1u) + ((fdcbt & 0x7u) + 1u);
+
+    return (clock % (presdiv * tq)) ? 0u : (clock / (presdiv * tq));
+}
+
+/* CAN FD mode, and switching to the data bit rate for frames with BRS */
+static uint8_t fd_enabled(const controller_t* c)
+{
+    return (c->regs[R_MCR] & MCR_FDEN) ? 1u : 0u;
+}
+
+static uint8_t rate_switch(const controller_t* c)
+{
+    return fd_enabled(c) && (c->regs[R_FDCTRL] & FDCTRL_FDRATE);
+}
+
+static uint32_t timer_value(const controller_t* c, uint64_t t)
+{
+    if( !c->timer_running || (t < c->timer_since) )
+    {
+        return c->timer_base;
+    }
+
+    uint64_t ticks = (uint64_t)(((unsigned __int128)(t - c->timer_since) * controller_bitrate(c)) / NS_PER_S);
+
+    return (uint32_t)((c->timer_base + ticks) & 0xFFFFu);
+}
+
+static void timer_stop(controller_t* c, uint64_t t)
+{
+    c->timer_base = timer_value(c, t);
+    c->timer_running = 0;
+}
+
+static void timer_start(controller_t* c, uint64_t t)
+{
+    if( !c->timer_running )
+    {
+        c->timer_since = t;
+        c->timer_running = 1;
+    }
+}
+
+/* Whether the frame on the bus involves the controller, and when it ends */
+static uint8_t in_frame(const controller_t* c, uint64_t* end)
+{
+    const sim_bus_t* bus = c->bus;
+
+    if( (bus == 0) || !bus->busy ||
+        (((bus->receivers >> controller_index(c)) & 1u) == 0u && (bus->sender_can != c)) )
+    {
+        return 0;
+    }
+
+    *end = bits_ns(bus, bus->end);
+
+    return 1;
+}
+
+/* Time the controller is synchronized after leaving freeze or low power mode at now */
+static uint64_t sync_time(const controller_t* c, uint64_t now)
+{
+    const sim_bus_t* bus = c->bus;
+
+    if( bus == 0 )
+    {
+        return now;
+    }
+
+    uint64_t from = bits_ceil(bus, now);
+
+    if( bus->busy )
+    {
+        uint64_t idle = bus->end + INTERMISSION_BITS;
+        from = (idle > from) ? idle : from;
+    }
+
+    return bits_ns(bus, from + SYNC_BITS);
+}
+
+/* On the bus: receives, acknowledges and may transmit */
+static uint8_t controller_active(const controller_t* c, uint64_t now)
+{
+    return (c->bus != 0) && !c->disabled && !c->frozen && !c->bus_off && (now >= c->ready_at) &&
+           clock_enabled(c) && (controller_bitrate(c) == c->bus->bitrate) &&
+           (!rate_switch(c) || (controller_data_bitrate(c) == c->bus->data_bitrate));
+}
+
+/* Whether a freeze mode only register may be written */
+static uint8_t config_allowed(const controller_t* c)
+{
+    return c->frozen || c->disabled;
+}
+
+/* First message buffer after the RX FIFO and its ID filter table */
+static uint32_t first_mb(const controller_t* c)
+{
+    if( !(c->regs[R_MCR] & MCR_RFEN) )
+    {
+        return 0;
+    }
+
+    return 6u + (2u * (((c->regs[R_CTRL2] >> CTRL2_RFFN_SHIFT) & 0xFu) + 1u));
+}
+
+/* Words of a message buffer: 8 bytes of payload, or the MBDSR0 size in CAN FD mode */
+static uint32_t mb_words(const controller_t* c)
+{
+    if( !fd_enabled(c) )
+    {
+        return MB_WORDS;
+    }
+
+    return 2u + (2u << ((c->regs[R_FDCTRL] >> FDCTRL_MBDSR0_SHIFT) & 0x3u));
+}
+
+/* Message buffers the RAM holds at that size */
+static uint32_t mb_total(const controller_t* c)
+{
+    return (c->mb_count * MB_WORDS) / mb_words(c);
+}
+
+static uint32_t last_mb(const controller_t* c)
+{
+    uint32_t maxmb = c->regs[R_MCR] & MCR_MAXMB;
+
+    return (maxmb < mb_total(c)) ? maxmb : (mb_total(c) - 1u);
+}
+
+static volatile uint32_t* mailbox(const controller_t* c, uint32_t mb)
+{
+    return &c->regs[R_MB0 + (mb * mb_words(c))];
+}
+
+static uint32_t mb_code(const controller_t* c, uint32_t mb)
+{
+    return (mailbox(c, mb)[MB_CS] >> CS_CODE_SHIFT) & 0xFu;
+}
+
+static void set_flags(controller_t* c, uint32_t flags)
+{
+    uint32_t valid = (c->mb_count >= 32u) ? 0xFFFFFFFFu : ((1u << c->mb_count) - 1u);
+
+    c->regs[R_IFLAG1] |= flags & valid;
+}
+
+/* Message buffer words of a received frame */
+static void frame_words(const sim_frame_t* frame, uint32_t timestamp, uint32_t* words)
+{
+    uint32_t extended = frame->ID >> 31;
+
+    words[MB_CS] = timestamp | ((uint32_t)(frame->dlc & 0xFu) << CS_DLC_SHIFT) |
+                   (frame->rtr ? CS_RTR : 0u) | (extended ? (CS_IDE | CS_SRR) : 0u) |
+                   (frame->edl ? (CS_EDL | (frame->brs ? CS_BRS : 0u)) : 0u);
+    words[MB_ID] = extended ? (frame->ID & CAN_ID_MASK) : ((frame->ID & 0x7FFu) << ID_STD_SHIFT);
+    memcpy(&words[2], frame->payload, sizeof(frame->payload));
+}
+
+/* Frame a transmission message buffer holds */
+static void mailbox_frame(const controller_t* c, uint32_t mb, sim_frame_t* frame)
+{
+    volatile uint32_t* words = mailbox(c, mb);
+    uint32_t cs = words[MB_CS];
+    uint32_t id = words[MB_ID];
+    uint8_t fd = (fd_enabled(c) && (cs & CS_EDL)) ? 1u : 0u;
+
+    frame->ID = (cs & CS_IDE) ? (CAN_ID_EXT | (id & CAN_ID_MASK)) : ((id >> ID_STD_SHIFT) & 0x7FFu);
+    frame->dlc = (uint8_t)((cs >> CS_DLC_SHIFT) & 0xFu);
+    frame->rtr = (!fd && (cs & CS_RTR)) ? 1u : 0u;
+    frame->edl = fd;
+    frame->brs = (fd && (cs & CS_BRS) && rate_switch(c)) ? 1u : 0u;
+    memset(frame->payload, 0, sizeof(frame->payload));
+    for(uint32_t w = 0; w < (mb_words(c) - 2u); w++)
+    {
+        frame->payload[w] = words[2u + w];
+    }
+    frame->time = 0;
+}
+
+/* Present the oldest RX FIFO entry at the output and flag it */
+static void fifo_present(controller_t* c)
+{
+    volatile uint32_t* output = mailbox(c, 0);
+
+    for(uint32_t w = 0; w < MB_WORDS; w++)
+    {
+        output[w] = c->fifo[0][w];
+    }
+
+    c->regs[R_RXFIR] = c->fifo[0][MB_CS] >> FIFO_IDHIT_SHIFT;
+    set_flags(c, IFLAG1_BUF5I);
+}
+
+static void fifo_push(controller_t* c, const uint32_t* words, uint32_t idhit)
+{
+    uint32_t* entry = c->fifo[c->fifo_count++];
+
+    memcpy(entry, words, sizeof(c->fifo[0]));
+    entry[MB_CS] |= idhit << FIFO_IDHIT_SHIFT;
+
+    if( c->fifo_count == FIFO_WARNING )
+    {
+        set_flags(c, IFLAG1_BUF6I);
+    }
+
+    if( c->fifo_count == 1u )
+    {
+        fifo_present(c);
+    }
+}
+
+static void fifo_pop(controller_t* c)
+{
+    memmove(c->fifo[0], c->fifo[1], (FIFO_DEPTH - 1u) * sizeof(c->fifo[0]));
+    c->fifo_count--;
+
+    if( c->fifo_count )
+    {
+        fifo_present(c);
+    }
+}
+
+/* First ID filter table element accepting a frame, as its IDHIT, -1 if none */
+static int32_t fifo_match(const controller_t* c, const sim_frame_t* frame)
+{
+    uint32_t mcr = c->regs[R_MCR];
+    uint32_t format = (mcr >> MCR_IDAM_SHIFT) & 0x3u;
+    uint32_t rffn = (c->regs[R_CTRL2] >> CTRL2_RFFN_SHIFT) & 0xFu;
+    uint32_t elements = 8u * (rffn + 1u);
+    uint32_t individual = 8u + (2u * rffn);
+    uint32_t extended = frame->ID >> 31;
+    uint32_t id = frame->ID & CAN_ID_MASK;
+
+    individual = (mcr & MCR_IRMQ) ? ((individual < c->mb_count) ? individual : c->mb_count) : 0u;
+
+    /* Format D rejects every frame */
+    if( format == 3u )
+    {
+        return -1;
+    }
+
+    /* The frame as each format encodes it: A with RTR, IDE and the ID, B with RTR, IDE and the
+     * 14 most significant ID bits, C with the 8 most significant ID bits */
+    uint32_t a = ((uint32_t)frame->rtr << 31) | (extended << 30) | (extended ? (id << 1) : (id << 19));
+    uint32_t b = ((uint32_t)frame->rtr << 15) | (extended << 14) | (extended ? ((id >> 15) & 0x3FFFu) : (id << 3));
+    uint32_t cc = extended ? ((id >> 21) & 0xFFu) : ((id >> 3) & 0xFFu);
+
+    for(uint32_t e = 0; e < elements; e++)
+    {
+        uint32_t word = c->regs[R_ID_TABLE + e];
+        uint32_t mask = (e < individual) ? c->regs[R_RXIMR0 + e] : c->regs[R_RXFGMASK];
+
+        if( format == 0u )
+        {
+            if( ((a ^ word) & mask) == 0u )
+            {
+                return (int32_t)e;
+            }
+        }
+        else if( format == 1u )
+        {
+            for(uint32_t k = 0; k < 2u; k++)
+            {
+                uint32_t shift = 16u * (1u - k);
+
+                if( (((b ^ (word >> shift)) & (mask >> shift)) & 0xFFFFu) == 0u )
+                {
+                    return (int32_t)((2u * e) + k);
+                }
+            }
+        }
+        else
+        {
+            for(uint32_t k = 0; k < 4u; k++)
+            {
+                uint32_t shift = 24u - (8u * k);
+
+                if( (((cc ^ (word >> shift)) & (mask >> shift)) & 0xFFu) == 0u )
+                {
+                    return (int32_t)((4u * e) + k);
+                }
+            }
+        }
+    }
+
+    return -1;
+}
+
+/* Whether a reception message buffer accepts a frame, the IDE bit is always compared */
+static uint8_t mb_match(const controller_t* c, uint32_t mb, const sim_frame_t* frame, const uint32_t* words)
+{
+    volatile uint32_t* box = mailbox(c, mb);
+    uint32_t mask;
+
+    if( ((box[MB_CS] ^ words[MB_CS]) & CS_IDE) != 0u )
+    {
+        return 0;
+    }
+
+    if( c->regs[R_MCR] & MCR_IRMQ )
+    {
+        mask = c->regs[R_RXIMR0 + mb];
+    }
+    else
+    {
+        mask = (mb == 14u) ? c->regs[R_RX14MASK] : ((mb == 15u) ? c->regs[R_RX15MASK] : c->regs[R_RXMGMASK]);
+    }
+
+    (void)frame;
+
+    return (((box[MB_ID] ^ words[MB_ID]) & mask & CAN_ID_MASK) == 0u) ? 1u : 0u;
+}
+
+/* Free to receive: empty, or full and serviced, its flag cleared since the last frame */
+static uint8_t mb_free(const controller_t* c, uint32_t mb)
+{
+    return (mb_code(c, mb) == CODE_RX_EMPTY) || !((c->regs[R_IFLAG1] >> mb) & 1u);
+}
+
+/* Move a frame into a reception message buffer, or hold it while the message buffer is locked */
+static void mb_store(controller_t* c, uint32_t mb, const uint32_t* words)
+{
+    if( (int32_t)mb == c->locked_mb )
+    {
+        c->held = 1;
+        c->held_mb = (int32_t)mb;
+        memcpy(c->held_words, words, sizeof(c->held_words));
+        return;
+    }
+
+    volatile uint32_t* box = mailbox(c, mb);
+    uint32_t code = mb_free(c, mb) ? CODE_RX_FULL : CODE_RX_OVERRUN;
+
+    /* A payload longer than the message buffer is cut at its size */
+    box[MB_ID] = words[MB_ID];
+    for(uint32_t w = 2; w < mb_words(c); w++)
+    {
+        box[w] = words[w];
+    }
+    box[MB_CS] = words[MB_CS] | (code << CS_CODE_SHIFT);
+
+    set_flags(c, 1u << mb);
+}
+
+static void mb_unlock(controller_t* c)
+{
+    c->locked_mb = -1;
+
+    if( c->held )
+    {
+        c->held = 0;
+        mb_store(c, (uint32_t)c->held_mb, c->held_words);
+    }
+}
+
+static uint8_t is_rx_code(uint32_t code)
+{
+    return (code == CODE_RX_EMPTY) || (code == CODE_RX_FULL) || (code == CODE_RX_OVERRUN);
+}
+
+/* Matching and storing of a received frame, by the MRP order of the RX FIFO and the message buffers */
+static void controller_receive(controller_t* c, const sim_frame_t* frame, uint64_t sof)
+{
+    uint32_t words[MB_WORDS_MAX];
+    uint32_t mcr = c->regs[R_MCR];
+    uint8_t fifo = (mcr & MCR_RFEN) ? 1u : 0u;
+    uint8_t queue = (mcr & MCR_IRMQ) ? 1u : 0u;
+    uint8_t mbs_first = (c->regs[R_CTRL2] & CTRL2_MRP) ? 1u : 0u;
+
+    /* Classical controllers ignore CAN FD frames, the RX FIFO never takes them */
+    if( frame->edl && !fd_enabled(c) )
+    {
+        return;
+    }
+
+    frame_words(frame, timer_value(c, bits_ns(c->bus, sof + 1u)), words);
+
+    int32_t idhit = (fifo && !frame->edl) ? fifo_match(c, frame) : -1;
+
+    if( (idhit >= 0) && !mbs_first && (c->fifo_count < FIFO_DEPTH) )
+    {
+        fifo_push(c, words, (uint32_t)idhit);
+        return;
+    }
+
+    /* The first matching free message buffer, else the last matching one is overrun. Without
+     * the queue of IRMQ the first matching one takes the frame */
+    int32_t match = -1;
+
+    for(uint32_t mb = first_mb(c); mb <= last_mb(c); mb++)
+    {
+        uint32_t code = mb_code(c, mb);
+
+        if( !is_rx_code(code) || !mb_match(c, mb, frame, words) )
+        {
+            continue;
+        }
+
+        match = (int32_t)mb;
+
+        if( !queue || (mb_free(c, mb) && ((int32_t)mb != c->locked_mb)) )
+        {
+            mb_store(c, mb, words);
+            return;
+        }
+    }
+
+    if( (idhit >= 0) && (c->fifo_count < FIFO_DEPTH) )
+    {
+        fifo_push(c, words, (uint32_t)idhit);
+    }
+    else if( match >= 0 )
+    {
+        mb_store(c, (uint32_t)match, words);
+    }
+    else if( idhit >= 0 )
+    {
+        set_flags(c, IFLAG1_BUF7I);
+    }
+}
+
+/* Pending message buffer the internal arbitration picks at a bit time, -1 if none */
+static int32_t controller_candidate(const controller_t* c, uint64_t at)
+{
+    uint8_t lowest_buffer = (c->regs[R_CTRL1] & CTRL1_LBUF) ? 1u : 0u;
+    uint8_t local_priority = (c->regs[R_MCR] & MCR_LPRIOEN) ? 1u : 0u;
+    uint64_t best_key = UINT64_MAX;
+    int32_t best = -1;
+
+    for(uint32_t pending = c->tx_pending; pending; pending &= pending - 1u)
+    {
+        uint32_t mb = (uint32_t)__builtin_ctz(pending);
+        sim_frame_t frame;
+
+        if( bits_ceil(c->bus, c->tx_since[mb]) > at )
+        {
+            continue;
+        }
+
+        mailbox_frame(c, mb, &frame);
+
+        uint64_t prio = local_priority ? (mailbox(c, mb)[MB_ID] >> ID_PRIO_SHIFT) : 0u;
+        uint64_t key = lowest_buffer ? mb : ((prio << 32) | bus_key(&frame));
+
+        if( key < best_key )
+        {
+            best_key = key;
+            best = (int32_t)mb;
+        }
+    }
+
+    return best;
+}
+
+static uint8_t controller_may_send(const controller_t* c, uint64_t now)
+{
+    return controller_active(c, now) && !c->freeze_requested && c->tx_pending;
+}
+
+/* Transmission confirmed at the end of frame */
+static void tx_done(controller_t* c, uint32_t mb, uint64_t sof)
+{
+    uint32_t bit = 1u << mb;
+    volatile uint32_t* box = mailbox(c, mb);
+
+    c->tx_mb = -1;
+    c->tx_abort &= ~bit;
+
+    if( (c->regs[R_ECR] & 0xFFu) != 0u )
+    {
+        c->regs[R_ECR] -= 1u;
+    }
+
+    if( c->tx_deactivated & bit )
+    {
+        c->tx_deactivated &= ~bit;
+        return;
+    }
+
+    uint32_t timestamp = timer_value(c, bits_ns(c->bus, sof + 1u));
+
+    box[MB_CS] = (box[MB_CS] & ~((0xFu << CS_CODE_SHIFT) | CS_TIMESTAMP)) |
+                 ((uint32_t)CODE_TX_INACTIVE << CS_CODE_SHIFT) | timestamp;
+    set_flags(c, bit);
+}
+
+/* Error counters of the fault confinement, kept apart from ECR while bus-off */
+static uint32_t tx_errors(const controller_t* c)
+{
+    return c->regs[R_ECR] & 0xFFu;
+}
+
+static uint32_t rx_errors(const controller_t* c)
+{
+    return (c->regs[R_ECR] >> ECR_RXERRCNT_SHIFT) & 0xFFu;
+}
+
+static void set_rx_errors(controller_t* c, uint32_t count)
+{
+    c->regs[R_ECR] = (c->regs[R_ECR] & ~(0xFFu << ECR_RXERRCNT_SHIFT)) | (count << ECR_RXERRCNT_SHIFT);
+}
+
+/* Transmit error counter past 255: off the bus until 128 occurrences of 11 recessive bits */
+static void enter_bus_off(controller_t* c, uint64_t now)
+{
+    c->bus_off = 1;
+    c->recovery_at = (c->bus != 0) ? bits_ns(c->bus, bits_ceil(c->bus, now) + RECOVERY_BITS) : UINT64_MAX;
+    c->regs[R_ESR1] |= ESR1_BOFFINT;
+}
+
+/* A bus error the controller detected: 8 on the transmit error counter for the transmitter, 1 on
+ * the receive error counter for a receiver, which stays error passive past 255 */
+static void bus_error(controller_t* c, uint32_t error, uint8_t transmitter, uint64_t now)
+{
+    c->regs[R_ESR1] |= error | ESR1_ERRINT;
+
+    if( c->bus_off )
+    {
+        return;
+    }
+
+    if( !transmitter )
+    {
+        set_rx_errors(c, (rx_errors(c) < 0xFFu) ? (rx_errors(c) + 1u) : 0xFFu);
+    }
+    else if( (tx_errors(c) + 8u) >= ERROR_BUS_OFF )
+    {
+        enter_bus_off(c, now);
+    }
+    else
+    {
+        c->regs[R_ECR] += 8u;
+    }
+}
+
+/* Nobody acknowledged, the frame is sent again unless it was aborted meanwhile */
+static void tx_failed(controller_t* c, uint32_t mb)
+{
+    uint32_t bit = 1u << mb;
+
+    c->tx_mb = -1;
+
+    /* An error passive transmitter doesn't count the missing ACKs */
+    if( tx_errors(c) < ERROR_PASSIVE )
+    {
+        bus_error(c, ESR1_ACKERR, 1, bits_ns(c->bus, c->bus->end));
+    }
+    else
+    {
+        c->regs[R_ESR1] |= ESR1_ACKERR | ESR1_ERRINT;
+    }
+
+    if( c->tx_deactivated & bit )
+    {
+        c->tx_deactivated &= ~bit;
+    }
+    else if( c->tx_abort & bit )
+    {
+        c->tx_abort &= ~bit;
+        set_flags(c, bit);
+    }
+    else
+    {
+        c->tx_pending |= bit;
+    }
+}
+
+/* Status bits of MCR and ESR1 at now, and the freeze acknowledgement once due */
+static void controller_update(controller_t* c, uint64_t now)
+{
+    if( c->freeze_requested && !c->disabled && !c->frozen && (now >= c->freeze_at) )
+    {
+        c->frozen = 1;
+        timer_stop(c, c->freeze_at);
+    }
+
+    uint32_t mcr = c->regs[R_MCR] & ~MCR_STATUS;
+
+    mcr |= (c->disabled && (now >= c->lpm_at)) ? MCR_LPMACK : 0u;
+    mcr |= c->frozen ? MCR_FRZACK : 0u;
+    mcr |= (c->disabled || c->frozen || (now < c->ready_at)) ? MCR_NOTRDY : 0u;
+    c->regs[R_MCR] = mcr;
+
+    /* Bus-off recovery once the recessive bits went by, unless BOFFREC holds it. The counters
+     * start over */
+    if( c->bus_off && (now >= c->recovery_at) && !(c->regs[R_CTRL1] & CTRL1_BOFFREC) )
+    {
+        c->bus_off = 0;
+        c->regs[R_ECR] = 0;
+        c->regs[R_ESR1] |= ESR1_BOFFDONEINT;
+    }
+
+    uint32_t fltconf = ((tx_errors(c) >= ERROR_PASSIVE) || (rx_errors(c) >= ERROR_PASSIVE)) ? 1u : 0u;
+    uint32_t esr1 = c->regs[R_ESR1] & ~((0x3u << ESR1_FLTCONF_SHIFT) | ESR1_SYNCH | ESR1_IDLE);
+
+    esr1 |= (c->bus_off ? 2u : fltconf) << ESR1_FLTCONF_SHIFT;
+    esr1 |= controller_active(c, now) ? ESR1_SYNCH : 0u;
+    esr1 |= ((c->bus == 0) || !c->bus->busy) ? ESR1_IDLE : 0u;
+    c->regs[R_ESR1] = esr1;
+}
+
+static void controller_reset(controller_t* c)
+{
+    uint32_t seed = 0x2545F491u * (controller_index(c) + 1u);
+
+    /* Message buffer RAM and the individual masks are undefined out of reset */
+    for(uint32_t w = 0; w < (MB_MAX * MB_WORDS); w++)
+    {
+        seed = (seed * 1103515245u) + 12345u;
+        c->regs[R_MB0 + w] = seed;
+    }
+    for(uint32_t w = 0; w < MB_MAX; w++)
+    {
+        seed = (seed * 1103515245u) + 12345u;
+        c->regs[R_RXIMR0 + w] = seed;
+    }
+
+    c->regs[R_MCR] = MCR_RESET;
+    c->regs[R_CTRL1] = 0;
+    c->regs[R_TIMER] = 0;
+    c->regs[R_RXMGMASK] = 0xFFFFFFFFu;
+    c->regs[R_RX14MASK] = 0xFFFFFFFFu;
+    c->regs[R_RX15MASK] = 0xFFFFFFFFu;
+    c->regs[R_RXFGMASK] = 0xFFFFFFFFu;
+    c->regs[R_ECR] = 0;
+    c->regs[R_ESR1] = 0;
+    c->regs[R_IMASK1] = 0;
+    c->regs[R_IFLAG1] = 0;
+    c->regs[R_CTRL2] = CTRL2_RESET;
+    c->regs[R_CBT] = 0;
+    c->regs[R_RXFIR] = 0;
+    c->regs[R_FDCTRL] = FDCTRL_RESET;
+    c->regs[R_FDCBT] = 0;
+
+    c->disabled = 1;
+    c->freeze_requested = 1;
+    c->frozen = 0;
+    c->lpm_at = 0;
+    c->ready_at = 0;
+    c->timer_running = 0;
+    c->timer_base = 0;
+    c->tx_pending = 0;
+    c->tx_mb = -1;
+    c->tx_abort = 0;
+    c->tx_deactivated = 0;
+    c->bus_off = 0;
+    c->fifo_count = 0;
+    c->locked_mb = -1;
+    c->held = 0;
+}
+
+/* Low power and freeze requests of an MCR write */
+static void mcr_write(controller_t* c, uint32_t old, uint32_t value, uint64_t now)
+{
+    uint64_t end;
+
+    if( !config_allowed(c) && ((old ^ value) & MCR_FREEZE_ONLY) )
+    {
+        value = (value & ~MCR_FREEZE_ONLY) | (old & MCR_FREEZE_ONLY);
+        stats.ignored_writes++;
+    }
+
+    c->regs[R_MCR] = (value & ~(MCR_STATUS | MCR_SOFTRST)) | (old & MCR_STATUS);
+
+    if( value & MCR_SOFTRST )
+    {
+        uint32_t bus_off = c->regs[R_MCR] & MCR_MDIS;
+        controller_reset(c);
+        c->regs[R_MCR] = (MCR_RESET & ~MCR_MDIS) | bus_off;
+        c->disabled = bus_off ? 1u : 0u;
+    }
+
+    uint8_t disable = (value & MCR_MDIS) ? 1u : 0u;
+
+    if( disable && !c->disabled )
+    {
+        c->disabled = 1;
+        c->lpm_at = in_frame(c, &end) ? end : now;
+        timer_stop(c, now);
+    }
+    else if( !disable && c->disabled )
+    {
+        c->disabled = 0;
+        c->ready_at = sync_time(c, now);
+        if( c->freeze_requested )
+        {
+            c->freeze_at = now;
+        }
+        else
+        {
+            timer_start(c, now);
+        }
+    }
+
+    uint8_t freeze = ((value & MCR_FRZ) && (value & MCR_HALT)) ? 1u : 0u;
+
+    if( freeze && !c->freeze_requested )
+    {
+        c->freeze_requested = 1;
+        c->freeze_at = (!c->disabled && in_frame(c, &end)) ? end : now;
+    }
+    else if( !freeze && c->freeze_requested )
+    {
+        c->freeze_requested = 0;
+
+        if( c->frozen )
+        {
+            c->frozen = 0;
+            c->ready_at = sync_time(c, now);
+            if( !c->disabled )
+            {
+                timer_start(c, now);
+            }
+        }
+    }
+
+    controller_update(c, now);
+}
+
+/* Control/status word written: the transmission state machine */
+static void cs_write(controller_t* c, uint32_t mb, uint32_t value, uint64_t now)
+{
+    uint32_t code = (value >> CS_CODE_SHIFT) & 0xFu;
+    uint32_t bit = 1u << mb;
+    uint8_t abort_enabled = (c->regs[R_MCR] & MCR_AEN) ? 1u : 0u;
+
+    /* The frame on the bus completes, an abort then leaves the CODE it writes */
+    if( c->tx_mb == (int32_t)mb )
+    {
+        if( (code == CODE_TX_ABORT) && abort_enabled )
+        {
+            c->tx_abort |= bit;
+        }
+        else
+        {
+            c->tx_deactivated |= bit;
+        }
+        return;
+    }
+
+    if( c->tx_pending & bit )
+    {
+        c->tx_pending &= ~bit;
+
+        /* Aborted before arbitration: flagged with CODE still ABORT */
+        if( (code == CODE_TX_ABORT) && abort_enabled )
+        {
+            set_flags(c, bit);
+            return;
+        }
+    }
+
+    if( code == CODE_TX_DATA )
+    {
+        c->tx_pending |= bit;
+        c->tx_since[mb] = now;
+    }
+}
+
+/* Flags written: write 1 to clear, and the RX FIFO advances when BUF5I is cleared */
+static void iflag_write(controller_t* c, uint32_t old, uint32_t value)
+{
+    uint32_t fifo = (c->regs[R_MCR] & MCR_RFEN) ? 1u : 0u;
+
+    c->regs[R_IFLAG1] = old & ~value;
+
+    if( fifo && (value & IFLAG1_BUF5I) && c->fifo_count )
+    {
+        fifo_pop(c);
+    }
+
+    if( fifo && (value & IFLAG1_BUF0I) && c->frozen )
+    {
+        c->fifo_count = 0;
+        c->regs[R_IFLAG1] &= ~IFLAG1_BUF5I;
+    }
+}
+
+/* Register of a freeze mode only field written */
+static void config_write(controller_t* c, uint32_t word, uint32_t old, uint32_t value, uint32_t freeze_only)
+{
+    if( !config_allowed(c) && ((old ^ value) & freeze_only) )
+    {
+        c->regs[word] = (value & ~freeze_only) | (old & freeze_only);
+        stats.ignored_writes++;
+    }
+}
+
+static void can_write(controller_t* c, uint32_t word, uint32_t old, uint32_t value, uint64_t now)
+{
+    if( (word >= R_MB0) && (word < (R_MB0 + (mb_total(c) * mb_words(c)))) )
+    {
+        uint32_t mb = (word - R_MB0) / mb_words(c);
+
+        if( (((word - R_MB0) % mb_words(c)) == MB_CS) && (mb >= first_mb(c)) )
+        {
+            cs_write(c, mb, value, now);
+        }
+        return;
+    }
+
+    if( (word >= R_RXIMR0) && (word < (R_RXIMR0 + MB_MAX)) )
+    {
+        config_write(c, word, old, value, 0xFFFFFFFFu);
+        return;
+    }
+
+    switch( word )
+    {
+    case R_MCR:
+        mcr_write(c, old, value, now);
+        break;
+    case R_CTRL1:
+        config_write(c, word, old, value, CTRL1_FREEZE_ONLY);
+        if( !c->disabled && ((old ^ c->regs[word]) & CTRL1_CLKSRC) )
+        {
+            c->regs[word] ^= CTRL1_CLKSRC;
+            stats.ignored_writes++;
+        }
+        break;
+    case R_CTRL2:
+        config_write(c, word, old, value, CTRL2_FREEZE_ONLY);
+        break;
+    case R_TIMER:
+        c->timer_base = value & 0xFFFFu;
+        c->timer_since = now;
+        break;
+    case R_ESR1:
+        c->regs[word] = old & ~(value & ESR1_W1C);
+        break;
+    case R_IFLAG1:
+        iflag_write(c, old, value);
+        break;
+    case R_CBT:
+    case R_FDCBT:
+    case R_FDCTRL:
+    case R_ECR:
+    case R_RXMGMASK:
+    case R_RX14MASK:
+    case R_RX15MASK:
+    case R_RXFGMASK:
+        config_write(c, word, old, value, 0xFFFFFFFFu);
+        break;
+    case R_ESR2:
+    case R_CRCR:
+    case R_RXFIR:
+    case R_FDCRC:
+        c->regs[word] = old;
+        break;
+    default:
+        break;
+    }
+}
+
+/* Side effects of reading: the timer is sampled and unlocks, a control/status word locks */
+static void can_read(controller_t* c, uint32_t word, uint64_t now)
+{
+    if( word == R_TIMER )
+    {
+        c->regs[R_TIMER] = timer_value(c, now);
+        mb_unlock(c);
+        return;
+    }
+
+    if( (word >= R_MB0) && (word < (R_MB0 + (mb_total(c) * mb_words(c)))) &&
+        (((word - R_MB0) % mb_words(c)) == MB_CS) )
+    {
+        uint32_t mb = (word - R_MB0) / mb_words(c);
+
+        if( (mb >= first_mb(c)) && is_rx_code(mb_code(c, mb)) && (c->locked_mb != (int32_t)mb) )
+        {
+            mb_unlock(c);
+            c->locked_mb = (int32_t)mb;
+        }
+    }
+}
+
+/*------------------------------------ Buses ------------------------------------------*/
+
+static void node_deliver(sim_node_t* node, const sim_frame_t* frame)
+{
+    if( (node->rx_head - node->rx_tail) >= SIM_NODE_RX_QUEUE )
+    {
+        node->stats.rx_dropped++;
+        return;
+    }
+
+    node->rx[node->rx_head % SIM_NODE_RX_QUEUE] = *frame;
+    node->rx_head++;
+    node->stats.received++;
+}
+
+static void node_queue(sim_node_t* node, const sim_frame_t* frame, uint64_t ready)
+{
+    if( (node->tx_head - node->tx_tail) >= SIM_NODE_QUEUE )
+    {
+        node->stats.tx_dropped++;
+        return;
+    }
+
+    node->tx[node->tx_head % SIM_NODE_QUEUE] = *frame;
+    node->tx_ready[node->tx_head % SIM_NODE_QUEUE] = ready;
+    node->tx_head++;
+}
+
+/* Earliest bit time a frame may start at, UINT64_MAX if nothing waits */
+static uint64_t bus_next_start(const sim_bus_t* bus, uint64_t now)
+{
+    uint64_t ready = UINT64_MAX;
+
+    for(uint32_t i = 0; i < FlexCAN_instances; i++)
+    {
+        const controller_t* c = &controllers[i];
+
+        if( (c->bus != bus) || !controller_may_send(c, now) )
+        {
+            continue;
+        }
+
+        for(uint32_t pending = c->tx_pending; pending; pending &= pending - 1u)
+        {
+            uint64_t since = bits_ceil(bus, c->tx_since[__builtin_ctz(pending)]);
+            ready = (since < ready) ? since : ready;
+        }
+    }
+
+    for(uint32_t n = 0; n < node_count; n++)
+    {
+        const sim_node_t* node = &nodes[n];
+
+        if( (node->bus == bus) && (node->tx_head != node->tx_tail) )
+        {
+            uint64_t since = node->tx_ready[node->tx_tail % SIM_NODE_QUEUE];
+            ready = (since < ready) ? since : ready;
+        }
+    }
+
+    if( ready == UINT64_MAX )
+    {
+        return ready;
+    }
+
+    return (ready > bus->idle_from) ? ready : bus->idle_from;
+}
+
+/* Arbitration among the frames ready at the start of frame */
+static void bus_start(sim_bus_t* bus, uint64_t sof, uint64_t now)
+{
+    uint32_t best_key = UINT32_MAX;
+    sim_frame_t frame;
+
+    bus->sender_can = 0;
+    bus->sender_node = 0;
+    bus->receivers = 0;
+
+    for(uint32_t i = 0; i < FlexCAN_instances; i++)
+    {
+        controller_t* c = &controllers[i];
+
+        if( c->bus != bus )
+        {
+            continue;
+        }
+
+        if( controller_active(c, now) )
+        {
+            bus->receivers |= 1u << i;
+        }
+
+        int32_t mb = controller_may_send(c, now) ? controller_candidate(c, sof) : -1;
+        if( mb < 0 )
+        {
+            continue;
+        }
+
+        mailbox_frame(c, (uint32_t)mb, &frame);
+
+        if( bus_key(&frame) < best_key )
+        {
+            best_key = bus_key(&frame);
+            bus->frame = frame;
+            bus->sender_can = c;
+            bus->sender_mb = mb;
+        }
+    }
+
+    for(uint32_t n = 0; n < node_count; n++)
+    {
+        sim_node_t* node = &nodes[n];
+        uint32_t slot = node->tx_tail % SIM_NODE_QUEUE;
+
+        if( (node->bus != bus) || (node->tx_head == node->tx_tail) || (node->tx_ready[slot] > sof) )
+        {
+            continue;
+        }
+
+        if( bus_key(&node->tx[slot]) < best_key )
+        {
+            best_key = bus_key(&node->tx[slot]);
+            bus->frame = node->tx[slot];
+            bus->sender_can = 0;
+            bus->sender_node = node;
+        }
+    }
+
+    if( (bus->sender_can == 0) && (bus->sender_node == 0) )
+    {
+        /* What was ready went away, look again from the next bit */
+        bus->idle_from = sof + 1u;
+        return;
+    }
+
+    if( bus->sender_can )
+    {
+        bus->sender_can->tx_pending &= ~(1u << bus->sender_mb);
+        bus->sender_can->tx_mb = bus->sender_mb;
+        bus->receivers &= ~(1u << controller_index(bus->sender_can));
+    }
+
+    bus->busy = 1;
+    bus->sof = sof;
+    bus->end = sof + frame_bit_times(bus, &bus->frame) - INTERMISSION_BITS;
+    bus->frame.time = bits_ns(bus, sof);
+}
+
+/* End of frame: acknowledgement, confirmation and reception */
+static void bus_finish(sim_bus_t* bus)
+{
+    uint8_t ack = (bus->receivers != 0u) ? 1u : 0u;
+
+    for(uint32_t n = 0; (n < node_count) && !ack; n++)
+    {
+        ack = (nodes[n].bus == bus) && (&nodes[n] != bus->sender_node);
+    }
+
+    bus->busy = 0;
+    bus->idle_from = bus->end + INTERMISSION_BITS;
+
+    if( bus->sender_can )
+    {
+        controller_t* c = bus->sender_can;
+
+        if( ack )
+        {
+            tx_done(c, (uint32_t)bus->sender_mb, bus->sof);
+
+            /* Self reception */
+            if( !(c->regs[R_MCR] & MCR_SRXDIS) )
+            {
+                controller_receive(c, &bus->frame, bus->sof);
+            }
+        }
+        else
+        {
+            tx_failed(c, (uint32_t)bus->sender_mb);
+        }
+    }
+    else if( ack )
+    {
+        bus->sender_node->tx_tail++;
+        bus->sender_node->stats.sent++;
+    }
+
+    if( !ack )
+    {
+        bus->stats.ack_errors++;
+        return;
+    }
+
+    bus->stats.frames++;
+    bus->stats.bits += (bus->end + INTERMISSION_BITS) - bus->sof;
+
+    for(uint32_t i = 0; i < FlexCAN_instances; i++)
+    {
+        if( (bus->receivers >> i) & 1u )
+        {
+            controller_t* c = &controllers[i];
+            uint32_t rec = rx_errors(c);
+
+            /* A successful reception takes an error passive receiver back below the limit */
+            set_rx_errors(c, (rec >= ERROR_PASSIVE) ? (ERROR_PASSIVE - 1u) : ((rec != 0u) ? (rec - 1u) : 0u));
+            controller_receive(c, &bus->frame, bus->sof);
+        }
+    }
+
+    for(uint32_t n = 0; n < node_count; n++)
+    {
+        if( (nodes[n].bus == bus) && (&nodes[n] != bus->sender_node) )
+        {
+            node_deliver(&nodes[n], &bus->frame);
+        }
+    }
+}
+
+static void bus_advance(sim_bus_t* bus, uint64_t now)
+{
+    uint64_t now_bits = bits_floor(bus, now);
+
+    /* Frames the generators queued up to now */
+    for(uint32_t n = 0; n < node_count; n++)
+    {
+        sim_node_t* node = &nodes[n];
+
+        while( (node->bus == bus) && node->gen_left && (node->gen_next <= now) )
+        {
+            node_queue(node, &node->gen_frame, bits_ceil(bus, node->gen_next));
+            node->gen_frame.payload[0]++;
+            node->gen_next += node->gen_period;
+            node->gen_left--;
+        }
+    }
+
+    for(;;)
+    {
+        if( bus->busy )
+        {
+            if( bus->end > now_bits )
+            {
+                break;
+            }
+
+            bus_finish(bus);
+            continue;
+        }
+
+        uint64_t sof = bus_next_start(bus, now);
+        if( sof > now_bits )
+        {
+            break;
+        }
+
+        bus_start(bus, sof, now);
+    }
+}
+
+/*------------------------------------ SCG, LPIT0, NVIC -------------------------------*/
+
+static uint8_t lpit_clock_enabled(void)
+{
+    return (blocks[BLOCK_PCC].regs[PCC_REG(PCC_LPIT)] & PCC_CGC) ? 1u : 0u;
+}
+
+static uint64_t lpit_ticks(const lpit_channel_t* ch, uint64_t now)
+{
+    return (now < ch->since) ? 0u : (uint64_t)(((unsigned __int128)(now - ch->since) * config.osc_hz) / NS_PER_S);
+}
+
+static volatile uint32_t* lpit_tmr(uint32_t ch)
+{
+    return &blocks[BLOCK_LPIT0].regs[LPIT_REG(TMR) + (ch * LPIT_TMR_WORDS)];
+}
+
+/* Timeouts of the running channels set their flags */
+static void lpit_update(uint64_t now)
+{
+    volatile uint32_t* regs = blocks[BLOCK_LPIT0].regs;
+
+    if( !(regs[LPIT_REG(MCR)] & LPIT_MCR_M_CEN_MASK) )
+    {
+        return;
+    }
+
+    for(uint32_t ch = 0; ch < LPIT_CHANNELS; ch++)
+    {
+        if( !lpit[ch].running )
+        {
+            continue;
+        }
+
+        uint64_t timeouts = lpit_ticks(&lpit[ch], now) / ((uint64_t)lpit_tmr(ch)[0] + 1u);
+
+        if( timeouts > lpit[ch].timeouts )
+        {
+            lpit[ch].timeouts = timeouts;
+            regs[LPIT_REG(MSR)] |= 1u << ch;
+        }
+    }
+}
+
+static void lpit_enable(uint32_t ch, uint8_t enable, uint64_t now)
+{
+    volatile uint32_t* tmr = lpit_tmr(ch);
+
+    if( enable && !lpit[ch].running )
+    {
+        lpit[ch].running = 1;
+        lpit[ch].since = now;
+        lpit[ch].timeouts = 0;
+    }
+    else if( !enable )
+    {
+        lpit[ch].running = 0;
+    }
+
+    tmr[2] = enable ? (tmr[2] | LPIT_TCTRL_T_EN) : (tmr[2] & ~LPIT_TCTRL_T_EN);
+}
+
+static void lpit_write(uint32_t word, uint32_t old, uint32_t value, uint64_t now)
+{
+    volatile uint32_t* regs = blocks[BLOCK_LPIT0].regs;
+
+    if( word == LPIT_REG(MSR) )
+    {
+        regs[word] = old & ~value;
+    }
+    else if( (word == LPIT_REG(SETTEN)) || (word == LPIT_REG(CLRTEN)) )
+    {
+        for(uint32_t ch = 0; ch < LPIT_CHANNELS; ch++)
+        {
+            if( (value >> ch) & 1u )
+            {
+                lpit_enable(ch, word == LPIT_REG(SETTEN), now);
+            }
+        }
+        regs[word] = 0;
+    }
+    else if( (word >= LPIT_REG(TMR)) && (((word - LPIT_REG(TMR)) % LPIT_TMR_WORDS) == 2u) )
+    {
+        uint32_t ch = (word - LPIT_REG(TMR)) / LPIT_TMR_WORDS;
+
+        if( ch < LPIT_CHANNELS )
+        {
+            lpit_enable(ch, (value & LPIT_TCTRL_T_EN) ? 1u : 0u, now);
+        }
+    }
+}
+
+static void lpit_read(uint32_t word, uint64_t now)
+{
+    if( (word >= LPIT_REG(TMR)) && (((word - LPIT_REG(TMR)) % LPIT_TMR_WORDS) == 1u) )
+    {
+        uint32_t ch = (word - LPIT_REG(TMR)) / LPIT_TMR_WORDS;
+        volatile uint32_t* tmr = lpit_tmr(ch);
+
+        if( (ch < LPIT_CHANNELS) && lpit[ch].running )
+        {
+            tmr[1] = tmr[0] - (uint32_t)(lpit_ticks(&lpit[ch], now) % ((uint64_t)tmr[0] + 1u));
+        }
+    }
+}
+
+static void scg_write(uint32_t word, uint32_t old, uint32_t value, uint64_t now)
+{
+    if( word != SCG_REG(SCG_SOSCCSR) )
+    {
+        return;
+    }
+
+    if( (value & SOSCCSR_SOSCEN) && !(old & SOSCCSR_SOSCEN) )
+    {
+        sosc_valid_at = now + (((uint64_t)SOSC_STARTUP_CYCLES * NS_PER_S) / config.osc_hz);
+    }
+    else if( !(value & SOSCCSR_SOSCEN) )
+    {
+        sosc_valid_at = UINT64_MAX;
+    }
+}
+
+static void scg_read(uint32_t word, uint64_t now)
+{
+    volatile uint32_t* regs = blocks[BLOCK_SCG].regs;
+
+    if( word == SCG_REG(SCG_SOSCCSR) )
+    {
+        regs[word] = (now >= sosc_valid_at) ? (regs[word] | SOSCCSR_SOSCVLD) : (regs[word] & ~SOSCCSR_SOSCVLD);
+    }
+}
+
+/* Registers of the NVIC reflect its enable and pending state */
+static void nvic_publish(void)
+{
+    volatile uint32_t* regs = blocks[BLOCK_NVIC].regs;
+
+    for(uint32_t i = 0; i < NVIC_WORDS; i++)
+    {
+        regs[NVIC_REG(ISER) + i] = nvic_enabled[i];
+        regs[NVIC_REG(ICER) + i] = nvic_enabled[i];
+        regs[NVIC_REG(ISPR) + i] = nvic_pending[i];
+        regs[NVIC_REG(ICPR) + i] = nvic_pending[i];
+    }
+}
+
+static void nvic_write(uint32_t word, uint32_t value)
+{
+    /* ISER starts the block */
+    if( word < (NVIC_REG(ISER) + NVIC_WORDS) )
+    {
+        nvic_enabled[word - NVIC_REG(ISER)] |= value;
+    }
+    else if( (word >= NVIC_REG(ICER)) && (word < (NVIC_REG(ICER) + NVIC_WORDS)) )
+    {
+        nvic_enabled[word - NVIC_REG(ICER)] &= ~value;
+    }
+    else if( (word >= NVIC_REG(ISPR)) && (word < (NVIC_REG(ISPR) + NVIC_WORDS)) )
+    {
+        nvic_pending[word - NVIC_REG(ISPR)] |= value;
+    }
+    else if( (word >= NVIC_REG(ICPR)) && (word < (NVIC_REG(ICPR) + NVIC_WORDS)) )
+    {
+        nvic_pending[word - NVIC_REG(ICPR)] &= ~value;
+    }
+    else
+    {
+        return;
+    }
+
+    nvic_publish();
+}
+
+/* A level interrupt still asserted when its handler returns pends again, not while it runs */
+static void nvic_raise(uint32_t irq, uint32_t level)
+{
+    if( level && ((int32_t)irq != cpu_active_irq) )
+    {
+        nvic_pending[irq >> 5] |= 1u << (irq & 0x1Fu);
+    }
+}
+
+/* Level interrupts of the modelled sources pend their line */
+static void nvic_sample_lines(void)
+{
+    static const IRQn_Type mb_low[FlexCAN_instances]  = { CAN0_ORed_0_15_MB_IRQn, CAN1_ORed_0_15_MB_IRQn };
+    static const IRQn_Type ored[FlexCAN_instances]    = { CAN0_ORed_IRQn, CAN1_ORed_IRQn };
+    static const IRQn_Type error[FlexCAN_instances]   = { CAN0_Error_IRQn, CAN1_Error_IRQn };
+
+    for(uint32_t i = 0; i < FlexCAN_instances; i++)
+    {
+        volatile uint32_t* regs = controllers[i].regs;
+        uint32_t flags = regs[R_IFLAG1] & regs[R_IMASK1];
+        uint32_t ctrl1 = regs[R_CTRL1];
+        uint32_t esr1 = regs[R_ESR1];
+
+        nvic_raise(mb_low[i], flags & 0xFFFFu);
+        if( i == FlexCAN_0 )
+        {
+            nvic_raise(CAN0_ORed_16_31_MB_IRQn, flags & 0xFFFF0000u);
+        }
+
+        nvic_raise(ored[i], ((esr1 & ESR1_BOFFINT) && (ctrl1 & CTRL1_BOFFMSK)) ||
+                            ((esr1 & ESR1_TWRNINT) && (ctrl1 & CTRL1_TWRNMSK)) ||
+                            ((esr1 & ESR1_RWRNINT) && (ctrl1 & CTRL1_RWRNMSK)) ||
+                            ((esr1 & ESR1_BOFFDONEINT) && (regs[R_CTRL2] & CTRL2_BOFFDONEMSK)));
+        nvic_raise(error[i], (esr1 & ESR1_ERRINT) && (ctrl1 & CTRL1_ERRMSK));
+    }
+
+    volatile uint32_t* lpit_regs = blocks[BLOCK_LPIT0].regs;
+    nvic_raise(LPIT0_Ch0_IRQn, lpit_regs[LPIT_REG(MSR)] & lpit_regs[LPIT_REG(MIER)] & 1u);
+
+    nvic_publish();
+}
+
+/* Enabled pending interrupt of the highest priority, lowest number first, made active */
+static int32_t nvic_take(void)
+{
+    volatile uint8_t* priorities = (volatile uint8_t*)blocks[BLOCK_NVIC].regs + NVIC_IP_OFFSET;
+    int32_t best = -1;
+    uint32_t best_priority = 0x100u;
+
+    nvic_sample_lines();
+
+    for(uint32_t i = 0; i < NVIC_WORDS; i++)
+    {
+        for(uint32_t ready = nvic_enabled[i] & nvic_pending[i]; ready; ready &= ready - 1u)
+        {
+            uint32_t irq = (32u * i) + (uint32_t)__builtin_ctz(ready);
+
+            if( priorities[irq] < best_priority )
+            {
+                best_priority = priorities[irq];
+                best = (int32_t)irq;
+            }
+        }
+    }
+
+    if( best >= 0 )
+    {
+        nvic_pending[best >> 5] &= ~(1u << (best & 0x1F));
+        nvic_publish();
+    }
+
+    return best;
+}
+
+static void (*handler_of(int32_t irq))(void)
+{
+    switch( irq )
+    {
+    case LPIT0_Ch0_IRQn:          return LPIT0_Ch0_IRQHandler;
+    case CAN0_ORed_IRQn:          return CAN0_ORed_IRQHandler;
+    case CAN0_Error_IRQn:         return CAN0_Error_IRQHandler;
+    case CAN0_ORed_0_15_MB_IRQn:  return CAN0_ORed_0_15_MB_IRQHandler;
+    case CAN0_ORed_16_31_MB_IRQn: return CAN0_ORed_16_31_MB_IRQHandler;
+    case CAN1_ORed_IRQn:          return CAN1_ORed_IRQHandler;
+    case CAN1_Error_IRQn:         return CAN1_Error_IRQHandler;
+    case CAN1_ORed_0_15_MB_IRQn:  return CAN1_ORed_0_15_MB_IRQHandler;
+    default:                      return 0;
+    }
+}
+
+/* Run the pending handlers unless masked or one already runs, they don't preempt each other */
+static void dispatch(void)
+{
+    if( cpu_masked || cpu_in_handler )
+    {
+        return;
+    }
+
+    cpu_in_handler = 1;
+
+    for(;;)
+    {
+        model_enter();
+        int32_t irq = nvic_take();
+        model_exit();
+
+        if( irq < 0 )
+        {
+            break;
+        }
+
+        void (*handler)(void) = handler_of(irq);
+
+        stats.interrupts++;
+        cpu_active_irq = irq;
+        if( handler != 0 )
+        {
+            handler();
+        }
+        cpu_active_irq = -1;
+    }
+
+    cpu_in_handler = 0;
+}
+
+void host_interrupts_disable(void)
+{
+    cpu_masked = 1;
+    COMPILER_BARRIER();
+}
+
+void host_interrupts_enable(void)
+{
+    COMPILER_BARRIER();
+    cpu_masked = 0;
+    dispatch();
+}
+
+/*------------------------------------ eDMA -------------------------------------------*/
+
+static DMA_Type* edma_regs(void)
+{
+    return (DMA_Type*)blocks[BLOCK_EDMA].regs;
+}
+
+/* CERQ and SERQ written, the write-only byte registers read as zero */
+static void edma_write(uint32_t word, uint32_t byte)
+{
+    DMA_Type* edma = edma_regs();
+    uint32_t offset = (word * sizeof(uint32_t)) + byte;
+    volatile uint8_t* reg = (volatile uint8_t*)blocks[BLOCK_EDMA].regs + offset;
+    uint32_t channels = (*reg & EDMA_ALL_CHANNELS) ? 0xFFFFu : (1u << (*reg & (EDMA_CHANNELS - 1u)));
+
+    if( offset == offsetof(DMA_Type, CERQ) )
+    {
+        edma->ERQ &= ~channels;
+        *reg = 0;
+    }
+    else if( offset == offsetof(DMA_Type, SERQ) )
+    {
+        edma->ERQ |= channels;
+        *reg = 0;
+    }
+}
+
+/* Word at a 32-bit bus address: a register through the writable mapping, else host memory */
+static volatile uint32_t* bus_word(uint32_t address)
+{
+    block_id_t b = block_of(address);
+
+    if( b == BLOCKS )
+    {
+        return (volatile uint32_t*)(uintptr_t)address;
+    }
+
+    if( (address < blocks[b].address) || (address >= (blocks[b].address + (blocks[b].words * sizeof(uint32_t)))) )
+    {
+        sim_abort("eDMA access next to a register block");
+    }
+
+    return &blocks[b].regs[(address - blocks[b].address) / sizeof(uint32_t)];
+}
+
+/* One minor loop of a channel, and the end of the major loop when its count runs out */
+static void edma_minor_loop(uint32_t ch)
+{
+    DMA_Type* edma = edma_regs();
+    __typeof__(edma->TCD[0])* tcd = &edma->TCD[ch];
+
+    if( ((tcd->ATTR & EDMA_ATTR_SIZES) != EDMA_ATTR_SIZES_32) || ((tcd->NBYTES.MLNO % sizeof(uint32_t)) != 0u) )
+    {
+        sim_abort("eDMA transfers other than 32-bit are not modelled");
+    }
+
+    /* The source modulo keeps the upper address bits, the offset only wraps the lower ones */
+    uint32_t smod = (tcd->ATTR >> EDMA_ATTR_SMOD_SHIFT) & 0x1Fu;
+    uint32_t fixed = smod ? ~((1u << smod) - 1u) : 0u;
+    uint32_t saddr = tcd->SADDR;
+    uint32_t daddr = tcd->DADDR;
+
+    for(uint32_t n = 0; n < tcd->NBYTES.MLNO; n += sizeof(uint32_t))
+    {
+        *bus_word(daddr) = *bus_word(saddr);
+        saddr = (saddr & fixed) | ((saddr + (uint32_t)(int32_t)(int16_t)tcd->SOFF) & ~fixed);
+        daddr += (uint32_t)(int32_t)(int16_t)tcd->DOFF;
+    }
+
+    uint32_t citer = (tcd->CITER.ELINKNO & EDMA_CITER_MASK) - 1u;
+
+    if( citer == 0u )
+    {
+        saddr += tcd->SLAST;
+        daddr += tcd->DLASTSGA;
+        citer = tcd->BITER.ELINKNO & EDMA_CITER_MASK;
+        tcd->CSR |= EDMA_CSR_DONE;
+
+        if( tcd->CSR & EDMA_CSR_DREQ )
+        {
+            edma->ERQ &= ~(1u << ch);
+        }
+        if( tcd->CSR & EDMA_CSR_INTMAJOR )
+        {
+            edma->INT |= 1u << ch;
+        }
+    }
+
+    tcd->SADDR = saddr;
+    tcd->DADDR = daddr;
+    tcd->CITER.ELINKNO = (uint16_t)citer;
+}
+
+/* RX FIFO of a controller in DMA mode: each frame available raises the request of its DMAMUX
+ * source, the minor loop reading the output pops the FIFO */
+static void edma_update(void)
+{
+    static const uint8_t sources[FlexCAN_instances] = { EDMA_REQ_FLEXCAN0, EDMA_REQ_FLEXCAN1 };
+    volatile uint8_t* chcfg = (volatile uint8_t*)blocks[BLOCK_DMAMUX].regs;
+    DMA_Type* edma = edma_regs();
+
+    if( !(blocks[BLOCK_PCC].regs[PCC_REG(PCC_DMAMUX)] & PCC_CGC) )
+    {
+        return;
+    }
+
+    for(uint32_t ch = 0; ch < EDMA_CHANNELS; ch++)
+    {
+        for(uint32_t i = 0; (i < FlexCAN_instances) && (chcfg[ch] & DMAMUX_ENBL); i++)
+        {
+            controller_t* c = &controllers[i];
+
+            if( (chcfg[ch] & DMAMUX_SOURCE) != sources[i] )
+            {
+                continue;
+            }
+
+            while( ((edma->ERQ >> ch) & 1u) && ((c->regs[R_MCR] & (MCR_DMA | MCR_RFEN)) == (MCR_DMA | MCR_RFEN)) &&
+                   c->fifo_count )
+            {
+                edma_minor_loop(ch);
+                c->regs[R_IFLAG1] &= ~IFLAG1_BUF5I;
+                fifo_pop(c);
+            }
+        }
+    }
+}
+
+/*------------------------------------ Model ------------------------------------------*/
+
+static void model_sync(uint64_t now)
+{
+    for(uint32_t i = 0; i < FlexCAN_instances; i++)
+    {
+        controller_update(&controllers[i], now);
+    }
+
+    for(uint32_t b = 0; b < SIM_BUSES; b++)
+    {
+        if( buses[b].used )
+        {
+            bus_advance(&buses[b], now);
+        }
+    }
+
+    for(uint32_t i = 0; i < FlexCAN_instances; i++)
+    {
+        controller_update(&controllers[i], now);
+    }
+
+    edma_update();
+    lpit_update(now);
+    nvic_sample_lines();
+}
+
+static controller_t* controller_of(block_id_t b)
+{
+    return (b == BLOCK_CAN0) ? &controllers[FlexCAN_0] : ((b == BLOCK_CAN1) ? &controllers[FlexCAN_1] : 0);
+}
+
+static void before_access(block_id_t b, uint32_t word, uint64_t now)
+{
+    controller_t* c = controller_of(b);
+
+    if( c != 0 )
+    {
+        if( !clock_enabled(c) )
+        {
+            sim_abort("FlexCAN register accessed with its clock gated");
+        }
+        can_read(c, word, now);
+    }
+    else if( b == BLOCK_LPIT0 )
+    {
+        if( !lpit_clock_enabled() )
+        {
+            sim_abort("LPIT0 register accessed with its clock gated");
+        }
+        lpit_read(word, now);
+    }
+    else if( b == BLOCK_SCG )
+    {
+        scg_read(word, now);
+    }
+}
+
+static void after_access(block_id_t b, uint64_t now)
+{
+    static uint32_t changed[BLOCK_WORDS_MAX];
+    static uint32_t written[BLOCK_WORDS_MAX];
+    block_t* block = &blocks[b];
+    controller_t* c = controller_of(b);
+    uint32_t count = 0;
+
+    /* Collect the writes first, applying one may update other registers. Writing the value
+     * a register already holds matters for the write 1 to clear ones */
+    for(uint32_t w = 0; w < block->words; w++)
+    {
+        if( (block->before[w] != block->regs[w]) || ((w == block->fault_word) && block->fault_write) )
+        {
+            changed[count] = w;
+            written[count] = block->regs[w];
+            count++;
+        }
+    }
+
+    for(uint32_t i = 0; i < count; i++)
+    {
+        uint32_t w = changed[i];
+        uint32_t old = block->before[w];
+        uint32_t value = written[i];
+
+        if( c != 0 )
+        {
+            can_write(c, w, old, value, now);
+        }
+        else if( b == BLOCK_NVIC )
+        {
+            nvic_write(w, value);
+        }
+        else if( b == BLOCK_LPIT0 )
+        {
+            lpit_write(w, old, value, now);
+        }
+        else if( b == BLOCK_SCG )
+        {
+            scg_write(w, old, value, now);
+        }
+        else if( (b == BLOCK_EDMA) && (w == block->fault_word) )
+        {
+            edma_write(w, block->fault_byte);
+        }
+    }
+
+    /* Reading ESR1 clears its error bits */
+    if( (c != 0) && (block->fault_word == R_ESR1) && !block->fault_write )
+    {
+        c->regs[R_ESR1] &= ~ESR1_READ_CLEAR;
+    }
+}
+
+/*------------------------------------ Traps ------------------------------------------*/
+
+static block_id_t block_of(uintptr_t address)
+{
+    for(uint32_t b = 0; b < BLOCKS; b++)
+    {
+        if( (address >= blocks[b].page) && (address < (blocks[b].page + blocks[b].length)) )
+        {
+            return (block_id_t)b;
+        }
+    }
+
+    return BLOCKS;
+}
+
+/* Access to a register page: apply what the hardware does before it, open the page and
+ * single-step the instruction with the tick blocked */
+static void on_fault(int sig, siginfo_t* info, void* context)
+{
+    ucontext_t* uc = (ucontext_t*)context;
+    uintptr_t address = (uintptr_t)info->si_addr;
+    block_id_t b = block_of(address);
+    int saved_errno = errno;
+
+    (void)sig;
+
+    if( b == BLOCKS )
+    {
+        /* Not a register, fault again without this handler */
+        signal(SIGSEGV, SIG_DFL);
+        return;
+    }
+
+    if( model_depth != 0 )
+    {
+        sim_abort("register accessed from the simulator");
+    }
+
+    block_t* block = &blocks[b];
+
+    if( trap_blocks == 0u )
+    {
+        trap_entry = wall_ns();
+        trap_now = sim_time(trap_entry);
+        trap_tick_blocked = (uint8_t)sigismember(&uc->uc_sigmask, SIGALRM);
+        sigaddset(&uc->uc_sigmask, SIGALRM);
+
+        model_depth = 1;
+        model_sync(trap_now);
+        model_depth = 0;
+    }
+
+    block->fault_word = (address < block->address) ? UINT32_MAX : (uint32_t)((address - block->address) / sizeof(uint32_t));
+    block->fault_write = (uc->uc_mcontext.gregs[REG_ERR] & PF_ERR_WRITE) ? 1u : 0u;
+    block->fault_byte = (uint32_t)(address % sizeof(uint32_t));
+
+    model_depth = 1;
+    before_access(b, block->fault_word, trap_now);
+    model_depth = 0;
+
+    memcpy(block->before, (const void*)block->regs, block->words * sizeof(uint32_t));
+    trap_blocks |= 1u << b;
+
+    mprotect((void*)block->page, block->length, PROT_READ | PROT_WRITE);
+    uc->uc_mcontext.gregs[REG_EFL] |= EFLAGS_TF;
+
+    errno = saved_errno;
+}
+
+/* The instruction completed: apply its writes, close the pages and run the interrupts it raised */
+static void on_step(int sig, siginfo_t* info, void* context)
+{
+    ucontext_t* uc = (ucontext_t*)context;
+    uint32_t opened = trap_blocks;
+    uint8_t wrote = 0;
+    int saved_errno = errno;
+
+    (void)sig;
+    (void)info;
+
+    if( opened == 0u )
+    {
+        sim_abort("unexpected trace trap");
+    }
+
+    uc->uc_mcontext.gregs[REG_EFL] &= ~(greg_t)EFLAGS_TF;
+    trap_blocks = 0;
+
+    model_depth = 1;
+    for(uint32_t b = 0; b < BLOCKS; b++)
+    {
+        if( (opened >> b) & 1u )
+        {
+            block_t* block = &blocks[b];
+
+            mprotect((void*)block->page, block->length, PROT_NONE);
+            wrote |= block->fault_write || memcmp(block->before, (const void*)block->regs, block->words * sizeof(uint32_t));
+            after_access((block_id_t)b, trap_now);
+        }
+    }
+    nvic_sample_lines();
+    model_depth = 0;
+
+    if( wrote )
+    {
+        stats.writes++;
+    }
+    else
+    {
+        stats.reads++;
+    }
+    stats.trap_ns += wall_ns() - trap_entry;
+
+    if( !trap_tick_blocked )
+    {
+        sigdelset(&uc->uc_sigmask, SIGALRM);
+    }
+
+    dispatch();
+
+    errno = saved_errno;
+}
+
+static void on_tick(int sig)
+{
+    int saved_errno = errno;
+
+    (void)sig;
+
+    if( model_depth != 0 )
+    {
+        tick_deferred = 1;
+        return;
+    }
+
+    model_depth = 1;
+    model_sync(sim_now());
+    model_depth = 0;
+
+    dispatch();
+
+    errno = saved_errno;
+}
+
+/*------------------------------------ API --------------------------------------------*/
+
+status_t sim_init(const sim_config_t* cfg)
+{
+    const struct {
+        const volatile void* address;
+        size_t size;
+    } layout[BLOCKS] = {
+        [BLOCK_CAN0]   = { &host_CAN0,     sizeof(host_CAN0) },
+        [BLOCK_CAN1]   = { &host_CAN1,     sizeof(host_CAN1) },
+        [BLOCK_SCG]    = { &host_SCG,      sizeof(host_SCG) },
+        [BLOCK_PCC]    = { &host_PCC,      sizeof(host_PCC) },
+        [BLOCK_PORTD]  = { &host_PORTD,    sizeof(host_PORTD) },
+        [BLOCK_PORTE]  = { &host_PORTE,    sizeof(host_PORTE) },
+        [BLOCK_PTD]    = { &host_PTD,      sizeof(host_PTD) },
+        [BLOCK_NVIC]   = { &host_S32_NVIC, sizeof(host_S32_NVIC) },
+        [BLOCK_EDMA]   = { &host_EDMA,     sizeof(host_EDMA) },
+        [BLOCK_DMAMUX] = { &host_DMAMUX,   sizeof(host_DMAMUX) },
+        [BLOCK_LPIT0]  = { &host_LPIT0,    sizeof(host_LPIT0) },
+    };
+
+    config = (cfg != 0) ? *cfg : default_config;
+    config.slowdown = (config.slowdown != 0u) ? config.slowdown : 1u;
+    start_ns = wall_ns();
+    clock_last_ns = start_ns;
+
+    /* Every block on pages of its own, seen by the driver without access and by the simulator writable */
+    for(uint32_t b = 0; b < BLOCKS; b++)
+    {
+        block_t* block = &blocks[b];
+
+        block->address = (uintptr_t)layout[b].address;
+        block->words = (uint32_t)(layout[b].size / sizeof(uint32_t));
+        block->page = block->address & ~(uintptr_t)(PAGE_BYTES - 1u);
+        block->length = ((block->address + layout[b].size - block->page) + PAGE_BYTES - 1u) & ~(size_t)(PAGE_BYTES - 1u);
+
+        int fd = memfd_create("CAN_sim", 0);
+        if( (fd < 0) || (ftruncate(fd, (off_t)block->length) != 0) )
+        {
+            return Failure;
+        }
+
+        void* view = mmap((void*)block->page, block->length, PROT_NONE, MAP_SHARED | MAP_FIXED_NOREPLACE, fd, 0);
+        void* alias = mmap(0, block->length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+
+        if( (view != (void*)block->page) || (alias == MAP_FAILED) )
+        {
+            return Failure;
+        }
+
+        block->regs = (volatile uint32_t*)((uint8_t*)alias + (block->address - block->page));
+    }
+
+    /* Out of reset every PCC register shows its peripheral present */
+    for(uint32_t w = 0; w < blocks[BLOCK_PCC].words; w++)
+    {
+        blocks[BLOCK_PCC].regs[w] = PCC_PR;
+    }
+
+    controllers[FlexCAN_0].regs = blocks[BLOCK_CAN0].regs;
+    controllers[FlexCAN_0].pcc_word = PCC_REG(PCC_FlexCAN0);
+    controllers[FlexCAN_0].mb_count = 32;
+    controllers[FlexCAN_1].regs = blocks[BLOCK_CAN1].regs;
+    controllers[FlexCAN_1].pcc_word = PCC_REG(PCC_FlexCAN1);
+    controllers[FlexCAN_1].mb_count = 16;
+
+    for(uint32_t i = 0; i < FlexCAN_instances; i++)
+    {
+        controller_reset(&controllers[i]);
+    }
+
+    struct sigaction action;
+
+    memset(&action, 0, sizeof(action));
+    sigemptyset(&action.sa_mask);
+    sigaddset(&action.sa_mask, SIGALRM);
+
+    action.sa_flags = SA_SIGINFO;
+    action.sa_sigaction = on_fault;
+    sigaction(SIGSEGV, &action, 0);
+
+    /* Handlers run from the trap take their own traps */
+    action.sa_flags = SA_SIGINFO | SA_NODEFER;
+    action.sa_sigaction = on_step;
+    sigaction(SIGTRAP, &action, 0);
+
+    memset(&action, 0, sizeof(action));
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    action.sa_handler = on_tick;
+    sigaction(SIGALRM, &action, 0);
+
+    timer_t timer;
+    struct sigevent event;
+    struct itimerspec period;
+
+    memset(&event, 0, sizeof(event));
+    event.sigev_notify = SIGEV_SIGNAL;
+    event.sigev_signo = SIGALRM;
+
+    period.it_interval.tv_sec = config.tick_ns / NS_PER_S;
+    period.it_interval.tv_nsec = config.tick_ns % NS_PER_S;
+    period.it_value = period.it_interval;
+
+    if( (timer_create(CLOCK_MONOTONIC, &event, &timer) != 0) || (timer_settime(timer, 0, &period, 0) != 0) )
+    {
+        return Failure;
+    }
+
+    return Success;
+}
+
+sim_bus_t* sim_bus_create(uint32_t bitrate)
+{
+    return sim_bus_create_fd(bitrate, bitrate);
+}
+
+sim_bus_t* sim_bus_create_fd(uint32_t bitrate, uint32_t data_bitrate)
+{
+    sim_bus_t* bus = 0;
+
+    model_enter();
+
+    for(uint32_t b = 0; (b < SIM_BUSES) && (bus == 0); b++)
+    {
+        if( !buses[b].used )
+        {
+            bus = &buses[b];
+            memset(bus, 0, sizeof(*bus));
+            bus->used = 1;
+            bus->bitrate = bitrate;
+            bus->data_bitrate = data_bitrate;
+            bus->idle_from = bits_ceil(bus, sim_now());
+        }
+    }
+
+    model_exit();
+
+    return bus;
+}
+
+void sim_attach(FlexCAN_instance_t can, sim_bus_t* bus)
+{
+    model_enter();
+
+    controller_t* c = &controllers[can];
+    c->bus = bus;
+    c->ready_at = sync_time(c, sim_now());
+
+    model_exit();
+}
+
+sim_node_t* sim_node_create(sim_bus_t* bus)
+{
+    sim_node_t* node = 0;
+
+    model_enter();
+
+    if( node_count < SIM_NODES )
+    {
+        node = &nodes[node_count];
+        memset(node, 0, sizeof(*node));
+        node->bus = bus;
+        node_count++;
+    }
+
+    model_exit();
+
+    return node;
+}
+
+status_t sim_node_send(sim_node_t* node, const sim_frame_t* frame)
+{
+    status_t status = BufferFull;
+
+    model_enter();
+
+    if( (node->tx_head - node->tx_tail) < SIM_NODE_QUEUE )
+    {
+        node_queue(node, frame, bits_ceil(node->bus, sim_now()));
+        status = Success;
+    }
+
+    model_exit();
+
+    return status;
+}
+
+void sim_node_generate(sim_node_t* node, const sim_frame_t* frame, uint64_t period_ns, uint32_t count)
+{
+    model_enter();
+
+    node->gen_frame = *frame;
+    node->gen_period = period_ns;
+    node->gen_next = sim_now();
+    node->gen_left = count;
+
+    model_exit();
+}
+
+status_t sim_node_receive(sim_node_t* node, sim_frame_t* frame)
+{
+    status_t status = Failure;
+
+    model_enter();
+
+    if( node->rx_tail != node->rx_head )
+    {
+        *frame = node->rx[node->rx_tail % SIM_NODE_RX_QUEUE];
+        node->rx_tail++;
+        status = Success;
+    }
+
+    model_exit();
+
+    return status;
+}
+
+void sim_run(uint64_t ns)
+{
+    uint64_t end = sim_now() + ns;
+
+    while( sim_now() < end )
+    {
+        pause();
+    }
+}
+
+void sim_inject_errors(FlexCAN_instance_t can, uint32_t error, uint32_t count, uint8_t transmitter)
+{
+    model_enter();
+
+    controller_t* c = &controllers[can];
+    uint64_t now = sim_now();
+
+    for(uint32_t i = 0; i < count; i++)
+    {
+        bus_error(c, error, transmitter, now);
+    }
+    controller_update(c, now);
+
+    model_exit();
+}
+
+void sim_get_stats(sim_stats_t* out, uint8_t reset)
+{
+    model_enter();
+
+    *out = stats;
+    if( reset )
+    {
+        memset(&stats, 0, sizeof(stats));
+    }
+
+    model_exit();
+}
+
+void sim_get_bus_stats(sim_bus_t* bus, sim_bus_stats_t* out, uint8_t reset)
+{
+    model_enter();
+
+    *out = bus->stats;
+    if( reset )
+    {
+        memset(&bus->stats, 0, sizeof(bus->stats));
+    }
+
+    model_exit();
+}
+
+void sim_get_node_stats(sim_node_t* node, sim_node_stats_t* out, uint8_t reset)
+{
+    model_enter();
+
+    *out = node->stats;
+    if( reset )
+    {
+        memset(&node->stats, 0, sizeof(node->stats));
+    }
+
+    model_exit();
+}
@@ -0,0 +1,238 @@
+/**
+ * @file
+ * Header file for the host simulator of the FlexCAN, NVIC, SCG, LPIT0, eDMA and DMAMUX registers
+ * the driver uses
+ *
+ * Host builds (HOST_REGISTERS) link the register blocks at fixed addresses, see test/Makefile.
+ * The simulator maps them without any access right and catches every access of the driver with a
+ * page fault, single-steps the instruction on a writable mapping, and applies the side effects of
+ * the hardware right around it: write-1-to-clear flags, the RX FIFO advancing when BUF5I is
+ * cleared, message buffer locking, freeze and low power acknowledgements, the free running timer.
+ * The driver therefore runs unmodified, only slower, about 10 us per register access.
+ *
+ * Time runs from CLOCK_MONOTONIC, divided by the slowdown of the configuration so a simulated
+ * microcontroller keeps up with busier buses, and skips the stretches the host didn't run the
+ * process for longer than a millisecond. A periodic signal advances the buses and raises the
+ * interrupts of the driver, which run on the calling thread as the NVIC would. Handlers don't
+ * preempt each other, and CRITICAL_ENTER() masks them like PRIMASK does.
+ *
+ * Modelled:
+ *  - MCR handshakes: LPMACK, FRZACK at the end of the current frame, NOTRDY until 11 recessive bits
+ *  - Registers only writable in freeze mode ignore other writes, counted by the statistics
+ *  - RX FIFO of 6 frames with IFLAG1 BUF5I, BUF6I (4 to 5 frames) and BUF7I (frame lost), ID filter
+ *    table formats A, B, C and D, individual and global masks, IDHIT, and the MRP order
+ *  - Message buffer CODE state machine for reception (EMPTY, FULL, OVERRUN, serviced, locking) and
+ *    transmission (DATA, abort with AEN, INACTIVE), internal arbitration with LPRIOEN and LBUF
+ *  - CAN FD with FDEN: message buffers of the MBDSR0 payload size packed in the 512 bytes of RAM,
+ *    EDL, BRS with FDRATE, the data length codes above 8, the data phase at the FDCBT bit rate
+ *  - 16-bit timer at the bit rate, stopped in freeze mode, timestamps at the start of the identifier
+ *  - Buses at a configurable bit rate with bit-stuffed frame lengths, arbitration, ACK and
+ *    virtual nodes. A controller whose bit timings don't give the bus bit rate stays off the bus,
+ *    as does one switching to a data bit rate other than the one of the bus
+ *  - Fault confinement: error counters, error passive, bus-off past 255 transmit errors with
+ *    BOFFINT, recovery after 128 occurrences of 11 recessive bits unless BOFFREC holds it, then
+ *    BOFFDONEINT and cleared counters. Besides missing ACKs, bus errors are injected
+ *  - eDMA channels the DMAMUX routes to the RX FIFO of a controller in DMA mode: 32-bit minor
+ *    loops with source modulo, each popping the FIFO, major loop count, last address adjustments,
+ *    DONE and DREQ
+ *  - SOSC valid 4096 crystal cycles after SOSCEN, LPIT0 channels as 32-bit periodic counters
+ *  - NVIC enable, pending and priority registers, level interrupts of the modelled sources
+ *
+ * Not modelled: the error frames CAN FD frames cause in classical controllers, which ignore them,
+ * ESI, other eDMA requests and the eDMA interrupts, pretended networking, bus errors other than
+ * missing ACKs unless injected.
+ *
+ * Linux on x86-64 only, in a single threaded, non-PIE executable.
+ */
+
+#ifndef FLEXCAN_TEST_SIM_CAN_SIM_H_
+#define FLEXCAN_TEST_SIM_CAN_SIM_H_
+
+#include <FlexCAN/include/CAN_RXFIFO.h>
+
+/* Limits of the simulated topology */
+#define SIM_BUSES           (4u)
+#define SIM_NODES           (8u)
+#define SIM_NODE_QUEUE      (64u)
+#define SIM_NODE_RX_QUEUE   (256u)
+
+/* Simulation parameters */
+typedef struct{
+	uint32_t slowdown;        /* Wall clock time per simulated time, 1 for real time */
+	uint32_t tick_ns;         /* Period of the signal advancing the buses, in wall clock time */
+	uint32_t osc_hz;          /* SOSCDIV2 clock, CTRL1 CLKSRC = 0 and LPIT0 */
+	uint32_t periph_hz;       /* Peripheral clock, CTRL1 CLKSRC = 1 */
+} sim_config_t;
+
+/* Frame on a simulated bus */
+typedef struct{
+	uint32_t ID;                       /* Standard ID, or extended ID ORed with CAN_ID_EXT */
+	uint8_t dlc;                       /* Up to 15, CAN FD lengths when edl is set */
+	uint8_t rtr;
+	uint8_t edl;                       /* CAN FD frame, never remote */
+	uint8_t brs;                       /* Data phase of a CAN FD frame at the data bit rate */
+	uint32_t payload[MAX_FD_MTU_WORDS]; /* Message buffer words, as frame_t and fd_frame_t */
+	uint64_t time;                     /* Start of frame in simulated ns, set on reception */
+} sim_frame_t;
+
+/* Counters of the register accesses and interrupts */
+typedef struct{
+	uint64_t reads;           /* Trapped register accesses that only read */
+	uint64_t writes;          /* Trapped register accesses that wrote */
+	uint64_t trap_ns;         /* Wall clock time spent in the trap handlers */
+	uint64_t interrupts;      /* Handlers run */
+	uint64_t ignored_writes;  /* Writes to freeze mode only fields outside of freeze mode */
+} sim_stats_t;
+
+/* Counters of a bus */
+typedef struct{
+	uint64_t frames;          /* Frames acknowledged */
+	uint64_t bits;            /* Nominal bit times the frames took, including stuff bits and intermission */
+	uint64_t ack_errors;      /* Frames nobody acknowledged, retransmitted */
+} sim_bus_stats_t;
+
+/* Counters of a virtual node */
+typedef struct{
+	uint64_t sent;
+	uint64_t received;
+	uint64_t tx_dropped;      /* Frames refused or generated while the queue was full */
+	uint64_t rx_dropped;      /* Frames received while the queue was full */
+} sim_node_stats_t;
+
+/* Bus errors a controller can be made to detect, as their ESR1 bits */
+#define SIM_STUFF_ERROR     (1u << 10)
+#define SIM_FORM_ERROR      (1u << 11)
+#define SIM_CRC_ERROR       (1u << 12)
+#define SIM_ACK_ERROR       (1u << 13)
+#define SIM_BIT0_ERROR      (1u << 14)
+#define SIM_BIT1_ERROR      (1u << 15)
+
+typedef struct sim_bus sim_bus_t;
+typedef struct sim_node sim_node_t;
+
+/**
+ *  Map the register blocks, install the trap and tick handlers and reset the simulated hardware.
+ *  Call it once, before any driver function.
+ *
+ *  @param [in] config  Simulation parameters, NULL for real time, a 50 us tick, 8 MHz and 48 MHz
+ *
+ *  @return Success If the register blocks could be mapped at their link addresses
+ */
+status_t sim_init(const sim_config_t* config);
+
+/**
+ *  Add a bus.
+ *
+ *  @param [in] bitrate  Nominal bit rate in bit/s
+ *
+ *  @return The bus, NULL if all SIM_BUSES are used
+ */
+sim_bus_t* sim_bus_create(uint32_t bitrate);
+
+/**
+ *  Add a bus carrying CAN FD frames whose data phase may switch to a faster bit rate.
+ *
+ *  @param [in] bitrate       Nominal bit rate in bit/s
+ *  @param [in] data_bitrate  Data phase bit rate of frames with BRS, in bit/s
+ *
+ *  @return The bus, NULL if all SIM_BUSES are used
+ */
+sim_bus_t* sim_bus_create_fd(uint32_t bitrate, uint32_t data_bitrate);
+
+/**
+ *  Connect a FlexCAN instance to a bus, it takes part once its bit timings give the bus bit rate
+ *  and it left freeze mode.
+ *
+ *  @param [in] can  Instance to connect
+ *  @param [in] bus  Bus, NULL to disconnect
+ */
+void sim_attach(FlexCAN_instance_t can, sim_bus_t* bus);
+
+/**
+ *  Add a virtual node, which acknowledges and queues every frame of its bus.
+ *
+ *  @param [in] bus  Bus of the node
+ *
+ *  @return The node, NULL if all SIM_NODES are used
+ */
+sim_node_t* sim_node_create(sim_bus_t* bus);
+
+/**
+ *  Queue a frame for transmission from a virtual node, from now on.
+ *
+ *  @param [in] node   Transmitting node
+ *  @param [in] frame  Frame to send, its time is ignored
+ *
+ *  @return Success If the frame was queued
+ *  @return BufferFull If SIM_NODE_QUEUE frames wait for the bus
+ */
+status_t sim_node_send(sim_node_t* node, const sim_frame_t* frame);
+
+/**
+ *  Make a virtual node queue a frame periodically, payload word 0 counting from its initial value.
+ *
+ *  @param [in] node       Transmitting node
+ *  @param [in] frame      First frame
+ *  @param [in] period_ns  Period in simulated ns, the first frame is queued now
+ *  @param [in] count      Number of frames, 0 to stop the generator
+ */
+void sim_node_generate(sim_node_t* node, const sim_frame_t* frame, uint64_t period_ns, uint32_t count);
+
+/**
+ *  Take the oldest frame a virtual node received.
+ *
+ *  @param [in] node    Receiving node
+ *  @param [out] frame  Frame with the time of its start of frame
+ *
+ *  @return Success If a frame was waiting
+ */
+status_t sim_node_receive(sim_node_t* node, sim_frame_t* frame);
+
+/**
+ *  Let simulated time pass, while the interrupts and buses run.
+ *
+ *  @param [in] ns  Simulated ns to wait
+ */
+void sim_run(uint64_t ns);
+
+/**
+ *  Simulated ns since sim_init().
+ */
+uint64_t sim_now(void);
+
+/**
+ *  Length of a frame on the bus in bits, from the start of frame to the end of the intermission,
+ *  those of the data phase of a CAN FD frame included as they are.
+ *
+ *  @param [in] frame  Frame whose stuff bits are counted
+ */
+uint32_t sim_frame_bits(const sim_frame_t* frame);
+
+/**
+ *  Time a frame takes on a bus, from the start of frame to the end of the intermission, with the
+ *  data phase of a CAN FD frame with BRS at the data bit rate.
+ *
+ *  @param [in] bus    Bus the frame is sent on
+ *  @param [in] frame  Frame whose stuff bits are counted
+ */
+uint64_t sim_frame_ns(const sim_bus_t* bus, const sim_frame_t* frame);
+
+/**
+ *  Make a controller detect bus errors now. Each one counts 8 on the transmit error counter of a
+ *  transmitter, which goes bus-off past 255, and 1 on the receive error counter of a receiver.
+ *
+ *  @param [in] can          Instance detecting the errors
+ *  @param [in] error        One of the SIM_*_ERROR bits
+ *  @param [in] count        Number of errors
+ *  @param [in] transmitter  Whether the instance was transmitting
+ */
+void sim_inject_errors(FlexCAN_instance_t can, uint32_t error, uint32_t count, uint8_t transmitter);
+
+/**
+ *  Copy the counters, and clear them when reset is set.
+ */
+void sim_get_stats(sim_stats_t* stats, uint8_t reset);
+void sim_get_bus_stats(sim_bus_t* bus, sim_bus_stats_t* stats, uint8_t reset);
+void sim_get_node_stats(sim_node_t* node, sim_node_stats_t* stats, uint8_t reset);
+
+#endif /* FLEXCAN_TEST_SIM_CAN_SIM_H_ */
@@ -0,0 +1,49 @@
+/**
+ * @file
+ * Header file of the checks shared by the host tests, each test_*.c is a program that
+ * returns nonzero when a check failed
+ */
+
+#ifndef FLEXCAN_TEST_TEST_H_
+#define FLEXCAN_TEST_TEST_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+static uint32_t test_failures = 0;
+
+/* Report a failed condition and carry on with the next checks */
+#define CHECK(cond) \
+    do { \
+        if( !(cond) ) \
+        { \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            test_failures++; \
+        } \
+    } while(0)
+
+/* Same for two integers, printing both */
+#define CHECK_EQ(a, b) \
+    do { \
+        unsigned long long check_a = (unsigned long long)(a); \
+        unsigned long long check_b = (unsigned long long)(b); \
+        if( check_a != check_b ) \
+        { \
+            printf("%s:%d: CHECK_EQ(%s, %s) failed, 0x%llx != 0x%llx\n", \
+                   __FILE__, __LINE__, #a, #b, check_a, check_b); \
+            test_failures++; \
+        } \
+    } while(0)
+
+/* Run one test function */
+#define RUN(test) \
+    do { \
+        uint32_t failures_before = test_failures; \
+        test(); \
+        printf("%s %s\n", (test_failures == failures_before) ? "PASS" : "FAIL", #test); \
+    } while(0)
+
+/* Exit status of the program */
+#define TEST_RESULT() ((test_failures == 0u) ? 0 : 1)
+
+#endif /* FLEXCAN_TEST_TEST_H_ */
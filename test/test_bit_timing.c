@@ -0,0 +1,283 @@
+/**
+ * Source file
+ */
+
+#include "test.h"
+#include <FlexCAN/include/CAN_bit_timing.h>
+#include <string.h>
+
+/* make runs the tests from test/ */
+#define TABLE_PATH          "../include/FlexCAN/include/CAN_bit_timing_table.h"
+
+/* Sample point tolerance of tools/bit_timing_table.py, which has none */
+#define NO_TOLERANCE        (1000u)
+
+/* Field ranges in time quanta, as the reference manual gives them for CAN0_CBT and CAN0_FDCBT */
+#define PRESDIV_MAX         (1024u)
+#define NOMINAL_PROPSEG_MAX (64u)
+#define NOMINAL_PSEG_MAX    (32u)
+#define DATA_PROPSEG_MAX    (31u)
+#define DATA_PSEG_MAX       (8u)
+#define PSEG2_MIN           (2u)
+
+/* Segments of a solution in time quanta */
+typedef struct{
+    uint32_t prescaler;
+    uint32_t propseg;
+    uint32_t pseg1;
+    uint32_t pseg2;
+    uint32_t rjw;
+    uint32_t tq;
+} segments_t;
+
+static segments_t decode(const CAN_bit_timings_t* t, bit_timing_phase_t phase)
+{
+    segments_t s = {
+            .prescaler = t->PRESDIV + 1u,
+            .propseg = (phase == Data_phase) ? t->PROPSEG : (t->PROPSEG + 1u),
+            .pseg1 = t->PSEG1 + 1u,
+            .pseg2 = t->PSEG2 + 1u,
+            .rjw = t->RJW + 1u,
+    };
+
+    s.tq = 1u + s.propseg + s.pseg1 + s.pseg2;
+
+    return s;
+}
+
+static uint32_t sample_point(const segments_t* s)
+{
+    return ((s->tq - s->pseg2) * 1000u) / s->tq;
+}
+
+static uint32_t distance(uint32_t a, uint32_t b)
+{
+    return (a > b) ? (a - b) : (b - a);
+}
+
+/* Closest sample point any legal register setting gives for an exact bit rate, by brute force */
+static uint32_t best_error(uint32_t clock_hz, uint32_t bitrate, uint32_t wanted, bit_timing_phase_t phase)
+{
+    uint32_t propseg_min = (phase == Data_phase) ? 0u : 1u;
+    uint32_t propseg_max = (phase == Data_phase) ? DATA_PROPSEG_MAX : NOMINAL_PROPSEG_MAX;
+    uint32_t pseg_max = (phase == Data_phase) ? DATA_PSEG_MAX : NOMINAL_PSEG_MAX;
+    uint32_t best = UINT32_MAX;
+
+    for(uint32_t prescaler = 1; prescaler <= PRESDIV_MAX; prescaler++)
+    {
+        if( clock_hz % (bitrate * prescaler) )
+        {
+            continue;
+        }
+
+        uint32_t tq = clock_hz / (bitrate * prescaler);
+
+        for(uint32_t pseg2 = PSEG2_MIN; pseg2 <= pseg_max; pseg2++)
+        {
+            for(uint32_t pseg1 = 1; pseg1 <= pseg_max; pseg1++)
+            {
+                if( tq < (1u + pseg1 + pseg2 + propseg_min) )
+                {
+                    break;
+                }
+
+                uint32_t propseg = tq - 1u - pseg1 - pseg2;
+
+                if( propseg <= propseg_max )
+                {
+                    uint32_t error = distance(((tq - pseg2) * 1000u) / tq, wanted);
+                    best = (error < best) ? error : best;
+                }
+            }
+        }
+    }
+
+    return best;
+}
+
+/* A solution gives the exact bit rate, fits its register and samples as close as any setting can */
+static void check_solution(uint32_t clock_hz, uint32_t bitrate, uint32_t wanted, bit_timing_phase_t phase,
+                           const CAN_bit_timings_t* timings)
+{
+    segments_t s = decode(timings, phase);
+    uint32_t pseg_max = (phase == Data_phase) ? DATA_PSEG_MAX : NOMINAL_PSEG_MAX;
+
+    CHECK_EQ(s.prescaler * s.tq * bitrate, clock_hz);
+    CHECK(s.prescaler <= PRESDIV_MAX);
+    CHECK(s.propseg <= ((phase == Data_phase) ? DATA_PROPSEG_MAX : NOMINAL_PROPSEG_MAX));
+    CHECK((s.pseg1 >= 1u) && (s.pseg1 <= pseg_max));
+    CHECK((s.pseg2 >= PSEG2_MIN) && (s.pseg2 <= pseg_max));
+    CHECK(s.rjw <= s.pseg1);
+    CHECK(s.rjw <= s.pseg2);
+    CHECK_EQ(distance(sample_point(&s), wanted), best_error(clock_hz, bitrate, wanted, phase));
+}
+
+/* The solver finds a setting exactly when one samples within the tolerance */
+static void check_solve(uint32_t clock_hz, uint32_t bitrate, uint32_t wanted, bit_timing_phase_t phase)
+{
+    CAN_bit_timings_t timings;
+    uint32_t best = best_error(clock_hz, bitrate, wanted, phase);
+    status_t status = solve_bit_timings(clock_hz, bitrate, (uint16_t)wanted, CAN_SP_TOLERANCE, phase, &timings);
+
+    CHECK_EQ(status, (best <= CAN_SP_TOLERANCE) ? Success : Failure);
+
+    if( status == Success )
+    {
+        check_solution(clock_hz, bitrate, wanted, phase, &timings);
+    }
+}
+
+/* 8, 40 and 80 MHz from 125 kbit/s to 1 Mbit/s, and the CAN FD data phase up to 8 Mbit/s */
+static void test_sweep(void)
+{
+    static const uint32_t clocks[] = { 8000000u, 40000000u, 80000000u };
+    static const uint32_t nominal[] = { 125000u, 250000u, 500000u, 1000000u };
+    static const uint32_t nominal_sp[] = { 800u, 875u };
+    static const uint32_t data[] = { 2000000u, 4000000u, 5000000u, 8000000u };
+    static const uint32_t data_sp[] = { 700u, 750u, 800u };
+
+    for(uint32_t c = 0; c < 3u; c++)
+    {
+        for(uint32_t r = 0; r < 4u; r++)
+        {
+            for(uint32_t p = 0; p < 2u; p++)
+            {
+                check_solve(clocks[c], nominal[r], nominal_sp[p], Nominal_phase);
+            }
+        }
+
+        for(uint32_t r = 0; r < 4u; r++)
+        {
+            for(uint32_t p = 0; p < 3u; p++)
+            {
+                check_solve(clocks[c], data[r], data_sp[p], Data_phase);
+            }
+        }
+    }
+}
+
+/* Bit rates the clock can't divide into, or not within the tolerance */
+static void test_unsolvable(void)
+{
+    CAN_bit_timings_t timings;
+
+    CHECK_EQ(solve_bit_timings(8000000u, 0, 875, CAN_SP_TOLERANCE, Nominal_phase, &timings), Failure);
+    CHECK_EQ(solve_bit_timings(8000000u, 3000000u, 875, CAN_SP_TOLERANCE, Nominal_phase, &timings), Failure);
+    CHECK_EQ(solve_bit_timings(8000000u, 333333u, 875, CAN_SP_TOLERANCE, Nominal_phase, &timings), Failure);
+
+    /* 8 quanta per bit and at least 2 after the sample point: 750 per mille at best */
+    CHECK_EQ(solve_bit_timings(8000000u, 1000000u, 875, CAN_SP_TOLERANCE, Nominal_phase, &timings), Failure);
+    CHECK_EQ(solve_bit_timings(8000000u, 1000000u, 810, 50, Nominal_phase, &timings), Failure);
+    CHECK_EQ(solve_bit_timings(8000000u, 1000000u, 810, 60, Nominal_phase, &timings), Success);
+
+    /* 5 quanta per bit at 40 MHz and 8 Mbit/s: 600 per mille at best */
+    CHECK_EQ(solve_bit_timings(40000000u, 8000000u, 700, CAN_SP_TOLERANCE, Data_phase, &timings), Failure);
+}
+
+/* Every entry of the generated table is what the runtime solver finds without a tolerance, the
+ * build rejects the entries sampling too far off with _Static_assert */
+static void test_table(void)
+{
+    static const struct {
+        const char* condition;
+        const char* prefix;
+        bit_timing_phase_t phase;
+    } sections[] = {
+            { " (CAN_CLOCK_HZ == %uu) && (CAN_BITRATE == %uu) && (CAN_SAMPLE_POINT == %uu)", "CAN_NOMINAL_", Nominal_phase },
+            { " (CAN_FD_CLOCK_HZ == %uu) && (CAN_FD_NOMINAL_BITRATE == %uu) && (CAN_SAMPLE_POINT == %uu)", "CAN_FD_NOMINAL_", Nominal_phase },
+            { " (CAN_FD_CLOCK_HZ == %uu) && (CAN_FD_DATA_BITRATE == %uu) && (CAN_FD_DATA_SAMPLE_POINT == %uu)", "CAN_FD_DATA_", Data_phase },
+    };
+    static const char* const fields[] = { "PRESDIV", "PROPSEG", "PSEG1", "PSEG2", "RJW", "SP_REACHED" };
+
+    FILE* table = fopen(TABLE_PATH, "r");
+    char line[256];
+    uint32_t entries = 0;
+
+    CHECK(table != 0);
+
+    while( (table != 0) && fgets(line, sizeof(line), table) )
+    {
+        unsigned clock_hz, bitrate, sp;
+        uint32_t s = 0;
+
+        /* The condition of an entry, after #if or #elif */
+        const char* condition = strchr(line, ' ');
+
+        while( (s < 3u) && ((condition == 0) || (line[0] != '#') ||
+               (sscanf(condition, sections[s].condition, &clock_hz, &bitrate, &sp) != 3)) )
+        {
+            s++;
+        }
+
+        if( s == 3u )
+        {
+            continue;
+        }
+
+        /* Its six definitions, in order */
+        unsigned values[6];
+        for(uint32_t f = 0; f < 6u; f++)
+        {
+            char name[64];
+            char expected[64];
+
+            snprintf(expected, sizeof(expected), "%s%s", sections[s].prefix, fields[f]);
+            CHECK(fgets(line, sizeof(line), table) != 0);
+            CHECK_EQ(sscanf(line, "#define %63s (%uu)", name, &values[f]), 2);
+            CHECK(strcmp(name, expected) == 0);
+        }
+
+        CAN_bit_timings_t solved;
+        CAN_bit_timings_t listed = {
+                .PRESDIV = (uint16_t)values[0],
+                .PROPSEG = (uint8_t)values[1],
+                .PSEG1 = (uint8_t)values[2],
+                .PSEG2 = (uint8_t)values[3],
+                .RJW = (uint8_t)values[4],
+        };
+
+        CHECK_EQ(solve_bit_timings(clock_hz, bitrate, (uint16_t)sp, NO_TOLERANCE, sections[s].phase, &solved), Success);
+        CHECK_EQ(solved.PRESDIV, listed.PRESDIV);
+        CHECK_EQ(solved.PROPSEG, listed.PROPSEG);
+        CHECK_EQ(solved.PSEG1, listed.PSEG1);
+        CHECK_EQ(solved.PSEG2, listed.PSEG2);
+        CHECK_EQ(solved.RJW, listed.RJW);
+
+        segments_t segments = decode(&listed, sections[s].phase);
+        CHECK_EQ(sample_point(&segments), values[5]);
+        check_solution(clock_hz, bitrate, sp, sections[s].phase, &listed);
+
+        entries++;
+    }
+
+    if( table != 0 )
+    {
+        fclose(table);
+    }
+
+    /* 40 classical, 24 CAN FD arbitration and some data phase entries */
+    CHECK(entries > 64u);
+}
+
+/* The configuration compiled in is the table entry of CAN_CLOCK_HZ and CAN_BITRATE */
+static void test_configuration(void)
+{
+    CAN_bit_timings_t solved;
+
+    CHECK_EQ(solve_bit_timings(CAN_CLOCK_HZ, CAN_BITRATE, CAN_SAMPLE_POINT, CAN_SP_TOLERANCE, Nominal_phase, &solved), Success);
+    CHECK_EQ(CAN_timings.PRESDIV, solved.PRESDIV);
+    CHECK_EQ(CAN_timings.PROPSEG, solved.PROPSEG);
+    CHECK_EQ(CAN_timings.PSEG1, solved.PSEG1);
+    CHECK_EQ(CAN_timings.PSEG2, solved.PSEG2);
+    CHECK_EQ(CAN_timings.RJW, solved.RJW);
+}
+
+int main(void)
+{
+    RUN(test_sweep);
+    RUN(test_unsolvable);
+    RUN(test_table);
+    RUN(test_configuration);
+
+    return TEST_RESULT();
+}
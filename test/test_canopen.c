@@ -0,0 +1,573 @@
+/**
+ * Source file
+ */
+
+#include "test.h"
+#include "CAN_sim.h"
+#include <FlexCAN/include/CAN_canopen.h>
+#include <FlexCAN/include/CAN_internal.h>
+#include <string.h>
+
+#define BITRATE             (500000u)
+#define MS_NS               (1000000u)
+
+#define NODE_ID             (0x10u)
+#define HEARTBEAT_MS        (100u)
+
+/* COB-IDs of the node in the predefined connection set */
+#define COB_NMT             (0x000u)
+#define COB_TPDO1           (0x180u + NODE_ID)
+#define COB_TPDO2           (0x280u + NODE_ID)
+#define COB_RPDO1           (0x200u + NODE_ID)
+#define COB_RPDO2           (0x300u + NODE_ID)
+#define COB_SDO_TX          (0x580u + NODE_ID)
+#define COB_SDO_RX          (0x600u + NODE_ID)
+#define COB_HEARTBEAT       (0x700u + NODE_ID)
+
+/* SDO abort codes */
+#define ABORT_TOGGLE        (0x05030000u)
+#define ABORT_TIMEOUT       (0x05040000u)
+#define ABORT_WRITE_ONLY    (0x06010001u)
+#define ABORT_READ_ONLY     (0x06010002u)
+#define ABORT_NO_OBJECT     (0x06020000u)
+#define ABORT_LENGTH        (0x06070010u)
+
+/* Mapping entry of a PDO */
+#define MAP(index, subindex, bits) (((uint32_t)(index) << 16) | ((uint32_t)(subindex) << 8) | (bits))
+
+static uint32_t device_type = 0x00020192u;
+static char device_name[20] = "FlexCAN test node 1";
+static uint8_t value_u8;
+static uint16_t value_u16;
+static uint32_t value_u32;
+static uint32_t command;
+static uint8_t block[16];
+static uint8_t nibble;
+static uint16_t twelve_bits;
+
+static const co_object_t objects[] = {
+        { 0x1000, 0, CO_READ, 4, &device_type },
+        { 0x1008, 0, CO_READ, sizeof(device_name), device_name },
+        { 0x2000, 1, CO_READ | CO_WRITE, 1, &value_u8 },
+        { 0x2000, 2, CO_READ | CO_WRITE, 2, &value_u16 },
+        { 0x2000, 3, CO_READ | CO_WRITE, 4, &value_u32 },
+        { 0x2001, 0, CO_WRITE, 4, &command },
+        { 0x2100, 0, CO_READ | CO_WRITE, sizeof(block), block },
+        { 0x6000, 1, CO_READ | CO_WRITE, 1, &nibble },
+        { 0x6000, 2, CO_READ | CO_WRITE, 2, &twelve_bits },
+};
+
+static sim_node_t* master;
+static uint32_t resets;
+
+static void reset(void)
+{
+    resets++;
+}
+
+/* Byte of a simulated frame, laid out as frame_t */
+static uint8_t get_byte(const sim_frame_t* frame, uint32_t i)
+{
+    return (uint8_t)(frame->payload[i >> 2] >> (24u - ((i & 3u) * 8u)));
+}
+
+static void set_bytes(uint32_t* payload, const uint8_t* bytes, uint32_t count)
+{
+    payload[0] = 0;
+    payload[1] = 0;
+
+    for(uint32_t i = 0; i < count; i++)
+    {
+        payload[i >> 2] |= (uint32_t)bytes[i] << (24u - ((i & 3u) * 8u));
+    }
+}
+
+/* Let the bus and the node run, as the main loop would */
+static void run(uint64_t ns)
+{
+    uint64_t until = sim_now() + ns;
+
+    do
+    {
+        (void)co_poll();
+        sim_run(100000);
+    } while( sim_now() < until );
+}
+
+static uint64_t master_sent(void)
+{
+    sim_node_stats_t stats;
+
+    sim_get_node_stats(master, &stats, 0);
+
+    return stats.sent;
+}
+
+/* Frame of the master, returns once it was on the bus */
+static void master_send(uint32_t cob_id, const uint8_t* bytes, uint32_t count)
+{
+    sim_frame_t frame = { .ID = cob_id, .dlc = (uint8_t)count };
+    uint64_t target = master_sent() + 1u;
+    uint64_t until = sim_now() + (50u * MS_NS);
+
+    set_bytes(frame.payload, bytes, count);
+    CHECK_EQ(sim_node_send(master, &frame), Success);
+
+    while( (master_sent() < target) && (sim_now() < until) )
+    {
+        (void)co_poll();
+        sim_run(100000);
+    }
+    CHECK_EQ(master_sent(), target);
+}
+
+/* Wait for the next frame of a COB-ID from the node, skipping the others */
+static status_t master_receive(uint32_t cob_id, sim_frame_t* frame, uint64_t timeout_ns)
+{
+    uint64_t until = sim_now() + timeout_ns;
+
+    while( (sim_node_receive(master, frame) != Success) || (frame->ID != cob_id) )
+    {
+        if( sim_now() >= until )
+        {
+            return Failure;
+        }
+
+        (void)co_poll();
+        sim_run(100000);
+    }
+
+    return Success;
+}
+
+/* Frames of a COB-ID the node sends within a time */
+static uint32_t count_frames(uint32_t cob_id, uint64_t ns)
+{
+    sim_frame_t frame;
+    uint32_t count = 0;
+    uint64_t until = sim_now() + ns;
+
+    while( sim_now() < until )
+    {
+        while( sim_node_receive(master, &frame) == Success )
+        {
+            count += (frame.ID == cob_id) ? 1u : 0u;
+        }
+
+        run(100000);
+    }
+
+    return count;
+}
+
+static void nmt(uint8_t command_specifier, uint8_t target)
+{
+    uint8_t bytes[2] = { command_specifier, target };
+
+    master_send(COB_NMT, bytes, 2);
+}
+
+/* SDO request and its response */
+static void sdo(const uint8_t* request, sim_frame_t* response)
+{
+    master_send(COB_SDO_RX, request, 8);
+    CHECK_EQ(master_receive(COB_SDO_TX, response, 50u * MS_NS), Success);
+    CHECK_EQ(response->dlc, 8);
+}
+
+/* An SDO request answered with an abort code */
+static void check_abort(const uint8_t* request, uint32_t code)
+{
+    sim_frame_t response;
+
+    sdo(request, &response);
+    CHECK_EQ(get_byte(&response, 0), 0x80);
+    CHECK_EQ(get_byte(&response, 1), request[1]);
+    CHECK_EQ(get_byte(&response, 2), request[2]);
+    CHECK_EQ(get_byte(&response, 3), request[3]);
+    CHECK_EQ(response.payload[1], __builtin_bswap32(code));
+}
+
+static void flush(void)
+{
+    sim_frame_t frame;
+
+    run(2u * MS_NS);
+    while( sim_node_receive(master, &frame) == Success );
+}
+
+/* The dictionary must be sorted, the node announces itself then sends its heartbeat */
+static void test_init(void)
+{
+    static const co_object_t unsorted[] = {
+            { 0x2000, 2, CO_READ, 2, &value_u16 },
+            { 0x2000, 1, CO_READ, 1, &value_u8 },
+    };
+    co_config_t config = { .can = FlexCAN_0, .node_id = NODE_ID, .heartbeat_ms = HEARTBEAT_MS,
+                           .objects = unsorted, .object_count = 2, .reset = reset };
+    sim_frame_t frame;
+
+    CHECK_EQ(co_init(&config), Failure);
+    config.objects = objects;
+    config.object_count = sizeof(objects) / sizeof(objects[0]);
+    config.node_id = 0;
+    CHECK_EQ(co_init(&config), Failure);
+    config.node_id = 128;
+    CHECK_EQ(co_init(&config), Failure);
+    config.node_id = NODE_ID;
+    CHECK_EQ(co_init(&config), Success);
+    CHECK_EQ(co_state(), Co_pre_operational);
+
+    CHECK_EQ(master_receive(COB_HEARTBEAT, &frame, 50u * MS_NS), Success);
+    CHECK_EQ(get_byte(&frame, 0), 0);
+
+    CHECK_EQ(master_receive(COB_HEARTBEAT, &frame, 200u * MS_NS), Success);
+    CHECK_EQ(get_byte(&frame, 0), Co_pre_operational);
+
+    /* Periods keep their phase rather than drifting with the polling */
+    uint64_t first = frame.time;
+    for(uint32_t i = 0; i < 10u; i++)
+    {
+        CHECK_EQ(master_receive(COB_HEARTBEAT, &frame, 200u * MS_NS), Success);
+    }
+    CHECK((frame.time - first) + (2u * MS_NS) >= (10u * HEARTBEAT_MS * MS_NS));
+    CHECK((frame.time - first) <= (10u * HEARTBEAT_MS * MS_NS) + (2u * MS_NS));
+}
+
+/* NMT commands for the node or for all of them */
+static void test_nmt(void)
+{
+    sim_frame_t frame;
+    uint8_t request[8] = { 0x40, 0x00, 0x10, 0x00 };
+
+    flush();
+
+    nmt(0x01, NODE_ID);
+    run(2u * MS_NS);
+    CHECK_EQ(co_state(), Co_operational);
+    CHECK_EQ(master_receive(COB_HEARTBEAT, &frame, 200u * MS_NS), Success);
+    CHECK_EQ(get_byte(&frame, 0), Co_operational);
+
+    nmt(0x02, NODE_ID + 1u);
+    run(2u * MS_NS);
+    CHECK_EQ(co_state(), Co_operational);
+
+    /* Stopped, the node doesn't answer SDOs */
+    nmt(0x02, 0);
+    run(2u * MS_NS);
+    CHECK_EQ(co_state(), Co_stopped);
+    master_send(COB_SDO_RX, request, 8);
+    CHECK_EQ(count_frames(COB_SDO_TX, 5u * MS_NS), 0);
+
+    nmt(0x80, NODE_ID);
+    run(2u * MS_NS);
+    CHECK_EQ(co_state(), Co_pre_operational);
+
+    /* Reset node calls the application, both resets send the boot-up message */
+    nmt(0x81, NODE_ID);
+    CHECK_EQ(master_receive(COB_HEARTBEAT, &frame, 50u * MS_NS), Success);
+    CHECK_EQ(get_byte(&frame, 0), 0);
+    CHECK_EQ(resets, 1);
+    nmt(0x82, 0);
+    CHECK_EQ(master_receive(COB_HEARTBEAT, &frame, 50u * MS_NS), Success);
+    CHECK_EQ(get_byte(&frame, 0), 0);
+    CHECK_EQ(resets, 1);
+    CHECK_EQ(co_state(), Co_pre_operational);
+}
+
+/* Objects up to 4 bytes go in one request and one response */
+static void test_sdo_expedited(void)
+{
+    static const uint8_t download_u16[8] = { 0x2B, 0x00, 0x20, 0x02, 0x34, 0x12 };
+    static const uint8_t download_u32[8] = { 0x23, 0x00, 0x20, 0x03, 0x78, 0x56, 0x34, 0x12 };
+    static const uint8_t download_unsized[8] = { 0x22, 0x00, 0x20, 0x01, 0x5A };
+    static const uint8_t upload_type[8] = { 0x40, 0x00, 0x10, 0x00 };
+    static const uint8_t upload_u16[8] = { 0x40, 0x00, 0x20, 0x02 };
+    sim_frame_t response;
+
+    flush();
+
+    sdo(download_u16, &response);
+    CHECK_EQ(get_byte(&response, 0), 0x60);
+    CHECK_EQ(get_byte(&response, 2), 0x20);
+    CHECK_EQ(get_byte(&response, 3), 0x02);
+    CHECK_EQ(value_u16, 0x1234);
+
+    sdo(download_u32, &response);
+    CHECK_EQ(get_byte(&response, 0), 0x60);
+    CHECK_EQ(value_u32, 0x12345678);
+
+    sdo(download_unsized, &response);
+    CHECK_EQ(get_byte(&response, 0), 0x60);
+    CHECK_EQ(value_u8, 0x5A);
+
+    /* The unused bytes tell the size */
+    sdo(upload_type, &response);
+    CHECK_EQ(get_byte(&response, 0), 0x43);
+    CHECK_EQ(response.payload[1], __builtin_bswap32(device_type));
+
+    sdo(upload_u16, &response);
+    CHECK_EQ(get_byte(&response, 0), 0x4B);
+    CHECK_EQ(get_byte(&response, 4), 0x34);
+    CHECK_EQ(get_byte(&response, 5), 0x12);
+
+    static const uint8_t missing[8] = { 0x40, 0x00, 0x30, 0x00 };
+    static const uint8_t read_only[8] = { 0x23, 0x00, 0x10, 0x00, 1, 2, 3, 4 };
+    static const uint8_t write_only[8] = { 0x40, 0x01, 0x20, 0x00 };
+    static const uint8_t wrong_size[8] = { 0x2B, 0x00, 0x20, 0x03, 1, 2 };
+    static const uint8_t too_long[8] = { 0x22, 0x00, 0x21, 0x00, 1, 2, 3, 4 };
+
+    check_abort(missing, ABORT_NO_OBJECT);
+    check_abort(read_only, ABORT_READ_ONLY);
+    check_abort(write_only, ABORT_WRITE_ONLY);
+    check_abort(wrong_size, ABORT_LENGTH);
+    check_abort(too_long, ABORT_LENGTH);
+    CHECK_EQ(device_type, 0x00020192u);
+    CHECK_EQ(value_u32, 0x12345678);
+}
+
+/* Longer objects go in segments of 7 bytes with an alternating toggle bit */
+static void test_sdo_segmented(void)
+{
+    static const uint8_t upload_name[8] = { 0x40, 0x08, 0x10, 0x00 };
+    static const uint8_t download_block[8] = { 0x21, 0x00, 0x21, 0x00, sizeof(block) };
+    sim_frame_t response;
+    char name[sizeof(device_name)];
+    uint32_t received = 0;
+    uint8_t toggle = 0;
+
+    flush();
+
+    sdo(upload_name, &response);
+    CHECK_EQ(get_byte(&response, 0), 0x41);
+    CHECK_EQ(response.payload[1], __builtin_bswap32(sizeof(device_name)));
+
+    for(uint32_t last = 0; !last && (received < sizeof(name)); toggle ^= 1u)
+    {
+        uint8_t request[8] = { (uint8_t)(0x60u | (toggle << 4)) };
+
+        sdo(request, &response);
+        CHECK_EQ(get_byte(&response, 0) & 0xF0u, (uint32_t)toggle << 4);
+
+        uint32_t count = 7u - ((get_byte(&response, 0) >> 1) & 7u);
+        last = get_byte(&response, 0) & 1u;
+        for(uint32_t i = 0; (i < count) && (received < sizeof(name)); i++)
+        {
+            name[received++] = (char)get_byte(&response, 1u + i);
+        }
+    }
+    CHECK_EQ(received, sizeof(device_name));
+    CHECK(memcmp(name, device_name, sizeof(name)) == 0);
+
+    /* 7, 7 then 2 bytes */
+    sdo(download_block, &response);
+    CHECK_EQ(get_byte(&response, 0), 0x60);
+
+    uint32_t sent = 0;
+    toggle = 0;
+    while( sent < sizeof(block) )
+    {
+        uint32_t count = ((sizeof(block) - sent) < 7u) ? (sizeof(block) - sent) : 7u;
+        uint8_t last = (sent + count) == sizeof(block);
+        uint8_t request[8] = { (uint8_t)((toggle << 4) | ((7u - count) << 1) | last) };
+
+        for(uint32_t i = 0; i < count; i++)
+        {
+            request[1u + i] = (uint8_t)(0xA0u + sent + i);
+        }
+        sent += count;
+
+        sdo(request, &response);
+        CHECK_EQ(get_byte(&response, 0), 0x20u | (toggle << 4));
+        toggle ^= 1u;
+    }
+    for(uint32_t i = 0; i < sizeof(block); i++)
+    {
+        CHECK_EQ(block[i], 0xA0u + i);
+    }
+
+    /* A repeated toggle bit aborts the transfer */
+    static const uint8_t segment[8] = { 0x00, 1, 2, 3, 4, 5, 6, 7 };
+
+    sdo(download_block, &response);
+    sdo(segment, &response);
+    CHECK_EQ(get_byte(&response, 0), 0x20);
+    sdo(segment, &response);
+    CHECK_EQ(get_byte(&response, 0), 0x80);
+    CHECK_EQ(response.payload[1], __builtin_bswap32(ABORT_TOGGLE));
+
+    /* A client that stops sending segments */
+    sdo(download_block, &response);
+    CHECK_EQ(count_frames(COB_SDO_TX, (CO_SDO_TIMEOUT_MS - 50u) * MS_NS), 0);
+    CHECK_EQ(master_receive(COB_SDO_TX, &response, 200u * MS_NS), Success);
+    CHECK_EQ(get_byte(&response, 0), 0x80);
+    CHECK_EQ(get_byte(&response, 2), 0x21);
+    CHECK_EQ(response.payload[1], __builtin_bswap32(ABORT_TIMEOUT));
+}
+
+/* Fill the transmission queue with frames the interrupt can't take while it is masked */
+static void fill_queue(void)
+{
+    frame_t frame = { .ID = 0x7FF };
+
+    while( transmit_frame(FlexCAN_0, &frame) == Success );
+}
+
+/* SDO request handed to the node as if it had just been received */
+static void co_request(const uint8_t* request)
+{
+    frame_t frame = { .ID = COB_SDO_RX };
+
+    set_bytes(frame.payload, request, 8);
+    CHECK_EQ(co_frame(&frame), Success);
+}
+
+/* A response waiting for the transmission queue is kept, requests sent before it are ignored */
+static void test_sdo_pending(void)
+{
+    static const uint8_t upload_u8[8] = { 0x40, 0x00, 0x20, 0x01 };
+    static const uint8_t download_u8[8] = { 0x2F, 0x00, 0x20, 0x01, 0x33 };
+    static const uint8_t abort[8] = { 0x80, 0x00, 0x20, 0x01, 0x00, 0x00, 0x04, 0x05 };
+    sim_frame_t response;
+
+    flush();
+    value_u8 = 0x11;
+
+    CRITICAL_ENTER();
+    fill_queue();
+    co_request(upload_u8);
+    co_request(download_u8);
+    CRITICAL_EXIT();
+
+    /* The upload is answered once the queue has room, the download never happened */
+    CHECK_EQ(master_receive(COB_SDO_TX, &response, 100u * MS_NS), Success);
+    CHECK_EQ(get_byte(&response, 0), 0x4F);
+    CHECK_EQ(get_byte(&response, 4), 0x11);
+    CHECK_EQ(count_frames(COB_SDO_TX, 5u * MS_NS), 0);
+    CHECK_EQ(value_u8, 0x11);
+
+    /* The client gives up on the pending response */
+    flush();
+    CRITICAL_ENTER();
+    fill_queue();
+    co_request(upload_u8);
+    co_request(abort);
+    CRITICAL_EXIT();
+    CHECK_EQ(count_frames(COB_SDO_TX, 50u * MS_NS), 0);
+
+    /* And the next request is served */
+    sdo(download_u8, &response);
+    CHECK_EQ(get_byte(&response, 0), 0x60);
+    CHECK_EQ(value_u8, 0x33);
+}
+
+/* Receive PDOs update their objects while operational, bit fields included */
+static void test_rpdo(void)
+{
+    const uint32_t mapping[] = { MAP(0x2000, 1, 8), MAP(0x2000, 2, 16), MAP(0x2000, 3, 32) };
+    const uint32_t fields[] = { MAP(0x6000, 1, 4), MAP(0x6000, 2, 12) };
+    static const uint8_t pdo[8] = { 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77 };
+    static const uint8_t packed[2] = { 0x2B, 0xCD };
+
+    flush();
+
+    CHECK_EQ(co_map_rpdo(0, CO_DEFAULT_COB_ID, mapping, 3), Success);
+    CHECK_EQ(co_map_rpdo(1, CO_DEFAULT_COB_ID, fields, 2), Success);
+
+    /* Only while operational */
+    value_u8 = 0;
+    master_send(COB_RPDO1, pdo, 7);
+    run(2u * MS_NS);
+    CHECK_EQ(value_u8, 0);
+
+    nmt(0x01, NODE_ID);
+    master_send(COB_RPDO1, pdo, 7);
+    master_send(COB_RPDO2, packed, 2);
+    run(2u * MS_NS);
+    CHECK_EQ(value_u8, 0x11);
+    CHECK_EQ(value_u16, 0x3322);
+    CHECK_EQ(value_u32, 0x77665544);
+    CHECK_EQ(nibble, 0xB);
+    CHECK_EQ(twelve_bits, 0xCD2);
+
+    /* Mappings that can't be compiled */
+    const uint32_t missing[] = { MAP(0x2002, 0, 8) };
+    const uint32_t read_only[] = { MAP(0x1000, 0, 32) };
+    const uint32_t too_wide[] = { MAP(0x2000, 2, 17) };
+    const uint32_t too_long[] = { MAP(0x2000, 3, 32), MAP(0x2000, 3, 32), MAP(0x2000, 1, 8) };
+
+    CHECK_EQ(co_map_rpdo(2, CO_DEFAULT_COB_ID, missing, 1), Failure);
+    CHECK_EQ(co_map_rpdo(2, CO_DEFAULT_COB_ID, read_only, 1), Failure);
+    CHECK_EQ(co_map_rpdo(2, CO_DEFAULT_COB_ID, too_wide, 1), Failure);
+    CHECK_EQ(co_map_rpdo(2, CO_DEFAULT_COB_ID, too_long, 3), Failure);
+    CHECK_EQ(co_map_rpdo(CO_RPDOS, CO_DEFAULT_COB_ID, mapping, 1), Failure);
+}
+
+/* Transmit PDOs pack their objects little endian, on request or on their event timer */
+static void test_tpdo(void)
+{
+    const uint32_t mapping[] = { MAP(0x6000, 1, 4), MAP(0x6000, 2, 12), MAP(0x2000, 3, 32) };
+    const uint32_t periodic[] = { MAP(0x2000, 1, 8) };
+    const uint32_t write_only[] = { MAP(0x2001, 0, 32) };
+    sim_frame_t frame;
+
+    flush();
+
+    CHECK_EQ(co_map_tpdo(0, CO_DEFAULT_COB_ID, write_only, 1, 0), Failure);
+    CHECK_EQ(co_map_tpdo(0, CO_DEFAULT_COB_ID, mapping, 3, 0), Success);
+    CHECK_EQ(co_map_tpdo(1, CO_DEFAULT_COB_ID, periodic, 1, 20), Success);
+
+    nibble = 0x5;
+    twelve_bits = 0xABC;
+    value_u32 = 0xDEADBEEFu;
+
+    CHECK_EQ(co_state(), Co_operational);
+    CHECK_EQ(co_send_tpdo(0), Success);
+    CHECK_EQ(master_receive(COB_TPDO1, &frame, 50u * MS_NS), Success);
+    CHECK_EQ(get_byte(&frame, 0), 0xC5);
+    CHECK_EQ(get_byte(&frame, 1), 0xAB);
+    CHECK_EQ(get_byte(&frame, 2), 0xEF);
+    CHECK_EQ(get_byte(&frame, 5), 0xDE);
+
+    /* 20 ms event timer while operational only */
+    uint32_t sent = count_frames(COB_TPDO2, 200u * MS_NS);
+    CHECK((sent >= 9u) && (sent <= 11u));
+
+    nmt(0x80, NODE_ID);
+    flush();
+    CHECK_EQ(count_frames(COB_TPDO2, 100u * MS_NS), 0);
+    CHECK_EQ(co_send_tpdo(0), Failure);
+    CHECK_EQ(co_send_tpdo(2), Failure);
+}
+
+int main(void)
+{
+    /* Every standard ID, the node sorts them out */
+    filter_t all = { .ID = 0, .mask = 0, .extended = 0 };
+
+    if( sim_init(0) != Success )
+    {
+        printf("sim_init failed\n");
+        return 1;
+    }
+
+    sim_bus_t* bus = sim_bus_create(BITRATE);
+    sim_attach(FlexCAN_0, bus);
+    master = sim_node_create(bus);
+
+    if( (FlexCAN_init_RXFIFO(FlexCAN_0) != Success) || (install_filters(FlexCAN_0, &all, 1, 0) != Success) )
+    {
+        printf("FlexCAN_init_RXFIFO failed\n");
+        return 1;
+    }
+
+    RUN(test_init);
+    RUN(test_nmt);
+    RUN(test_sdo_expedited);
+    RUN(test_sdo_segmented);
+    RUN(test_sdo_pending);
+    RUN(test_rpdo);
+    RUN(test_tpdo);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,288 @@
+/**
+ * Source file
+ */
+
+/*
+ * Header generated by tools/dbc_codegen.py from codec.dbc, checked against a decoder that
+ * walks the signals of the DBC bit by bit the way the DBC format numbers them
+ */
+
+#include "test.h"
+#include "codec_codec.h"
+#include <math.h>
+#include <stdlib.h>
+
+#define RANDOM_FRAMES   (10000u)
+
+typedef struct {
+    uint32_t start;
+    uint32_t length;
+    uint32_t intel;
+    uint32_t is_signed;
+    double factor;
+    double offset;
+} signal_t;
+
+/* The signals of codec.dbc in the order of the file */
+static const signal_t engine[] = {
+    {  0, 16, 1, 0, 0.25, 0.0 },
+    { 16,  8, 1, 0, 1.0, -40.0 },
+    { 24, 12, 1, 1, 2.0, 0.0 },
+    { 36, 10, 1, 0, 0.1, 0.0 },
+    { 56,  4, 1, 0, 1.0, 0.0 },
+};
+
+static const signal_t brake[] = {
+    {  7, 16, 0, 0, 0.1, 0.0 },
+    { 23, 12, 0, 1, 0.01, 0.0 },
+    { 27,  8, 0, 0, 1.0, 0.0 },
+    { 35,  4, 0, 0, 1.0, 0.0 },
+    { 63,  8, 0, 0, 1.0, 0.0 },
+};
+
+static const signal_t odometer[] = {
+    {  0, 40, 1, 0, 1.0, 0.0 },
+    { 47, 16, 0, 0, 1.0, -1000.0 },
+};
+
+/* Multiplexer, voltage on 0, current on 1, sequence */
+static const signal_t diagnostic[] = {
+    {  0,  8, 1, 0, 1.0, 0.0 },
+    {  8, 16, 1, 0, 1.0, 0.0 },
+    {  8, 16, 1, 1, 0.5, -10.0 },
+    { 56,  8, 1, 0, 1.0, 0.0 },
+};
+
+#define COUNT(table)    (sizeof(table) / sizeof(table[0]))
+
+/* Bit of the frame in the payload words, numbered the way the DBC format does */
+static uint32_t frame_bit(const frame_t* frame, uint32_t bit)
+{
+    uint32_t byte = bit / 8u;
+
+    return (frame->payload[byte / 4u] >> ((24u - (8u * (byte % 4u))) + (bit % 8u))) & 1u;
+}
+
+static void set_frame_bit(frame_t* frame, uint32_t bit)
+{
+    uint32_t byte = bit / 8u;
+
+    frame->payload[byte / 4u] |= 1u << ((24u - (8u * (byte % 4u))) + (bit % 8u));
+}
+
+/* Positions of the signal bits from the least significant up, the start bit of a Motorola
+ * signal is its most significant bit and the next bits wrap to bit 7 of the following byte */
+static void signal_bits(const signal_t* signal, uint32_t* bits)
+{
+    uint32_t bit = signal->start;
+
+    for(uint32_t i = 0; i < signal->length; i++)
+    {
+        if( signal->intel )
+        {
+            bits[i] = signal->start + i;
+        }
+        else
+        {
+            bits[signal->length - 1u - i] = bit;
+            bit = ((bit % 8u) == 0u) ? (bit + 15u) : (bit - 1u);
+        }
+    }
+}
+
+static int64_t reference_raw(const frame_t* frame, const signal_t* signal)
+{
+    uint32_t bits[64];
+    uint64_t raw = 0;
+
+    signal_bits(signal, bits);
+    for(uint32_t i = 0; i < signal->length; i++)
+    {
+        raw |= (uint64_t)frame_bit(frame, bits[i]) << i;
+    }
+
+    if( signal->is_signed && ((raw >> (signal->length - 1u)) & 1u) )
+    {
+        return (int64_t)raw - ((int64_t)1 << signal->length);
+    }
+    return (int64_t)raw;
+}
+
+static double reference_value(const frame_t* frame, const signal_t* signal)
+{
+    return ((double)reference_raw(frame, signal) * signal->factor) + signal->offset;
+}
+
+/* The payload bits the signals cover */
+static void signal_mask(frame_t* mask, const signal_t* signals, uint32_t count)
+{
+    uint32_t bits[64];
+
+    mask->payload[0] = 0;
+    mask->payload[1] = 0;
+    for(uint32_t s = 0; s < count; s++)
+    {
+        signal_bits(&signals[s], bits);
+        for(uint32_t i = 0; i < signals[s].length; i++)
+        {
+            set_frame_bit(mask, bits[i]);
+        }
+    }
+}
+
+/* A float field matches the reference to its precision */
+static int close_to(double value, double expected)
+{
+    return fabs(value - expected) <= (1e-6 * fmax(1.0, fabs(expected)));
+}
+
+static void random_payload(frame_t* frame)
+{
+    frame->payload[0] = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+    frame->payload[1] = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+}
+
+/* Pack the unpacked frame again and compare with the payload bits the signals cover */
+static void check_round_trip(const frame_t* packed, const frame_t* frame, const signal_t* signals, uint32_t count)
+{
+    frame_t mask;
+
+    signal_mask(&mask, signals, count);
+    CHECK_EQ(packed->payload[0], frame->payload[0] & mask.payload[0]);
+    CHECK_EQ(packed->payload[1], frame->payload[1] & mask.payload[1]);
+}
+
+/* Frames of the documented signal values, laid out by hand */
+static void test_known_frames(void)
+{
+    engine_t engine_msg = { .engine_speed = 1000.0f, .coolant_temp = 90, .torque = -100, .throttle = 50.0f, .counter = 9 };
+    brake_t brake_msg = { .pressure = 466.0f, .yaw_rate = -1.0f, .middle = 0xAB, .status = 5, .checksum = 0x77 };
+    frame_t frame;
+
+    CHECK_EQ(ENGINE_ID, 0x100u);
+    CHECK_EQ(DIAGNOSTIC_ID, CAN_ID_EXT | 0x18FF00E5u);
+
+    /* Intel: 0x0FA0 in bytes 0-1, 0x82 in byte 2, 0xFCE from byte 3 into the low nibble of byte 4,
+     * 0x1F4 from the high nibble of byte 4 into byte 5, 9 in the low nibble of byte 7 */
+    engine_pack(&frame, &engine_msg);
+    CHECK_EQ(frame.ID, ENGINE_ID);
+    CHECK_EQ(frame.payload[0], 0xA00F82CEu);
+    CHECK_EQ(frame.payload[1], 0x4F1F0009u);
+
+    /* Motorola: 0x1234 in bytes 0-1, 0xF9C from byte 2 into the high nibble of byte 3, 0xAB from
+     * the low nibble of byte 3 into the high nibble of byte 4, 5 in its low nibble, 0x77 in byte 7 */
+    brake_pack(&frame, &brake_msg);
+    CHECK_EQ(frame.ID, BRAKE_ID);
+    CHECK_EQ(frame.payload[0], 0x1234F9CAu);
+    CHECK_EQ(frame.payload[1], 0xB5000077u);
+}
+
+static void test_intel(void)
+{
+    engine_t msg;
+    frame_t frame, packed;
+
+    for(uint32_t i = 0; i < RANDOM_FRAMES; i++)
+    {
+        random_payload(&frame);
+        engine_unpack(&frame, &msg);
+
+        CHECK(close_to(msg.engine_speed, reference_value(&frame, &engine[0])));
+        CHECK_EQ(msg.coolant_temp, (int64_t)reference_value(&frame, &engine[1]));
+        CHECK_EQ(msg.torque, (int64_t)reference_value(&frame, &engine[2]));
+        CHECK(close_to(msg.throttle, reference_value(&frame, &engine[3])));
+        CHECK_EQ(msg.counter, (int64_t)reference_value(&frame, &engine[4]));
+
+        engine_pack(&packed, &msg);
+        check_round_trip(&packed, &frame, engine, COUNT(engine));
+    }
+}
+
+static void test_motorola(void)
+{
+    brake_t msg;
+    frame_t frame, packed;
+
+    for(uint32_t i = 0; i < RANDOM_FRAMES; i++)
+    {
+        random_payload(&frame);
+        brake_unpack(&frame, &msg);
+
+        CHECK(close_to(msg.pressure, reference_value(&frame, &brake[0])));
+        CHECK(close_to(msg.yaw_rate, reference_value(&frame, &brake[1])));
+        CHECK_EQ(msg.middle, (int64_t)reference_value(&frame, &brake[2]));
+        CHECK_EQ(msg.status, (int64_t)reference_value(&frame, &brake[3]));
+        CHECK_EQ(msg.checksum, (int64_t)reference_value(&frame, &brake[4]));
+
+        brake_pack(&packed, &msg);
+        check_round_trip(&packed, &frame, brake, COUNT(brake));
+    }
+}
+
+/* A 40-bit Intel signal over both words next to a Motorola one with an integral offset */
+static void test_wide(void)
+{
+    odometer_t msg;
+    frame_t frame, packed;
+
+    for(uint32_t i = 0; i < RANDOM_FRAMES; i++)
+    {
+        random_payload(&frame);
+        odometer_unpack(&frame, &msg);
+
+        CHECK_EQ(msg.distance, (int64_t)reference_value(&frame, &odometer[0]));
+        CHECK_EQ(msg.trip, (int64_t)reference_value(&frame, &odometer[1]));
+
+        odometer_pack(&packed, &msg);
+        check_round_trip(&packed, &frame, odometer, COUNT(odometer));
+    }
+}
+
+/* The multiplexer selects the signal compared and the pack function */
+static void test_multiplexed(void)
+{
+    static const signal_t selected[2][3] = {
+        { diagnostic[0], diagnostic[1], diagnostic[3] },
+        { diagnostic[0], diagnostic[2], diagnostic[3] },
+    };
+    diagnostic_t msg;
+    frame_t frame, packed;
+
+    for(uint32_t i = 0; i < RANDOM_FRAMES; i++)
+    {
+        uint32_t mode = i % 2u;
+
+        random_payload(&frame);
+        frame.payload[0] = (frame.payload[0] & 0x00FFFFFFu) | (mode << 24);
+        diagnostic_unpack(&frame, &msg);
+
+        CHECK_EQ(msg.mode, mode);
+        CHECK_EQ(msg.sequence, (int64_t)reference_value(&frame, &diagnostic[3]));
+        if( mode == 0u )
+        {
+            CHECK_EQ(msg.voltage, (int64_t)reference_value(&frame, &diagnostic[1]));
+            diagnostic_pack_m0(&packed, &msg);
+        }
+        else
+        {
+            CHECK(close_to(msg.current, reference_value(&frame, &diagnostic[2])));
+            diagnostic_pack_m1(&packed, &msg);
+        }
+
+        CHECK_EQ(packed.ID, DIAGNOSTIC_ID);
+        check_round_trip(&packed, &frame, selected[mode], 3);
+    }
+}
+
+int main(void)
+{
+    srand(1);
+
+    RUN(test_known_frames);
+    RUN(test_intel);
+    RUN(test_motorola);
+    RUN(test_wide);
+    RUN(test_multiplexed);
+
+    return TEST_RESULT();
+}
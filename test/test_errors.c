@@ -0,0 +1,257 @@
+/**
+ * Source file
+ */
+
+#include "test.h"
+#include "CAN_sim.h"
+#include <FlexCAN/include/CAN_errors.h>
+#include <FlexCAN/include/CAN_internal.h>
+
+#define BITRATE             (500000u)
+
+/* Manual policy of FlexCAN0, and the bus-off recovery of the automatic one at BITRATE */
+#define BACKOFF_MS          (10u)
+#define BACKOFF_MAX_MS      (80u)
+#define RECOVERY_NS         ((128u * 11u * 1000000000ull) / BITRATE)
+
+static sim_bus_t* bus;
+static sim_node_t* peer;
+
+static uint32_t now_ms(void)
+{
+    return (uint32_t)(sim_now() / 1000000u);
+}
+
+static error_stats_t stats_of(FlexCAN_instance_t can)
+{
+    error_stats_t stats;
+
+    get_error_stats(can, &stats);
+
+    return stats;
+}
+
+/* Let the error interrupts see what was injected */
+static void settle(void)
+{
+    sim_run(300000);
+}
+
+/* Poll as the application would until the state is reached, return the ms it took */
+static uint32_t poll_until(FlexCAN_instance_t can, fault_state_t state, uint32_t max_ms)
+{
+    uint32_t start = now_ms();
+
+    error_poll(can, now_ms());
+    while( (stats_of(can).state != state) && ((now_ms() - start) < max_ms) )
+    {
+        sim_run(250000);
+        error_poll(can, now_ms());
+    }
+
+    return now_ms() - start;
+}
+
+/* Poll for a while, the state has to stay as it is */
+static void poll_for(FlexCAN_instance_t can, uint32_t ms)
+{
+    uint32_t start = now_ms();
+
+    while( (now_ms() - start) < ms )
+    {
+        error_poll(can, now_ms());
+        sim_run(250000);
+    }
+}
+
+/* Transmit errors past the 255 limit of the transmit error counter */
+static void bus_off(FlexCAN_instance_t can)
+{
+    sim_inject_errors(can, SIM_BIT1_ERROR, 32, 1);
+    settle();
+}
+
+/* One frame from the peer, the reception takes the receive error counter below the passive limit */
+static void peer_frame(void)
+{
+    sim_frame_t frame = { .ID = 0x123, .dlc = 1 };
+    frame_t received;
+
+    CHECK_EQ(sim_node_send(peer, &frame), Success);
+    sim_run(1000000);
+    while( receive_frame(FlexCAN_0, &received) == Success );
+}
+
+/* Every error type lands in its own counter, the receive and transmit error counters follow */
+static void test_histogram(void)
+{
+    static const uint32_t injected[Error_types] = {
+            SIM_BIT0_ERROR, SIM_BIT1_ERROR, SIM_STUFF_ERROR, SIM_FORM_ERROR, SIM_CRC_ERROR, SIM_ACK_ERROR
+    };
+    error_stats_t before = stats_of(FlexCAN_0);
+
+    for(uint32_t i = 0; i < Error_types; i++)
+    {
+        sim_inject_errors(FlexCAN_0, injected[i], 1, (i == Ack_error) ? 1u : 0u);
+        settle();
+    }
+
+    error_stats_t after = stats_of(FlexCAN_0);
+
+    for(uint32_t i = 0; i < Error_types; i++)
+    {
+        CHECK_EQ(after.errors[i] - before.errors[i], 1);
+    }
+    CHECK_EQ(after.rx_errors, 5);
+    CHECK_EQ(after.tx_errors, 8);
+    CHECK_EQ(after.state, Error_active);
+    CHECK_EQ(after.transitions, before.transitions);
+}
+
+/* Past 127 errors of either counter the node is error passive, back below it error active again */
+static void test_passive(void)
+{
+    frame_t frame = { .ID = 0x321 };
+    sim_frame_t seen;
+    error_stats_t before = stats_of(FlexCAN_0);
+
+    /* 8 + 15 * 8 = 128 transmit errors */
+    sim_inject_errors(FlexCAN_0, SIM_BIT0_ERROR, 15, 1);
+    settle();
+    CHECK_EQ(stats_of(FlexCAN_0).state, Error_passive);
+    CHECK_EQ(stats_of(FlexCAN_0).tx_errors, 128);
+
+    /* A successful transmission counts one down, error_poll() sees the return */
+    CHECK_EQ(transmit_frame(FlexCAN_0, &frame), Success);
+    sim_run(1000000);
+    CHECK_EQ(sim_node_receive(peer, &seen), Success);
+    CHECK_EQ(poll_until(FlexCAN_0, Error_active, 5) < 5u, 1);
+
+    /* Same through the receive error counter */
+    sim_inject_errors(FlexCAN_0, SIM_STUFF_ERROR, 123, 0);
+    settle();
+    CHECK_EQ(stats_of(FlexCAN_0).state, Error_passive);
+    CHECK_EQ(stats_of(FlexCAN_0).rx_errors, 128);
+
+    peer_frame();
+    CHECK_EQ(poll_until(FlexCAN_0, Error_active, 5) < 5u, 1);
+    CHECK_EQ(stats_of(FlexCAN_0).rx_errors, 127);
+    CHECK_EQ(stats_of(FlexCAN_0).transitions - before.transitions, 4);
+}
+
+/* The manual policy holds the node in bus-off for the backoff, doubled on each bus-off soon after */
+static void test_manual_recovery(void)
+{
+    frame_t frame = { .ID = 0x456, .payload = { 7 } };
+    sim_frame_t seen;
+    error_stats_t before = stats_of(FlexCAN_0);
+
+    bus_off(FlexCAN_0);
+    CHECK_EQ(stats_of(FlexCAN_0).state, Bus_off);
+    CHECK_EQ(stats_of(FlexCAN_0).bus_offs - before.bus_offs, 1);
+
+    /* Off the bus, the frame waits */
+    CHECK_EQ(transmit_frame(FlexCAN_0, &frame), Success);
+
+    /* Well past the 128 x 11 recessive bits, BOFFREC still holds it */
+    uint32_t waited = poll_until(FlexCAN_0, Error_active, 30);
+    CHECK(waited >= BACKOFF_MS);
+    CHECK(waited <= (BACKOFF_MS + 3u));
+    CHECK_EQ(stats_of(FlexCAN_0).recoveries - before.recoveries, 1);
+    CHECK_EQ(stats_of(FlexCAN_0).tx_errors, 0);
+    CHECK_EQ(stats_of(FlexCAN_0).rx_errors, 0);
+    CHECK_EQ(CAN0->CAN0_CTRL1_b.BOFFREC, 1);
+
+    /* Back on the bus, the frame goes out */
+    sim_run(1000000);
+    CHECK_EQ(sim_node_receive(peer, &seen), Success);
+    CHECK_EQ(seen.ID, 0x456);
+    while( transmitted_frame(FlexCAN_0, &frame) == Success );
+
+    /* Right away again: twice the backoff */
+    bus_off(FlexCAN_0);
+    waited = poll_until(FlexCAN_0, Error_active, 60);
+    CHECK(waited >= (2u * BACKOFF_MS));
+    CHECK(waited <= ((2u * BACKOFF_MS) + 3u));
+}
+
+/* The backoff only starts over once the node stayed error active for backoff_max_ms, a long
+ * time since the last bus-off spent error passive doesn't count */
+static void test_backoff_reset(void)
+{
+    /* Error passive for longer than backoff_max_ms, then error active again at one poll */
+    sim_inject_errors(FlexCAN_0, SIM_CRC_ERROR, 128, 0);
+    settle();
+    CHECK_EQ(stats_of(FlexCAN_0).state, Error_passive);
+    poll_for(FlexCAN_0, BACKOFF_MAX_MS + 10u);
+    peer_frame();
+    CHECK_EQ(poll_until(FlexCAN_0, Error_active, 5) < 5u, 1);
+
+    /* Third bus-off in a row: four times the backoff */
+    bus_off(FlexCAN_0);
+    uint32_t waited = poll_until(FlexCAN_0, Error_active, 100);
+    CHECK(waited >= (4u * BACKOFF_MS));
+    CHECK(waited <= ((4u * BACKOFF_MS) + 3u));
+
+    /* Error active for backoff_max_ms: the initial backoff */
+    poll_for(FlexCAN_0, BACKOFF_MAX_MS + 5u);
+    bus_off(FlexCAN_0);
+    waited = poll_until(FlexCAN_0, Error_active, 100);
+    CHECK(waited >= BACKOFF_MS);
+    CHECK(waited <= (BACKOFF_MS + 3u));
+}
+
+/* The automatic policy rejoins after 128 occurrences of 11 recessive bits, without error_poll() */
+static void test_automatic_recovery(void)
+{
+    error_stats_t before = stats_of(FlexCAN_1);
+
+    CHECK_EQ(CAN1->CAN0_CTRL1_b.BOFFREC, 0);
+
+    sim_inject_errors(FlexCAN_1, SIM_FORM_ERROR, 32, 1);
+    sim_run(RECOVERY_NS / 2u);
+    CHECK_EQ(stats_of(FlexCAN_1).state, Bus_off);
+    CHECK_EQ(stats_of(FlexCAN_1).bus_offs - before.bus_offs, 1);
+    CHECK_EQ(stats_of(FlexCAN_1).errors[Form_error] - before.errors[Form_error], 1);
+
+    sim_run(RECOVERY_NS);
+    CHECK_EQ(stats_of(FlexCAN_1).state, Error_active);
+    CHECK_EQ(stats_of(FlexCAN_1).recoveries - before.recoveries, 1);
+    CHECK_EQ(stats_of(FlexCAN_1).tx_errors, 0);
+    CHECK_EQ(stats_of(FlexCAN_1).transitions - before.transitions, 2);
+}
+
+int main(void)
+{
+    /* Millisecond checks of the backoff: slow simulated time down against host scheduling */
+    sim_config_t config = { .slowdown = 4, .tick_ns = 50000, .osc_hz = 8000000, .periph_hz = 48000000 };
+    error_policy_t manual = { .recovery = Recovery_manual, .backoff_ms = BACKOFF_MS, .backoff_max_ms = BACKOFF_MAX_MS };
+    error_policy_t automatic = { .recovery = Recovery_automatic };
+
+    if( sim_init(&config) != Success )
+    {
+        printf("sim_init failed\n");
+        return 1;
+    }
+
+    bus = sim_bus_create(BITRATE);
+    sim_attach(FlexCAN_0, bus);
+    sim_attach(FlexCAN_1, bus);
+    peer = sim_node_create(bus);
+
+    if( (FlexCAN_init_RXFIFO(FlexCAN_0) != Success) || (install_ID(FlexCAN_0, 0x123) != Success) ||
+        (FlexCAN_init_RXFIFO(FlexCAN_1) != Success) ||
+        (errors_init(FlexCAN_0, &manual) != Success) || (errors_init(FlexCAN_1, &automatic) != Success) )
+    {
+        printf("initialization failed\n");
+        return 1;
+    }
+
+    RUN(test_histogram);
+    RUN(test_passive);
+    RUN(test_manual_recovery);
+    RUN(test_backoff_reset);
+    RUN(test_automatic_recovery);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,319 @@
+/**
+ * Source file
+ */
+
+#include "test.h"
+#include "CAN_sim.h"
+#include <FlexCAN/include/CAN_internal.h>
+
+/* Message buffers of 64 bytes: 8 header bytes plus the payload, 7 of them in the 512 bytes of RAM,
+ * the first 5 receive, the last 2 of those take the extended IDs */
+#define MB_STRIDE_WORDS     ((8u + 64u) / 4u)
+#define MB_COUNT            (7u)
+#define RX_MB_COUNT         (5u)
+#define RX_EXT_MB_FIRST     (3u)
+#define MBDSR_64_BYTES      (3u)
+
+#define CODE_RX_EMPTY       (0x4u)
+#define CODE_TX_INACTIVE    (0x8u)
+#define CS_IDE              (1u << 21)
+
+#define TX_ID               (0x120u)
+#define RX_ID               (0x340u)
+#define EXT_ID              (0x1ABCDEF0u)
+
+/* Longest frame at the nominal bit rate, with margin */
+#define FRAME_NS_MAX        (1000000u)
+
+/* Period of a generator the interrupts keep up with under host load */
+#define BURST_PERIOD_NS     (150000u)
+
+/* Let simulated time pass until a condition holds, at most timeout_ns */
+#define WAIT_UNTIL(cond, timeout_ns) \
+    do { \
+        uint64_t wait_until = sim_now() + (timeout_ns); \
+        while( !(cond) && (sim_now() < wait_until) ) \
+        { \
+            sim_run(20000); \
+        } \
+    } while(0)
+
+static sim_bus_t* bus;
+static sim_node_t* node;
+
+/* Byte i of a payload in message buffer word order */
+static uint8_t byte_of(const uint32_t* payload, uint32_t i)
+{
+    return (uint8_t)(payload[i / 4u] >> (24u - (8u * (i % 4u))));
+}
+
+/* Bytes counting from a seed, zero past the length */
+static void fill(uint32_t* payload, uint32_t words, uint32_t length, uint8_t seed)
+{
+    for(uint32_t w = 0; w < words; w++)
+    {
+        payload[w] = 0;
+    }
+
+    for(uint32_t i = 0; i < length; i++)
+    {
+        payload[i / 4u] |= (uint32_t)(uint8_t)(seed + i) << (24u - (8u * (i % 4u)));
+    }
+}
+
+/* Whether the first length bytes count from the seed and the padding up to padded is zero */
+static uint8_t matches(const uint32_t* payload, uint32_t length, uint32_t padded, uint8_t seed)
+{
+    for(uint32_t i = 0; i < padded; i++)
+    {
+        if( byte_of(payload, i) != ((i < length) ? (uint8_t)(seed + i) : 0u) )
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static uint64_t bus_bits(void)
+{
+    sim_bus_stats_t stats;
+
+    sim_get_bus_stats(bus, &stats, 0);
+
+    return stats.bits;
+}
+
+/* MBDSR0 packs 72-byte message buffers, initialized for reception then transmission */
+static void test_layout(void)
+{
+    volatile uint32_t* ram = (volatile uint32_t*)&CAN0->Classic_RX_FIFO[0];
+
+    CHECK_EQ(CAN0->CAN0_MCR_b.FDEN, 1);
+    CHECK_EQ(CAN0->CAN0_FDCTRL_b.MBDSR0, MBDSR_64_BYTES);
+    CHECK_EQ(CAN0->CAN0_FDCTRL_b.FDRATE, 1);
+    CHECK_EQ(CAN0->CAN0_MCR_b.MAXMB, MB_COUNT - 1u);
+
+    for(uint32_t mb = 0; mb < MB_COUNT; mb++)
+    {
+        uint32_t cs = ram[mb * MB_STRIDE_WORDS];
+
+        if( mb < RX_MB_COUNT )
+        {
+            CHECK_EQ((cs >> 24) & 0xFu, CODE_RX_EMPTY);
+            CHECK_EQ((cs & CS_IDE) ? 1u : 0u, (mb >= RX_EXT_MB_FIRST) ? 1u : 0u);
+        }
+        else
+        {
+            CHECK_EQ((cs >> 24) & 0xFu, CODE_TX_INACTIVE);
+        }
+    }
+
+    /* Reading a control/status word locked the message buffer */
+    (void)CAN0->CAN0_TIMER;
+}
+
+/* Every payload length rounds up to the smallest data length code holding it */
+static void test_dlc_mapping(void)
+{
+    for(uint32_t length = 0; length <= CAN_FD_PAYLOAD_BYTES; length++)
+    {
+        uint8_t dlc = FD_length_to_dlc((uint8_t)length);
+
+        CHECK(FD_dlc_to_length(dlc) >= length);
+        CHECK((dlc == 0u) || (FD_dlc_to_length(dlc - 1u) < length));
+        CHECK_EQ(dlc, (length <= 8u) ? length : dlc);
+    }
+
+    CHECK_EQ(FD_length_to_dlc(9), 9);
+    CHECK_EQ(FD_length_to_dlc(13), 10);
+    CHECK_EQ(FD_length_to_dlc(33), 14);
+    CHECK_EQ(FD_dlc_to_length(15), 64);
+}
+
+/* transmit_frame_FD(): every length with and without BRS arrives whole, the data phase of the
+ * frames with BRS at the data bit rate */
+static void test_transmit(void)
+{
+    uint64_t bits[2];
+
+    for(uint8_t brs = 0; brs < 2u; brs++)
+    {
+        uint64_t before = bus_bits();
+
+        for(uint32_t length = 0; length <= CAN_FD_PAYLOAD_BYTES; length++)
+        {
+            fd_frame_t frame = { .ID = TX_ID + length, .length = (uint8_t)length, .BRS = brs };
+            sim_frame_t seen;
+            status_t status;
+
+            fill(frame.payload, MAX_FD_MTU_WORDS, length, (uint8_t)(length + brs));
+
+            WAIT_UNTIL((status = transmit_frame_FD(FlexCAN_0, &frame)) != BufferFull, FRAME_NS_MAX);
+            CHECK_EQ(status, Success);
+
+            WAIT_UNTIL(sim_node_receive(node, &seen) == Success, FRAME_NS_MAX);
+            CHECK_EQ(seen.ID, TX_ID + length);
+            CHECK_EQ(seen.edl, 1);
+            CHECK_EQ(seen.brs, brs);
+            CHECK_EQ(seen.dlc, FD_length_to_dlc((uint8_t)length));
+            CHECK(matches(seen.payload, length, FD_dlc_to_length(seen.dlc), (uint8_t)(length + brs)));
+        }
+
+        bits[brs] = bus_bits() - before;
+    }
+
+    /* Four times the bit rate over most of the frames */
+    CHECK(bits[1] < ((bits[0] * 2u) / 3u));
+    CHECK_EQ(sim_node_receive(node, &(sim_frame_t){ 0 }), Failure);
+
+    /* Longer than the message buffers hold */
+    fd_frame_t frame = { .ID = TX_ID, .length = CAN_FD_PAYLOAD_BYTES + 1u };
+    CHECK_EQ(transmit_frame_FD(FlexCAN_0, &frame), Failure);
+}
+
+/* The FD mailboxes and drain_rx_FD(): every data length code with and without BRS */
+static void test_receive(void)
+{
+    uint64_t last = 0;
+
+    for(uint8_t brs = 0; brs < 2u; brs++)
+    {
+        for(uint32_t length = 0; length <= CAN_FD_PAYLOAD_BYTES; length++)
+        {
+            sim_frame_t frame = { .ID = RX_ID, .edl = 1, .brs = brs, .dlc = FD_length_to_dlc((uint8_t)length) };
+            fd_frame_t received;
+
+            fill(frame.payload, MAX_FD_MTU_WORDS, length, (uint8_t)(0x80u + length));
+
+            CHECK_EQ(sim_node_send(node, &frame), Success);
+            WAIT_UNTIL(receive_frame_FD(FlexCAN_0, &received) == Success, FRAME_NS_MAX);
+
+            CHECK_EQ(received.ID, RX_ID);
+            CHECK_EQ(received.length, FD_dlc_to_length(frame.dlc));
+            CHECK_EQ(received.BRS, brs);
+            CHECK(matches(received.payload, length, received.length, (uint8_t)(0x80u + length)));
+            CHECK(received.timestamp > last);
+            CHECK(received.timestamp <= FlexCAN_timer_now(FlexCAN_0));
+            last = received.timestamp;
+        }
+    }
+}
+
+/* Extended IDs go out with IDE and come in through the extended message buffers */
+static void test_extended(void)
+{
+    fd_frame_t frame = { .ID = CAN_ID_EXT | EXT_ID, .length = 48, .BRS = 1 };
+    sim_frame_t seen;
+    fd_frame_t received;
+
+    fill(frame.payload, MAX_FD_MTU_WORDS, 48, 0x30);
+    CHECK_EQ(transmit_frame_FD(FlexCAN_0, &frame), Success);
+    WAIT_UNTIL(sim_node_receive(node, &seen) == Success, FRAME_NS_MAX);
+    CHECK_EQ(seen.ID, CAN_ID_EXT | EXT_ID);
+    CHECK_EQ(seen.dlc, 14);
+
+    seen.ID = CAN_ID_EXT | (EXT_ID + 1u);
+    CHECK_EQ(sim_node_send(node, &seen), Success);
+    WAIT_UNTIL(receive_frame_FD(FlexCAN_0, &received) == Success, FRAME_NS_MAX);
+    CHECK_EQ(received.ID, CAN_ID_EXT | (EXT_ID + 1u));
+    CHECK_EQ(received.length, 48);
+    CHECK(matches(received.payload, 48, 48, 0x30));
+}
+
+/* Frames for longer than the 16-bit timer takes to wrap, every timestamp has to stay between the
+ * start and the time it is read */
+static void test_wrap_timestamps(void)
+{
+    sim_frame_t frame = { .ID = RX_ID, .edl = 1, .brs = 1, .dlc = 8 };
+    uint64_t period = BURST_PERIOD_NS;
+    uint32_t count = (uint32_t)((3u * 65536000ull) / (2u * period));
+    uint64_t start = FlexCAN_timer_now(FlexCAN_0);
+    uint64_t last = start;
+    uint32_t received = 0;
+    fd_frame_t out;
+
+    sim_node_generate(node, &frame, period, count);
+
+    uint64_t deadline = sim_now() + ((uint64_t)count * period * 2u) + 10000000u;
+    while( (received < count) && (sim_now() < deadline) )
+    {
+        while( receive_frame_FD(FlexCAN_0, &out) == Success )
+        {
+            CHECK(out.timestamp >= start);
+            CHECK(out.timestamp <= FlexCAN_timer_now(FlexCAN_0));
+            last = (out.timestamp > last) ? out.timestamp : last;
+            received++;
+        }
+
+        sim_run(100000);
+    }
+
+    CHECK_EQ(received, count);
+    CHECK((last - start) > 65536u);
+}
+
+/* FlexCAN_init_RXFIFO() after CAN FD mode: classic frames go out and come in through the RX FIFO,
+ * the FD calls are refused again */
+static void test_back_to_classic(void)
+{
+    sim_bus_t* classic = sim_bus_create(CAN_BITRATE);
+    sim_node_t* other = sim_node_create(classic);
+    sim_frame_t frame = { .ID = RX_ID, .dlc = 8, .payload = { 0xC1C2C3C4u, 0xC5C6C7C8u } };
+    frame_t out = { .ID = TX_ID, .payload = { 0x11111111u, 0x22222222u } };
+    fd_frame_t fd = { .ID = TX_ID, .length = 8 };
+    frame_t got;
+    sim_frame_t seen;
+    status_t status = Failure;
+
+    sim_attach(FlexCAN_0, classic);
+    CHECK_EQ(FlexCAN_init_RXFIFO(FlexCAN_0), Success);
+    CHECK_EQ(install_ID(FlexCAN_0, RX_ID), Success);
+    CHECK_EQ(CAN0->CAN0_MCR_b.FDEN, 0);
+
+    CHECK_EQ(transmit_frame(FlexCAN_0, &out), Success);
+    WAIT_UNTIL(sim_node_receive(other, &seen) == Success, FRAME_NS_MAX);
+    CHECK_EQ(seen.ID, TX_ID);
+    CHECK_EQ(seen.edl, 0);
+    CHECK_EQ(seen.payload[1], 0x22222222u);
+
+    CHECK_EQ(sim_node_send(other, &frame), Success);
+    WAIT_UNTIL((status = receive_frame(FlexCAN_0, &got)) == Success, FRAME_NS_MAX);
+    CHECK_EQ(status, Success);
+    CHECK_EQ(got.ID, RX_ID);
+    CHECK_EQ(got.payload[0], 0xC1C2C3C4u);
+
+    CHECK_EQ(transmit_frame_FD(FlexCAN_0, &fd), Failure);
+}
+
+int main(void)
+{
+    /* Frames of a few tens of microseconds: slow simulated time down so the interrupts keep up */
+    sim_config_t config = { .slowdown = 8, .tick_ns = 50000, .osc_hz = 8000000, .periph_hz = CAN_FD_CLOCK_HZ };
+
+    if( sim_init(&config) != Success )
+    {
+        printf("sim_init failed\n");
+        return 1;
+    }
+
+    bus = sim_bus_create_fd(CAN_FD_NOMINAL_BITRATE, CAN_FD_DATA_BITRATE);
+    sim_attach(FlexCAN_0, bus);
+    node = sim_node_create(bus);
+
+    if( FlexCAN_init_FD(FlexCAN_0) != Success )
+    {
+        printf("FlexCAN_init_FD failed\n");
+        return 1;
+    }
+
+    RUN(test_layout);
+    RUN(test_dlc_mapping);
+    RUN(test_transmit);
+    RUN(test_receive);
+    RUN(test_extended);
+    RUN(test_wrap_timestamps);
+    RUN(test_back_to_classic);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,297 @@
+/**
+ * Source file
+ */
+
+#include "test.h"
+#include <FlexCAN/include/CAN_filter_compiler.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STD_IDS             (0x800u)
+
+/* Whether a standard ID passes the table */
+static uint8_t table_accepts(const filter_t* filters, uint32_t count, uint32_t id)
+{
+    for(uint32_t i = 0; i < count; i++)
+    {
+        if( (id & filters[i].mask) == filters[i].ID )
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* Random distinct standard IDs */
+static uint32_t random_ids(uint32_t* ids, uint32_t count, uint32_t seed)
+{
+    static uint8_t taken[STD_IDS];
+    uint32_t n = 0;
+
+    srand(seed);
+    memset(taken, 0, sizeof(taken));
+
+    while( n < count )
+    {
+        uint32_t id = (uint32_t)rand() & 0x7FFu;
+
+        if( !taken[id] )
+        {
+            taken[id] = 1;
+            ids[n++] = id;
+        }
+    }
+
+    return n;
+}
+
+/* Every listed ID passes the table and, with the residual filter behind it, nothing else does */
+static void check_exact(const filter_t* filters, uint32_t used, const residual_filter_t* residual,
+                        const uint32_t* list, uint32_t count)
+{
+    static uint8_t listed[STD_IDS];
+
+    memset(listed, 0, sizeof(listed));
+    for(uint32_t i = 0; i < count; i++)
+    {
+        listed[list[i]] = 1;
+    }
+
+    uint32_t false_positives = 0;
+
+    for(uint32_t id = 0; id < STD_IDS; id++)
+    {
+        uint8_t table = table_accepts(filters, used, id);
+
+        if( listed[id] )
+        {
+            CHECK(table);
+            CHECK_EQ(residual_accepts(residual, id), Success);
+        }
+        else if( table )
+        {
+            false_positives++;
+            CHECK_EQ(residual_accepts(residual, id), Failure);
+        }
+    }
+
+    CHECK_EQ(filters_false_positives(filters, used, count), false_positives);
+}
+
+static void test_empty(void)
+{
+    filter_t filters[1];
+    residual_filter_t residual;
+
+    CHECK_EQ(compile_filters(0, 0, 0, 4, 0, filters, &residual), 0);
+    CHECK_EQ(residual.count, 0);
+    CHECK_EQ(residual_accepts(&residual, 0x123), Failure);
+}
+
+/* The list comes back sorted without repeats, an aligned block of IDs is one exact filter */
+static void test_lossless(void)
+{
+    uint32_t ids[20];
+    uint32_t list[16];
+    filter_t filters[20];
+    residual_filter_t residual;
+
+    for(uint32_t i = 0; i < 16u; i++)
+    {
+        ids[i] = 0x10Fu - i;
+        list[i] = 0x100u + i;
+    }
+    ids[16] = 0x105;
+    ids[17] = 0x100;
+    ids[18] = 0x10F;
+    ids[19] = 0x108;
+
+    uint32_t used = compile_filters(ids, 20, 0, 32, 0, filters, &residual);
+
+    CHECK_EQ(used, 1);
+    CHECK_EQ(filters[0].ID, 0x100);
+    CHECK_EQ(filters[0].mask, 0x7F0);
+    CHECK_EQ(filters[0].extended, 0);
+    CHECK_EQ(residual.count, 16);
+    for(uint32_t i = 0; i < 16u; i++)
+    {
+        CHECK_EQ(residual.accept[i], 0x100u + i);
+    }
+
+    check_exact(filters, used, &residual, list, 16);
+}
+
+/* Without a tolerance and with room in the table, nothing is over-accepted */
+static void test_no_tolerance(void)
+{
+    static uint32_t ids[64];
+    static uint32_t list[64];
+    static filter_t filters[64];
+    residual_filter_t residual;
+
+    uint32_t count = random_ids(list, 64, 1);
+    memcpy(ids, list, sizeof(list));
+
+    uint32_t used = compile_filters(ids, count, 0, 64, 0, filters, &residual);
+
+    CHECK(used <= 64u);
+    CHECK_EQ(filters_false_positives(filters, used, count), 0);
+    check_exact(filters, used, &residual, list, count);
+}
+
+/* Over budget, filters merge until they fit and the residual filter takes the slack */
+static void test_budget(void)
+{
+    static const uint32_t budgets[] = { 1, 8, 24, 104 };
+    static uint32_t ids[300];
+    static uint32_t list[300];
+    static filter_t filters[300];
+    residual_filter_t residual;
+
+    for(uint32_t b = 0; b < (sizeof(budgets) / sizeof(budgets[0])); b++)
+    {
+        uint32_t count = random_ids(list, 300, 2u + b);
+        memcpy(ids, list, sizeof(list));
+
+        uint32_t used = compile_filters(ids, count, 0, budgets[b], 0, filters, &residual);
+
+        CHECK(used >= 1u);
+        CHECK(used <= budgets[b]);
+        check_exact(filters, used, &residual, list, count);
+    }
+}
+
+/* Under budget, merging goes on only while the false positives stay within the tolerance */
+static void test_tolerance(void)
+{
+    static uint32_t ids[100];
+    static uint32_t list[100];
+    static filter_t filters[100];
+    residual_filter_t residual;
+    uint32_t used_strict = 0;
+
+    for(uint32_t tolerated = 0; tolerated <= 200u; tolerated += 100u)
+    {
+        uint32_t count = random_ids(list, 100, 7);
+        memcpy(ids, list, sizeof(list));
+
+        uint32_t used = compile_filters(ids, count, 0, 100, tolerated, filters, &residual);
+        uint32_t false_positives = filters_false_positives(filters, used, count);
+
+        CHECK(((uint64_t)false_positives * 1000u) <= ((uint64_t)tolerated * (count + false_positives)));
+        check_exact(filters, used, &residual, list, count);
+
+        /* A looser tolerance never needs more filters */
+        if( tolerated == 0u )
+        {
+            used_strict = used;
+        }
+        else
+        {
+            CHECK(used <= used_strict);
+        }
+    }
+}
+
+/* Merges that swallow other filters cost only the IDs they add, so a long list squeezed into a
+ * small budget keeps the budget's worth of filters instead of collapsing into one */
+static void test_merge_cost(void)
+{
+    static uint32_t ids[190];
+    static uint32_t list[190];
+    static filter_t filters[190];
+    residual_filter_t residual;
+
+    uint32_t count = random_ids(list, 190, 11);
+    memcpy(ids, list, sizeof(list));
+
+    uint32_t used = compile_filters(ids, count, 0, 8, 0, filters, &residual);
+
+    CHECK(used > 1u);
+    CHECK(used <= 8u);
+    check_exact(filters, used, &residual, list, count);
+
+    /* Six blocks of neighbouring IDs, one of them ragged, fit 8 filters within 10% */
+    count = 0;
+    for(uint32_t block = 0; block < 6u; block++)
+    {
+        for(uint32_t i = 0; (i < 32u) && (count < 190u); i++)
+        {
+            list[count++] = (block * 0x140u) + 0x100u + i;
+        }
+    }
+    memcpy(ids, list, sizeof(list));
+
+    used = compile_filters(ids, count, 0, 8, 100, filters, &residual);
+    uint32_t false_positives = filters_false_positives(filters, used, count);
+
+    CHECK(used > 1u);
+    CHECK(used <= 8u);
+    CHECK(((uint64_t)false_positives * 1000u) <= (100u * (uint64_t)(count + false_positives)));
+    check_exact(filters, used, &residual, list, count);
+}
+
+/* Wide extended filters overflow 32 bits of accepted IDs, the count saturates */
+static void test_false_positives_saturate(void)
+{
+    filter_t wide[8];
+
+    for(uint32_t i = 0; i < 8u; i++)
+    {
+        wide[i] = (filter_t){ .ID = 0, .mask = 0, .extended = 1 };
+    }
+
+    CHECK_EQ(filters_false_positives(wide, 8, 0), UINT32_MAX);
+    CHECK_EQ(filters_false_positives(wide, 1, 10), (1u << 29) - 10u);
+}
+
+/* Extended IDs keep the 29-bit width and their flag, and nothing listed is rejected */
+static void test_extended(void)
+{
+    uint32_t list[] = { 0x18FEF100u, 0x18FEF101u, 0x18FEF102u, 0x18FEF103u, 0x0CF00400u, 0x1FFFFFFFu };
+    uint32_t ids[6];
+    filter_t filters[6];
+    residual_filter_t residual;
+
+    memcpy(ids, list, sizeof(list));
+
+    uint32_t used = compile_filters(ids, 6, 1, 2, 0, filters, &residual);
+
+    CHECK(used <= 2u);
+    for(uint32_t i = 0; i < used; i++)
+    {
+        CHECK_EQ(filters[i].extended, 1);
+        CHECK_EQ(filters[i].mask & ~CAN_ID_MASK, 0);
+    }
+
+    for(uint32_t k = 0; k < 6u; k++)
+    {
+        uint8_t passes = 0;
+
+        for(uint32_t i = 0; i < used; i++)
+        {
+            passes |= ((list[k] & filters[i].mask) == filters[i].ID) ? 1u : 0u;
+        }
+        CHECK(passes);
+        CHECK_EQ(residual_accepts(&residual, list[k]), Success);
+    }
+    CHECK_EQ(residual_accepts(&residual, 0x18FEF104u), Failure);
+
+    /* An upper bound for extended IDs: at least what one wide filter lets through */
+    CHECK(filters_false_positives(filters, used, 6) > 0u);
+}
+
+int main(void)
+{
+    RUN(test_empty);
+    RUN(test_lossless);
+    RUN(test_no_tolerance);
+    RUN(test_budget);
+    RUN(test_tolerance);
+    RUN(test_extended);
+    RUN(test_merge_cost);
+    RUN(test_false_positives_saturate);
+
+    return TEST_RESULT();
+}
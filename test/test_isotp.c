@@ -0,0 +1,550 @@
+/**
+ * Source file
+ */
+
+#include "test.h"
+#include "CAN_sim.h"
+#include <FlexCAN/include/CAN_isotp.h>
+
+#define BITRATE             (500000u)
+#define MS_NS               (1000000u)
+
+/* The driver answers a tester on the usual diagnostic IDs */
+#define TESTER_ID           (0x7E0u)
+#define ECU_ID              (0x7E8u)
+#define BLOCK_SIZE          (8u)
+
+#define MESSAGE_MAX         (5000u)
+
+static sim_node_t* tester;
+static uint8_t session;
+
+static uint8_t message[MESSAGE_MAX];
+static uint8_t buffer[MESSAGE_MAX];
+
+/* Byte of a simulated frame, laid out as frame_t */
+static uint8_t get_byte(const sim_frame_t* frame, uint32_t i)
+{
+    return (uint8_t)(frame->payload[i >> 2] >> (24u - ((i & 3u) * 8u)));
+}
+
+static uint64_t tester_sent(void)
+{
+    sim_node_stats_t stats;
+
+    sim_get_node_stats(tester, &stats, 0);
+
+    return stats.sent;
+}
+
+/* Frame of the tester from its first bytes, the rest padded, returns once it was on the bus */
+static void tester_send(const uint8_t* bytes, uint32_t count)
+{
+    sim_frame_t frame = { .ID = TESTER_ID, .dlc = 8 };
+    uint64_t target = tester_sent() + 1u;
+    uint64_t until = sim_now() + (50u * MS_NS);
+
+    for(uint32_t i = 0; i < 8u; i++)
+    {
+        uint8_t value = (i < count) ? bytes[i] : ISOTP_PADDING;
+
+        frame.payload[i >> 2] |= (uint32_t)value << (24u - ((i & 3u) * 8u));
+    }
+
+    CHECK_EQ(sim_node_send(tester, &frame), Success);
+
+    while( (tester_sent() < target) && (sim_now() < until) )
+    {
+        (void)isotp_poll(FlexCAN_0);
+        sim_run(100000);
+    }
+    CHECK_EQ(tester_sent(), target);
+}
+
+/* Let the bus and the sessions run, as the main loop would */
+static void run(uint64_t ns)
+{
+    uint64_t until = sim_now() + ns;
+
+    do
+    {
+        (void)isotp_poll(FlexCAN_0);
+        sim_run(100000);
+    } while( sim_now() < until );
+}
+
+/* Wait for the next frame the driver sends */
+static status_t tester_receive(sim_frame_t* frame)
+{
+    uint64_t until = sim_now() + (50u * MS_NS);
+
+    while( sim_node_receive(tester, frame) != Success )
+    {
+        if( sim_now() >= until )
+        {
+            return Failure;
+        }
+
+        (void)isotp_poll(FlexCAN_0);
+        sim_run(100000);
+    }
+
+    CHECK_EQ(frame->ID, ECU_ID);
+    CHECK_EQ(frame->dlc, 8);
+
+    return Success;
+}
+
+/* Wait for the message being sent to finish, and read the result */
+static isotp_result_t send_finished(void)
+{
+    uint64_t until = sim_now() + (50u * MS_NS);
+    isotp_result_t result;
+
+    while( ((result = isotp_send_result(session)) == Isotp_busy) && (sim_now() < until) )
+    {
+        run(100000);
+    }
+
+    return result;
+}
+
+/* Same for the message being received */
+static isotp_result_t receive_finished(uint32_t* length)
+{
+    uint64_t until = sim_now() + (50u * MS_NS);
+    isotp_result_t result;
+
+    while( (((result = isotp_receive_result(session, length)) == Isotp_busy) || (result == Isotp_idle)) &&
+           (sim_now() < until) )
+    {
+        run(100000);
+    }
+
+    return result;
+}
+
+/* Flow control the tester sends */
+static void tester_flow(uint8_t status, uint8_t block_size, uint8_t st_min)
+{
+    uint8_t bytes[3] = { (uint8_t)(0x30u | status), block_size, st_min };
+
+    tester_send(bytes, 3);
+}
+
+/* Nothing left on the bus and no result pending from a previous test */
+static void flush(void)
+{
+    sim_frame_t frame;
+    uint32_t length;
+
+    run(2u * MS_NS);
+    while( sim_node_receive(tester, &frame) == Success );
+    (void)isotp_send_result(session);
+    (void)isotp_receive_result(session, &length);
+}
+
+static void fill(uint32_t length, uint8_t seed)
+{
+    for(uint32_t i = 0; i < length; i++)
+    {
+        message[i] = (uint8_t)((i * 7u) + seed);
+    }
+}
+
+/* Messages below 8 bytes go as one single frame each way */
+static void test_single_frame(void)
+{
+    sim_frame_t frame;
+    uint32_t length;
+
+    flush();
+    fill(5, 1);
+
+    CHECK_EQ(isotp_send(session, message, 5), Success);
+    CHECK_EQ(isotp_send(session, message, 5), BufferFull);
+    CHECK_EQ(isotp_send(session, message, 0), Failure);
+    CHECK_EQ(tester_receive(&frame), Success);
+    CHECK_EQ(get_byte(&frame, 0), 0x05);
+    for(uint32_t i = 0; i < 5u; i++)
+    {
+        CHECK_EQ(get_byte(&frame, 1u + i), message[i]);
+    }
+    CHECK_EQ(get_byte(&frame, 6), ISOTP_PADDING);
+    CHECK_EQ(get_byte(&frame, 7), ISOTP_PADDING);
+    CHECK_EQ(isotp_send_result(session), Isotp_done);
+    CHECK_EQ(isotp_send_result(session), Isotp_idle);
+
+    uint8_t single[8] = { 0x07, 1, 2, 3, 4, 5, 6, 7 };
+
+    CHECK_EQ(isotp_receive(session, buffer, sizeof(buffer)), Success);
+    tester_send(single, 8);
+    CHECK_EQ(receive_finished(&length), Isotp_done);
+    CHECK_EQ(length, 7);
+    for(uint32_t i = 0; i < 7u; i++)
+    {
+        CHECK_EQ(buffer[i], i + 1u);
+    }
+    CHECK_EQ(isotp_receive_result(session, &length), Isotp_idle);
+}
+
+/* Send a message the driver segments, honouring the tester's block size and separation time */
+static void check_send(uint32_t length, uint8_t block_size, uint8_t st_min)
+{
+    sim_frame_t frame;
+    uint32_t offset;
+    uint8_t sn = 1;
+    uint32_t in_block = 0;
+    uint64_t first = 0;
+    uint32_t spaced = 0;
+
+    flush();
+    fill(length, (uint8_t)length);
+    CHECK_EQ(isotp_send(session, message, length), Success);
+
+    CHECK_EQ(tester_receive(&frame), Success);
+    CHECK_EQ(get_byte(&frame, 0) >> 4, 1);
+
+    if( length <= 4095u )
+    {
+        CHECK_EQ(((get_byte(&frame, 0) & 0xFu) << 8) | get_byte(&frame, 1), length);
+        offset = 2;
+    }
+    else
+    {
+        /* Escape sequence, then the length on 32 bits */
+        CHECK_EQ(get_byte(&frame, 0), 0x10);
+        CHECK_EQ(get_byte(&frame, 1), 0);
+        CHECK_EQ(((uint32_t)get_byte(&frame, 2) << 24) | ((uint32_t)get_byte(&frame, 3) << 16) |
+                 ((uint32_t)get_byte(&frame, 4) << 8) | get_byte(&frame, 5), length);
+        offset = 6;
+    }
+
+    uint32_t received = 8u - offset;
+    for(uint32_t i = 0; i < received; i++)
+    {
+        CHECK_EQ(get_byte(&frame, offset + i), message[i]);
+    }
+
+    /* Nothing more until the flow control */
+    run(5u * MS_NS);
+    CHECK_EQ(sim_node_receive(tester, &frame), Failure);
+    CHECK_EQ(isotp_send_result(session), Isotp_busy);
+    tester_flow(0, block_size, st_min);
+
+    while( (received < length) && (tester_receive(&frame) == Success) )
+    {
+        CHECK_EQ(get_byte(&frame, 0), 0x20u | sn);
+        sn = (sn + 1u) & 0xFu;
+
+        /* Each one queued a separation time after the previous one: over a block, at least the
+         * separation times less how late the first one went out */
+        if( first == 0u )
+        {
+            first = frame.time;
+            spaced = 0;
+        }
+        else
+        {
+            spaced++;
+        }
+        CHECK((frame.time - first) + MS_NS >= ((uint64_t)spaced * st_min * MS_NS));
+
+        for(uint32_t i = 1; (i < 8u) && (received < length); i++)
+        {
+            CHECK_EQ(get_byte(&frame, i), message[received++]);
+        }
+
+        if( (block_size != 0u) && (++in_block == block_size) && (received < length) )
+        {
+            in_block = 0;
+            first = 0;
+            run(2u * MS_NS);
+            CHECK_EQ(sim_node_receive(tester, &frame), Failure);
+            tester_flow(0, block_size, st_min);
+        }
+    }
+
+    CHECK_EQ(received, length);
+    CHECK_EQ(send_finished(), Isotp_done);
+}
+
+static void test_send(void)
+{
+    /* 28 consecutive frames, the sequence number wraps around */
+    check_send(200, 0, 0);
+    check_send(200, 5, 0);
+    check_send(60, 0, 5);
+    check_send(MESSAGE_MAX, 0, 0);
+}
+
+/* Feed a segmented message the driver reassembles, answering its flow controls */
+static void check_receive(uint32_t length)
+{
+    sim_frame_t frame;
+    uint8_t bytes[8];
+    uint32_t sent;
+    uint32_t got;
+    uint8_t sn = 1;
+    uint32_t in_block = 0;
+
+    flush();
+    fill(length, (uint8_t)(length + 3u));
+    CHECK_EQ(isotp_receive(session, buffer, sizeof(buffer)), Success);
+
+    if( length <= 4095u )
+    {
+        bytes[0] = (uint8_t)(0x10u | (length >> 8));
+        bytes[1] = (uint8_t)length;
+        sent = 6;
+        for(uint32_t i = 0; i < sent; i++)
+        {
+            bytes[2u + i] = message[i];
+        }
+    }
+    else
+    {
+        bytes[0] = 0x10;
+        bytes[1] = 0;
+        bytes[2] = (uint8_t)(length >> 24);
+        bytes[3] = (uint8_t)(length >> 16);
+        bytes[4] = (uint8_t)(length >> 8);
+        bytes[5] = (uint8_t)length;
+        sent = 2;
+        bytes[6] = message[0];
+        bytes[7] = message[1];
+    }
+    tester_send(bytes, 8);
+
+    /* The driver grants its configured block size and separation time */
+    CHECK_EQ(tester_receive(&frame), Success);
+    CHECK_EQ(get_byte(&frame, 0), 0x30);
+    CHECK_EQ(get_byte(&frame, 1), BLOCK_SIZE);
+    CHECK_EQ(get_byte(&frame, 2), 0);
+
+    while( sent < length )
+    {
+        bytes[0] = (uint8_t)(0x20u | sn);
+        sn = (sn + 1u) & 0xFu;
+
+        uint32_t i;
+        for(i = 1; (i < 8u) && (sent < length); i++)
+        {
+            bytes[i] = message[sent++];
+        }
+        tester_send(bytes, i);
+
+        if( (++in_block == BLOCK_SIZE) && (sent < length) )
+        {
+            in_block = 0;
+            CHECK_EQ(tester_receive(&frame), Success);
+            CHECK_EQ(get_byte(&frame, 0), 0x30);
+        }
+    }
+
+    CHECK_EQ(receive_finished(&got), Isotp_done);
+    CHECK_EQ(got, length);
+    for(uint32_t i = 0; i < length; i++)
+    {
+        CHECK_EQ(buffer[i], message[i]);
+    }
+    CHECK_EQ(sim_node_receive(tester, &frame), Failure);
+}
+
+static void test_receive(void)
+{
+    check_receive(8);
+    check_receive(200);
+    check_receive(4096);
+}
+
+/* ISO 15765-2 ignores a first frame whose length fits a single frame, or an escaped length
+ * that fits the 12-bit field: no flow control, the reception stays idle */
+static void test_first_frame_length(void)
+{
+    static const uint8_t short_ff[8] = { 0x10, 0x07, 1, 2, 3, 4, 5, 6 };
+    static const uint8_t zero_ff[8] = { 0x10, 0x00, 0, 0, 0, 0, 1, 2 };
+    static const uint8_t escaped_short[8] = { 0x10, 0x00, 0, 0, 0x0F, 0xFF, 1, 2 };
+    static const uint8_t escaped[8] = { 0x10, 0x00, 0, 0, 0x10, 0x00, 1, 2 };
+    sim_frame_t frame;
+    uint32_t length;
+
+    flush();
+    CHECK_EQ(isotp_receive(session, buffer, sizeof(buffer)), Success);
+
+    tester_send(short_ff, 8);
+    tester_send(zero_ff, 8);
+    tester_send(escaped_short, 8);
+    run(5u * MS_NS);
+    CHECK_EQ(sim_node_receive(tester, &frame), Failure);
+    CHECK_EQ(isotp_receive_result(session, &length), Isotp_idle);
+
+    /* The smallest escaped length is accepted */
+    tester_send(escaped, 8);
+    CHECK_EQ(tester_receive(&frame), Success);
+    CHECK_EQ(get_byte(&frame, 0), 0x30);
+    CHECK_EQ(isotp_receive_result(session, &length), Isotp_busy);
+    CHECK_EQ(length, 2);
+
+    /* A single frame replaces the message in progress */
+    uint8_t single[2] = { 0x01, 0x55 };
+    tester_send(single, 2);
+    CHECK_EQ(receive_finished(&length), Isotp_done);
+    CHECK_EQ(length, 1);
+    CHECK_EQ(buffer[0], 0x55);
+}
+
+/* A message bigger than the buffer, or without one, is refused with an overflow flow control */
+static void test_overflow(void)
+{
+    static const uint8_t first[8] = { 0x10, 0x40, 1, 2, 3, 4, 5, 6 };
+    sim_frame_t frame;
+    uint32_t length;
+
+    flush();
+
+    tester_send(first, 8);
+    CHECK_EQ(tester_receive(&frame), Success);
+    CHECK_EQ(get_byte(&frame, 0), 0x32);
+    CHECK_EQ(isotp_receive_result(session, &length), Isotp_idle);
+
+    CHECK_EQ(isotp_receive(session, buffer, 0x3F), Success);
+    tester_send(first, 8);
+    CHECK_EQ(tester_receive(&frame), Success);
+    CHECK_EQ(get_byte(&frame, 0), 0x32);
+    CHECK_EQ(isotp_receive_result(session, &length), Isotp_idle);
+
+    /* A single frame has no flow control to refuse it, the result reports the overflow */
+    static const uint8_t single[8] = { 0x05, 1, 2, 3, 4, 5, 0, 0 };
+
+    CHECK_EQ(isotp_receive(session, buffer, 4), Success);
+    tester_send(single, 8);
+    CHECK_EQ(receive_finished(&length), Isotp_overflow);
+    CHECK_EQ(length, 0);
+    CHECK_EQ(isotp_receive_result(session, &length), Isotp_idle);
+
+    /* The sender side gives up on an overflow flow control */
+    fill(100, 9);
+    CHECK_EQ(isotp_send(session, message, 100), Success);
+    CHECK_EQ(tester_receive(&frame), Success);
+    tester_flow(2, 0, 0);
+    CHECK_EQ(send_finished(), Isotp_overflow);
+    CHECK_EQ(sim_node_receive(tester, &frame), Failure);
+}
+
+/* A consecutive frame out of order ends the reception */
+static void test_sequence(void)
+{
+    static const uint8_t first[8] = { 0x10, 0x20, 1, 2, 3, 4, 5, 6 };
+    static const uint8_t wrong[8] = { 0x22, 1, 2, 3, 4, 5, 6, 7 };
+    sim_frame_t frame;
+    uint32_t length;
+
+    flush();
+    CHECK_EQ(isotp_receive(session, buffer, sizeof(buffer)), Success);
+
+    tester_send(first, 8);
+    CHECK_EQ(tester_receive(&frame), Success);
+    tester_send(wrong, 8);
+    CHECK_EQ(receive_finished(&length), Isotp_sequence);
+    CHECK_EQ(length, 6);
+}
+
+/* Peers that stop answering, or keep asking to wait */
+static void test_timeouts(void)
+{
+    static const uint8_t first[8] = { 0x10, 0x20, 1, 2, 3, 4, 5, 6 };
+    sim_frame_t frame;
+    uint32_t length;
+
+    /* No flow control */
+    flush();
+    fill(100, 2);
+    CHECK_EQ(isotp_send(session, message, 100), Success);
+    CHECK_EQ(tester_receive(&frame), Success);
+    run((ISOTP_TIMEOUT_MS - 50u) * MS_NS);
+    CHECK_EQ(isotp_send_result(session), Isotp_busy);
+    run(100u * MS_NS);
+    CHECK_EQ(isotp_send_result(session), Isotp_timeout);
+
+    /* No consecutive frame */
+    flush();
+    CHECK_EQ(isotp_receive(session, buffer, sizeof(buffer)), Success);
+    tester_send(first, 8);
+    CHECK_EQ(tester_receive(&frame), Success);
+    run((ISOTP_TIMEOUT_MS + 50u) * MS_NS);
+    CHECK_EQ(isotp_receive_result(session, &length), Isotp_timeout);
+
+    /* Each wait restarts the timeout, one more than ISOTP_WFT_MAX gives up */
+    flush();
+    CHECK_EQ(isotp_send(session, message, 100), Success);
+    CHECK_EQ(tester_receive(&frame), Success);
+    for(uint32_t i = 0; i < ISOTP_WFT_MAX; i++)
+    {
+        tester_flow(1, 0, 0);
+        run(2u * MS_NS);
+        CHECK_EQ(isotp_send_result(session), Isotp_busy);
+    }
+    tester_flow(1, 0, 0);
+    CHECK_EQ(send_finished(), Isotp_aborted);
+    CHECK_EQ(sim_node_receive(tester, &frame), Failure);
+}
+
+/* Parameters checked on opening, and a limited number of sessions */
+static void test_open(void)
+{
+    isotp_config_t config = { .can = FlexCAN_0, .tx_ID = 0x7E9, .rx_ID = 0x7E1 };
+    uint8_t other;
+    uint32_t length = 1;
+
+    config.st_min = 0x80;
+    CHECK_EQ(isotp_open(&config, &other), Failure);
+    config.st_min = 0xFA;
+    CHECK_EQ(isotp_open(&config, &other), Failure);
+    config.st_min = 0xF1;
+
+    for(uint32_t i = 1; i < ISOTP_SESSIONS; i++)
+    {
+        CHECK_EQ(isotp_open(&config, &other), Success);
+        CHECK(other != session);
+    }
+    CHECK_EQ(isotp_open(&config, &other), BufferFull);
+    CHECK_EQ(isotp_send(ISOTP_SESSIONS, message, 1), Failure);
+    CHECK_EQ(isotp_receive(ISOTP_SESSIONS, buffer, 1), Failure);
+    CHECK_EQ(isotp_send_result(ISOTP_SESSIONS), Isotp_idle);
+    CHECK_EQ(isotp_receive_result(ISOTP_SESSIONS, &length), Isotp_idle);
+    CHECK_EQ(length, 0);
+}
+
+int main(void)
+{
+    isotp_config_t config = { .can = FlexCAN_0, .tx_ID = ECU_ID, .rx_ID = TESTER_ID, .block_size = BLOCK_SIZE };
+
+    if( sim_init(0) != Success )
+    {
+        printf("sim_init failed\n");
+        return 1;
+    }
+
+    sim_bus_t* bus = sim_bus_create(BITRATE);
+    sim_attach(FlexCAN_0, bus);
+    tester = sim_node_create(bus);
+
+    if( (FlexCAN_init_RXFIFO(FlexCAN_0) != Success) || (install_ID(FlexCAN_0, TESTER_ID) != Success) ||
+        (isotp_open(&config, &session) != Success) )
+    {
+        printf("FlexCAN_init_RXFIFO failed\n");
+        return 1;
+    }
+
+    RUN(test_single_frame);
+    RUN(test_send);
+    RUN(test_receive);
+    RUN(test_first_frame_length);
+    RUN(test_overflow);
+    RUN(test_sequence);
+    RUN(test_timeouts);
+    RUN(test_open);
+
+    return TEST_RESULT();
+}
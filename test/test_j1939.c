@@ -0,0 +1,532 @@
+/**
+ * Source file
+ */
+
+#include "test.h"
+#include "CAN_sim.h"
+#include <FlexCAN/include/CAN_j1939.h>
+#include <string.h>
+
+#define BITRATE             (500000u)
+#define MS_NS               (1000000u)
+
+/* The node under test and a peer on the bus, its NAME has no arbitrary address capability */
+#define NODE_NAME           (0x00A0000012345678ull)
+#define NODE_ADDRESS        (0x80u)
+#define PEER_ADDRESS        (0x20u)
+
+/* PGNs of the network and transport layers, and some application ones */
+#define PGN_REQUEST         (0x0EA00u)
+#define PGN_ADDRESS_CLAIMED (0x0EE00u)
+#define PGN_TP_CM           (0x0EC00u)
+#define PGN_TP_DT           (0x0EB00u)
+#define PGN_PROPRIETARY_A   (0x0EF00u)
+#define PGN_CCVS            (0x0FEF1u)
+#define PGN_ENGINE_HOURS    (0x0FEE5u)
+#define PGN_DM1             (0x0FECAu)
+
+#define TP_RTS              (16u)
+#define TP_CTS              (17u)
+#define TP_EOMA             (19u)
+#define TP_BAM              (32u)
+#define TP_ABORT            (255u)
+
+static sim_node_t* peer;
+
+/* Last message the handlers got */
+static uint32_t handled;
+static uint32_t handled_pgn;
+static uint8_t handled_source;
+static uint8_t handled_data[J1939_MAX_MESSAGE];
+static uint16_t handled_length;
+
+static uint8_t message[J1939_MAX_MESSAGE + 100u];
+
+static void handler(uint32_t pgn, uint8_t source, const uint8_t* data, uint16_t length)
+{
+    handled++;
+    handled_pgn = pgn;
+    handled_source = source;
+    handled_length = length;
+    memcpy(handled_data, data, length);
+}
+
+/* Byte of a simulated frame, laid out as frame_t */
+static uint8_t get_byte(const sim_frame_t* frame, uint32_t i)
+{
+    return (uint8_t)(frame->payload[i >> 2] >> (24u - ((i & 3u) * 8u)));
+}
+
+/* 29-bit ID of a PGN, the destination going in the PDU specific byte of PDU1 PGNs */
+static uint32_t j1939_id(uint8_t priority, uint32_t pgn, uint8_t destination, uint8_t source)
+{
+    uint32_t pdu = (((pgn >> 8) & 0xFFu) < 240u) ? (pgn | destination) : pgn;
+
+    return CAN_ID_EXT | ((uint32_t)priority << 26) | (pdu << 8) | source;
+}
+
+/* Let the bus and the node run, as the main loop would */
+static void run(uint64_t ns)
+{
+    uint64_t until = sim_now() + ns;
+
+    do
+    {
+        (void)j1939_poll();
+        sim_run(100000);
+    } while( sim_now() < until );
+}
+
+static uint64_t peer_sent(void)
+{
+    sim_node_stats_t stats;
+
+    sim_get_node_stats(peer, &stats, 0);
+
+    return stats.sent;
+}
+
+/* Frame of the peer, bytes past count are padded, returns once it was on the bus */
+static void peer_send(uint32_t id, const uint8_t* bytes, uint32_t count)
+{
+    sim_frame_t frame = { .ID = id, .dlc = 8 };
+    uint64_t target = peer_sent() + 1u;
+    uint64_t until = sim_now() + (50u * MS_NS);
+
+    for(uint32_t i = 0; i < 8u; i++)
+    {
+        uint8_t value = (i < count) ? bytes[i] : 0xFFu;
+
+        frame.payload[i >> 2] |= (uint32_t)value << (24u - ((i & 3u) * 8u));
+    }
+
+    CHECK_EQ(sim_node_send(peer, &frame), Success);
+
+    while( (peer_sent() < target) && (sim_now() < until) )
+    {
+        (void)j1939_poll();
+        sim_run(100000);
+    }
+    CHECK_EQ(peer_sent(), target);
+}
+
+/* Connection management message from the peer to the node */
+static void peer_cm(uint8_t destination, uint8_t control, uint8_t b1, uint8_t b2, uint8_t b3, uint8_t b4, uint32_t pgn)
+{
+    uint8_t bytes[8] = { control, b1, b2, b3, b4, (uint8_t)pgn, (uint8_t)(pgn >> 8), (uint8_t)(pgn >> 16) };
+
+    peer_send(j1939_id(7, PGN_TP_CM, destination, PEER_ADDRESS), bytes, 8);
+}
+
+/* Wait for the next frame the node sends, at most timeout_ns */
+static status_t peer_receive(sim_frame_t* frame, uint64_t timeout_ns)
+{
+    uint64_t until = sim_now() + timeout_ns;
+
+    while( sim_node_receive(peer, frame) != Success )
+    {
+        if( sim_now() >= until )
+        {
+            return Failure;
+        }
+
+        (void)j1939_poll();
+        sim_run(100000);
+    }
+
+    CHECK_EQ(frame->dlc, 8);
+
+    return Success;
+}
+
+/* Wait for a connection management message of the node, check its ID and control byte */
+static void expect_cm(uint8_t destination, uint8_t control, sim_frame_t* frame)
+{
+    CHECK_EQ(peer_receive(frame, 200u * MS_NS), Success);
+    CHECK_EQ(frame->ID, j1939_id(7, PGN_TP_CM, destination, NODE_ADDRESS));
+    CHECK_EQ(get_byte(frame, 0), control);
+}
+
+/* Wait for the handlers to be called count times in all */
+static void wait_handled(uint32_t count)
+{
+    uint64_t until = sim_now() + (50u * MS_NS);
+
+    while( (handled < count) && (sim_now() < until) )
+    {
+        run(100000);
+    }
+
+    CHECK_EQ(handled, count);
+}
+
+static void flush(void)
+{
+    sim_frame_t frame;
+
+    run(2u * MS_NS);
+    while( sim_node_receive(peer, &frame) == Success );
+}
+
+static void fill(uint32_t length, uint8_t seed)
+{
+    for(uint32_t i = 0; i < length; i++)
+    {
+        message[i] = (uint8_t)((i * 13u) + seed);
+    }
+}
+
+/* The NAME goes out little endian from the preferred address, which is taken once nobody contends */
+static void test_claim(void)
+{
+    sim_frame_t frame;
+
+    CHECK_EQ(j1939_init(FlexCAN_0, NODE_NAME, J1939_NULL_ADDRESS), Failure);
+    CHECK_EQ(j1939_init(FlexCAN_0, NODE_NAME, NODE_ADDRESS), Success);
+    CHECK_EQ(j1939_address(), J1939_NULL_ADDRESS);
+    CHECK_EQ(j1939_send(PGN_CCVS, 6, J1939_GLOBAL_ADDRESS, message, 8, 0), Failure);
+
+    CHECK_EQ(peer_receive(&frame, 50u * MS_NS), Success);
+    CHECK_EQ(frame.ID, j1939_id(6, PGN_ADDRESS_CLAIMED, J1939_GLOBAL_ADDRESS, NODE_ADDRESS));
+    for(uint32_t i = 0; i < 8u; i++)
+    {
+        CHECK_EQ(get_byte(&frame, i), (uint8_t)(NODE_NAME >> (8u * i)));
+    }
+
+    run(200u * MS_NS);
+    CHECK_EQ(j1939_address(), J1939_NULL_ADDRESS);
+    run(100u * MS_NS);
+    CHECK_EQ(j1939_address(), NODE_ADDRESS);
+
+    /* A request for the address claimed is answered with the claim */
+    uint8_t request[3] = { 0x00, 0xEE, 0x00 };
+    peer_send(j1939_id(6, PGN_REQUEST, J1939_GLOBAL_ADDRESS, PEER_ADDRESS), request, 3);
+    CHECK_EQ(peer_receive(&frame, 50u * MS_NS), Success);
+    CHECK_EQ(frame.ID, j1939_id(6, PGN_ADDRESS_CLAIMED, J1939_GLOBAL_ADDRESS, NODE_ADDRESS));
+
+    /* A contender with a higher NAME loses, the node claims again and keeps its address */
+    uint8_t higher[8] = { 0, 0, 0, 0, 0, 0, 0, 0xFF };
+    peer_send(j1939_id(6, PGN_ADDRESS_CLAIMED, J1939_GLOBAL_ADDRESS, NODE_ADDRESS), higher, 8);
+    CHECK_EQ(peer_receive(&frame, 50u * MS_NS), Success);
+    CHECK_EQ(frame.ID, j1939_id(6, PGN_ADDRESS_CLAIMED, J1939_GLOBAL_ADDRESS, NODE_ADDRESS));
+    CHECK_EQ(j1939_address(), NODE_ADDRESS);
+}
+
+/* Messages up to 8 bytes are one frame each way, the handler is found by PGN */
+static void test_single_frame(void)
+{
+    static const uint32_t pgns[] = { PGN_ENGINE_HOURS, PGN_CCVS, PGN_PROPRIETARY_A, PGN_DM1 };
+    sim_frame_t frame;
+    uint8_t bytes[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+
+    flush();
+    fill(8, 1);
+
+    /* Registered out of order, the table keeps them sorted */
+    for(uint32_t i = 0; i < 4u; i++)
+    {
+        CHECK_EQ(j1939_register(pgns[i], handler), Success);
+    }
+    CHECK_EQ(j1939_register(PGN_CCVS, handler), Success);
+    CHECK_EQ(j1939_register(PGN_CCVS, 0), Failure);
+
+    CHECK_EQ(j1939_send(PGN_CCVS, 8, J1939_GLOBAL_ADDRESS, message, 8, 0), Failure);
+    CHECK_EQ(j1939_send(PGN_CCVS, 6, PEER_ADDRESS, message, 8, 0), Success);
+    CHECK_EQ(peer_receive(&frame, 50u * MS_NS), Success);
+    CHECK_EQ(frame.ID, 0x18FEF180u | CAN_ID_EXT);
+    for(uint32_t i = 0; i < 8u; i++)
+    {
+        CHECK_EQ(get_byte(&frame, i), message[i]);
+    }
+
+    /* PDU1 carries the destination, short messages are padded */
+    CHECK_EQ(j1939_send(PGN_PROPRIETARY_A, 3, PEER_ADDRESS, message, 3, 0), Success);
+    CHECK_EQ(peer_receive(&frame, 50u * MS_NS), Success);
+    CHECK_EQ(frame.ID, 0x0CEF2080u | CAN_ID_EXT);
+    CHECK_EQ(get_byte(&frame, 2), message[2]);
+    CHECK_EQ(get_byte(&frame, 3), 0xFF);
+
+    uint32_t before = handled;
+
+    peer_send(j1939_id(6, PGN_CCVS, J1939_GLOBAL_ADDRESS, PEER_ADDRESS), bytes, 8);
+    wait_handled(before + 1u);
+    CHECK_EQ(handled_pgn, PGN_CCVS);
+    CHECK_EQ(handled_source, PEER_ADDRESS);
+    CHECK_EQ(handled_length, 8);
+    CHECK_EQ(handled_data[7], 8);
+
+    peer_send(j1939_id(6, PGN_PROPRIETARY_A, NODE_ADDRESS, PEER_ADDRESS), bytes, 8);
+    wait_handled(before + 2u);
+    CHECK_EQ(handled_pgn, PGN_PROPRIETARY_A);
+
+    /* Addressed to another node, or without a handler */
+    peer_send(j1939_id(6, PGN_PROPRIETARY_A, 0x30, PEER_ADDRESS), bytes, 8);
+    peer_send(j1939_id(6, 0x0FF00u, J1939_GLOBAL_ADDRESS, PEER_ADDRESS), bytes, 8);
+    run(5u * MS_NS);
+    CHECK_EQ(handled, before + 2u);
+}
+
+/* A broadcast goes out as BAM then its packets, J1939_BAM_GAP_MS apart */
+static void test_bam_send(void)
+{
+    sim_frame_t frame;
+    uint8_t session;
+    uint64_t announced;
+
+    flush();
+    fill(20, 2);
+
+    CHECK_EQ(j1939_send(PGN_DM1, 6, PEER_ADDRESS, message, 20, &session), Success);
+
+    expect_cm(J1939_GLOBAL_ADDRESS, TP_BAM, &frame);
+    CHECK_EQ(get_byte(&frame, 1), 20);
+    CHECK_EQ(get_byte(&frame, 2), 0);
+    CHECK_EQ(get_byte(&frame, 3), 3);
+    CHECK_EQ(get_byte(&frame, 5), 0xCA);
+    CHECK_EQ(get_byte(&frame, 6), 0xFE);
+    CHECK_EQ(get_byte(&frame, 7), 0x00);
+    announced = frame.time;
+
+    for(uint32_t p = 1; p <= 3u; p++)
+    {
+        CHECK_EQ(peer_receive(&frame, 200u * MS_NS), Success);
+        CHECK_EQ(frame.ID, j1939_id(7, PGN_TP_DT, J1939_GLOBAL_ADDRESS, NODE_ADDRESS));
+        CHECK_EQ(get_byte(&frame, 0), p);
+        /* Each one queued the gap after the previous one, less how late the BAM went out */
+        CHECK((frame.time - announced) + (2u * MS_NS) >= ((uint64_t)p * J1939_BAM_GAP_MS * MS_NS));
+
+        for(uint32_t i = 1; i < 8u; i++)
+        {
+            uint32_t offset = ((p - 1u) * 7u) + i - 1u;
+
+            CHECK_EQ(get_byte(&frame, i), (offset < 20u) ? message[offset] : 0xFFu);
+        }
+    }
+
+    run(2u * MS_NS);
+    CHECK_EQ(j1939_send_result(session), J1939_done);
+    CHECK_EQ(j1939_send_result(session), J1939_idle);
+}
+
+/* A broadcast is reassembled without any answer from the node */
+static void test_bam_receive(void)
+{
+    sim_frame_t frame;
+    uint8_t bytes[8];
+    uint32_t before = handled;
+
+    flush();
+    fill(30, 3);
+
+    peer_cm(J1939_GLOBAL_ADDRESS, TP_BAM, 30, 0, 5, 0xFF, PGN_DM1);
+    for(uint32_t p = 1; p <= 5u; p++)
+    {
+        bytes[0] = (uint8_t)p;
+        for(uint32_t i = 1; i < 8u; i++)
+        {
+            uint32_t offset = ((p - 1u) * 7u) + i - 1u;
+
+            bytes[i] = (offset < 30u) ? message[offset] : 0xFFu;
+        }
+        peer_send(j1939_id(7, PGN_TP_DT, J1939_GLOBAL_ADDRESS, PEER_ADDRESS), bytes, 8);
+    }
+
+    wait_handled(before + 1u);
+    CHECK_EQ(handled_pgn, PGN_DM1);
+    CHECK_EQ(handled_source, PEER_ADDRESS);
+    CHECK_EQ(handled_length, 30);
+    CHECK(memcmp(handled_data, message, 30) == 0);
+    CHECK_EQ(sim_node_receive(peer, &frame), Failure);
+}
+
+/* Packets go out in the windows the receiver's clear to send messages open */
+static void test_rts_send(void)
+{
+    sim_frame_t frame;
+    uint8_t session;
+    uint8_t other;
+
+    flush();
+    fill(40, 4);
+
+    CHECK_EQ(j1939_send(PGN_PROPRIETARY_A, 6, PEER_ADDRESS, message, 40, &session), Success);
+    CHECK_EQ(j1939_send(PGN_PROPRIETARY_A, 6, PEER_ADDRESS, message, 40, &other), BufferFull);
+
+    expect_cm(PEER_ADDRESS, TP_RTS, &frame);
+    CHECK_EQ(get_byte(&frame, 1), 40);
+    CHECK_EQ(get_byte(&frame, 3), 6);
+    CHECK_EQ(get_byte(&frame, 6), 0xEF);
+
+    /* Hold the connection open: nothing sent */
+    peer_cm(NODE_ADDRESS, TP_CTS, 0, 1, 0xFF, 0xFF, PGN_PROPRIETARY_A);
+    run(5u * MS_NS);
+    CHECK_EQ(sim_node_receive(peer, &frame), Failure);
+
+    /* Two windows, the second one asking again for a packet of the first */
+    static const uint8_t windows[][2] = { { 3, 1 }, { 4, 3 } };
+    for(uint32_t w = 0; w < 2u; w++)
+    {
+        peer_cm(NODE_ADDRESS, TP_CTS, windows[w][0], windows[w][1], 0xFF, 0xFF, PGN_PROPRIETARY_A);
+
+        for(uint32_t p = windows[w][1]; p < (uint32_t)(windows[w][1] + windows[w][0]); p++)
+        {
+            CHECK_EQ(peer_receive(&frame, 50u * MS_NS), Success);
+            CHECK_EQ(frame.ID, j1939_id(7, PGN_TP_DT, PEER_ADDRESS, NODE_ADDRESS));
+            CHECK_EQ(get_byte(&frame, 0), p);
+            CHECK_EQ(get_byte(&frame, 1), message[(p - 1u) * 7u]);
+        }
+
+        run(5u * MS_NS);
+        CHECK_EQ(sim_node_receive(peer, &frame), Failure);
+        CHECK_EQ(j1939_send_result(session), J1939_busy);
+    }
+
+    peer_cm(NODE_ADDRESS, TP_EOMA, 40, 0, 6, 0xFF, PGN_PROPRIETARY_A);
+    run(2u * MS_NS);
+    CHECK_EQ(j1939_send_result(session), J1939_done);
+
+    /* The receiver gives up */
+    CHECK_EQ(j1939_send(PGN_PROPRIETARY_A, 6, PEER_ADDRESS, message, 40, &session), Success);
+    expect_cm(PEER_ADDRESS, TP_RTS, &frame);
+    peer_cm(NODE_ADDRESS, TP_ABORT, 1, 0xFF, 0xFF, 0xFF, PGN_PROPRIETARY_A);
+    run(2u * MS_NS);
+    CHECK_EQ(j1939_send_result(session), J1939_aborted);
+}
+
+/* Send the packets first to last of the message from the peer */
+static void peer_packets(uint32_t first, uint32_t last, uint32_t length)
+{
+    uint8_t bytes[8];
+
+    for(uint32_t p = first; p <= last; p++)
+    {
+        bytes[0] = (uint8_t)p;
+        for(uint32_t i = 1; i < 8u; i++)
+        {
+            uint32_t offset = ((p - 1u) * 7u) + i - 1u;
+
+            bytes[i] = (offset < length) ? message[offset] : 0xFFu;
+        }
+        peer_send(j1939_id(7, PGN_TP_DT, NODE_ADDRESS, PEER_ADDRESS), bytes, 8);
+    }
+}
+
+/* The node opens windows of J1939_CTS_PACKETS, asks again after a lost packet and acknowledges */
+static void test_rts_receive(void)
+{
+    sim_frame_t frame;
+    uint32_t before = handled;
+    uint32_t length = 200;
+    uint32_t packets = 29;
+
+    flush();
+    fill(length, 5);
+
+    peer_cm(NODE_ADDRESS, TP_RTS, (uint8_t)length, 0, (uint8_t)packets, 0xFF, PGN_PROPRIETARY_A);
+    expect_cm(PEER_ADDRESS, TP_CTS, &frame);
+    CHECK_EQ(get_byte(&frame, 1), J1939_CTS_PACKETS);
+    CHECK_EQ(get_byte(&frame, 2), 1);
+    CHECK_EQ(get_byte(&frame, 6), 0xEF);
+
+    /* Packet 3 lost: the node asks again from it */
+    peer_packets(1, 2, length);
+    peer_packets(4, 4, length);
+    expect_cm(PEER_ADDRESS, TP_CTS, &frame);
+    CHECK_EQ(get_byte(&frame, 1), J1939_CTS_PACKETS);
+    CHECK_EQ(get_byte(&frame, 2), 3);
+
+    peer_packets(3, 18, length);
+    expect_cm(PEER_ADDRESS, TP_CTS, &frame);
+    CHECK_EQ(get_byte(&frame, 1), packets - 18u);
+    CHECK_EQ(get_byte(&frame, 2), 19);
+
+    peer_packets(19, packets, length);
+    expect_cm(PEER_ADDRESS, TP_EOMA, &frame);
+    CHECK_EQ(get_byte(&frame, 1), (uint8_t)length);
+    CHECK_EQ(get_byte(&frame, 2), 0);
+    CHECK_EQ(get_byte(&frame, 3), packets);
+
+    wait_handled(before + 1u);
+    CHECK_EQ(handled_pgn, PGN_PROPRIETARY_A);
+    CHECK_EQ(handled_length, length);
+    CHECK(memcmp(handled_data, message, length) == 0);
+
+    /* Bigger than J1939_MAX_MESSAGE: aborted for lack of resources */
+    peer_cm(NODE_ADDRESS, TP_RTS, (uint8_t)(J1939_MAX_MESSAGE + 7u), (uint8_t)((J1939_MAX_MESSAGE + 7u) >> 8),
+            (uint8_t)((J1939_MAX_MESSAGE + 13u) / 7u), 0xFF, PGN_PROPRIETARY_A);
+    expect_cm(PEER_ADDRESS, TP_ABORT, &frame);
+    CHECK_EQ(get_byte(&frame, 1), 2);
+}
+
+/* Peers that stop answering get an abort */
+static void test_timeouts(void)
+{
+    sim_frame_t frame;
+    uint8_t session;
+
+    /* No clear to send within T3 */
+    flush();
+    fill(40, 6);
+    CHECK_EQ(j1939_send(PGN_PROPRIETARY_A, 6, PEER_ADDRESS, message, 40, &session), Success);
+    expect_cm(PEER_ADDRESS, TP_RTS, &frame);
+    run(1200u * MS_NS);
+    CHECK_EQ(j1939_send_result(session), J1939_busy);
+    expect_cm(PEER_ADDRESS, TP_ABORT, &frame);
+    CHECK_EQ(get_byte(&frame, 1), 3);
+    CHECK_EQ(j1939_send_result(session), J1939_timeout);
+
+    /* No packet within T2 after the clear to send */
+    peer_cm(NODE_ADDRESS, TP_RTS, 20, 0, 3, 0xFF, PGN_PROPRIETARY_A);
+    expect_cm(PEER_ADDRESS, TP_CTS, &frame);
+    CHECK_EQ(peer_receive(&frame, 1200u * MS_NS), Failure);
+    expect_cm(PEER_ADDRESS, TP_ABORT, &frame);
+    CHECK_EQ(get_byte(&frame, 1), 3);
+}
+
+/* A lower NAME takes the address, a node without the arbitrary address capability gives up */
+static void test_claim_lost(void)
+{
+    uint8_t lower[8] = { 0 };
+    sim_frame_t frame;
+
+    flush();
+
+    peer_send(j1939_id(6, PGN_ADDRESS_CLAIMED, J1939_GLOBAL_ADDRESS, NODE_ADDRESS), lower, 8);
+    CHECK_EQ(peer_receive(&frame, 50u * MS_NS), Success);
+    CHECK_EQ(frame.ID, j1939_id(6, PGN_ADDRESS_CLAIMED, J1939_GLOBAL_ADDRESS, J1939_NULL_ADDRESS));
+    CHECK_EQ(j1939_address(), J1939_NULL_ADDRESS);
+    CHECK_EQ(j1939_send(PGN_CCVS, 6, J1939_GLOBAL_ADDRESS, message, 8, 0), Failure);
+}
+
+int main(void)
+{
+    /* Every extended ID, the node sorts them out */
+    filter_t all = { .ID = 0, .mask = 0, .extended = 1 };
+
+    if( sim_init(0) != Success )
+    {
+        printf("sim_init failed\n");
+        return 1;
+    }
+
+    sim_bus_t* bus = sim_bus_create(BITRATE);
+    sim_attach(FlexCAN_0, bus);
+    peer = sim_node_create(bus);
+
+    if( (FlexCAN_init_RXFIFO(FlexCAN_0) != Success) || (install_filters(FlexCAN_0, &all, 1, 0) != Success) )
+    {
+        printf("FlexCAN_init_RXFIFO failed\n");
+        return 1;
+    }
+
+    RUN(test_claim);
+    RUN(test_single_frame);
+    RUN(test_bam_send);
+    RUN(test_bam_receive);
+    RUN(test_rts_send);
+    RUN(test_rts_receive);
+    RUN(test_timeouts);
+    RUN(test_claim_lost);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,236 @@
+/**
+ * Source file
+ */
+
+#include "test.h"
+#include "CAN_sim.h"
+#include <FlexCAN/include/CAN_internal.h>
+
+#define BITRATE             (500000u)
+#define BIT_NS              (1000000000u / BITRATE)
+
+/* Longest classical frame with 8 data bytes, stuff bits included */
+#define FRAME_BITS_MAX      (135u)
+
+#define RX_ID               (0x123u)
+
+/* IFLAG1 bit of the RX FIFO overflow */
+#define BUF7I               (1u << 7)
+
+static sim_node_t* node;
+
+static void flush(void)
+{
+    frame_t frame;
+
+    while( receive_frame(FlexCAN_0, &frame) == Success );
+}
+
+/* Run the generator to its end without touching the ring, return the frames it sent */
+static uint32_t generate(uint32_t count, uint32_t period_bits, uint32_t first)
+{
+    sim_frame_t frame = { .ID = RX_ID, .dlc = 8, .payload = { first, 0 } };
+    sim_node_stats_t stats;
+    uint64_t target;
+
+    sim_get_node_stats(node, &stats, 0);
+    target = stats.sent + count;
+
+    sim_node_generate(node, &frame, (uint64_t)period_bits * BIT_NS, count);
+
+    uint64_t deadline = sim_now() + ((uint64_t)count * period_bits * BIT_NS * 2u) + 10000000u;
+    do
+    {
+        sim_run(100000);
+        sim_get_node_stats(node, &stats, 0);
+    } while( (stats.sent < target) && (sim_now() < deadline) );
+
+    sim_run(1000000);
+
+    return (uint32_t)(stats.sent - (target - count));
+}
+
+/* The interrupt drains the FIFO while the main loop doesn't poll at all, only the ring fills up */
+static void test_drain_without_polling(void)
+{
+    rx_stats_t before, after;
+    frame_t frame;
+    uint32_t count = RX_RING_SIZE + 40u;
+
+    flush();
+    get_rx_stats(FlexCAN_0, &before);
+
+    CHECK_EQ(generate(count, FRAME_BITS_MAX, 0), count);
+
+    get_rx_stats(FlexCAN_0, &after);
+    CHECK_EQ(after.fifo_overflows - before.fifo_overflows, 0);
+    CHECK_EQ(after.received - before.received, RX_RING_SIZE);
+    CHECK_EQ(after.ring_overruns - before.ring_overruns, count - RX_RING_SIZE);
+
+    /* The oldest frames were kept, in order */
+    for(uint32_t i = 0; i < RX_RING_SIZE; i++)
+    {
+        CHECK_EQ(receive_frame(FlexCAN_0, &frame), Success);
+        CHECK_EQ(frame.ID, RX_ID);
+        CHECK_EQ(frame.payload[0], i);
+    }
+    CHECK_EQ(receive_frame(FlexCAN_0, &frame), Failure);
+}
+
+/* Back-to-back and slower frames with the main loop polling in between: nothing is lost */
+static void test_rates(void)
+{
+    static const uint32_t periods[] = { FRAME_BITS_MAX, 2u * FRAME_BITS_MAX, 10u * FRAME_BITS_MAX };
+    static const uint32_t polls_ns[] = { 50000u, 1000000u, 5000000u };
+
+    for(uint32_t p = 0; p < (sizeof(periods) / sizeof(periods[0])); p++)
+    {
+        sim_frame_t first = { .ID = RX_ID, .dlc = 8 };
+        rx_stats_t before, after;
+        frame_t frame;
+        uint32_t count = 200u;
+        uint32_t expected = 0;
+        uint64_t last = 0;
+
+        flush();
+        get_rx_stats(FlexCAN_0, &before);
+
+        /* Poll often enough for the ring to hold what arrives in between */
+        uint32_t poll_ns = polls_ns[p];
+        CHECK(((uint64_t)poll_ns / (periods[p] * BIT_NS)) < RX_RING_SIZE);
+
+        sim_node_generate(node, &first, (uint64_t)periods[p] * BIT_NS, count);
+
+        uint64_t deadline = sim_now() + ((uint64_t)count * periods[p] * BIT_NS * 2u) + 10000000u;
+        while( (expected < count) && (sim_now() < deadline) )
+        {
+            while( receive_frame(FlexCAN_0, &frame) == Success )
+            {
+                CHECK_EQ(frame.payload[0], expected);
+                CHECK(frame.timestamp > last);
+                last = frame.timestamp;
+                expected = frame.payload[0] + 1u;
+            }
+            sim_run(poll_ns);
+        }
+
+        CHECK_EQ(expected, count);
+        get_rx_stats(FlexCAN_0, &after);
+        CHECK_EQ(after.dropped - before.dropped, 0);
+        CHECK_EQ(after.received - before.received, count);
+    }
+}
+
+/* Frames lent in place come as one span up to the end of the ring, then the rest after the release */
+static void test_lend(void)
+{
+    frame_t* frames;
+    frame_t* frame;
+    uint32_t taken = 0;
+
+    flush();
+
+    /* Move the ring indexes off a multiple of the size so the span wraps around */
+    CHECK_EQ(generate(3, FRAME_BITS_MAX, 0), 3);
+    flush();
+
+    CHECK_EQ(generate(RX_RING_SIZE, FRAME_BITS_MAX, 100), RX_RING_SIZE);
+
+    uint32_t n = lend_frames(FlexCAN_0, &frames);
+    CHECK(n > 0u);
+    CHECK(n < RX_RING_SIZE);
+    for(uint32_t i = 0; i < n; i++)
+    {
+        CHECK_EQ(frames[i].payload[0], 100u + i);
+    }
+    taken += n;
+
+    /* Still lent: the ring is full, a new frame is dropped rather than overwriting the span */
+    rx_stats_t before, after;
+    get_rx_stats(FlexCAN_0, &before);
+    CHECK_EQ(generate(1, FRAME_BITS_MAX, 999), 1);
+    get_rx_stats(FlexCAN_0, &after);
+    CHECK_EQ(after.ring_overruns - before.ring_overruns, 1);
+    CHECK_EQ(frames[0].payload[0], 100);
+
+    release_frames(FlexCAN_0, n);
+
+    n = lend_frames(FlexCAN_0, &frames);
+    CHECK_EQ(n, RX_RING_SIZE - taken);
+    for(uint32_t i = 0; i < n; i++)
+    {
+        CHECK_EQ(frames[i].payload[0], 100u + taken + i);
+    }
+    release_frames(FlexCAN_0, n);
+
+    CHECK_EQ(lend_frame(FlexCAN_0, &frame), Failure);
+}
+
+/* Frames lost at the ring and at the RX FIFO behind it: each overrun counts once, an overflow once
+ * however many frames the FIFO missed, and dropped adds them up */
+static void test_overflow_accounting(void)
+{
+    rx_stats_t before, after;
+    frame_t frame;
+
+    flush();
+    get_rx_stats(FlexCAN_0, &before);
+
+    /* The ring fills up, the last 5 frames find it full */
+    CHECK_EQ(generate(RX_RING_SIZE + 5u, FRAME_BITS_MAX, 0), RX_RING_SIZE + 5u);
+
+    /* With the interrupt held off the 6 entries of the FIFO fill up and the last 3 frames are lost */
+    CRITICAL_ENTER();
+    CHECK_EQ(generate(9, FRAME_BITS_MAX, 100), 9);
+    CHECK(CAN0->CAN0_IFLAG1 & BUF7I);
+    CRITICAL_EXIT();
+
+    /* The interrupt counts the overflow, the 6 frames it drains find the ring still full */
+    sim_run(1000000);
+
+    get_rx_stats(FlexCAN_0, &after);
+    CHECK_EQ(after.fifo_overflows - before.fifo_overflows, 1);
+    CHECK_EQ(after.ring_overruns - before.ring_overruns, 5u + 6u);
+    CHECK_EQ(after.dropped - before.dropped, 1u + 5u + 6u);
+    CHECK_EQ(after.received - before.received, RX_RING_SIZE);
+
+    /* A lower bound of the 5 + 3 + 6 frames lost */
+    CHECK((after.dropped - before.dropped) <= (5u + 3u + 6u));
+
+    for(uint32_t i = 0; i < RX_RING_SIZE; i++)
+    {
+        CHECK_EQ(receive_frame(FlexCAN_0, &frame), Success);
+        CHECK_EQ(frame.payload[0], i);
+    }
+    CHECK_EQ(receive_frame(FlexCAN_0, &frame), Failure);
+}
+
+int main(void)
+{
+    /* Saturated buses with traps of tens of microseconds: slow simulated time down so the
+     * interrupts keep up as they would on the target */
+    sim_config_t config = { .slowdown = 8, .tick_ns = 50000, .osc_hz = 8000000, .periph_hz = 48000000 };
+
+    if( sim_init(&config) != Success )
+    {
+        printf("sim_init failed\n");
+        return 1;
+    }
+
+    sim_bus_t* bus = sim_bus_create(BITRATE);
+    sim_attach(FlexCAN_0, bus);
+    node = sim_node_create(bus);
+
+    if( (FlexCAN_init_RXFIFO(FlexCAN_0) != Success) || (install_ID(FlexCAN_0, RX_ID) != Success) )
+    {
+        printf("FlexCAN_init_RXFIFO failed\n");
+        return 1;
+    }
+
+    RUN(test_drain_without_polling);
+    RUN(test_rates);
+    RUN(test_lend);
+    RUN(test_overflow_accounting);
+
+    return TEST_RESULT();
+}
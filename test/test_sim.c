@@ -0,0 +1,732 @@
+/**
+ * Source file
+ */
+
+#include "test.h"
+#include "CAN_sim.h"
+#include <FlexCAN/include/CAN_internal.h>
+
+#define BITRATE             (500000u)
+#define BIT_NS              (1000000000u / BITRATE)
+
+/* IFLAG1 bits of the RX FIFO, ESR1 status bits and the message buffer CODE values checked */
+#define BUF5I               (1u << 5)
+#define BUF6I               (1u << 6)
+#define BUF7I               (1u << 7)
+#define ESR1_IDLE           (1u << 7)
+#define ESR1_SYNCH          (1u << 18)
+#define CODE_RX_FULL        (0x2u)
+#define CODE_RX_OVERRUN     (0x6u)
+#define CODE_TX_DATA        (0xCu)
+
+/* Transmission message buffers of FlexCAN1 as Classic_MessageBuffer indexes, and their IFLAG1 bits */
+#define CAN1_TX_MB_FIRST    (4u)
+#define CAN1_TX_MB_COUNT    (4u)
+#define CAN1_TX_IFLAGS      (0xFu << 12)
+
+/* Frames of lower IDs than the ones FlexCAN1 queues, holding the bus for 4 ms */
+#define BLOCKERS            (16u)
+
+/* Hot message buffer of slot 0 as a Classic_MessageBuffer index, below the transmission ones */
+#define HOT_MB              (16u - HOT_MB_COUNT)
+
+/* Let simulated time pass until a condition holds, at most timeout_ns */
+#define WAIT_UNTIL(cond, timeout_ns) \
+    do { \
+        uint64_t wait_until = sim_now() + (timeout_ns); \
+        while( !(cond) && (sim_now() < wait_until) ) \
+        { \
+            sim_run(20000); \
+        } \
+    } while(0)
+
+static sim_bus_t* bus;
+static sim_node_t* node;
+static sim_node_t* peer;
+
+static frame_t hot_frames[4];
+static volatile uint32_t hot_count = 0;
+
+static sim_frame_t std_frame(uint32_t id, uint32_t word0)
+{
+    sim_frame_t frame = { .ID = id, .dlc = 8, .payload = { word0, 0x01020304u } };
+
+    return frame;
+}
+
+static uint64_t node_sent(sim_node_t* n)
+{
+    sim_node_stats_t stats;
+
+    sim_get_node_stats(n, &stats, 0);
+
+    return stats.sent;
+}
+
+/* Send frames from the node, wait for the bus to carry them and the interrupts to serve them */
+static void send_frames(const sim_frame_t* frames, uint32_t count)
+{
+    uint64_t target = node_sent(node) + count;
+
+    for(uint32_t i = 0; i < count; i++)
+    {
+        CHECK_EQ(sim_node_send(node, &frames[i]), Success);
+    }
+
+    WAIT_UNTIL(node_sent(node) >= target, 50000000u);
+    CHECK_EQ(node_sent(node), target);
+
+    sim_run(2000000);
+}
+
+static void flush(FlexCAN_instance_t can)
+{
+    frame_t frame;
+    sim_frame_t seen;
+
+    while( receive_frame(can, &frame) == Success );
+    while( transmitted_frame(can, &frame) == Success );
+    while( sim_node_receive(peer, &seen) == Success );
+}
+
+/* CODE of the hot message buffer, reading the timer releases the lock the read takes */
+static uint32_t hot_code(void)
+{
+    uint32_t code = CAN0->Classic_MessageBuffer[HOT_MB].CODE;
+
+    (void)CAN0->CAN0_TIMER;
+
+    return code;
+}
+
+static void on_hot(const frame_t* frame)
+{
+    if( hot_count < 4u )
+    {
+        hot_frames[hot_count] = *frame;
+    }
+    hot_count = hot_count + 1u;
+}
+
+static void test_frame_bits(void)
+{
+    sim_frame_t zero = { .ID = 0, .dlc = 0 };
+    sim_frame_t full = std_frame(0x555, 0x55555555u);
+
+    /* 34 bits of zeros up to the end of the CRC, a stuff bit after every 5 of them, 13 bits of
+     * delimiters, ACK, EOF and intermission */
+    CHECK_EQ(sim_frame_bits(&zero), 34 + 6 + 13);
+
+    /* 8 data bytes: 111 bits without stuffing, at most 24 stuff bits */
+    CHECK(sim_frame_bits(&full) >= 111u);
+    CHECK(sim_frame_bits(&full) <= 135u);
+}
+
+/* The driver starts both instances through the freeze and ready handshakes */
+static void test_handshake(void)
+{
+    sim_stats_t before, after;
+
+    CHECK_EQ(FlexCAN_init_RXFIFO(FlexCAN_0), Success);
+    CHECK_EQ(FlexCAN_init_RXFIFO(FlexCAN_1), Success);
+
+    CHECK_EQ(CAN0->CAN0_MCR_b.FRZACK, 0);
+    CHECK_EQ(CAN0->CAN0_MCR_b.NOTRDY, 0);
+    CHECK_EQ(CAN0->CAN0_MCR_b.LPMACK, 0);
+    CHECK(CAN0->CAN0_ESR1 & ESR1_SYNCH);
+    CHECK(CAN1->CAN0_ESR1 & ESR1_SYNCH);
+
+    /* MAXMB is only writable in freeze mode */
+    sim_get_stats(&before, 0);
+    CAN0->CAN0_MCR_b.MAXMB = 3;
+    sim_get_stats(&after, 0);
+    CHECK_EQ(CAN0->CAN0_MCR_b.MAXMB, 31);
+    CHECK_EQ(after.ignored_writes - before.ignored_writes, 1);
+
+    /* Freeze requested during a frame is acknowledged at its end, then 11 bits resynchronize */
+    sim_frame_t frame = std_frame(0x7F0, 0);
+    sim_frame_t seen;
+
+    flush(FlexCAN_1);
+    CHECK_EQ(sim_node_send(node, &frame), Success);
+    WAIT_UNTIL(!(CAN1->CAN0_ESR1 & ESR1_IDLE), 10000000u);
+
+    CAN1->CAN0_MCR_b.HALT = 1;
+    CAN1->CAN0_MCR_b.FRZ = 1;
+    while( !CAN1->CAN0_MCR_b.FRZACK );
+    uint64_t acked = sim_now();
+
+    WAIT_UNTIL(sim_node_receive(peer, &seen) == Success, 10000000u);
+    CHECK(acked >= (seen.time + ((uint64_t)(sim_frame_bits(&frame) - 3u) * BIT_NS)));
+
+    uint64_t released = sim_now();
+    CAN1->CAN0_MCR_b.HALT = 0;
+    CAN1->CAN0_MCR_b.FRZ = 0;
+    while( CAN1->CAN0_MCR_b.NOTRDY );
+    CHECK(sim_now() >= (released + (11u * BIT_NS)));
+}
+
+/* BUF5I, BUF6I and BUF7I as the FIFO fills, and the FIFO advancing when BUF5I is cleared */
+static void test_fifo_flags(void)
+{
+    sim_frame_t frames[7];
+    rx_stats_t before, after;
+    frame_t frame;
+
+    CHECK_EQ(install_ID(FlexCAN_0, 0x123), Success);
+    flush(FlexCAN_0);
+    get_rx_stats(FlexCAN_0, &before);
+
+    for(uint32_t i = 0; i < 7u; i++)
+    {
+        frames[i] = std_frame(0x123, i);
+    }
+
+    /* Keep the driver from draining the FIFO */
+    CRITICAL_ENTER();
+
+    send_frames(frames, 7);
+
+    CHECK_EQ(CAN0->CAN0_IFLAG1 & (BUF5I | BUF6I | BUF7I), BUF5I | BUF6I | BUF7I);
+    CHECK_EQ(CAN0->CAN0_RXFIR & 0x1FFu, 0);
+    CHECK_EQ(CAN0->Classic_RX_FIFO[0].STD_ID, 0x123);
+    CHECK_EQ(CAN0->Classic_RX_FIFO[0].IDHIT, 0);
+    CHECK_EQ(CAN0->Classic_RX_FIFO[0].payload[0], 0);
+
+    /* Clearing BUF5I presents the next frame and flags it again */
+    CAN0->CAN0_IFLAG1 = BUF5I;
+    CHECK(CAN0->CAN0_IFLAG1 & BUF5I);
+    CHECK_EQ(CAN0->Classic_RX_FIFO[0].payload[0], 1);
+
+    CRITICAL_EXIT();
+    sim_run(2000000);
+
+    /* The driver drains the 5 remaining frames, the 7th was lost */
+    for(uint32_t i = 2; i < 7u; i++)
+    {
+        CHECK_EQ(receive_frame(FlexCAN_0, &frame), Success);
+        CHECK_EQ(frame.ID, 0x123);
+        CHECK_EQ(frame.payload[0], i - 1u);
+    }
+    CHECK_EQ(receive_frame(FlexCAN_0, &frame), Failure);
+
+    get_rx_stats(FlexCAN_0, &after);
+    CHECK_EQ(after.fifo_warnings - before.fifo_warnings, 1);
+    CHECK_EQ(after.fifo_overflows - before.fifo_overflows, 1);
+}
+
+/* Formats A to D of the ID filter table, with the format install_filters() picks */
+static void test_id_table(void)
+{
+    filter_t filters[50];
+    sim_frame_t frames[2];
+    frame_t frame;
+
+    /* Format A, extended ID */
+    CHECK_EQ(install_ID(FlexCAN_1, CAN_ID_EXT | 0x1ABCDEu), Success);
+    CHECK_EQ(CAN1->CAN0_MCR_b.IDAM, 0);
+    flush(FlexCAN_1);
+    frames[0] = std_frame(CAN_ID_EXT | 0x1ABCDEu, 1);
+    frames[1] = std_frame(0x0DE, 2);
+    send_frames(frames, 2);
+    CHECK_EQ(receive_frame(FlexCAN_1, &frame), Success);
+    CHECK_EQ(frame.ID, CAN_ID_EXT | 0x1ABCDEu);
+    CHECK_EQ(receive_frame(FlexCAN_1, &frame), Failure);
+
+    /* Format B, 30 standard IDs don't fit in the 24 elements of FlexCAN1 */
+    for(uint32_t i = 0; i < 30u; i++)
+    {
+        filters[i] = (filter_t){ .ID = 0x400u + i, .mask = 0x7FFu, .extended = 0 };
+    }
+    CHECK_EQ(install_filters(FlexCAN_1, filters, 30, 0), Success);
+    CHECK_EQ(CAN1->CAN0_MCR_b.IDAM, 1);
+    frames[0] = std_frame(0x600, 1);
+    frames[1] = std_frame(0x411, 2);
+    send_frames(frames, 2);
+    CHECK_EQ(receive_frame(FlexCAN_1, &frame), Success);
+    CHECK_EQ(frame.ID, 0x411);
+    CHECK_EQ(receive_frame(FlexCAN_1, &frame), Failure);
+
+    /* Format C, 50 filters on standard ID bits 10..3 */
+    for(uint32_t i = 0; i < 50u; i++)
+    {
+        filters[i] = (filter_t){ .ID = i << 3, .mask = 0x7F8u, .extended = 0 };
+    }
+    CHECK_EQ(install_filters(FlexCAN_1, filters, 50, 0), Success);
+    CHECK_EQ(CAN1->CAN0_MCR_b.IDAM, 2);
+    frames[0] = std_frame((20u << 3) | 5u, 1);
+    frames[1] = std_frame(100u << 3, 2);
+    send_frames(frames, 2);
+    CHECK_EQ(receive_frame(FlexCAN_1, &frame), Success);
+    CHECK_EQ(frame.ID, (20u << 3) | 5u);
+    CHECK_EQ(receive_frame(FlexCAN_1, &frame), Failure);
+
+    /* Format D rejects everything */
+    CHECK_EQ(install_filters(FlexCAN_1, 0, 0, 0), Success);
+    CHECK_EQ(CAN1->CAN0_MCR_b.IDAM, 3);
+    frames[0] = std_frame(0x000, 1);
+    send_frames(frames, 1);
+    CHECK_EQ(receive_frame(FlexCAN_1, &frame), Failure);
+}
+
+/* ID filter table, RFFN, individual masks and global mask install_filters() programs for each
+ * format on FlexCAN1, whose table holds at most 24 elements */
+static void test_filter_layout(void)
+{
+    volatile uint32_t* table = (volatile uint32_t*)&CAN1->ID_TABLE_RXFIFO[0];
+    volatile uint32_t* rximr = &CAN1->CAN0_RXIMR0;
+    filter_t filters[50];
+    uint16_t slots[50];
+
+    /* Format A: 3 elements in the 8 of RFFN 0, all with their own mask, the spare ones repeat the last */
+    filters[0] = (filter_t){ .ID = 0x123, .mask = 0x7FF, .extended = 0 };
+    filters[1] = (filter_t){ .ID = 0x450, .mask = 0x7F0, .extended = 0 };
+    filters[2] = (filter_t){ .ID = 0x1ABCDEF, .mask = 0x1FFFFFFF, .extended = 1 };
+    for(uint32_t n = 0; n < 50u; n++)
+    {
+        slots[n] = 0xFFFFu;
+    }
+    CHECK_EQ(install_filters(FlexCAN_1, filters, 3, slots), Success);
+    CHECK_EQ(CAN1->CAN0_MCR_b.IDAM, 0);
+    CHECK_EQ(CAN1->CAN0_CTRL2_b.RFFN, 0);
+    CHECK_EQ(table[0], 0x123u << 19);
+    CHECK_EQ(rximr[0], (1u << 30) | (0x7FFu << 19));
+    CHECK_EQ(table[1], 0x450u << 19);
+    CHECK_EQ(rximr[1], (1u << 30) | (0x7F0u << 19));
+    CHECK_EQ(table[2], (1u << 30) | (0x1ABCDEFu << 1));
+    CHECK_EQ(rximr[2], (1u << 30) | (0x1FFFFFFFu << 1));
+    for(uint32_t e = 3; e < 8u; e++)
+    {
+        CHECK_EQ(table[e], table[2]);
+        CHECK_EQ(rximr[e], rximr[2]);
+    }
+    CHECK_EQ(CAN1->CAN0_RXFGMASK, rximr[2]);
+    for(uint32_t n = 0; n < 3u; n++)
+    {
+        CHECK_EQ(slots[n], n);
+    }
+
+    /* Format A over the whole table: RFFN 2, elements 12 to 23 share the global mask, the AND of theirs */
+    for(uint32_t i = 0; i < 24u; i++)
+    {
+        filters[i] = (filter_t){ .ID = 0x100u + i, .mask = 0x7FF, .extended = 0 };
+    }
+    filters[15].mask = 0x7F0;
+    filters[20].mask = 0x70F;
+    CHECK_EQ(install_filters(FlexCAN_1, filters, 24, slots), Success);
+    CHECK_EQ(CAN1->CAN0_MCR_b.IDAM, 0);
+    CHECK_EQ(CAN1->CAN0_CTRL2_b.RFFN, 2);
+    for(uint32_t e = 0; e < 24u; e++)
+    {
+        CHECK_EQ(table[e], (0x100u + e) << 19);
+        CHECK_EQ(slots[e], e);
+    }
+    for(uint32_t e = 0; e < 12u; e++)
+    {
+        CHECK_EQ(rximr[e], (1u << 30) | (0x7FFu << 19));
+    }
+    CHECK_EQ(CAN1->CAN0_RXFGMASK, (1u << 30) | (0x700u << 19));
+
+    /* Format B: 29 filters in 15 elements of RFFN 1, the short last one repeats its first filter.
+     * An extended filter only caring about ID bits 28..15 fits too */
+    filters[0] = (filter_t){ .ID = 0x1ABC0000, .mask = 0x1FFF8000, .extended = 1 };
+    for(uint32_t i = 1; i < 29u; i++)
+    {
+        filters[i] = (filter_t){ .ID = 0x400u + i, .mask = 0x7FF, .extended = 0 };
+    }
+    filters[25].mask = 0x7F0;
+    CHECK_EQ(install_filters(FlexCAN_1, filters, 29, slots), Success);
+    CHECK_EQ(CAN1->CAN0_MCR_b.IDAM, 1);
+    CHECK_EQ(CAN1->CAN0_CTRL2_b.RFFN, 1);
+    CHECK_EQ(table[0], (((1u << 14) | (0x1ABC0000u >> 15)) << 16) | (0x401u << 3));
+    CHECK_EQ(rximr[0], (0x7FFFu << 16) | 0x7FF8u);
+    for(uint32_t e = 1; e < 14u; e++)
+    {
+        CHECK_EQ(table[e], ((0x400u + (2u * e)) << 19) | ((0x401u + (2u * e)) << 3));
+    }
+    CHECK_EQ(table[14], (0x41Cu << 19) | (0x41Cu << 3));
+    CHECK_EQ(table[15], table[14]);
+    for(uint32_t e = 1; e < 10u; e++)
+    {
+        CHECK_EQ(rximr[e], 0x7FF87FF8u);
+    }
+    CHECK_EQ(CAN1->CAN0_RXFGMASK, 0x7FF87F80u);
+    for(uint32_t n = 0; n < 29u; n++)
+    {
+        CHECK_EQ(slots[n], n);
+    }
+
+    /* Format C: 50 filters in 13 elements of RFFN 1, standard ID bits 10..3 in each byte */
+    for(uint32_t i = 0; i < 50u; i++)
+    {
+        filters[i] = (filter_t){ .ID = (i + 1u) << 3, .mask = 0x7F8u, .extended = 0 };
+    }
+    CHECK_EQ(install_filters(FlexCAN_1, filters, 50, slots), Success);
+    CHECK_EQ(CAN1->CAN0_MCR_b.IDAM, 2);
+    CHECK_EQ(CAN1->CAN0_CTRL2_b.RFFN, 1);
+    for(uint32_t e = 0; e < 12u; e++)
+    {
+        uint32_t first = (4u * e) + 1u;
+
+        CHECK_EQ(table[e], (first << 24) | ((first + 1u) << 16) | ((first + 2u) << 8) | (first + 3u));
+    }
+    CHECK_EQ(table[12], (49u << 24) | (50u << 16) | (49u << 8) | 49u);
+    for(uint32_t e = 13; e < 16u; e++)
+    {
+        CHECK_EQ(table[e], table[12]);
+    }
+    for(uint32_t e = 0; e < 10u; e++)
+    {
+        CHECK_EQ(rximr[e], 0xFFFFFFFFu);
+    }
+    CHECK_EQ(CAN1->CAN0_RXFGMASK, 0xFFFFFFFFu);
+    CHECK_EQ(slots[49], 49);
+
+    /* Format D: every element only matches an extended remote frame of ID 0x1FFFFFFF */
+    CHECK_EQ(install_filters(FlexCAN_1, 0, 0, 0), Success);
+    CHECK_EQ(CAN1->CAN0_MCR_b.IDAM, 3);
+    CHECK_EQ(CAN1->CAN0_CTRL2_b.RFFN, 0);
+    for(uint32_t e = 0; e < 8u; e++)
+    {
+        CHECK_EQ(table[e], 0xFFFFFFFEu);
+        CHECK_EQ(rximr[e], 0xFFFFFFFFu);
+    }
+    CHECK_EQ(CAN1->CAN0_RXFGMASK, 0xFFFFFFFFu);
+}
+
+/* Reception message buffer: FULL while serviced, OVERRUN when not, and locking */
+static void test_mb_codes(void)
+{
+    sim_frame_t frames[2];
+    rx_stats_t before, after;
+
+    CHECK_EQ(install_hot_ID(FlexCAN_0, 0, 0x055, on_hot), Success);
+    get_rx_stats(FlexCAN_0, &before);
+
+    frames[0] = std_frame(0x055, 0xA0);
+    send_frames(frames, 1);
+    CHECK_EQ(hot_count, 1);
+    CHECK_EQ(hot_frames[0].payload[0], 0xA0);
+    CHECK_EQ(hot_code(), CODE_RX_FULL);
+
+    /* The driver serviced it, so the next frame leaves it FULL */
+    frames[0] = std_frame(0x055, 0xA1);
+    send_frames(frames, 1);
+    CHECK_EQ(hot_count, 2);
+    CHECK_EQ(hot_code(), CODE_RX_FULL);
+
+    /* Two frames without servicing in between: OVERRUN, the latest one wins */
+    CRITICAL_ENTER();
+    frames[0] = std_frame(0x055, 0xA2);
+    frames[1] = std_frame(0x055, 0xA3);
+    send_frames(frames, 2);
+    CHECK_EQ(hot_code(), CODE_RX_OVERRUN);
+    CRITICAL_EXIT();
+    sim_run(2000000);
+
+    CHECK_EQ(hot_count, 3);
+    CHECK_EQ(hot_frames[2].payload[0], 0xA3);
+    get_rx_stats(FlexCAN_0, &after);
+    CHECK_EQ(after.dropped - before.dropped, 1);
+
+    /* Reading the control/status word locks the message buffer until the timer is read */
+    CRITICAL_ENTER();
+    (void)CAN0->Classic_MessageBuffer[HOT_MB].CODE;
+    frames[0] = std_frame(0x055, 0xA4);
+    send_frames(frames, 1);
+    CHECK_EQ(CAN0->Classic_MessageBuffer[HOT_MB].payload[0], 0xA3);
+    (void)CAN0->CAN0_TIMER;
+    CHECK_EQ(CAN0->Classic_MessageBuffer[HOT_MB].payload[0], 0xA4);
+    CRITICAL_EXIT();
+    sim_run(2000000);
+    CHECK_EQ(hot_count, 4);
+}
+
+/* Timestamps are the timer at the start of the identifier, one bit after the start of frame */
+static void test_timestamps(void)
+{
+    sim_frame_t frames[1] = { std_frame(0x055, 0xB0) };
+    sim_frame_t seen;
+
+    flush(FlexCAN_0);
+    hot_count = 0;
+
+    /* The timer was sampled somewhere between the two clock readings */
+    uint64_t before = sim_now();
+    uint64_t ticks = FlexCAN_timer_now(FlexCAN_0);
+    uint64_t after = sim_now();
+
+    send_frames(frames, 1);
+    CHECK_EQ(hot_count, 1);
+    CHECK_EQ(sim_node_receive(peer, &seen), Success);
+
+    uint64_t earliest = ticks + ((seen.time - after) / BIT_NS) + 1u;
+    uint64_t latest = ticks + ((seen.time - before) / BIT_NS) + 1u;
+
+    CHECK(hot_frames[0].timestamp + 1u >= earliest);
+    CHECK(hot_frames[0].timestamp <= latest + 1u);
+}
+
+/* A frame transmitted by FlexCAN0 reaches FlexCAN1 and the virtual nodes, and is confirmed */
+static void test_multi_node(void)
+{
+    frame_t frame = { .ID = 0x300, .payload = { 0x11111111u, 0x22222222u } };
+    frame_t got;
+    sim_frame_t seen;
+
+    CHECK_EQ(install_ID(FlexCAN_1, 0x300), Success);
+    flush(FlexCAN_0);
+    flush(FlexCAN_1);
+
+    CHECK_EQ(transmit_frame(FlexCAN_0, &frame), Success);
+    WAIT_UNTIL(receive_frame(FlexCAN_1, &got) == Success, 10000000u);
+    CHECK_EQ(got.ID, 0x300);
+    CHECK_EQ(got.payload[1], 0x22222222u);
+
+    CHECK_EQ(sim_node_receive(peer, &seen), Success);
+    CHECK_EQ(seen.ID, 0x300);
+    CHECK_EQ(seen.dlc, 8);
+
+    sim_run(1000000);
+    CHECK_EQ(transmitted_frame(FlexCAN_0, &got), Success);
+    CHECK_EQ(got.ID, 0x300);
+}
+
+/* A 29-bit ID goes out of FlexCAN0 with IDE and into FlexCAN1 through a masked format A extended
+ * filter, which turns away the other extended IDs and the standard frames of the same base ID */
+static void test_extended(void)
+{
+    filter_t source_any = { .ID = 0x18FEF100u, .mask = 0x1FFFFF00u, .extended = 1 };
+    frame_t frame = { .ID = CAN_ID_EXT | 0x18FEF1ABu, .payload = { 0xE1E2E3E4u, 0xE5E6E7E8u } };
+    sim_frame_t others[2] = { std_frame(CAN_ID_EXT | 0x18FEF2ABu, 1), std_frame(0x18FEF1ABu >> 18, 2) };
+    frame_t got;
+    sim_frame_t seen;
+
+    CHECK_EQ(install_filters(FlexCAN_1, &source_any, 1, 0), Success);
+    CHECK_EQ(CAN1->CAN0_MCR_b.IDAM, 0);
+    flush(FlexCAN_0);
+    flush(FlexCAN_1);
+
+    CHECK_EQ(transmit_frame(FlexCAN_0, &frame), Success);
+    WAIT_UNTIL(receive_frame(FlexCAN_1, &got) == Success, 10000000u);
+    CHECK_EQ(got.ID, CAN_ID_EXT | 0x18FEF1ABu);
+    CHECK_EQ(got.payload[0], 0xE1E2E3E4u);
+    CHECK_EQ(got.payload[1], 0xE5E6E7E8u);
+
+    CHECK_EQ(sim_node_receive(peer, &seen), Success);
+    CHECK_EQ(seen.ID, CAN_ID_EXT | 0x18FEF1ABu);
+
+    sim_run(1000000);
+    CHECK_EQ(transmitted_frame(FlexCAN_0, &got), Success);
+    CHECK_EQ(got.ID, CAN_ID_EXT | 0x18FEF1ABu);
+
+    /* Another source address and a standard frame with the 11 most significant bits */
+    send_frames(others, 2);
+    CHECK_EQ(receive_frame(FlexCAN_1, &got), Failure);
+}
+
+/* Transmission message buffers of FlexCAN1 holding a pending frame of at most ID max */
+static uint32_t instance1_loaded(uint32_t max)
+{
+    uint32_t loaded = 0;
+
+    for(uint32_t mb = CAN1_TX_MB_FIRST; mb < (CAN1_TX_MB_FIRST + CAN1_TX_MB_COUNT); mb++)
+    {
+        if( (CAN1->Classic_MessageBuffer[mb].CODE == CODE_TX_DATA) && (CAN1->Classic_MessageBuffer[mb].STD_ID <= max) )
+        {
+            loaded++;
+        }
+    }
+
+    return loaded;
+}
+
+/* FlexCAN1 transmits from message buffers 4 to 7 and has no hot message buffer: the frames
+ * queued past those four wait in the heap and every frame goes out in ID order */
+static void test_instance1_tx(void)
+{
+    sim_frame_t blockers[BLOCKERS];
+    frame_t frame = { 0 };
+    frame_t got;
+    sim_frame_t seen;
+
+    CHECK_EQ(install_hot_ID(FlexCAN_1, 0, 0x055, on_hot), Failure);
+    CHECK_EQ(CAN1->CAN0_IMASK1 & CAN1_TX_IFLAGS, CAN1_TX_IFLAGS);
+    flush(FlexCAN_1);
+
+    /* Frames of lower IDs hold the bus while the interrupt loads and aborts message buffers */
+    for(uint32_t i = 0; i < BLOCKERS; i++)
+    {
+        blockers[i] = std_frame(0x100u + i, i);
+        CHECK_EQ(sim_node_send(node, &blockers[i]), Success);
+    }
+    WAIT_UNTIL(!(CAN1->CAN0_ESR1 & ESR1_IDLE), 10000000u);
+
+    /* Queued from the highest ID down, the interrupt only sees them all at once */
+    CRITICAL_ENTER();
+    for(uint32_t i = 0; i < 10u; i++)
+    {
+        frame.ID = 0x20Au - i;
+        frame.payload[0] = i;
+        CHECK_EQ(transmit_frame(FlexCAN_1, &frame), Success);
+    }
+    CRITICAL_EXIT();
+
+    /* The four lowest IDs are loaded while the blockers hold the bus, the rest wait in the heap */
+    WAIT_UNTIL(instance1_loaded(0x204u) == CAN1_TX_MB_COUNT, 10000000u);
+    CHECK_EQ(instance1_loaded(0x204u), CAN1_TX_MB_COUNT);
+
+    sim_run(20000000);
+    for(uint32_t i = 0; i < BLOCKERS; i++)
+    {
+        CHECK_EQ(sim_node_receive(peer, &seen), Success);
+        CHECK_EQ(seen.ID, 0x100u + i);
+    }
+    for(uint32_t i = 0; i < 10u; i++)
+    {
+        CHECK_EQ(sim_node_receive(peer, &seen), Success);
+        CHECK_EQ(seen.ID, 0x201u + i);
+        CHECK_EQ(seen.payload[0], 9u - i);
+        CHECK_EQ(transmitted_frame(FlexCAN_1, &got), Success);
+    }
+    CHECK_EQ(sim_node_receive(peer, &seen), Failure);
+}
+
+/* The RX FIFO filters of FlexCAN1 count their hits in the slots install_filters() reports */
+static void test_instance1_filters(void)
+{
+    filter_t filters[2] = {
+        { .ID = 0x240, .mask = 0x7F0, .extended = 0 },
+        { .ID = 0x1ABCDEF, .mask = 0x1FFFFFFF, .extended = 1 },
+    };
+    sim_frame_t frames[4] = {
+        std_frame(0x245, 1), std_frame(0x250, 2), std_frame(CAN_ID_EXT | 0x1ABCDEFu, 3), std_frame(0x24F, 4),
+    };
+    uint16_t slots[2];
+    rx_stats_t before, after;
+    frame_t got;
+
+    CHECK_EQ(install_filters(FlexCAN_1, filters, 2, slots), Success);
+    flush(FlexCAN_1);
+    get_rx_stats(FlexCAN_1, &before);
+
+    send_frames(frames, 4);
+
+    CHECK_EQ(receive_frame(FlexCAN_1, &got), Success);
+    CHECK_EQ(got.ID, 0x245);
+    CHECK_EQ(receive_frame(FlexCAN_1, &got), Success);
+    CHECK_EQ(got.ID, CAN_ID_EXT | 0x1ABCDEFu);
+    CHECK_EQ(receive_frame(FlexCAN_1, &got), Success);
+    CHECK_EQ(got.ID, 0x24F);
+    CHECK_EQ(receive_frame(FlexCAN_1, &got), Failure);
+
+    get_rx_stats(FlexCAN_1, &after);
+    CHECK_EQ(after.received - before.received, 3);
+    CHECK_EQ(after.filter_hits[slots[0]] - before.filter_hits[slots[0]], 2);
+    CHECK_EQ(after.filter_hits[slots[1]] - before.filter_hits[slots[1]], 1);
+}
+
+/* The lowest ID wins the arbitration after the frame on the bus */
+static void test_arbitration(void)
+{
+    sim_node_t* low = sim_node_create(bus);
+    sim_node_t* high = sim_node_create(bus);
+    sim_frame_t blocker = std_frame(0x7F0, 0);
+    sim_frame_t a = std_frame(0x400, 1);
+    sim_frame_t b = std_frame(0x100, 2);
+    sim_frame_t seen;
+
+    flush(FlexCAN_0);
+
+    CHECK_EQ(sim_node_send(node, &blocker), Success);
+    WAIT_UNTIL(!(CAN0->CAN0_ESR1 & ESR1_IDLE), 10000000u);
+    CHECK_EQ(sim_node_send(high, &a), Success);
+    CHECK_EQ(sim_node_send(low, &b), Success);
+    sim_run(2000000);
+
+    CHECK_EQ(sim_node_receive(peer, &seen), Success);
+    CHECK_EQ(seen.ID, 0x7F0);
+    CHECK_EQ(sim_node_receive(peer, &seen), Success);
+    CHECK_EQ(seen.ID, 0x100);
+    uint64_t second = seen.time;
+    CHECK_EQ(sim_node_receive(peer, &seen), Success);
+    CHECK_EQ(seen.ID, 0x400);
+    CHECK(seen.time >= (second + ((uint64_t)sim_frame_bits(&b) * BIT_NS)));
+}
+
+/* Without anybody to acknowledge the frame is retried, a controller at another bit rate stays off the bus */
+static void test_ack_and_bitrate(void)
+{
+    sim_bus_t* lone = sim_bus_create(BITRATE);
+    sim_bus_t* slow = sim_bus_create(BITRATE / 2u);
+    sim_bus_stats_t stats;
+    frame_t frame = { .ID = 0x321 };
+    frame_t got;
+    sim_frame_t seen;
+
+    CHECK_EQ(install_ID(FlexCAN_1, 0x123), Success);
+    flush(FlexCAN_1);
+
+    sim_attach(FlexCAN_1, lone);
+    sim_run(100000);
+    CHECK_EQ(transmit_frame(FlexCAN_1, &frame), Success);
+    sim_run(5000000);
+
+    sim_get_bus_stats(lone, &stats, 0);
+    CHECK(stats.ack_errors > 0u);
+    CHECK_EQ(stats.frames, 0);
+    CHECK_EQ(CAN1->CAN0_ECR & 0xFFu, 128);
+    CHECK(CAN1->CAN0_ESR1_b.FLTCONF == 1u);
+
+    sim_node_t* listener = sim_node_create(lone);
+    WAIT_UNTIL(sim_node_receive(listener, &seen) == Success, 10000000u);
+    CHECK_EQ(seen.ID, 0x321);
+    sim_run(1000000);
+    CHECK_EQ(transmitted_frame(FlexCAN_1, &got), Success);
+
+    /* FlexCAN1 runs at 500 kbit/s */
+    sim_node_t* talker = sim_node_create(slow);
+    sim_frame_t hello = std_frame(0x123, 0);
+
+    sim_attach(FlexCAN_1, slow);
+    sim_run(100000);
+    CHECK_EQ(CAN1->CAN0_ESR1 & ESR1_SYNCH, 0);
+    CHECK_EQ(sim_node_send(talker, &hello), Success);
+    sim_run(3000000);
+    sim_get_bus_stats(slow, &stats, 0);
+    CHECK(stats.ack_errors > 0u);
+    CHECK_EQ(receive_frame(FlexCAN_1, &got), Failure);
+
+    sim_attach(FlexCAN_1, bus);
+}
+
+int main(void)
+{
+    if( sim_init(0) != Success )
+    {
+        printf("sim_init failed\n");
+        return 1;
+    }
+
+    bus = sim_bus_create(BITRATE);
+    sim_attach(FlexCAN_0, bus);
+    sim_attach(FlexCAN_1, bus);
+    node = sim_node_create(bus);
+    peer = sim_node_create(bus);
+
+    RUN(test_frame_bits);
+    RUN(test_handshake);
+    RUN(test_fifo_flags);
+    RUN(test_id_table);
+    RUN(test_filter_layout);
+    RUN(test_mb_codes);
+    RUN(test_timestamps);
+    RUN(test_multi_node);
+    RUN(test_extended);
+    RUN(test_instance1_tx);
+    RUN(test_instance1_filters);
+    RUN(test_arbitration);
+    RUN(test_ack_and_bitrate);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,182 @@
+/**
+ * Source file
+ */
+
+#include "test.h"
+#include "CAN_sim.h"
+#include <FlexCAN/include/CAN_internal.h>
+
+#define BITRATE             (500000u)
+#define BIT_NS              (1000000000u / BITRATE)
+
+/* The 16-bit free running timer wraps every 65536 bit times */
+#define WRAP_BITS           (65536u)
+#define WRAP_NS             ((uint64_t)WRAP_BITS * BIT_NS)
+
+#define RX_ID               (0x123u)
+
+/* Longest classical frame with 8 data bytes, stuff bits included, with margin */
+#define FRAME_NS_MAX        (1000000u)
+
+/* LPIT0 channel 1 as the anchor, counting down from its full 32-bit range at the oscillator clock */
+#define OSC_HZ              (8000000u)
+#define LPIT_CH1            (1u << 1)
+#define PCC_PCS_SOSCDIV2    (1u)
+
+/* Let simulated time pass until a condition holds, at most timeout_ns */
+#define WAIT_UNTIL(cond, timeout_ns) \
+    do { \
+        uint64_t wait_until = sim_now() + (timeout_ns); \
+        while( !(cond) && (sim_now() < wait_until) ) \
+        { \
+            sim_run(20000); \
+        } \
+    } while(0)
+
+static sim_node_t* node;
+
+/* Extended timer and simulated time read together, the timer sampled in between */
+typedef struct
+{
+    uint64_t ticks;
+    uint64_t before;
+    uint64_t after;
+} reference_t;
+
+static reference_t reference(void)
+{
+    reference_t ref;
+
+    ref.before = sim_now();
+    ref.ticks = FlexCAN_timer_now(FlexCAN_0);
+    ref.after = sim_now();
+
+    return ref;
+}
+
+/* Whether ticks lies within the bit times elapsed since the reference up to now, one bit of slack */
+static uint8_t since(const reference_t* ref, uint64_t ticks, uint64_t earliest_ns, uint64_t latest_ns)
+{
+    uint64_t earliest = ref->ticks + ((earliest_ns - ref->after) / BIT_NS);
+    uint64_t latest = ref->ticks + ((latest_ns - ref->before) / BIT_NS) + 1u;
+
+    return ((ticks + 1u) >= earliest) && (ticks <= latest);
+}
+
+/* One frame from the node, returns its timestamp, checked against the simulated time around it */
+static uint64_t frame_timestamp(const reference_t* ref)
+{
+    sim_frame_t frame = { .ID = RX_ID, .dlc = 8 };
+    frame_t received = { 0 };
+    status_t status = Failure;
+    uint64_t sent = sim_now();
+
+    CHECK_EQ(sim_node_send(node, &frame), Success);
+    WAIT_UNTIL((status = receive_frame(FlexCAN_0, &received)) == Success, FRAME_NS_MAX);
+    CHECK_EQ(status, Success);
+    CHECK(since(ref, received.timestamp, sent, sim_now()));
+
+    return received.timestamp;
+}
+
+static uint64_t lpit_anchor(void)
+{
+    return 0xFFFFFFFFu - LPIT0->TMR[1].CVAL;
+}
+
+static void lpit_start(void)
+{
+    /* The clock source can only be selected while the clock is gated */
+    PCC->PCC_LPIT_b.CGC = PCC_PCC_LPIT_CGC_0;
+    PCC->PCC_LPIT_b.PCS = PCC_PCS_SOSCDIV2;
+    PCC->PCC_LPIT_b.CGC = PCC_PCC_LPIT_CGC_1;
+
+    LPIT0->MCR = LPIT_MCR_M_CEN_MASK;
+    LPIT0->TMR[1].TVAL = 0xFFFFFFFFu;
+    LPIT0->TMR[1].TCTRL = 0;
+    LPIT0->SETTEN = LPIT_CH1;
+}
+
+/* Idle gaps shorter than a wraparound, several wraparounds over the frames: the timestamps keep
+ * counting up from the reference as the simulated time does */
+static void test_wrap_between_frames(void)
+{
+    reference_t ref = reference();
+    uint64_t last = ref.ticks;
+
+    for(uint32_t i = 0; i < 5u; i++)
+    {
+        sim_run((WRAP_NS * 3u) / 4u);
+
+        uint64_t timestamp = frame_timestamp(&ref);
+        CHECK(timestamp > last);
+        last = timestamp;
+    }
+
+    CHECK((last - ref.ticks) > (3u * WRAP_BITS));
+}
+
+/* Without an anchor a timer left unsampled for longer than a wraparound loses it */
+static void test_idle_without_anchor(void)
+{
+    reference_t ref = reference();
+
+    sim_run(WRAP_NS + (WRAP_NS / 4u));
+
+    uint64_t now = FlexCAN_timer_now(FlexCAN_0);
+    CHECK(now > ref.ticks);
+    CHECK((now - ref.ticks) < WRAP_BITS);
+}
+
+/* After set_timestamp_anchor() idle periods of several wraparounds are counted in full, by
+ * FlexCAN_timer_now() and by the timestamps of the next frames */
+static void test_anchor(void)
+{
+    lpit_start();
+    set_timestamp_anchor(FlexCAN_0, lpit_anchor, OSC_HZ);
+
+    reference_t ref = reference();
+
+    sim_run((5u * WRAP_NS) / 2u);
+
+    uint64_t before = sim_now();
+    uint64_t now = FlexCAN_timer_now(FlexCAN_0);
+    CHECK(since(&ref, now, before, sim_now()));
+
+    sim_run((3u * WRAP_NS) / 2u);
+    uint64_t first = frame_timestamp(&ref);
+    CHECK(first > now);
+
+    sim_run(WRAP_NS * 2u);
+    uint64_t second = frame_timestamp(&ref);
+    CHECK((second - first) > (2u * WRAP_BITS));
+
+    /* Back to the timer alone */
+    set_timestamp_anchor(FlexCAN_0, 0, 0);
+    CHECK(FlexCAN_timer_now(FlexCAN_0) >= second);
+}
+
+int main(void)
+{
+    if( sim_init(0) != Success )
+    {
+        printf("sim_init failed\n");
+        return 1;
+    }
+
+    sim_bus_t* bus = sim_bus_create(BITRATE);
+    sim_attach(FlexCAN_0, bus);
+    node = sim_node_create(bus);
+
+    if( (FlexCAN_init_RXFIFO(FlexCAN_0) != Success) || (install_ID(FlexCAN_0, RX_ID) != Success) )
+    {
+        printf("FlexCAN_init_RXFIFO failed\n");
+        return 1;
+    }
+
+    RUN(test_wrap_between_frames);
+    RUN(test_idle_without_anchor);
+    RUN(test_anchor);
+
+    return TEST_RESULT();
+}
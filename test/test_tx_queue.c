@@ -0,0 +1,281 @@
+/**
+ * Source file
+ */
+
+#include "test.h"
+#include "CAN_sim.h"
+#include <FlexCAN/include/CAN_internal.h>
+
+#define BITRATE             (500000u)
+#define BIT_NS              (1000000000u / BITRATE)
+
+/* Transmission message buffers of FlexCAN0 as Classic_MessageBuffer indexes */
+#define TX_MB_FIRST         (16u)
+#define TX_MB_COUNT         (8u)
+#define CODE_TX_DATA        (0xCu)
+
+static sim_bus_t* bus;
+static sim_node_t* peer;
+
+static void flush(void)
+{
+    frame_t frame;
+    sim_frame_t seen;
+
+    sim_run(2000000);
+    while( transmitted_frame(FlexCAN_0, &frame) == Success );
+    while( sim_node_receive(peer, &seen) == Success );
+}
+
+/* Let the bus carry the frames the peer expects, return how many it got */
+static uint32_t collect(sim_frame_t* frames, uint32_t count)
+{
+    uint32_t got = 0;
+    uint64_t deadline = sim_now() + ((uint64_t)count * 135u * BIT_NS * 2u) + 10000000u;
+
+    while( (got < count) && (sim_now() < deadline) )
+    {
+        if( sim_node_receive(peer, &frames[got]) == Success )
+        {
+            got++;
+        }
+        else
+        {
+            sim_run(100000);
+        }
+    }
+
+    return got;
+}
+
+/* transmit_frame() hands the frame over to the interrupt and returns without waiting for the bus */
+static void test_nonblocking(void)
+{
+    frame_t frame = { .ID = 0x210, .payload = { 1, 2 } };
+    frame_t done;
+    sim_frame_t seen;
+
+    flush();
+
+    /* With the interrupt masked the frame can only have been queued */
+    CRITICAL_ENTER();
+    CHECK_EQ(transmit_frame(FlexCAN_0, &frame), Success);
+    for(uint32_t mb = TX_MB_FIRST; mb < (TX_MB_FIRST + TX_MB_COUNT); mb++)
+    {
+        CHECK(CAN0->Classic_MessageBuffer[mb].CODE != CODE_TX_DATA);
+    }
+    CRITICAL_EXIT();
+    CHECK_EQ(transmitted_frame(FlexCAN_0, &done), Failure);
+
+    CHECK_EQ(collect(&seen, 1), 1);
+    CHECK_EQ(seen.ID, 0x210);
+    CHECK_EQ(seen.payload[1], 2);
+
+    sim_run(1000000);
+    CHECK_EQ(transmitted_frame(FlexCAN_0, &done), Success);
+    CHECK_EQ(done.ID, 0x210);
+    CHECK_EQ(done.payload[0], 1);
+}
+
+/* A full queue reports BufferFull, not Failure, and every accepted frame still goes out */
+static void test_buffer_full(void)
+{
+    frame_t frame = { .ID = 0x220 };
+    frame_t done;
+    sim_frame_t seen[TX_QUEUE_SIZE];
+
+    flush();
+
+    /* Keep the interrupt from taking frames out of the queue */
+    CRITICAL_ENTER();
+    for(uint32_t i = 0; i < TX_QUEUE_SIZE; i++)
+    {
+        frame.payload[0] = i;
+        CHECK_EQ(transmit_frame(FlexCAN_0, &frame), Success);
+    }
+    CHECK_EQ(transmit_frame(FlexCAN_0, &frame), BufferFull);
+    CHECK_EQ(transmit_batch(FlexCAN_0, &frame, 1), 0);
+    CHECK_EQ(transmit_frame_prio(FlexCAN_0, &frame, TX_PRIO_LOWEST + 1u), Failure);
+    CRITICAL_EXIT();
+
+    /* Same ID, so the frames keep their queuing order */
+    CHECK_EQ(collect(seen, TX_QUEUE_SIZE), TX_QUEUE_SIZE);
+    for(uint32_t i = 0; i < TX_QUEUE_SIZE; i++)
+    {
+        CHECK_EQ(seen[i].payload[0], i);
+    }
+
+    sim_run(1000000);
+    for(uint32_t i = 0; i < TX_QUEUE_SIZE; i++)
+    {
+        CHECK_EQ(transmitted_frame(FlexCAN_0, &done), Success);
+        CHECK_EQ(done.payload[0], i);
+    }
+    CHECK_EQ(transmitted_frame(FlexCAN_0, &done), Failure);
+}
+
+/* The queue spreads over every transmission message buffer, and the bus sees the frames by ID */
+static void test_mailboxes(void)
+{
+    frame_t frames[TX_QUEUE_SIZE];
+    sim_frame_t seen[TX_QUEUE_SIZE];
+    uint32_t loaded = 0;
+
+    flush();
+
+    /* Queued from the highest ID down */
+    for(uint32_t i = 0; i < TX_QUEUE_SIZE; i++)
+    {
+        frames[i] = (frame_t){ .ID = 0x2FFu - i, .payload = { i, 0 } };
+    }
+
+    CRITICAL_ENTER();
+    CHECK_EQ(transmit_batch(FlexCAN_0, frames, TX_QUEUE_SIZE), TX_QUEUE_SIZE);
+    CRITICAL_EXIT();
+
+    for(uint32_t mb = TX_MB_FIRST; mb < (TX_MB_FIRST + TX_MB_COUNT); mb++)
+    {
+        loaded += (CAN0->Classic_MessageBuffer[mb].CODE == CODE_TX_DATA) ? 1u : 0u;
+    }
+    CHECK_EQ(loaded, TX_MB_COUNT);
+
+    CHECK_EQ(collect(seen, TX_QUEUE_SIZE), TX_QUEUE_SIZE);
+    for(uint32_t i = 0; i < TX_QUEUE_SIZE; i++)
+    {
+        CHECK_EQ(seen[i].ID, 0x2FFu - (TX_QUEUE_SIZE - 1u) + i);
+    }
+}
+
+/* A frame of higher priority queued behind full message buffers goes out next */
+static void test_priority(void)
+{
+    frame_t frame = { .ID = 0x300 };
+    frame_t urgent = { .ID = 0x400 };
+    sim_frame_t seen[TX_QUEUE_SIZE + 1u];
+    uint32_t ahead = 0;
+
+    flush();
+
+    CRITICAL_ENTER();
+    for(uint32_t i = 0; i < TX_QUEUE_SIZE; i++)
+    {
+        frame.ID = 0x300u + i;
+        CHECK_EQ(transmit_frame_prio(FlexCAN_0, &frame, TX_PRIO_LOWEST), Success);
+    }
+    CRITICAL_EXIT();
+
+    /* Once the first frame went out */
+    CHECK_EQ(collect(seen, 1), 1);
+    uint64_t queued = sim_now();
+    CHECK_EQ(transmit_frame_prio(FlexCAN_0, &urgent, 0), Success);
+
+    CHECK_EQ(collect(&seen[1], TX_QUEUE_SIZE), TX_QUEUE_SIZE);
+    CHECK_EQ(seen[0].ID, 0x300);
+
+    /* Priority 0 outranks the lower IDs waiting: only the frame in transmission when it was
+     * queued, and one more started before the abort completed, may go ahead of it */
+    for(uint32_t i = 1; (i <= TX_QUEUE_SIZE) && (seen[i].ID != 0x400u); i++)
+    {
+        ahead += (seen[i].time >= queued) ? 1u : 0u;
+    }
+    CHECK(ahead <= 1u);
+}
+
+/* A frame handed over by transmit_frame_ISR() goes before one of equal rank queued after it */
+static void test_isr_order(void)
+{
+    frame_t frame = { .ID = 0x600 };
+    sim_frame_t seen[TX_MB_COUNT + 3u];
+
+    flush();
+
+    /* As from an interrupt at CAN_MB_IRQ_PRIORITY: every message buffer loaded with a frame of
+     * its own rank, one more pending ahead of the two of equal rank */
+    CRITICAL_ENTER();
+    for(uint32_t i = 0; i <= TX_MB_COUNT; i++)
+    {
+        frame.ID = 0x600u + i;
+        CHECK_EQ(transmit_frame_ISR(FlexCAN_0, &frame, 0), Success);
+    }
+    frame = (frame_t){ .ID = 0x6F0, .payload = { 1, 0 } };
+    CHECK_EQ(transmit_frame_ISR(FlexCAN_0, &frame, 0), Success);
+    frame.payload[0] = 2;
+    CHECK_EQ(transmit_frame(FlexCAN_0, &frame), Success);
+    CRITICAL_EXIT();
+
+    CHECK_EQ(collect(seen, TX_MB_COUNT + 3u), TX_MB_COUNT + 3u);
+    for(uint32_t i = 0; i <= TX_MB_COUNT; i++)
+    {
+        CHECK_EQ(seen[i].ID, 0x600u + i);
+    }
+    CHECK_EQ(seen[TX_MB_COUNT + 1u].payload[0], 1);
+    CHECK_EQ(seen[TX_MB_COUNT + 2u].payload[0], 2);
+}
+
+/* The main loop keeps refilling the queue while the interrupt keeps the message buffers busy */
+static void test_refill(void)
+{
+    frame_t frames[TX_QUEUE_SIZE];
+    uint32_t queued = 0;
+    uint32_t count = 400;
+    uint32_t got = 0;
+    sim_frame_t seen;
+
+    flush();
+
+    uint64_t deadline = sim_now() + ((uint64_t)count * 135u * BIT_NS * 4u);
+
+    while( (got < count) && (sim_now() < deadline) )
+    {
+        uint32_t room = TX_QUEUE_SIZE;
+
+        for(uint32_t i = 0; i < TX_QUEUE_SIZE; i++)
+        {
+            frames[i] = (frame_t){ .ID = 0x500, .payload = { queued + i, 0 } };
+        }
+        room = (count - queued < room) ? (count - queued) : room;
+        queued += transmit_batch(FlexCAN_0, frames, room);
+
+        /* Same ID, so the frames leave in queuing order */
+        while( sim_node_receive(peer, &seen) == Success )
+        {
+            CHECK_EQ(seen.payload[0], got);
+            got++;
+        }
+        sim_run(200000);
+    }
+
+    CHECK_EQ(got, count);
+}
+
+int main(void)
+{
+    /* Saturated bus with traps of tens of microseconds: slow simulated time down so the
+     * interrupts keep up as they would on the target */
+    sim_config_t config = { .slowdown = 8, .tick_ns = 50000, .osc_hz = 8000000, .periph_hz = 48000000 };
+
+    if( sim_init(&config) != Success )
+    {
+        printf("sim_init failed\n");
+        return 1;
+    }
+
+    bus = sim_bus_create(BITRATE);
+    sim_attach(FlexCAN_0, bus);
+    peer = sim_node_create(bus);
+
+    if( FlexCAN_init_RXFIFO(FlexCAN_0) != Success )
+    {
+        printf("FlexCAN_init_RXFIFO failed\n");
+        return 1;
+    }
+
+    RUN(test_nonblocking);
+    RUN(test_buffer_full);
+    RUN(test_mailboxes);
+    RUN(test_priority);
+    RUN(test_isr_order);
+    RUN(test_refill);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,160 @@
+#!/usr/bin/env python3
+"""
+Generate the header of FlexCAN bit timings selected at compile time.
+
+Every combination of protocol engine clock, bitrate and sample point listed below is solved
+with the same search as solve_bit_timings() in CAN_bit_timing.c, without a tolerance, and
+emitted as a branch of a preprocessor chain on the configuration macros of CAN_RXFIFO.h:
+CAN_NOMINAL_* for CAN_CLOCK_HZ, CAN_BITRATE and CAN_SAMPLE_POINT, CAN_FD_NOMINAL_* and
+CAN_FD_DATA_* for the two phases of CAN FD mode. A configuration without an exact solution
+has no branch and stops the build with an #error. CAN_bit_timing.c checks the selected
+values against the configuration with _Static_assert, including CAN_SP_TOLERANCE.
+
+Add the clocks, bitrates or sample points of a new board to the lists and regenerate.
+
+Usage: bit_timing_table.py [-o output.h]
+"""
+
+import argparse
+import os
+
+# Classical CAN: SOSCDIV2 crystals and peripheral clocks
+NOMINAL_CLOCKS = (8000000, 16000000, 40000000, 48000000, 80000000)
+NOMINAL_BITRATES = (125000, 250000, 500000, 1000000)
+NOMINAL_SAMPLE_POINTS = (800, 875)
+
+# CAN FD: the peripheral clocks fast enough for a data phase
+FD_CLOCKS = (40000000, 48000000, 80000000)
+FD_DATA_BITRATES = (2000000, 4000000, 5000000, 8000000)
+FD_DATA_SAMPLE_POINTS = (700, 750, 800)
+
+# Ranges in time quanta, indexed like bit_timing_phase_t
+NOMINAL_PHASE, DATA_PHASE = 0, 1
+
+LIMITS = (
+    dict(presdiv_max=1024, propseg_min=1, propseg_max=64, pseg1_max=32, pseg2_max=32,
+         rjw_max=32, tq_min=8, tq_max=129),
+    dict(presdiv_max=1024, propseg_min=0, propseg_max=31, pseg1_max=8, pseg2_max=8,
+         rjw_max=8, tq_min=5, tq_max=48),
+)
+
+PSEG2_MIN = 2
+
+
+def solve(clock_hz, bitrate, sample_point, phase):
+    """Register encodings (PRESDIV, PROPSEG, PSEG1, PSEG2, RJW) and the sample point reached,
+    None without an exact bitrate. Mirrors solve_bit_timings()"""
+
+    limit = LIMITS[phase]
+    best = None
+    best_error = None
+
+    for presdiv in range(1, limit['presdiv_max'] + 1):
+        if clock_hz % (bitrate * presdiv):
+            continue
+
+        tq = clock_hz // (bitrate * presdiv)
+
+        if tq < limit['tq_min']:
+            break
+        if tq > limit['tq_max']:
+            continue
+
+        tseg1 = (sample_point * tq + 500) // 1000 - 1
+        pseg2 = tq - 1 - tseg1
+        pseg2 = min(max(pseg2, PSEG2_MIN), limit['pseg2_max'])
+        tseg1 = tq - 1 - pseg2
+
+        pseg1 = min(pseg2, limit['pseg1_max'])
+        pseg1 = min(pseg1, tseg1 - limit['propseg_min'])
+        if tseg1 - pseg1 > limit['propseg_max']:
+            pseg1 = tseg1 - limit['propseg_max']
+        propseg = tseg1 - pseg1
+
+        if pseg1 < 1 or pseg1 > limit['pseg1_max'] or propseg < limit['propseg_min']:
+            continue
+
+        actual = (tseg1 + 1) * 1000 // tq
+        error = abs(actual - sample_point)
+
+        if best_error is None or error < best_error:
+            rjw = min(pseg1, pseg2, limit['rjw_max'])
+            best = (presdiv - 1, propseg if phase == DATA_PHASE else propseg - 1,
+                    pseg1 - 1, pseg2 - 1, rjw - 1, actual)
+            best_error = error
+
+    return best
+
+
+def chain(prefix, clock_macro, bitrate_macro, sample_point_macro, clocks, bitrates, sample_points, phase):
+    """Preprocessor chain defining prefix* for the configured clock, bitrate and sample point"""
+
+    out = []
+
+    for clock in clocks:
+        for bitrate in bitrates:
+            for sample_point in sample_points:
+                solution = solve(clock, bitrate, sample_point, phase)
+                if solution is None:
+                    continue
+
+                presdiv, propseg, pseg1, pseg2, rjw, actual = solution
+                out.append('%s (%s == %du) && (%s == %du) && (%s == %du)' %
+                           ('#if' if not out else '#elif', clock_macro, clock,
+                            bitrate_macro, bitrate, sample_point_macro, sample_point))
+                out.append('#define %sPRESDIV    (%du)' % (prefix, presdiv))
+                out.append('#define %sPROPSEG    (%du)' % (prefix, propseg))
+                out.append('#define %sPSEG1      (%du)' % (prefix, pseg1))
+                out.append('#define %sPSEG2      (%du)' % (prefix, pseg2))
+                out.append('#define %sRJW        (%du)' % (prefix, rjw))
+                out.append('#define %sSP_REACHED (%du)' % (prefix, actual))
+
+    out.append('#else')
+    out.append('#error "No bit timing for %s, %s and %s, add them to tools/bit_timing_table.py"' %
+               (clock_macro, bitrate_macro, sample_point_macro))
+    out.append('#endif')
+
+    return out
+
+
+def generate(output):
+    guard = 'FLEXCAN_INCLUDE_%s_' % os.path.basename(output).upper().replace('.', '_')
+
+    out = ['/**',
+           ' * @file',
+           ' * Header file of the FlexCAN bit timings selected at compile time, register encodings',
+           ' * (value - 1) and the sample point reached in per mille',
+           ' * Generated by tools/bit_timing_table.py, do not edit',
+           ' */',
+           '',
+           '#ifndef %s' % guard,
+           '#define %s' % guard,
+           '',
+           '#include <FlexCAN/include/CAN_RXFIFO.h>',
+           '',
+           '/* Classical CAN, CAN0_CBT */']
+    out += chain('CAN_NOMINAL_', 'CAN_CLOCK_HZ', 'CAN_BITRATE', 'CAN_SAMPLE_POINT',
+                 NOMINAL_CLOCKS, NOMINAL_BITRATES, NOMINAL_SAMPLE_POINTS, NOMINAL_PHASE)
+    out += ['', '/* CAN FD arbitration phase, CAN0_CBT */']
+    out += chain('CAN_FD_NOMINAL_', 'CAN_FD_CLOCK_HZ', 'CAN_FD_NOMINAL_BITRATE', 'CAN_SAMPLE_POINT',
+                 FD_CLOCKS, NOMINAL_BITRATES, NOMINAL_SAMPLE_POINTS, NOMINAL_PHASE)
+    out += ['', '/* CAN FD data phase, CAN0_FDCBT */']
+    out += chain('CAN_FD_DATA_', 'CAN_FD_CLOCK_HZ', 'CAN_FD_DATA_BITRATE', 'CAN_FD_DATA_SAMPLE_POINT',
+                 FD_CLOCKS, FD_DATA_BITRATES, FD_DATA_SAMPLE_POINTS, DATA_PHASE)
+    out += ['', '#endif /* %s */' % guard]
+
+    with open(output, 'w') as header:
+        header.write('\n'.join(out) + '\n')
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Generate the FlexCAN bit timing table')
+    parser.add_argument('-o', '--output', default='include/FlexCAN/include/CAN_bit_timing_table.h',
+                        help='the header to write, %(default)s by default')
+    args = parser.parse_args()
+
+    generate(args.output)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,456 @@
+#!/usr/bin/env python3
+"""
+Generate a header of pack and unpack functions for the messages of a DBC file.
+
+Every signal is placed at generation time into the two payload words of frame_t, which hold
+the first byte of the frame in their upper bits. Motorola signals are contiguous in those
+words read as one big-endian 64-bit value, Intel signals in the byte swapped words, so each
+signal is unpacked with a shift and a mask of one word, or an OR of two words when it
+crosses the middle of the frame. No loops or branches are generated.
+
+Multiplexed messages get one pack function per multiplexer value, which packs the plain
+signals, the multiplexer and the signals of that value. The unpack function decodes every
+signal, the ones not selected by the multiplexer hold garbage.
+
+Signals with an integral factor and offset are held in the smallest integer type that covers
+their physical range, the others in a float, or a double above 24 bits.
+
+Usage: dbc_codegen.py input.dbc [-o output.h]
+"""
+
+import argparse
+import os
+import re
+import sys
+
+
+class Signal:
+    def __init__(self, name, mux, start, length, intel, signed, factor, offset):
+        self.name = name
+        self.mux = mux              # None, 'M' for the multiplexer or the selecting value
+        self.start = start
+        self.length = length
+        self.intel = intel
+        self.signed = signed
+        self.factor = factor
+        self.offset = offset
+
+
+class Message:
+    def __init__(self, ID, name):
+        self.ID = ID
+        self.name = name
+        self.signals = []
+
+
+MESSAGE_RE = re.compile(r'^BO_\s+(\d+)\s+(\w+)\s*:\s*(\d+)\s+(\w+)')
+SIGNAL_RE = re.compile(r'^SG_\s+(\w+)\s*(M|m\d+)?\s*:\s*(\d+)\|(\d+)@([01])([+-])\s*'
+                       r'\(\s*([^,\s]+)\s*,\s*([^)\s]+)\s*\)')
+
+
+def parse_dbc(path):
+    messages = []
+    current = None
+
+    with open(path, encoding='latin-1') as dbc:
+        for number, line in enumerate(dbc, 1):
+            line = line.strip()
+
+            match = MESSAGE_RE.match(line)
+            if match:
+                current = Message(int(match.group(1)), match.group(2))
+                messages.append(current)
+                continue
+
+            if line.startswith('SG_MUL_VAL_'):
+                sys.exit('%s:%d: extended multiplexing is not supported' % (path, number))
+
+            match = SIGNAL_RE.match(line)
+            if match:
+                if current is None:
+                    sys.exit('%s:%d: signal outside of a message' % (path, number))
+
+                mux = match.group(2)
+                if mux is not None and mux != 'M':
+                    mux = int(mux[1:])
+
+                current.signals.append(Signal(match.group(1), mux, int(match.group(3)),
+                                              int(match.group(4)), match.group(5) == '1',
+                                              match.group(6) == '-', float(match.group(7)),
+                                              float(match.group(8))))
+                continue
+
+            if line.startswith('BO_') or line.startswith('SG_'):
+                sys.exit('%s:%d: could not parse "%s"' % (path, number, line))
+
+    # The pseudo message holding the signals of no message
+    return [message for message in messages if message.name != 'VECTOR__INDEPENDENT_SIG_MSG']
+
+
+C_KEYWORDS = {'auto', 'break', 'case', 'char', 'const', 'continue', 'default', 'do', 'double',
+              'else', 'enum', 'extern', 'float', 'for', 'goto', 'if', 'inline', 'int', 'long',
+              'register', 'restrict', 'return', 'short', 'signed', 'sizeof', 'static', 'struct',
+              'switch', 'typedef', 'union', 'unsigned', 'void', 'volatile', 'while'}
+
+
+def snake_case(name):
+    name = re.sub(r'([a-z0-9])([A-Z])', r'\1_\2', name)
+    name = re.sub(r'([A-Z]+)([A-Z][a-z])', r'\1_\2', name)
+    name = name.lower()
+    return name + '_' if name in C_KEYWORDS else name
+
+
+def position(signal):
+    """Bit of the signal's LSB in the big-endian (Motorola) or byte swapped (Intel) 64-bit word"""
+
+    if signal.intel:
+        lsb = signal.start
+    else:
+        msb = 56 - 8 * (signal.start // 8) + signal.start % 8
+        lsb = msb - signal.length + 1
+
+    if signal.length < 1 or lsb < 0 or lsb + signal.length > 64:
+        sys.exit('signal %s does not fit 8 bytes' % signal.name)
+
+    return lsb
+
+
+def words(signal):
+    """Low and high 32-bit words of the 64-bit word of the signal"""
+
+    if signal.intel:
+        return 'le0', 'le1'
+    return 'frame->payload[1]', 'frame->payload[0]'
+
+
+def mask(length):
+    return '0x%Xu' % ((1 << length) - 1) if length < 64 else '0xFFFFFFFFFFFFFFFFu'
+
+
+def raw_type(length):
+    return 'uint32_t' if length <= 32 else 'uint64_t'
+
+
+def extract(signal):
+    """Expression of the raw value of a signal"""
+
+    low, high = words(signal)
+    lsb = position(signal)
+    length = signal.length
+
+    if length > 32:
+        value = '(((uint64_t)%s << 32) | %s)' % (high, low)
+        shifted = '(%s >> %d)' % (value, lsb) if lsb else value
+        return shifted if lsb + length == 64 else '(%s & %sull)' % (shifted, mask(length)[:-1])
+
+    if lsb >= 32:
+        word, lsb = high, lsb - 32
+        top = 32
+    elif lsb + length <= 32:
+        word = low
+        top = 32
+    else:
+        # Crosses the middle of the frame, ORed from both words
+        word = '((%s >> %d) | (%s << %d))' % (low, lsb, high, 32 - lsb)
+        return '(%s & %s)' % (word, mask(length))
+
+    shifted = '(%s >> %d)' % (word, lsb) if lsb else word
+    return shifted if lsb + length == top else '(%s & %s)' % (shifted, mask(length))
+
+
+def shift(value, bits):
+    if bits > 0:
+        return '%s << %d' % (value, bits)
+    if bits < 0:
+        return '%s >> %d' % (value, -bits)
+    return value
+
+
+def insert(signal, raw):
+    """Statements ORing a raw value into the words of a signal"""
+
+    low, high = words(signal)
+    lsb = position(signal)
+    length = signal.length
+
+    if length > 32:
+        masked = '(%s & %sull)' % (raw, mask(length)[:-1])
+        return ['%s |= (uint32_t)(%s);' % (low, shift(masked, lsb)),
+                '%s |= (uint32_t)(%s);' % (high, shift(masked, lsb - 32))]
+
+    masked = '(%s & %s)' % (raw, mask(length))
+    statements = []
+    if lsb < 32:
+        statements.append('%s |= %s;' % (low, shift(masked, lsb)))
+    if lsb + length > 32:
+        statements.append('%s |= %s;' % (high, shift(masked, lsb - 32)))
+    return statements
+
+
+def insert_constant(signal, value):
+    """Statements ORing a value known at generation time into the words of a signal"""
+
+    low, high = words(signal)
+    placed = (value & ((1 << signal.length) - 1)) << position(signal)
+    statements = []
+    if placed & 0xFFFFFFFF:
+        statements.append('%s |= 0x%Xu;' % (low, placed & 0xFFFFFFFF))
+    if placed >> 32:
+        statements.append('%s |= 0x%Xu;' % (high, placed >> 32))
+    return statements
+
+
+def add(value, offset):
+    """Expression of value + offset, offset being a C literal"""
+
+    if offset.startswith('-'):
+        return '%s - %s' % (value, offset[1:])
+    return '%s + %s' % (value, offset)
+
+
+def integral(value):
+    return float(value).is_integer()
+
+
+def c_float(value, double):
+    literal = repr(float(value))
+    return literal if double else literal + 'f'
+
+
+def raw_range(signal):
+    if signal.signed:
+        return -(1 << (signal.length - 1)), (1 << (signal.length - 1)) - 1
+    return 0, (1 << signal.length) - 1
+
+
+def field_type(signal):
+    """C type of the physical value of a signal"""
+
+    if not (integral(signal.factor) and integral(signal.offset)):
+        return 'double' if signal.length > 24 else 'float'
+
+    raw_min, raw_max = raw_range(signal)
+    ends = [raw_min * int(signal.factor) + int(signal.offset),
+            raw_max * int(signal.factor) + int(signal.offset)]
+    low, high = min(ends), max(ends)
+
+    for bits in (8, 16, 32, 64):
+        if low >= 0 and high < (1 << bits):
+            return 'uint%d_t' % bits
+        if low >= -(1 << (bits - 1)) and high < (1 << (bits - 1)):
+            return 'int%d_t' % bits
+
+    sys.exit('signal %s exceeds 64 bits once scaled' % signal.name)
+
+
+def wide_type(signal):
+    """C type holding every value of the integer scaling: the raw value, the raw value times the
+    factor and the physical value, whatever their length"""
+
+    raw_min, raw_max = raw_range(signal)
+    factor, offset = int(signal.factor), int(signal.offset)
+    values = [raw_min, raw_max, raw_min * factor, raw_max * factor,
+              raw_min * factor + offset, raw_max * factor + offset]
+    low, high = min(values), max(values)
+
+    if low >= -(1 << 31) and high < (1 << 31):
+        return 'int32_t'
+    if low >= -(1 << 63) and high < (1 << 63):
+        return 'int64_t'
+    if low >= 0 and high < (1 << 64):
+        return 'uint64_t'
+
+    sys.exit('signal %s exceeds 64 bits while scaled' % signal.name)
+
+
+def unpack_statement(signal, field):
+    ctype = field_type(signal)
+    raw = extract(signal)
+    utype = raw_type(signal.length)
+    stype = utype[1:]
+
+    if signal.signed and signal.length < (32 if utype == 'uint32_t' else 64):
+        # Sign extension by flipping and subtracting the sign bit
+        sign = '0x%Xu%s' % (1 << (signal.length - 1), 'll' if signal.length > 32 else '')
+        raw = '(%s)((%s ^ %s) - %s)' % (stype, raw, sign, sign)
+    elif signal.signed:
+        raw = '(%s)%s' % (stype, raw)
+
+    if ctype in ('float', 'double'):
+        double = ctype == 'double'
+        value = '(%s)%s' % (ctype, raw)
+        if signal.factor != 1.0:
+            value = '%s * %s' % (value, c_float(signal.factor, double))
+        if signal.offset != 0.0:
+            value = add(value, c_float(signal.offset, double))
+    else:
+        wide = wide_type(signal)
+        value = raw
+        if signal.factor != 1.0 or signal.offset != 0.0:
+            value = raw if raw.startswith('(%s)' % wide) else '(%s)%s' % (wide, raw)
+            if signal.factor != 1.0:
+                value = '%s * %d' % (value, int(signal.factor))
+            if signal.offset != 0.0:
+                value = add(value, '%d' % int(signal.offset))
+
+    return 'msg->%s = (%s)(%s);' % (field, ctype, value)
+
+
+def pack_statements(signal, field):
+    ctype = field_type(signal)
+    utype = raw_type(signal.length)
+
+    if ctype in ('float', 'double'):
+        double = ctype == 'double'
+        value = 'msg->%s' % field
+        if signal.offset != 0.0:
+            value = '(%s)' % add(value, c_float(-signal.offset, double))
+        if signal.factor != 1.0:
+            value = '%s * %s' % (value, c_float(1.0 / signal.factor, double))
+        suffix = '' if double else 'f'
+        # Rounded to nearest, compiled to a conditional select rather than a branch
+        value = '%s + ((%s < 0.0%s) ? -0.5%s : 0.5%s)' % (value, value, suffix, suffix, suffix)
+        raw = '(%s)(%s)(%s)' % (utype, 'int64_t' if signal.length > 24 else 'int32_t', value)
+    else:
+        wide = wide_type(signal)
+        value = 'msg->%s' % field
+        if signal.offset != 0.0 or signal.factor != 1.0:
+            value = '(%s)%s' % (wide, value)
+            if signal.offset != 0.0:
+                value = '(%s)' % add(value, '%d' % -int(signal.offset))
+            if signal.factor != 1.0:
+                value = '%s / %d' % (value, int(signal.factor))
+        raw = '(%s)(%s)' % (utype, value)
+
+    return insert(signal, raw)
+
+
+def id_macro(message):
+    if message.ID & 0x80000000:
+        return '(CAN_ID_EXT | 0x%Xu)' % (message.ID & 0x1FFFFFFF)
+    return '(0x%Xu)' % message.ID
+
+
+def generate_message(message, out):
+    prefix = snake_case(message.name)
+    fields = {}
+
+    for signal in message.signals:
+        field = snake_case(signal.name)
+        if field in fields.values():
+            sys.exit('message %s has two signals named %s' % (message.name, field))
+        fields[signal] = field
+
+    multiplexer = [signal for signal in message.signals if signal.mux == 'M']
+    if len(multiplexer) > 1:
+        sys.exit('message %s has more than one multiplexer' % message.name)
+    multiplexer = multiplexer[0] if multiplexer else None
+    values = sorted({signal.mux for signal in message.signals if isinstance(signal.mux, int)})
+
+    out.append('/* %s */' % message.name)
+    out.append('#define %s_ID %s' % (prefix.upper(), id_macro(message)))
+    out.append('')
+    out.append('typedef struct{')
+    for signal in message.signals:
+        comment = ''
+        if signal.mux == 'M':
+            comment = ' /* Multiplexer */'
+        elif signal.mux is not None:
+            comment = ' /* Valid when %s is %d */' % (fields[multiplexer], signal.mux)
+        out.append('\t%s %s;%s' % (field_type(signal), fields[signal], comment))
+    out.append('} %s_t;' % prefix)
+    out.append('')
+
+    # Unpack, every signal unconditionally
+    statements = [unpack_statement(signal, fields[signal]) for signal in message.signals]
+    out.append('static inline void %s_unpack(const frame_t* frame, %s_t* msg)' % (prefix, prefix))
+    out.append('{')
+    swapped = [word for word in ('le0', 'le1') if any(re.search(r'\b%s\b' % word, s) for s in statements)]
+    for word in swapped:
+        out.append('\tuint32_t %s = __builtin_bswap32(frame->payload[%s]);' % (word, word[-1]))
+    if swapped:
+        out.append('')
+    for statement in statements:
+        out.append('\t' + statement)
+    if not message.signals:
+        out.append('\t(void)frame;')
+        out.append('\t(void)msg;')
+    out.append('}')
+    out.append('')
+
+    # Pack, one function per multiplexer value
+    variants = [(None, '')] if multiplexer is None else [(value, '_m%d' % value) for value in values]
+    if multiplexer is not None and not values:
+        variants = [(None, '')]
+
+    for value, suffix in variants:
+        signals = [signal for signal in message.signals
+                   if signal.mux is None or signal.mux == 'M' or signal.mux == value]
+        statements = []
+        for signal in signals:
+            if signal is multiplexer and value is not None:
+                statements += insert_constant(signal, value)
+            else:
+                statements += pack_statements(signal, fields[signal])
+        swapped = [word for word in ('le0', 'le1') if any(re.search(r'\b%s\b' % word, s) for s in statements)]
+
+        if value is not None:
+            out.append('/* Packs %s with %s set to %d */' % (message.name, fields[multiplexer], value))
+        out.append('static inline void %s_pack%s(frame_t* frame, const %s_t* msg)' % (prefix, suffix, prefix))
+        out.append('{')
+        for word in swapped:
+            out.append('\tuint32_t %s = 0;' % word)
+        if swapped:
+            out.append('')
+        out.append('\tframe->ID = %s_ID;' % prefix.upper())
+        out.append('\tframe->payload[0] = 0;')
+        out.append('\tframe->payload[1] = 0;')
+        for statement in statements:
+            out.append('\t' + statement)
+        if swapped:
+            out.append('')
+        for word in swapped:
+            out.append('\tframe->payload[%s] |= __builtin_bswap32(%s);' % (word[-1], word))
+        if not any('msg->' in statement for statement in statements):
+            out.append('\t(void)msg;')
+        out.append('}')
+        out.append('')
+
+
+def generate(messages, source, output):
+    base = os.path.splitext(os.path.basename(output))[0]
+    guard = 'FLEXCAN_INCLUDE_%s_H_' % re.sub(r'\W', '_', base).upper()
+
+    out = ['/**',
+           ' * @file',
+           ' * Pack and unpack functions for the messages of %s' % os.path.basename(source),
+           ' * Generated by tools/dbc_codegen.py, do not edit',
+           ' */',
+           '',
+           '#ifndef %s' % guard,
+           '#define %s' % guard,
+           '',
+           '#include <FlexCAN/include/CAN_RXFIFO.h>',
+           '']
+
+    for message in messages:
+        generate_message(message, out)
+
+    out.append('#endif /* %s */' % guard)
+
+    with open(output, 'w') as header:
+        header.write('\n'.join(out) + '\n')
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Generate frame_t pack and unpack functions from a DBC file')
+    parser.add_argument('dbc', help='the DBC file')
+    parser.add_argument('-o', '--output', help='the header to write, <dbc name>_codec.h by default')
+    args = parser.parse_args()
+
+    output = args.output or os.path.splitext(os.path.basename(args.dbc))[0] + '_codec.h'
+    generate(parse_dbc(args.dbc), args.dbc, output)
+
+
+if __name__ == '__main__':
+    main()